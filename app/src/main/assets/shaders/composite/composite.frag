@@ -0,0 +1,12 @@
+#version 300 es
+precision mediump float;
+uniform sampler2D uScene;
+// Last texel centers inside the scaled region, the rest of the texture holds stale pixels
+uniform vec2 uUvMax;
+in vec2 vUv;
+out vec4 fragColor;
+
+void main() {
+    // Premultiplied, blended with ONE / ONE_MINUS_SRC_ALPHA
+    fragColor = texture(uScene, min(vUv, uUvMax));
+}
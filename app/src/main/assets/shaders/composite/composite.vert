@@ -0,0 +1,11 @@
+#version 300 es
+// Scaled region of the scene target, see SceneTarget
+uniform vec2 uUvScale;
+out vec2 vUv;
+
+void main() {
+    // One triangle covering the screen, corners (0,0) (2,0) (0,2) in uv
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    vUv = corner * uUvScale;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -4,21 +4,78 @@ precision mediump float;
 in vec3 vNormal;
 in vec2 vTexCoord;
 
+/* Built three times, see GLBModelAsync::AlphaMode : opaque (neither define, alpha ignored),
+ * ALPHA_MASK (discard under the material's cutoff) and ALPHA_BLEND (alpha out for blending).
+ * Only the mask variant discards on alpha, the others keep early depth testing effective */
 uniform sampler2D uTexture;
+#ifdef ALPHA_MASK
+uniform float uAlphaCutoff;
+#endif
+
+/* Depth occlusion, see DepthOcclusion::apply */
+uniform int uOcclusionEnabled;
+uniform highp sampler2D uDepthTexture;     // Meters, camera image space
+uniform highp vec2 uDepthUvOrigin;         // Depth uv of the bottom left screen corner
+uniform highp vec2 uDepthUvX;              // Across the screen, left to right
+uniform highp vec2 uDepthUvY;              // Bottom to top
+uniform highp vec2 uInvViewport;
+uniform highp vec2 uNearFar;
+
+/* ARCore environmental HDR estimate, world space, see LightEstimation */
+layout(std140) uniform Lighting {
+    vec4 uMainLightDirection;       // Towards the light
+    vec4 uMainLightIntensity;
+    vec4 uSphericalHarmonics[9];    // Premultiplied for irradiance
+};
 
 out vec4 fragColor;
 
+/* Real surfaces closer than this behind the model don't hide it, absorbs depth noise */
+const highp float kOcclusionBias = 0.05;
+
+vec3 ambientIrradiance(vec3 n) {
+    return uSphericalHarmonics[0].rgb
+         + uSphericalHarmonics[1].rgb * n.y
+         + uSphericalHarmonics[2].rgb * n.z
+         + uSphericalHarmonics[3].rgb * n.x
+         + uSphericalHarmonics[4].rgb * (n.y * n.x)
+         + uSphericalHarmonics[5].rgb * (n.y * n.z)
+         + uSphericalHarmonics[6].rgb * (3.0 * n.z * n.z - 1.0)
+         + uSphericalHarmonics[7].rgb * (n.x * n.z)
+         + uSphericalHarmonics[8].rgb * (n.x * n.x - n.y * n.y);
+}
+
+bool isOccluded() {
+    highp vec2 screen = gl_FragCoord.xy * uInvViewport;
+    highp vec2 depthUv = uDepthUvOrigin + screen.x * uDepthUvX + screen.y * uDepthUvY;
+    highp float realDepth = texture(uDepthTexture, depthUv).r;
+
+    /* View space distance of this fragment, back from the depth buffer value */
+    highp float near = uNearFar.x;
+    highp float far = uNearFar.y;
+    highp float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    highp float fragmentDepth = 2.0 * near * far / (far + near - ndcDepth * (far - near));
+    return fragmentDepth > realDepth + kOcclusionBias;
+}
+
 void main() {
+    if (uOcclusionEnabled != 0 && isOccluded()) discard;
+
     vec4 texColor = texture(uTexture, vTexCoord);
-    if (texColor.a < 0.1) discard;
+#ifdef ALPHA_MASK
+    if (texColor.a < uAlphaCutoff) discard;
+#endif
 
-    /* Simple lighting */
+    /* Lambert main light over the spherical harmonics ambient */
     vec3 normal = normalize(vNormal);
-    vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
-    float diff = max(dot(normal, lightDir), 0.3);
-    vec3 diffuse = diff * vec3(1.0, 1.0, 1.0);
+    float diffuse = max(dot(normal, uMainLightDirection.xyz), 0.0);
+    vec3 light = max(ambientIrradiance(normal), vec3(0.0)) + uMainLightIntensity.rgb * diffuse;
 
-    fragColor = vec4(texColor.rgb * (0.7 + 0.3 * diffuse), texColor.a);
+#ifdef ALPHA_BLEND
+    fragColor = vec4(texColor.rgb * light, texColor.a);
+#else
+    fragColor = vec4(texColor.rgb * light, 1.0);
+#endif
 
 //    fragColor = texColor;
 }
@@ -5,13 +5,23 @@ layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
-uniform mat4 mvp;
+/* Shared camera data, see FrameUniforms */
+layout(std140) uniform Frame {
+    highp mat4 uView;
+    highp mat4 uProjection;
+    highp mat4 uViewProjection;
+    highp vec4 uCameraPosition;
+};
+
+uniform highp mat4 model;
+/* World space normals : inverse transpose of the model matrix, see LightEstimation */
+uniform mat3 normalMatrix;
 
 out vec3 vNormal;
 out vec2 vTexCoord;
 
 void main() {
-    gl_Position = mvp * vec4(aPosition, 1.0);
-    vNormal = mat3(mvp) * aNormal;
+    gl_Position = uViewProjection * model * vec4(aPosition, 1.0);
+    vNormal = normalMatrix * aNormal;
     vTexCoord = aTexCoord;
 }
\ No newline at end of file
@@ -1,6 +1,15 @@
 #version 300 es
 layout(location = 0) in vec3 vPosition;
-uniform mat4 mvp;
+
+/* Shared camera data, see FrameUniforms */
+layout(std140) uniform Frame {
+    highp mat4 uView;
+    highp mat4 uProjection;
+    highp mat4 uViewProjection;
+    highp vec4 uCameraPosition;
+};
+
 void main() {
-    gl_Position = mvp * vec4(vPosition, 1.0);
-}
\ No newline at end of file
+    /* Plane polygons are already in world space */
+    gl_Position = uViewProjection * vec4(vPosition, 1.0);
+}
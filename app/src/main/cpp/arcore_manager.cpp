@@ -18,8 +18,12 @@
 
 void ARCoreManager::loadModelFromIntent(const std::string &path) {
     LOGI("SANJU : ARCoreManager::loadModelFromIntent");
-    glb_model.mState = GLBModelAsync::NOT_LOADED;
-    glb_model.load(path);
+    /* Supersedes a load that may still be running, its result will be dropped */
+    GLBModelAsync::LoadOptions options;
+    options.pickable = true;
+    glb_model.load(path, options);
+    /* Picks were on the previous model's triangles */
+    model_picked = false;
 }
 
 /* Runs on the main thread */
@@ -30,6 +34,7 @@ bool ARCoreManager::Initialize(void *env, jobject context, AAssetManager* mgr) {
         LOGE("NAT_ERROR : Asset manager is null");
         return false;
     }
+    conversion_service.setAssetManager(mgr);
 
     if(ar_session) return true;
 
@@ -44,6 +49,22 @@ bool ARCoreManager::Initialize(void *env, jobject context, AAssetManager* mgr) {
     }
 
     ArFrame_create(ar_session, &ar_frame);
+
+    /* Occlusion needs depth images, which are only produced once a depth mode is configured.
+     * The model is lit by the environmental HDR estimate (main light + spherical harmonics) */
+    ArConfig* ar_config = nullptr;
+    ArConfig_create(ar_session, &ar_config);
+    ArSession_getConfig(ar_session, ar_config);
+    bool depth_supported = IsDepthSupported();
+    if(depth_supported) ArConfig_setDepthMode(ar_session, ar_config, AR_DEPTH_MODE_AUTOMATIC);
+    ArConfig_setLightEstimationMode(ar_session, ar_config, AR_LIGHT_ESTIMATION_MODE_ENVIRONMENTAL_HDR);
+    ArStatus config_status = ArSession_configure(ar_session, ar_config);
+    ArConfig_destroy(ar_config);
+    if(config_status != AR_SUCCESS) {
+        LOGE("NAT_ERROR : ArSession_configure failed with status : %d", config_status);
+    }
+    depth_occlusion_enabled = depth_supported && config_status == AR_SUCCESS;
+    LOGI("SANJU : Depth occlusion %s", depth_occlusion_enabled ? "enabled" : "unavailable");
     return true;
 }
 
@@ -57,11 +78,88 @@ void ARCoreManager::Pause() {
     LOGI("SANJU : ArSession_pause");
 }
 
+/* Starts writing camera frames and sensor data of the running session into an MP4 dataset */
+bool ARCoreManager::StartRecording(const std::string &datasetUri) {
+    if(!ar_session) return false;
+
+    ArRecordingConfig* recording_config = nullptr;
+    ArRecordingConfig_create(ar_session, &recording_config);
+    ArRecordingConfig_setMp4DatasetUri(ar_session, recording_config, datasetUri.c_str());
+    ArRecordingConfig_setAutoStopOnPause(ar_session, recording_config, 1);
+
+    ArStatus status = ArSession_startRecording(ar_session, recording_config);
+    ArRecordingConfig_destroy(recording_config);
+
+    if(status != AR_SUCCESS) {
+        LOGE("NAT_ERROR : ArSession_startRecording failed with status : %d", status);
+        return false;
+    }
+    LOGI("SANJU : Recording to %s", datasetUri.c_str());
+    return true;
+}
+
+bool ARCoreManager::StopRecording() {
+    if(!ar_session) return false;
+
+    ArStatus status = ArSession_stopRecording(ar_session);
+    if(status != AR_SUCCESS) {
+        LOGE("NAT_ERROR : ArSession_stopRecording failed with status : %d", status);
+        return false;
+    }
+    return true;
+}
+
+/* ARCore only accepts a playback dataset while the session is paused, i.e. before Resume() */
+bool ARCoreManager::SetPlaybackDataset(const std::string &datasetUri) {
+    if(!ar_session) return false;
+
+    ArStatus status = ArSession_setPlaybackDatasetUri(ar_session, datasetUri.empty() ? nullptr : datasetUri.c_str());
+    if(status != AR_SUCCESS) {
+        LOGE("NAT_ERROR : ArSession_setPlaybackDatasetUri failed with status : %d", status);
+        return false;
+    }
+    LOGI("SANJU : Playback dataset set to %s", datasetUri.c_str());
+    return true;
+}
+
+/* Runs on the GL thread */
+void ARCoreManager::StartBenchmark(const std::string &reportPath) {
+    frame_stats.begin(reportPath);
+    frame_pacer.resetCounts();
+}
+
+/* Runs on the GL thread */
+bool ARCoreManager::StopBenchmark() {
+    /* Vsyncs of the run that were rendered or skipped, what the pacing saved */
+    FramePacer::Counts counts = frame_pacer.counts();
+    LOGI("SANJU : Frames rendered = %llu | skipped unchanged = %llu | skipped by cap = %llu",
+         (unsigned long long)counts.rendered, (unsigned long long)counts.skippedUnchanged, (unsigned long long)counts.skippedCap);
+    if(frame_stats.isActive()) {
+        frame_stats.recordEvent("frames_rendered", (double)counts.rendered);
+        frame_stats.recordEvent("frames_skipped_unchanged", (double)counts.skippedUnchanged);
+        frame_stats.recordEvent("frames_skipped_cap", (double)counts.skippedCap);
+    }
+    return frame_stats.end();
+}
+
+/* Runs on the main thread */
+bool ARCoreManager::ShouldRender(int64_t vsyncNs) {
+    /* 0 on the synchronous path, where the GL thread's ArSession_update waits for new images */
+    int64_t latest_camera_ns = tracking_pipeline.publishedTimestamp();
+    GLBModelAsync::State model_state = glb_model.state();
+    bool loading = model_state == GLBModelAsync::LOADING || model_state == GLBModelAsync::STREAMING;
+    return frame_pacer.onVsync(vsyncNs, latest_camera_ns, loading) == FramePacer::RENDER;
+}
+
 /* Runs on the GL thread */
 void ARCoreManager::OnSurfaceCreated() {
     LOGI("SANJU : ARCoreManager::OnSurfaceCreated");
     LOG_TID("THREAD_TEST : Thread of OnSurfaceCreated");
 
+    /* A new surface means a new render context : the tracking thread's textures went with the old
+     * one, and it must be off the session before the camera texture below is handed to ARCore */
+    tracking_pipeline.forget();
+
     std::string planeVertexShaderCode = LoadShaderFromAsset("shaders/plane/plane.vert");
     const char* planeVertexShaderSource = planeVertexShaderCode.c_str();
 
@@ -84,25 +182,21 @@ void ARCoreManager::OnSurfaceCreated() {
 
     /****************** Camera Config Program Starts *************/
 
-    std::string cameraVertexShaderCode = LoadShaderFromAsset("shaders/camera/camera.vert");
-    const char* cameraVertexShaderSource = cameraVertexShaderCode.c_str();
-
-    std::string cameraFragmentShaderCode = LoadShaderFromAsset("shaders/camera/camera.frag");
-    const char* cameraFragmentShaderSource = cameraFragmentShaderCode.c_str();
-
-    /* Compile and link object rendering shaders */
-    GLuint cameraVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(cameraVertexShader, 1, &cameraVertexShaderSource, nullptr);
-    glCompileShader(cameraVertexShader);
-
-    GLuint cameraFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(cameraFragmentShader, 1, &cameraFragmentShaderSource, nullptr);
-    glCompileShader(cameraFragmentShader);
-
-    camera_shader_program = glCreateProgram();
-    glAttachShader(camera_shader_program, cameraVertexShader);
-    glAttachShader(camera_shader_program, cameraFragmentShader);
-    glLinkProgram(camera_shader_program);
+    if(!background_renderer.create(LoadShaderFromAsset("shaders/camera/camera.vert"),
+                                   LoadShaderFromAsset("shaders/camera/camera.frag"))) {
+        LOGE("NAT_ERROR : Camera background program unavailable");
+    }
+    camera_gpu_timer.create();
+    if(!scene_target.create(LoadShaderFromAsset("shaders/composite/composite.vert"),
+                            LoadShaderFromAsset("shaders/composite/composite.frag"))) {
+        LOGE("NAT_ERROR : Scene composite program unavailable, 3D passes stay at full resolution");
+    }
+    planes_gpu_timer.create();
+    composite_gpu_timer.create();
+    resolution_controller.reset();
+    depth_occlusion.reset();
+    light_estimation.create();
+    frame_uniforms.create();
 
     glGenTextures(1, &cameraTextureId);
     glBindTexture(GL_TEXTURE_EXTERNAL_OES, cameraTextureId);
@@ -114,82 +208,18 @@ void ARCoreManager::OnSurfaceCreated() {
     /* Set texture for ARCore */
     ArSession_setCameraTextureName(ar_session, cameraTextureId);
 
-    float quad_vertices[] = {
-            // positions                //tex coords
-            -1.0f, -1.0f,   0.0f, 1.0f,
-            1.0f, -1.0f,   1.0f, 1.0f,
-            -1.0f,  1.0f,   0.0f, 0.0f,
-            1.0f,  1.0f,   1.0f, 0.0f
-    };
-
-    glGenVertexArrays(1, &camera_vao);
-    glBindVertexArray(camera_vao);
-
-    glGenBuffers(1, &camera_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, camera_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);   // Position
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);   // Texture
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-
-    glBindVertexArray(0);
-
     /****************** Camera Config Program Ends *************/
 
 
     /****************** Model Config Starts *****************/
 
     std::string modelVertexShaderCode = LoadShaderFromAsset("shaders/model/model.vert");
-    const char* modelVertexShaderSource = modelVertexShaderCode.c_str();
-
     std::string modelFragmentShaderCode = LoadShaderFromAsset("shaders/model/model.frag");
-    const char* modelFragmentShaderSource = modelFragmentShaderCode.c_str();
-
-    // Compile and link shaders
-    GLuint modelVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(modelVertexShader, 1, &modelVertexShaderSource, nullptr);
-    glCompileShader(modelVertexShader);
-
-    /* Checking for error */
-    GLint status = 0;
-    glGetShaderiv(modelVertexShader, GL_COMPILE_STATUS, &status);
-    if(status == GL_FALSE) {
-        GLint logLen = 0;;
-        glGetShaderiv(modelVertexShader, GL_INFO_LOG_LENGTH, &logLen);
-        std::vector<char> log(logLen);
-        glGetShaderInfoLog(modelVertexShader, logLen, nullptr, log.data());
-        LOGI("SANJU : Failed to compile modelvertexshader : %s", log.data());
-    }
-
-    GLuint modelFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(modelFragmentShader, 1, &modelFragmentShaderSource, nullptr);
-    glCompileShader(modelFragmentShader);
-
-    /* Checking for error */
-    glGetShaderiv(modelFragmentShader, GL_COMPILE_STATUS, &status);
-    if(status == GL_FALSE) {
-        GLint logLen = 0;
-        glGetShaderiv(modelFragmentShader, GL_INFO_LOG_LENGTH, &logLen);
-        std::vector<char> log(logLen);
-        glGetShaderInfoLog(modelFragmentShader, logLen, nullptr, log.data());
-        LOGI("SANJU : Failed to compile modelfragmentshader : %s", log.data());
-    }
 
-    model_shader_program = glCreateProgram();
-    glAttachShader(model_shader_program, modelVertexShader);
-    glAttachShader(model_shader_program, modelFragmentShader);
-    glLinkProgram(model_shader_program);
-
-    /* Checking for error */
-    glGetProgramiv(model_shader_program, GL_LINK_STATUS, &status);
-    if(status == GL_FALSE) {
-        GLint logLen = 0;;
-        glGetProgramiv(model_shader_program, GL_INFO_LOG_LENGTH, &logLen);
-        std::vector<char> log(logLen);
-        glGetProgramInfoLog(model_shader_program, logLen, nullptr, log.data());
-        LOGI("SANJU : Failed to link model_shader_program : %s", log.data());
+    /* One variant per model pass, in GLBModelAsync::AlphaMode order */
+    const char* modelVariants[GLBModelAsync::ALPHA_MODE_COUNT] = { nullptr, "ALPHA_MASK", "ALPHA_BLEND" };
+    for(int mode = 0; mode < GLBModelAsync::ALPHA_MODE_COUNT; mode++) {
+        model_shader_programs[mode] = CreateModelProgram(modelVertexShaderCode, modelFragmentShaderCode, modelVariants[mode]);
     }
 
 
@@ -221,12 +251,56 @@ void ARCoreManager::OnSurfaceCreated() {
 //        return;
 //    }
 
-    glb_model.setProgram(model_shader_program);
+    glb_model.setPrograms(model_shader_programs);
+    /* The upload context has to share with this new one too */
+    glb_model.setBackgroundUploads(background_uploads_requested);
+    for(GLuint program : model_shader_programs) {
+        LightEstimation::Attach(program);
+        FrameUniforms::Attach(program);
+    }
+    FrameUniforms::Attach(plane_shader_program);
 //    glb_model.load(asset_manager, "models/test_jepp.glb");
 //    glb_model.load(asset_manager, model_path_);
     /****************** Model Config Ends *****************/
 
+    /* The plane layout never changes, only the buffer contents do */
+    glGenVertexArrays(1, &plane_vao);
+    glBindVertexArray(plane_vao);
     glGenBuffers(1, &plane_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, plane_vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    /* The tracking thread shares its context with this one */
+    if(tracking_pipeline_requested) {
+        tracking_pipeline.start(ar_session, cameraTextureId);
+    }
+}
+
+/* Runs on the GL thread */
+void ARCoreManager::SetTrackingPipelineEnabled(bool enabled) {
+    tracking_pipeline_requested = enabled;
+    frame_pacer.markDirty();
+
+    /* Without a current context (surface not created yet) OnSurfaceCreated picks the request up */
+    if(!enabled) {
+        tracking_pipeline.stop();
+    } else if(ar_session && eglGetCurrentContext() != EGL_NO_CONTEXT) {
+        tracking_pipeline.start(ar_session, cameraTextureId);
+    }
+}
+
+/* Runs on the GL thread */
+void ARCoreManager::SetBackgroundUploadsEnabled(bool enabled) {
+    background_uploads_requested = enabled;
+
+    /* Without a current context (surface not created yet) OnSurfaceCreated picks the request up */
+    if(eglGetCurrentContext() == EGL_NO_CONTEXT) return;
+    if(!glb_model.setBackgroundUploads(enabled) && enabled) {
+        LOGE("NAT_ERROR : Background uploads unavailable, the model uploads on the GL thread");
+    }
 }
 
 /* Runs on the GL thread */
@@ -234,123 +308,204 @@ void ARCoreManager::OnDrawFrame(int width, int height, int displayRotation) {
 //    LOG_TID("THREAD_TEST : Thread of OnDrawFrame");
     if(!ar_session) return;
 
+    FrameStats::ScopedTimer frame_timer(frame_stats, FrameStats::STAGE_FRAME);
+
     screen_width = width;
     screen_height = height;
 
-    ArSession_setDisplayGeometry(ar_session, displayRotation, width, height);
-    ArStatus status = ArSession_update(ar_session, ar_frame);
-
-    ArCamera* camera;
-    ArFrame_acquireCamera(ar_session, ar_frame, &camera);
-    ArCamera_getViewMatrix(ar_session, camera, glm::value_ptr(view));
-    ArCamera_getProjectionMatrix(ar_session, camera, /*near*/ 0.1f, /*far*/ 100.0f, glm::value_ptr(proj));
-    ArCamera_release(camera);
-    mvp = proj * view;
-
-    /* Render camera frame image texture using OpenGL */
-    glUseProgram(camera_shader_program);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glDisable(GL_DEPTH_TEST);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_EXTERNAL_OES, cameraTextureId);
-    glUniform1i(glGetUniformLocation(camera_shader_program, "u_Texture"), 0);
-
-    GLuint rotationLocation = glGetUniformLocation(camera_shader_program, "u_Rotation");
-    glUniform1i(rotationLocation, displayRotation);
+    /* Fall back to the synchronous path if the tracking thread died */
+    if(tracking_pipeline.isRunning() && !tracking_pipeline.isHealthy()) {
+        tracking_pipeline.stop();
+    }
 
-    glBindVertexArray(camera_vao);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-    glUseProgram(0);
-
-    /* Plane detection logic */
-    ArTrackableList* planes;
-    ArTrackableList_create(ar_session, &planes);
-    ArSession_getAllTrackables(ar_session, AR_TRACKABLE_PLANE, planes);
-
-    int count = 0;
-    ArTrackableList_getSize(ar_session, planes, &count);
-
-    /* Check if rest of the code can be optimized using SIMD */
-    for(int i = 0; i < count; i++) {
-        ArTrackable *trackable;
-        ArTrackableList_acquireItem(ar_session, planes, i, &trackable);
-        ArTrackingState state;
-        ArTrackable_getTrackingState(ar_session, trackable, &state);
-
-        if(state == AR_TRACKING_STATE_TRACKING) {
-            /* Process plane data */
-            ArPlane* plane = reinterpret_cast<ArPlane*>(trackable);
-            ArPose* center_pose = nullptr;
-
-            ArPose_create(ar_session, nullptr, &center_pose);
-            ArPlane_getCenterPose(ar_session, plane, center_pose);
-
-            float model_matrix[16];
-            ArPose_getMatrix(ar_session, center_pose, model_matrix);
-
-            float extent_x = 0.0f;
-            float extent_z = 0.0f;
-            ArPlane_getExtentX(ar_session, plane, &extent_x);
-            ArPlane_getExtentZ(ar_session, plane, &extent_z);
-
-            int32_t polygon_size = 0;
-            ArPlane_getPolygonSize(ar_session, plane, &polygon_size);
-            std::vector<float> polygon(polygon_size);
-            ArPlane_getPolygon(ar_session, plane, polygon.data());
-
-            /* Transforming the planes' polygon vertices from local to world coordinates */
-            std::vector<float> world_vertices;
-            for(int i = 0; i < polygon_size; i += 2) {
-                float local_point[3] = { polygon[i], 0.0f, polygon[i + 1]};
-                float world_point[3];
-                TransformPoint(model_matrix, local_point, world_point);
-                world_vertices.push_back(world_point[0]);
-                world_vertices.push_back(world_point[1]);
-                world_vertices.push_back(world_point[2]);
+    /* The update stage is the render thread's wait for tracking data : ArSession_update itself
+     * when synchronous, only picking up the latest published snapshot when pipelined */
+    const TrackingSnapshot* snapshot = &frame_snapshot;
+    {
+        FrameStats::ScopedTimer update_timer(frame_stats, FrameStats::STAGE_UPDATE);
+        if(tracking_pipeline.isRunning()) {
+            tracking_pipeline.setDisplayGeometry(displayRotation, width, height);
+            if(!tracking_pipeline.acquire()) {
+                /* Nothing published yet : a cleared frame, closed like the others */
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                EndFrame();
+                return;
             }
+            snapshot = &tracking_pipeline.latest();
+        } else {
+            ArSession_setDisplayGeometry(ar_session, displayRotation, width, height);
+            ArSession_update(ar_session, ar_frame);
+            TrackingPipeline::CaptureFrame(ar_session, ar_frame, frame_snapshot);
+            TrackingPipeline::UpdateCameraUvs(ar_session, ar_frame, frame_snapshot.camera_uvs);
+        }
+    }
 
-            /* Draw the polygon (plane) */
-            glUseProgram(plane_shader_program);
-            /* Enable depth test */
-            glEnable(GL_DEPTH_TEST);
-            /* Accept fragment if it closer to the camera than the former one */
-            glDepthFunc(GL_LESS);
+    /* The benchmark ends by itself once the playback dataset has been fully replayed */
+    if(frame_stats.isActive()) {
+        ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+        ArSession_getPlaybackStatus(ar_session, &playback_status);
+        if(playback_status == AR_PLAYBACK_FINISHED) {
+            StopBenchmark();
+        }
+    }
 
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    view = snapshot->view;
+    proj = snapshot->proj;
+    frame_camera_ns = snapshot->timestamp_ns;
+    inverse_view = glm::inverse(view);
+    inverse_view_proj = glm::inverse(proj * view);
+    /* ArSession_update binds the camera texture behind the cache's back */
+    gl_state.invalidate();
+
+    /* Camera data for every program, the draws below only supply model matrices */
+    frame_uniforms.update(view, proj);
+
+    /* Hit tests requested by OnTouch while pipelined are answered through the snapshot */
+    if(snapshot->hit_request_id != applied_hit_request_id) {
+        applied_hit_request_id = snapshot->hit_request_id;
+        OnHitResult(snapshot->hit_valid, snapshot->hit_pose_matrix);
+    }
+    /* Taps and gestures queued by the UI thread since the previous frame */
+    ApplyInput();
 
-            GLuint mvpLocation = glGetUniformLocation(plane_shader_program, "mvp");
-            glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+    /* Render camera frame image texture using OpenGL */
+    {
+        FrameStats::ScopedTimer camera_timer(frame_stats, FrameStats::STAGE_CAMERA);
+        camera_gpu_timer.begin();
+        background_renderer.draw(gl_state, *snapshot);
+        /* Lags the frame by a few frames, the timer never waits for the GPU */
+        double camera_gpu_ms = camera_gpu_timer.end();
+        if(camera_gpu_ms >= 0.0) frame_stats.record(FrameStats::STAGE_CAMERA_GPU, camera_gpu_ms);
+    }
 
-            glBindBuffer(GL_ARRAY_BUFFER, plane_vbo);
-            glBufferData(GL_ARRAY_BUFFER, world_vertices.size() * sizeof(float) , world_vertices.data(), GL_STATIC_DRAW);
+    /* Planes and model go offscreen at a reduced scale while their GPU time is over budget */
+    bool offscreen = resolution_controller.scale() < 1.0f && scene_target.begin(gl_state, width, height, resolution_controller.scale());
+    int scene_width = offscreen ? scene_target.viewportWidth() : width;
+    int scene_height = offscreen ? scene_target.viewportHeight() : height;
+    /* GPU time of the scaled passes that came in this frame, -1 while none did */
+    double scene_gpu_ms = -1.0;
+    auto add_scene_gpu = [&scene_gpu_ms](double ms) {
+        if(ms >= 0.0) scene_gpu_ms = (scene_gpu_ms < 0.0 ? 0.0 : scene_gpu_ms) + ms;
+    };
 
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    /* Plane rendering, the world space polygons were collected with the snapshot */
+    if(!snapshot->plane_vertex_counts.empty()) {
+        FrameStats::ScopedTimer planes_timer(frame_stats, FrameStats::STAGE_PLANES);
+        planes_gpu_timer.begin();
+
+        /* One upload for all planes of the frame */
+        gl_state.bindBuffer(GL_ARRAY_BUFFER, plane_vbo);
+        glBufferData(GL_ARRAY_BUFFER, snapshot->plane_vertices.size() * sizeof(float), snapshot->plane_vertices.data(), GL_STREAM_DRAW);
+
+        /* Same state for every plane : depth tested, translucent */
+        gl_state.useProgram(plane_shader_program);
+        gl_state.bindVertexArray(plane_vao);
+        gl_state.setEnabled(GL_DEPTH_TEST, true);
+        gl_state.depthFunc(GL_LESS);
+        gl_state.depthMask(true);
+        gl_state.setEnabled(GL_BLEND, true);
+        /* Alpha accumulates coverage for the composite, see SceneTarget */
+        gl_state.blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        GLint first = 0;
+        for(int32_t vertex_count : snapshot->plane_vertex_counts) {
+            glDrawArrays(GL_TRIANGLE_FAN, first, vertex_count);
+            first += vertex_count;
+        }
+        double planes_gpu_ms = planes_gpu_timer.end();
+        if(planes_gpu_ms >= 0.0) frame_stats.record(FrameStats::STAGE_PLANES_GPU, planes_gpu_ms);
+        add_scene_gpu(planes_gpu_ms);
+    }
 
-            glDrawArrays(GL_TRIANGLE_FAN, 0, world_vertices.size() / 3);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glUseProgram(0);
+    {
+        FrameStats::ScopedTimer model_timer(frame_stats, FrameStats::STAGE_MODEL);
+        /* Uploads whatever part of a load is ready, never waits for one */
+        if(glb_model.poll(gl_state)) {
+            const GLBModelAsync::LoadTimeline& timeline = glb_model.loadTimeline();
+            frame_stats.recordEvent("load_first_drawable", timeline.firstDrawable);
+            frame_stats.recordEvent("load_geometry_complete", timeline.geometryComplete);
+            frame_stats.recordEvent("load_ready", timeline.ready);
+            const GLBModelAsync::LoadMemory& memory = glb_model.loadMemory();
+            frame_stats.recordEvent("load_baseline_rss_kb", memory.baselineKb);
+            frame_stats.recordEvent("load_peak_rss_kb", memory.peakKb);
+            frame_stats.recordEvent("load_steady_rss_kb", memory.steadyKb);
+            const GLBModelAsync::LoadTextures& textures = glb_model.loadTextures();
+            frame_stats.recordEvent("load_texture_mb", textures.megabytes);
+            frame_stats.recordEvent("load_texture_gl_ms", textures.glThreadMs);
+            if(textures.megabytes > 0.0) frame_stats.recordEvent("load_texture_gl_ms_per_mb", textures.glThreadMs / textures.megabytes);
+        }
+
+        /* Render the object here */
+        if(model_place && glb_model.isDrawable()) {
+            {
+                FrameStats::ScopedTimer depth_timer(frame_stats, FrameStats::STAGE_DEPTH);
+                if(depth_occlusion_enabled) depth_occlusion.update(gl_state, snapshot->depth);
+            }
+            /* Rewritten only when ARCore has a newer estimate */
+            light_estimation.update(snapshot->light);
+
+            glm::mat4 model_matrix = ModelMatrix();
+            /* Lighting is done in world space, the scale may be non uniform */
+            glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model_matrix)));
+
+            bool first_pixel = glb_model.loadTimeline().firstPixel < 0.0;
+            /* Occlusion uniforms are program state, set on each pass's program as it comes up */
+            glb_model.draw(gl_state, glm::value_ptr(model_matrix), glm::value_ptr(normal_matrix),
+                           glm::value_ptr(frame_uniforms.block().cameraPosition), [&](GLuint program) {
+                depth_occlusion.apply(gl_state, program, snapshot->camera_uvs.uvs, scene_width, scene_height,
+                                      TrackingPipeline::kNearPlane, TrackingPipeline::kFarPlane);
+            });
+            /* Fragment cost of each pass, lagging the frame like the camera's */
+            const FrameStats::Stage pass_stages[GLBModelAsync::ALPHA_MODE_COUNT] = {
+                    FrameStats::STAGE_MODEL_OPAQUE_GPU, FrameStats::STAGE_MODEL_MASK_GPU, FrameStats::STAGE_MODEL_BLEND_GPU
+            };
+            for(int mode = 0; mode < GLBModelAsync::ALPHA_MODE_COUNT; mode++) {
+                double pass_gpu_ms = glb_model.passGpuMs((GLBModelAsync::AlphaMode)mode);
+                if(pass_gpu_ms >= 0.0) frame_stats.record(pass_stages[mode], pass_gpu_ms);
+                add_scene_gpu(pass_gpu_ms);
+            }
+            /* Headline load metric, from load() to the first frame showing anything of the model */
+            if(first_pixel) frame_stats.recordEvent("load_first_pixel", glb_model.loadTimeline().firstPixel);
         }
-        ArTrackable_release(trackable);
     }
-    ArTrackableList_destroy(planes);
 
-    if(glb_model.mState == GLBModelAsync::LOADED) {
-        glb_model.update();
+    if(offscreen) {
+        scene_target.end();
+        composite_gpu_timer.begin();
+        scene_target.composite(gl_state);
+        double composite_gpu_ms = composite_gpu_timer.end();
+        if(composite_gpu_ms >= 0.0) frame_stats.record(FrameStats::STAGE_COMPOSITE_GPU, composite_gpu_ms);
+    }
+    /* The composite runs at full resolution whatever the scale, it isn't part of the budget */
+    if(resolution_controller.addSample(scene_gpu_ms)) {
+        LOGI("SANJU : Scene render scale %.2f (3D passes averaging %.2f ms on the GPU)",
+             resolution_controller.scale(), resolution_controller.averageMs());
     }
+    FrameStats::Count(FrameStats::COUNTER_SCENE_SCALE, (unsigned int)(resolution_controller.scale() * 100.0f + 0.5f));
 
-    /* Render the object here */
-    if(model_place && glb_model.mState == GLBModelAsync::READY) {
-        glm::mat4 model_pose_matrix = hit_pose_matrix;
-        glm::mat4 model_scale = glm::scale(glm::mat4(1.0f), glm::vec3(scaling_factor));
-        glm::mat4 model_rotation = glm::rotate(glm::mat4(1.0f), cube_rotation_angle, cube_rotation_axis);
-        glm::mat4 model_flip_axis = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 model_translation = glm::translate(glm::mat4(1.0f), cube_translation_vector);
-        glm::mat4 model_mvp = proj * view * model_translation * model_pose_matrix  * model_rotation * model_scale;
+    frame_uniforms.endFrame();
+    EndFrame();
+}
 
-        glb_model.draw(glm::value_ptr(model_mvp));
+/* Runs on the GL thread, last thing of every OnDrawFrame that got past the session check */
+void ARCoreManager::EndFrame() {
+    /* A cleared frame repeats the previous camera, the stillness stays as it was */
+    frame_pacer.onFrameRendered(frame_camera_ns, view);
+    FrameStats::Count(FrameStats::COUNTER_STATE_CALLS, (unsigned int)gl_state.counters().issued);
+    FrameStats::Count(FrameStats::COUNTER_STATE_SKIPPED, (unsigned int)gl_state.counters().skipped);
+    gl_state.resetCounters();
+
+    /* Up to the end of the frame's GL commands : the swap and the compositor come on top */
+    if(drag_motion_event_ns > 0) {
+        /* Same clock as MotionEvent times */
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double latency_ms = ((int64_t)now.tv_sec * 1000000000 + now.tv_nsec - drag_motion_event_ns) / 1e6;
+        if(frame_stats.isActive()) frame_stats.record(FrameStats::STAGE_TOUCH_TO_MOTION, latency_ms);
+        drag_moves++;
+        drag_latency_total_ms += latency_ms;
+        drag_latency_max_ms = std::max(drag_latency_max_ms, latency_ms);
+        drag_motion_event_ns = 0;
     }
-}
\ No newline at end of file
+    frame_stats.endFrame();
+}
@@ -10,6 +10,8 @@
 #include <jni.h>
 #include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <functional>
 #include <vector>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -26,11 +28,35 @@
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 
 #include "model.h"
+#include "frame_stats.h"
+#include "tracking_pipeline.h"
+#include "background_renderer.h"
+#include "gpu_timer.h"
+#include "depth_occlusion.h"
+#include "light_estimation.h"
+#include "frame_uniforms.h"
+#include "gl_state_cache.h"
+#include "frame_pacer.h"
+#include "scene_target.h"
+#include "resolution_controller.h"
+#include "input_queue.h"
+#include "conversion_service.h"
 //#include <glb_renderer.h>
 #include <glb_renderer_async.h>
 
 class ARCoreManager {
 public:
+    /* A triangle picked on the placed model, see OnLongPress() */
+    struct PickResult {
+        uint32_t mesh = 0;
+        uint32_t triangle = 0;
+        /* World space, where the touch ray met the triangle */
+        glm::vec3 point = glm::vec3(0.0f);
+        /* Meters to the previous pick on the same model as it stands now, -1 for the first one */
+        float distance_from_previous = -1.0f;
+    };
+    using PickCallback = std::function<void(const PickResult&)>;
+
     AAssetManager* asset_manager = nullptr;
 
     bool Initialize(void* env, jobject context, AAssetManager* mgr);
@@ -38,18 +64,47 @@ public:
     void Pause();
     void OnSurfaceCreated();
     void OnDrawFrame(int width, int height, int displayRotation);
+    /* UI thread. Only queued, the GL thread applies them at the start of its next frame */
     void OnTouch(float x, float y);
+    /* UI thread. Picks the model's triangle under the point, the pick callback gets it if it hits */
+    void OnLongPress(float x, float y);
     void RotateCube(float degrees);
     void ScaleCube(float scale);
     void TranslateCube(float x, float y, float z);
+    /* phase : 0 start, 1 move, 2 end. eventTimeNs : CLOCK_MONOTONIC time of the touch event */
+    void OnDrag(int phase, float x, float y, int64_t eventTimeNs);
     void DrawVector(glm::vec3 start, glm::vec3 end);
     bool IsDepthSupported();
     static void TransformPoint(const float model_matrix[16], const float local_point[3], float world_point[3]);
     void LoadTextureFromFile(const char* path, GLuint& textureID);
     std::string LoadShaderFromAsset(const char* shaderPath);
+    /* Links the model shader with define (if any) defined at the top of both stages */
+    static GLuint CreateModelProgram(const std::string& vertexCode, const std::string& fragmentCode, const char* define);
     bool ConvertToGLB(const char* inputAssetPath, const char* outputFilePath);
+    ConversionService& GetConversionService() { return conversion_service; }
     void SetModelPath(const std::string& path);
     void loadModelFromIntent(const std::string& path);
+    /* GL thread, the callback runs on it too. An empty one stops the reports */
+    void SetPickCallback(PickCallback callback) { pick_callback = std::move(callback); }
+
+    /* Session recording / playback of ARCore MP4 datasets */
+    bool StartRecording(const std::string& datasetUri);
+    bool StopRecording();
+    bool SetPlaybackDataset(const std::string& datasetUri);
+
+    /* Opt-in : run ArSession_update on a tracking thread instead of the GL thread */
+    void SetTrackingPipelineEnabled(bool enabled);
+    /* Model buffer and texture uploads on a thread with a shared context, see GLUploader */
+    void SetBackgroundUploadsEnabled(bool enabled);
+
+    /* Frame-time benchmark, runs on the GL thread */
+    void StartBenchmark(const std::string& reportPath);
+    bool StopBenchmark();
+
+    /* Main thread, once per display vsync : whether the GL thread should render, see FramePacer */
+    bool ShouldRender(int64_t vsyncNs);
+    /* Any thread. 0 leaves a cap off */
+    void SetFrameRateCaps(int maxFps, int stationaryFps) { frame_pacer.setFrameRateCaps(maxFps, stationaryFps); }
 
 private:
 
@@ -73,16 +128,69 @@ private:
     ArSession* ar_session = nullptr;
     ArFrame* ar_frame = nullptr;
 
+    FrameStats frame_stats;
+
+    ConversionService conversion_service;
+
+    TrackingPipeline tracking_pipeline;
+    bool tracking_pipeline_requested = false;
+    bool background_uploads_requested = false;
+    /* Filled by ArSession_update on the GL thread when not pipelined */
+    TrackingSnapshot frame_snapshot;
+    uint32_t applied_hit_request_id = 0;
+
+    BackgroundRenderer background_renderer;
+    GpuTimer camera_gpu_timer;
+
+    /* Enabled in Initialize() on devices that support depth */
+    bool depth_occlusion_enabled = false;
+    DepthOcclusion depth_occlusion;
+
+    LightEstimation light_estimation;
+    FrameUniforms frame_uniforms;
+    GLStateCache gl_state;
+    FramePacer frame_pacer;
+
+    /* Planes and model render offscreen at the controller's scale when it drops below 1 */
+    SceneTarget scene_target;
+    ResolutionController resolution_controller;
+    GpuTimer planes_gpu_timer;
+    GpuTimer composite_gpu_timer;
+
+    /* UI thread -> GL thread, see OnTouch() and the gesture handlers */
+    InputQueue input_queue;
+
+    void PlaceModel(const float pose_matrix[16]);
+    /* GL thread, once per frame after the update */
+    void ApplyInput();
+    /* GL thread. Feeds the pacer, closes the frame's counters and its stats */
+    void EndFrame();
+    /* plane_change_only : the answer only moves a placed model when it is on another plane */
+    void HitTest(float x, float y, bool plane_change_only);
+    void OnHitResult(bool valid, const float pose_matrix[16]);
+    bool IsOtherPlane(const float pose_matrix[16]) const;
+    void ApplyTranslation(float x, float y, float z);
+    void ApplyDrag(const InputQueue::Command& command);
+    /* World space ray through a screen point, from the frame's cached inverse view projection */
+    void TouchRay(float x, float y, glm::vec3& origin, glm::vec3& direction) const;
+    /* Where the touch ray meets the placement plane. False when it runs off towards the horizon */
+    bool IntersectPlacementPlane(float x, float y, glm::vec3& point) const;
+    /* Placement pose, then the gestures' translation, rotation and scale */
+    glm::mat4 ModelMatrix() const;
+    /* GL thread. Selects the placed model's triangle under a screen point and reports it to the
+     * pick callback. False when the ray misses the model or its BVH isn't built yet */
+    bool PickModel(float x, float y);
+
     int32_t screen_width = 0;
     int32_t screen_height = 0;
 
     GLfloat scaling_factor = 0.05;
 
     GLuint plane_shader_program;
-    GLuint camera_shader_program;
     GLuint object_shader_program;
     GLuint axis_shader_program;
-    GLuint model_shader_program;
+    /* By GLBModelAsync::AlphaMode */
+    GLuint model_shader_programs[GLBModelAsync::ALPHA_MODE_COUNT];
 
     GLuint axis_vao;
     GLuint axis_vbo;
@@ -95,9 +203,6 @@ private:
     GLuint plane_vao;
     GLuint plane_vbo;
 
-    GLuint camera_vao;
-    GLuint camera_vbo;
-
     GLuint test_vao;
     GLuint test_vbo;
 
@@ -118,7 +223,31 @@ private:
     glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view = glm::mat4(1.0f);
     glm::mat4 proj = glm::mat4(1.0f);
-    glm::mat4 mvp = glm::mat4(1.0f);
+    /* Camera timestamp of the latest snapshot drawn, kept over frames that had none */
+    int64_t frame_camera_ns = 0;
+    /* Inverted once per frame, not per touch event */
+    glm::mat4 inverse_view = glm::mat4(1.0f);
+    glm::mat4 inverse_view_proj = glm::mat4(1.0f);
+
+    /* Drag in progress : where the touch ray first met the placement plane, and the translation then */
+    bool dragging = false;
+    glm::vec3 drag_start_point = glm::vec3(0.0f);
+    glm::vec3 drag_start_translation = glm::vec3(0.0f);
+    /* Event time of the newest drag move applied this frame, 0 when none was */
+    int64_t drag_motion_event_ns = 0;
+    int drag_moves = 0;
+    double drag_latency_total_ms = 0.0;
+    double drag_latency_max_ms = 0.0;
+    /* Flag of the latest hit test request, see HitTest() */
+    bool hit_plane_change_only = false;
+
+    /* Latest triangle picked on the model, see PickModel(). The point is in model space so it
+     * follows the model when it moves, until another model is loaded */
+    bool model_picked = false;
+    uint32_t picked_mesh = 0;
+    uint32_t picked_triangle = 0;
+    glm::vec3 picked_point = glm::vec3(0.0f);
+    PickCallback pick_callback;
 
 };
 #endif //MY_NATIVE_APP_ARCORE_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,898 @@
+#include "arcore_sim.h"
+#include "arcore_c_api.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Everything ARCore hands out as an opaque pointer is defined here. Trackables are owned by the
+ * session and keep their address across frames, just like the real long-lived ARCore objects.
+ */
+
+namespace {
+
+struct SimPlane {
+    int32_t id = 0;
+    float pose_raw[7] = {0, 0, 0, 1, 0, 0, 0};
+    float extent_x = 0.0f;
+    float extent_z = 0.0f;
+    std::vector<float> polygon;
+};
+
+struct SimFrameData {
+    int64_t timestamp_ns = 0;
+    float camera_pose_raw[7] = {0, 0, 0, 1, 0, 0, 0};
+    std::vector<SimPlane> planes;
+};
+
+std::vector<SimFrameData> g_trace;
+int32_t g_frame_index = -1;
+
+glm::mat4 PoseRawToMatrix(const float pose_raw[7]) {
+    /* ARCore raw pose is qx, qy, qz, qw, tx, ty, tz */
+    glm::quat q(pose_raw[3], pose_raw[0], pose_raw[1], pose_raw[2]);
+    glm::mat4 m = glm::mat4_cast(q);
+    m[3] = glm::vec4(pose_raw[4], pose_raw[5], pose_raw[6], 1.0f);
+    return m;
+}
+
+void MatrixToPoseRaw(const glm::mat4& m, float pose_raw[7]) {
+    glm::quat q = glm::quat_cast(glm::mat3(m));
+    pose_raw[0] = q.x;
+    pose_raw[1] = q.y;
+    pose_raw[2] = q.z;
+    pose_raw[3] = q.w;
+    pose_raw[4] = m[3][0];
+    pose_raw[5] = m[3][1];
+    pose_raw[6] = m[3][2];
+}
+
+void BuildSyntheticTrace(int32_t frame_count) {
+    g_trace.clear();
+    if(frame_count <= 0) frame_count = 1;
+
+    /* A 4m x 4m floor 1.2m below the starting camera, with the camera orbiting its center */
+    SimPlane floor_plane;
+    floor_plane.id = 1;
+    floor_plane.pose_raw[5] = -1.2f;
+    floor_plane.pose_raw[6] = -1.5f;
+    floor_plane.extent_x = 4.0f;
+    floor_plane.extent_z = 4.0f;
+    floor_plane.polygon = { -2.0f, -2.0f,  2.0f, -2.0f,  2.0f, 2.0f,  -2.0f, 2.0f };
+
+    const glm::vec3 target(floor_plane.pose_raw[4], floor_plane.pose_raw[5], floor_plane.pose_raw[6]);
+    for(int32_t i = 0; i < frame_count; i++) {
+        float angle = 0.5f * std::sin(2.0f * glm::pi<float>() * (float)i / (float)frame_count);
+        glm::vec3 eye = target + glm::vec3(1.5f * std::sin(angle), 1.2f, 1.5f * std::cos(angle));
+        glm::mat4 view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        SimFrameData frame;
+        frame.timestamp_ns = (int64_t)i * 33333333LL + 1;
+        MatrixToPoseRaw(glm::inverse(view), frame.camera_pose_raw);
+        frame.planes.push_back(floor_plane);
+        g_trace.push_back(frame);
+    }
+    g_frame_index = -1;
+}
+
+void EnsureTrace() {
+    if(!g_trace.empty()) return;
+
+    /* ARCORE_SIM_TRACE lets a CI job pick the recording without touching the app code */
+    const char* trace_path = getenv("ARCORE_SIM_TRACE");
+    if(trace_path && ArSim_loadTrace(trace_path)) return;
+    BuildSyntheticTrace(300);
+}
+
+} // namespace
+
+struct ArConfig_ {
+    ArDepthMode depth_mode = AR_DEPTH_MODE_DISABLED;
+    ArLightEstimationMode light_estimation_mode = AR_LIGHT_ESTIMATION_MODE_AMBIENT_INTENSITY;
+    ArPlaneFindingMode plane_finding_mode = AR_PLANE_FINDING_MODE_HORIZONTAL;
+    ArUpdateMode update_mode = AR_UPDATE_MODE_BLOCKING;
+};
+
+struct ArPose_ {
+    float raw[7] = {0, 0, 0, 1, 0, 0, 0};
+};
+
+struct ArTrackable_ {
+    SimPlane plane;
+    ArTrackingState state = AR_TRACKING_STATE_TRACKING;
+};
+
+struct ArTrackableList_ {
+    std::vector<ArTrackable_*> items;
+};
+
+struct ArRecordingConfig_ {
+    std::string dataset_uri;
+    bool auto_stop_on_pause = false;
+};
+
+struct ArSession_ {
+    bool resumed = false;
+    bool playback = false;
+    bool playback_finished = false;
+    std::unique_ptr<std::ofstream> recording;
+    bool recording_auto_stop = false;
+    /* ARCore rotates through the texture names given to setCameraTextureNames */
+    std::vector<uint32_t> camera_textures;
+    size_t camera_texture_index = 0;
+    int32_t rotation = 0;
+    int32_t width = 1;
+    int32_t height = 1;
+    /* Reported by the next frame, like ARCore does */
+    bool display_geometry_changed = true;
+    ArConfig_ config;
+    std::map<int32_t, std::unique_ptr<ArTrackable_>> trackables;
+};
+
+struct ArFrame_ {
+    int64_t timestamp_ns = 0;
+    uint32_t camera_texture = 0;
+    float camera_pose_raw[7] = {0, 0, 0, 1, 0, 0, 0};
+    int32_t width = 1;
+    int32_t height = 1;
+    int32_t rotation = 0;
+    bool display_geometry_changed = false;
+    /* Timestamp of the depth image, 0 when depth is disabled */
+    int64_t depth_timestamp_ns = 0;
+    /* Timestamp of the light estimate, 0 when environmental HDR is disabled */
+    int64_t light_timestamp_ns = 0;
+};
+
+struct ArLightEstimate_ {
+    ArLightEstimateState state = AR_LIGHT_ESTIMATE_STATE_NOT_VALID;
+    int64_t timestamp_ns = 0;
+};
+
+struct ArImage_ {
+    int64_t timestamp_ns = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t row_stride = 0;
+    std::vector<uint8_t> data;
+};
+
+struct ArCamera_ {
+    glm::mat4 pose = glm::mat4(1.0f);
+    float aspect = 1.0f;
+};
+
+struct ArHitResult_ {
+    float pose_raw[7] = {0, 0, 0, 1, 0, 0, 0};
+    float distance = 0.0f;
+    ArTrackable_* trackable = nullptr;
+};
+
+struct ArHitResultList_ {
+    std::vector<ArHitResult_> items;
+};
+
+namespace {
+
+/* Vertical field of view of the simulated camera */
+constexpr float kSimFovY = glm::radians(60.0f);
+
+glm::mat4 FrameProjection(const ArFrame_* frame, float near_plane, float far_plane) {
+    float aspect = frame->height > 0 ? (float)frame->width / (float)frame->height : 1.0f;
+    return glm::perspective(kSimFovY, aspect, near_plane, far_plane);
+}
+
+/* Datasets are trace files here, accept both plain paths and file:// URIs */
+std::string UriToPath(const char* uri) {
+    std::string path(uri);
+    const std::string scheme = "file://";
+    if(path.compare(0, scheme.size(), scheme) == 0) path.erase(0, scheme.size());
+    return path;
+}
+
+void WriteTraceFrame(std::ofstream& out, const SimFrameData& frame) {
+    out << "frame " << frame.timestamp_ns;
+    for(float v : frame.camera_pose_raw) out << ' ' << v;
+    out << '\n';
+    for(const SimPlane& plane : frame.planes) {
+        out << "plane " << plane.id;
+        for(float v : plane.pose_raw) out << ' ' << v;
+        out << ' ' << plane.extent_x << ' ' << plane.extent_z;
+        for(float v : plane.polygon) out << ' ' << v;
+        out << '\n';
+    }
+}
+
+bool PointInPolygon(const std::vector<float>& polygon, float x, float z) {
+    bool inside = false;
+    size_t n = polygon.size() / 2;
+    for(size_t i = 0, j = n - 1; i < n; j = i++) {
+        float xi = polygon[i * 2], zi = polygon[i * 2 + 1];
+        float xj = polygon[j * 2], zj = polygon[j * 2 + 1];
+        if(((zi > z) != (zj > z)) && (x < (xj - xi) * (z - zi) / (zj - zi) + xi)) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+} // namespace
+
+extern "C" {
+
+/* ----------------------------- Simulator control ----------------------------- */
+
+bool ArSim_loadTrace(const char* path) {
+    std::ifstream file(path);
+    if(!file.is_open()) {
+        fprintf(stderr, "arcore_sim : failed to open trace %s\n", path);
+        return false;
+    }
+
+    std::vector<SimFrameData> frames;
+    std::string line;
+    while(std::getline(file, line)) {
+        size_t comment = line.find('#');
+        if(comment != std::string::npos) line.resize(comment);
+        std::istringstream in(line);
+        std::string kind;
+        if(!(in >> kind)) continue;
+
+        if(kind == "frame") {
+            SimFrameData frame;
+            in >> frame.timestamp_ns;
+            for(float& v : frame.camera_pose_raw) in >> v;
+            if(in.fail()) return false;
+            frames.push_back(frame);
+        } else if(kind == "plane") {
+            if(frames.empty()) return false;
+            SimPlane plane;
+            in >> plane.id;
+            for(float& v : plane.pose_raw) in >> v;
+            in >> plane.extent_x >> plane.extent_z;
+            if(in.fail()) return false;
+            float v;
+            while(in >> v) plane.polygon.push_back(v);
+            if(plane.polygon.size() % 2 != 0) return false;
+            frames.back().planes.push_back(plane);
+        } else {
+            return false;
+        }
+    }
+
+    if(frames.empty()) return false;
+    g_trace.swap(frames);
+    g_frame_index = -1;
+    return true;
+}
+
+void ArSim_useSyntheticTrace(int32_t frame_count) {
+    BuildSyntheticTrace(frame_count);
+}
+
+int32_t ArSim_getFrameIndex() {
+    return g_frame_index;
+}
+
+/* ----------------------------- Session ----------------------------- */
+
+ArStatus ArSession_create(void* env, void* context, ArSession** out_session_pointer) {
+    (void)env;
+    (void)context;
+    EnsureTrace();
+    *out_session_pointer = new ArSession_();
+    return AR_SUCCESS;
+}
+
+void ArSession_destroy(ArSession* session) {
+    delete session;
+}
+
+ArStatus ArSession_resume(ArSession* session) {
+    session->resumed = true;
+    return AR_SUCCESS;
+}
+
+ArStatus ArSession_pause(ArSession* session) {
+    session->resumed = false;
+    if(session->recording_auto_stop) session->recording.reset();
+    return AR_SUCCESS;
+}
+
+ArStatus ArSession_configure(ArSession* session, const ArConfig* config) {
+    session->config = *config;
+    return AR_SUCCESS;
+}
+
+void ArSession_getConfig(ArSession* session, ArConfig* out_config) {
+    *out_config = session->config;
+}
+
+void ArSession_setCameraTextureName(ArSession* session, uint32_t texture_id) {
+    session->camera_textures.assign(1, texture_id);
+    session->camera_texture_index = 0;
+}
+
+void ArSession_setCameraTextureNames(ArSession* session, int32_t number_of_textures, const uint32_t* texture_ids) {
+    session->camera_textures.assign(texture_ids, texture_ids + number_of_textures);
+    session->camera_texture_index = 0;
+}
+
+void ArSession_setDisplayGeometry(ArSession* session, int32_t rotation, int32_t width, int32_t height) {
+    if(rotation != session->rotation || width != session->width || height != session->height) {
+        session->display_geometry_changed = true;
+    }
+    session->rotation = rotation;
+    session->width = width;
+    session->height = height;
+}
+
+ArStatus ArSession_update(ArSession* session, ArFrame* out_frame) {
+    if(!session->resumed) return AR_ERROR_SESSION_PAUSED;
+    EnsureTrace();
+
+    /* Playback stops on the last frame of the dataset, the free-running trace loops */
+    if(session->playback && g_frame_index + 1 >= (int32_t)g_trace.size()) {
+        session->playback_finished = true;
+    } else {
+        g_frame_index = (g_frame_index + 1) % (int32_t)g_trace.size();
+    }
+    const SimFrameData& data = g_trace[g_frame_index];
+    if(session->recording) WriteTraceFrame(*session->recording, data);
+
+    out_frame->timestamp_ns = data.timestamp_ns;
+    if(!session->camera_textures.empty()) {
+        out_frame->camera_texture = session->camera_textures[session->camera_texture_index];
+        session->camera_texture_index = (session->camera_texture_index + 1) % session->camera_textures.size();
+    }
+    memcpy(out_frame->camera_pose_raw, data.camera_pose_raw, sizeof(data.camera_pose_raw));
+    out_frame->width = session->width;
+    out_frame->height = session->height;
+    out_frame->rotation = session->rotation;
+    out_frame->display_geometry_changed = session->display_geometry_changed;
+    session->display_geometry_changed = false;
+    /* Depth runs at half the camera rate, like on most devices */
+    if(session->config.depth_mode == AR_DEPTH_MODE_DISABLED) {
+        out_frame->depth_timestamp_ns = 0;
+    } else if(out_frame->depth_timestamp_ns == 0 || g_frame_index % 2 == 0) {
+        out_frame->depth_timestamp_ns = data.timestamp_ns;
+    }
+    /* Light estimates change slowly, a new one every 4 frames */
+    if(session->config.light_estimation_mode != AR_LIGHT_ESTIMATION_MODE_ENVIRONMENTAL_HDR) {
+        out_frame->light_timestamp_ns = 0;
+    } else if(out_frame->light_timestamp_ns == 0 || g_frame_index % 4 == 0) {
+        out_frame->light_timestamp_ns = data.timestamp_ns;
+    }
+
+    /* Planes not present in this frame stop tracking but keep their address */
+    for(auto& entry : session->trackables) {
+        entry.second->state = AR_TRACKING_STATE_STOPPED;
+    }
+    for(const SimPlane& plane : data.planes) {
+        std::unique_ptr<ArTrackable_>& trackable = session->trackables[plane.id];
+        if(!trackable) trackable = std::make_unique<ArTrackable_>();
+        trackable->plane = plane;
+        trackable->state = AR_TRACKING_STATE_TRACKING;
+    }
+    return AR_SUCCESS;
+}
+
+void ArSession_getAllTrackables(const ArSession* session, ArTrackableType filter_type, ArTrackableList* out_trackable_list) {
+    out_trackable_list->items.clear();
+    if(filter_type != AR_TRACKABLE_PLANE && filter_type != AR_TRACKABLE_BASE_TRACKABLE) return;
+    for(const auto& entry : session->trackables) {
+        out_trackable_list->items.push_back(entry.second.get());
+    }
+}
+
+void ArSession_isDepthModeSupported(const ArSession* session, ArDepthMode depth_mode, int32_t* out_is_supported) {
+    (void)session;
+    *out_is_supported = depth_mode != AR_DEPTH_MODE_RAW_DEPTH_ONLY ? 1 : 0;
+}
+
+/* ----------------------------- Recording and playback ----------------------------- */
+
+void ArRecordingConfig_create(const ArSession* session, ArRecordingConfig** out_config) {
+    (void)session;
+    *out_config = new ArRecordingConfig_();
+}
+
+void ArRecordingConfig_destroy(ArRecordingConfig* config) {
+    delete config;
+}
+
+void ArRecordingConfig_setMp4DatasetUri(const ArSession* session, ArRecordingConfig* config, const char* mp4_dataset_uri) {
+    (void)session;
+    config->dataset_uri = mp4_dataset_uri ? mp4_dataset_uri : "";
+}
+
+void ArRecordingConfig_setAutoStopOnPause(const ArSession* session, ArRecordingConfig* config, int32_t config_enabled) {
+    (void)session;
+    config->auto_stop_on_pause = config_enabled != 0;
+}
+
+/* Recording writes the replayed frames back out in the trace format */
+ArStatus ArSession_startRecording(ArSession* session, const ArRecordingConfig* recording_config) {
+    if(session->recording) return AR_ERROR_ILLEGAL_STATE;
+    auto out = std::make_unique<std::ofstream>(UriToPath(recording_config->dataset_uri.c_str()));
+    if(!out->is_open()) return AR_ERROR_RECORDING_FAILED;
+    session->recording = std::move(out);
+    session->recording_auto_stop = recording_config->auto_stop_on_pause;
+    return AR_SUCCESS;
+}
+
+ArStatus ArSession_stopRecording(ArSession* session) {
+    session->recording.reset();
+    return AR_SUCCESS;
+}
+
+void ArSession_getRecordingStatus(ArSession* session, ArRecordingStatus* out_recording_status) {
+    *out_recording_status = session->recording ? AR_RECORDING_OK : AR_RECORDING_NONE;
+}
+
+/* Playback datasets are trace files, see arcore_sim.h */
+ArStatus ArSession_setPlaybackDatasetUri(ArSession* session, const char* mp4_dataset_uri) {
+    if(session->resumed) return AR_ERROR_SESSION_NOT_PAUSED;
+    session->playback_finished = false;
+    if(!mp4_dataset_uri) {
+        session->playback = false;
+        return AR_SUCCESS;
+    }
+    if(!ArSim_loadTrace(UriToPath(mp4_dataset_uri).c_str())) return AR_ERROR_PLAYBACK_FAILED;
+    session->playback = true;
+    return AR_SUCCESS;
+}
+
+void ArSession_getPlaybackStatus(ArSession* session, ArPlaybackStatus* out_playback_status) {
+    if(!session->playback) {
+        *out_playback_status = AR_PLAYBACK_NONE;
+    } else {
+        *out_playback_status = session->playback_finished ? AR_PLAYBACK_FINISHED : AR_PLAYBACK_OK;
+    }
+}
+
+/* ----------------------------- Config ----------------------------- */
+
+void ArConfig_create(const ArSession* session, ArConfig** out_config) {
+    (void)session;
+    *out_config = new ArConfig_();
+}
+
+void ArConfig_destroy(ArConfig* config) {
+    delete config;
+}
+
+void ArConfig_getDepthMode(const ArSession* session, const ArConfig* config, ArDepthMode* depth_mode) {
+    (void)session;
+    *depth_mode = config->depth_mode;
+}
+
+void ArConfig_setLightEstimationMode(const ArSession* session, ArConfig* config, ArLightEstimationMode light_estimation_mode) {
+    (void)session;
+    config->light_estimation_mode = light_estimation_mode;
+}
+
+void ArConfig_setDepthMode(const ArSession* session, ArConfig* config, ArDepthMode mode) {
+    (void)session;
+    config->depth_mode = mode;
+}
+
+/* ----------------------------- Frame and camera ----------------------------- */
+
+void ArFrame_create(const ArSession* session, ArFrame** out_frame) {
+    (void)session;
+    *out_frame = new ArFrame_();
+}
+
+void ArFrame_destroy(ArFrame* frame) {
+    delete frame;
+}
+
+void ArFrame_getTimestamp(const ArSession* session, const ArFrame* frame, int64_t* out_timestamp_ns) {
+    (void)session;
+    *out_timestamp_ns = frame->timestamp_ns;
+}
+
+void ArFrame_getCameraTextureName(const ArSession* session, const ArFrame* frame, uint32_t* out_texture_id) {
+    (void)session;
+    *out_texture_id = frame->camera_texture;
+}
+
+void ArFrame_getDisplayGeometryChanged(const ArSession* session, const ArFrame* frame, int32_t* out_geometry_changed) {
+    (void)session;
+    *out_geometry_changed = frame->display_geometry_changed ? 1 : 0;
+}
+
+/* Only NDC -> normalized texture coordinates (the background quad) is simulated, for a landscape
+ * camera image shown at the frame's display rotation. Other pairs are copied unmodified */
+void ArFrame_transformCoordinates2d(const ArSession* session, const ArFrame* frame,
+                                    ArCoordinates2dType input_coordinates, int32_t number_of_vertices,
+                                    const float* vertices_2d, ArCoordinates2dType output_coordinates,
+                                    float* out_vertices_2d) {
+    (void)session;
+    bool ndc_to_texture = input_coordinates == AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES &&
+                          output_coordinates == AR_COORDINATES_2D_TEXTURE_NORMALIZED;
+    for(int32_t i = 0; i < number_of_vertices; i++) {
+        float x = vertices_2d[i * 2];
+        float y = vertices_2d[i * 2 + 1];
+        if(!ndc_to_texture) {
+            out_vertices_2d[i * 2] = x;
+            out_vertices_2d[i * 2 + 1] = y;
+            continue;
+        }
+        /* Texture v runs top to bottom, then rotate the image into the display */
+        float u = (x + 1.0f) * 0.5f;
+        float v = (1.0f - y) * 0.5f;
+        float out_u, out_v;
+        switch(frame->rotation) {
+            case 1: out_u = u; out_v = v; break;
+            case 2: out_u = 1.0f - v; out_v = u; break;
+            case 3: out_u = 1.0f - u; out_v = 1.0f - v; break;
+            default: out_u = v; out_v = 1.0f - u; break;
+        }
+        out_vertices_2d[i * 2] = out_u;
+        out_vertices_2d[i * 2 + 1] = out_v;
+    }
+}
+
+/* Synthetic 160x120 depth image : rows go from 0.5 m (top) to 8 m (bottom), the first column has
+ * no depth (0). Rows are padded to exercise the row stride */
+ArStatus ArFrame_acquireDepthImage16Bits(const ArSession* session, const ArFrame* frame, ArImage** out_depth_image) {
+    if(session->config.depth_mode == AR_DEPTH_MODE_DISABLED) return AR_ERROR_ILLEGAL_STATE;
+    if(frame->depth_timestamp_ns == 0) return AR_ERROR_NOT_YET_AVAILABLE;
+
+    ArImage_* image = new ArImage_();
+    image->timestamp_ns = frame->depth_timestamp_ns;
+    image->width = 160;
+    image->height = 120;
+    image->row_stride = image->width * 2 + 16;
+    image->data.assign((size_t)image->row_stride * image->height, 0);
+    for(int32_t y = 0; y < image->height; y++) {
+        uint16_t mm = (uint16_t)(500 + (7500 * y) / (image->height - 1));
+        uint16_t* row = reinterpret_cast<uint16_t*>(image->data.data() + (size_t)y * image->row_stride);
+        for(int32_t x = 1; x < image->width; x++) row[x] = mm;
+    }
+    *out_depth_image = image;
+    return AR_SUCCESS;
+}
+
+void ArFrame_acquireCamera(const ArSession* session, const ArFrame* frame, ArCamera** out_camera) {
+    (void)session;
+    ArCamera_* camera = new ArCamera_();
+    camera->pose = PoseRawToMatrix(frame->camera_pose_raw);
+    camera->aspect = frame->height > 0 ? (float)frame->width / (float)frame->height : 1.0f;
+    *out_camera = camera;
+}
+
+void ArCamera_release(ArCamera* camera) {
+    delete camera;
+}
+
+/* ----------------------------- Light estimation ----------------------------- */
+
+void ArLightEstimate_create(const ArSession* session, ArLightEstimate** out_light_estimate) {
+    (void)session;
+    *out_light_estimate = new ArLightEstimate_();
+}
+
+void ArLightEstimate_destroy(ArLightEstimate* light_estimate) {
+    delete light_estimate;
+}
+
+void ArFrame_getLightEstimate(const ArSession* session, const ArFrame* frame, ArLightEstimate* out_light_estimate) {
+    (void)session;
+    out_light_estimate->timestamp_ns = frame->light_timestamp_ns;
+    out_light_estimate->state = frame->light_timestamp_ns ? AR_LIGHT_ESTIMATE_STATE_VALID : AR_LIGHT_ESTIMATE_STATE_NOT_VALID;
+}
+
+void ArLightEstimate_getState(const ArSession* session, const ArLightEstimate* light_estimate,
+                              ArLightEstimateState* out_light_estimate_state) {
+    (void)session;
+    *out_light_estimate_state = light_estimate->state;
+}
+
+void ArLightEstimate_getTimestamp(const ArSession* session, const ArLightEstimate* light_estimate, int64_t* out_timestamp_ns) {
+    (void)session;
+    *out_timestamp_ns = light_estimate->timestamp_ns;
+}
+
+/* A warm overhead light over a neutral grey environment */
+void ArLightEstimate_getEnvironmentalHdrMainLightDirection(const ArSession* session, const ArLightEstimate* light_estimate,
+                                                           float* out_direction_3) {
+    (void)session;
+    (void)light_estimate;
+    glm::vec3 direction = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+    memcpy(out_direction_3, glm::value_ptr(direction), sizeof(float) * 3);
+}
+
+void ArLightEstimate_getEnvironmentalHdrMainLightIntensity(const ArSession* session, const ArLightEstimate* light_estimate,
+                                                           float* out_intensity_3) {
+    (void)session;
+    (void)light_estimate;
+    out_intensity_3[0] = 0.9f;
+    out_intensity_3[1] = 0.85f;
+    out_intensity_3[2] = 0.75f;
+}
+
+void ArLightEstimate_getEnvironmentalHdrAmbientSphericalHarmonics(const ArSession* session, const ArLightEstimate* light_estimate,
+                                                                  float* out_coefficients_27) {
+    (void)session;
+    (void)light_estimate;
+    memset(out_coefficients_27, 0, sizeof(float) * 27);
+    /* DC term only, about 0.5 irradiance once premultiplied */
+    for(int i = 0; i < 3; i++) out_coefficients_27[i] = 1.8f;
+}
+
+/* ----------------------------- Images ----------------------------- */
+
+void ArImage_getWidth(const ArSession* session, const ArImage* image, int32_t* out_width) {
+    (void)session;
+    *out_width = image->width;
+}
+
+void ArImage_getHeight(const ArSession* session, const ArImage* image, int32_t* out_height) {
+    (void)session;
+    *out_height = image->height;
+}
+
+void ArImage_getTimestamp(const ArSession* session, const ArImage* image, int64_t* out_timestamp_ns) {
+    (void)session;
+    *out_timestamp_ns = image->timestamp_ns;
+}
+
+void ArImage_getPlaneRowStride(const ArSession* session, const ArImage* image, int32_t plane_index, int32_t* out_row_stride) {
+    (void)session;
+    *out_row_stride = plane_index == 0 ? image->row_stride : 0;
+}
+
+void ArImage_getPlaneData(const ArSession* session, const ArImage* image, int32_t plane_index,
+                          const uint8_t** out_data, int32_t* out_data_length) {
+    (void)session;
+    *out_data = plane_index == 0 ? image->data.data() : nullptr;
+    *out_data_length = plane_index == 0 ? (int32_t)image->data.size() : 0;
+}
+
+void ArImage_release(ArImage* image) {
+    delete image;
+}
+
+void ArCamera_getTrackingState(const ArSession* session, const ArCamera* camera, ArTrackingState* out_tracking_state) {
+    (void)session;
+    (void)camera;
+    *out_tracking_state = AR_TRACKING_STATE_TRACKING;
+}
+
+void ArCamera_getPose(const ArSession* session, const ArCamera* camera, ArPose* out_pose) {
+    (void)session;
+    MatrixToPoseRaw(camera->pose, out_pose->raw);
+}
+
+void ArCamera_getDisplayOrientedPose(const ArSession* session, const ArCamera* camera, ArPose* out_pose) {
+    ArCamera_getPose(session, camera, out_pose);
+}
+
+void ArCamera_getViewMatrix(const ArSession* session, const ArCamera* camera, float* out_col_major_4x4) {
+    (void)session;
+    glm::mat4 view = glm::inverse(camera->pose);
+    memcpy(out_col_major_4x4, glm::value_ptr(view), sizeof(float) * 16);
+}
+
+void ArCamera_getProjectionMatrix(const ArSession* session, const ArCamera* camera,
+                                  float near, float far, float* dest_col_major_4x4) {
+    (void)session;
+    glm::mat4 proj = glm::perspective(kSimFovY, camera->aspect, near, far);
+    memcpy(dest_col_major_4x4, glm::value_ptr(proj), sizeof(float) * 16);
+}
+
+/* ----------------------------- Poses ----------------------------- */
+
+void ArPose_create(const ArSession* session, const float* pose_raw, ArPose** out_pose) {
+    (void)session;
+    ArPose_* pose = new ArPose_();
+    if(pose_raw) memcpy(pose->raw, pose_raw, sizeof(pose->raw));
+    *out_pose = pose;
+}
+
+void ArPose_destroy(ArPose* pose) {
+    delete pose;
+}
+
+void ArPose_getPoseRaw(const ArSession* session, const ArPose* pose, float* out_pose_raw_7) {
+    (void)session;
+    memcpy(out_pose_raw_7, pose->raw, sizeof(pose->raw));
+}
+
+void ArPose_getMatrix(const ArSession* session, const ArPose* pose, float* out_matrix_col_major_4x4) {
+    (void)session;
+    glm::mat4 m = PoseRawToMatrix(pose->raw);
+    memcpy(out_matrix_col_major_4x4, glm::value_ptr(m), sizeof(float) * 16);
+}
+
+/* ----------------------------- Trackables and planes ----------------------------- */
+
+void ArTrackableList_create(const ArSession* session, ArTrackableList** out_trackable_list) {
+    (void)session;
+    *out_trackable_list = new ArTrackableList_();
+}
+
+void ArTrackableList_destroy(ArTrackableList* trackable_list) {
+    delete trackable_list;
+}
+
+void ArTrackableList_getSize(const ArSession* session, const ArTrackableList* trackable_list, int32_t* out_size) {
+    (void)session;
+    *out_size = (int32_t)trackable_list->items.size();
+}
+
+void ArTrackableList_acquireItem(const ArSession* session, const ArTrackableList* trackable_list,
+                                 int32_t index, ArTrackable** out_trackable) {
+    (void)session;
+    *out_trackable = trackable_list->items[index];
+}
+
+void ArTrackable_release(ArTrackable* trackable) {
+    /* Owned by the session */
+    (void)trackable;
+}
+
+void ArTrackable_getType(const ArSession* session, const ArTrackable* trackable, ArTrackableType* out_trackable_type) {
+    (void)session;
+    (void)trackable;
+    *out_trackable_type = AR_TRACKABLE_PLANE;
+}
+
+void ArTrackable_getTrackingState(const ArSession* session, const ArTrackable* trackable, ArTrackingState* out_tracking_state) {
+    (void)session;
+    *out_tracking_state = trackable->state;
+}
+
+/* ArPlane is the same object as its ArTrackable */
+static const ArTrackable_* AsTrackable(const ArPlane* plane) {
+    return reinterpret_cast<const ArTrackable_*>(plane);
+}
+
+void ArPlane_getType(const ArSession* session, const ArPlane* plane, ArPlaneType* out_plane_type) {
+    (void)session;
+    (void)plane;
+    *out_plane_type = AR_PLANE_HORIZONTAL_UPWARD_FACING;
+}
+
+void ArPlane_acquireSubsumedBy(const ArSession* session, const ArPlane* plane, ArPlane** out_subsumed_by) {
+    (void)session;
+    (void)plane;
+    *out_subsumed_by = nullptr;
+}
+
+void ArPlane_getCenterPose(const ArSession* session, const ArPlane* plane, ArPose* out_pose) {
+    (void)session;
+    memcpy(out_pose->raw, AsTrackable(plane)->plane.pose_raw, sizeof(out_pose->raw));
+}
+
+void ArPlane_getExtentX(const ArSession* session, const ArPlane* plane, float* out_extent_x) {
+    (void)session;
+    *out_extent_x = AsTrackable(plane)->plane.extent_x;
+}
+
+void ArPlane_getExtentZ(const ArSession* session, const ArPlane* plane, float* out_extent_z) {
+    (void)session;
+    *out_extent_z = AsTrackable(plane)->plane.extent_z;
+}
+
+void ArPlane_getPolygonSize(const ArSession* session, const ArPlane* plane, int32_t* out_polygon_size) {
+    (void)session;
+    *out_polygon_size = (int32_t)AsTrackable(plane)->plane.polygon.size();
+}
+
+void ArPlane_getPolygon(const ArSession* session, const ArPlane* plane, float* out_polygon_xz) {
+    (void)session;
+    const std::vector<float>& polygon = AsTrackable(plane)->plane.polygon;
+    memcpy(out_polygon_xz, polygon.data(), polygon.size() * sizeof(float));
+}
+
+/* ----------------------------- Hit testing ----------------------------- */
+
+void ArFrame_hitTest(const ArSession* session, const ArFrame* frame, float pixel_x, float pixel_y,
+                     ArHitResultList* hit_result_list) {
+    hit_result_list->items.clear();
+    if(frame->width <= 0 || frame->height <= 0) return;
+
+    /* Unproject the pixel into a world space ray */
+    glm::mat4 camera_pose = PoseRawToMatrix(frame->camera_pose_raw);
+    glm::mat4 inv_view_proj = glm::inverse(FrameProjection(frame, 0.1f, 100.0f) * glm::inverse(camera_pose));
+    float ndc_x = 2.0f * pixel_x / (float)frame->width - 1.0f;
+    float ndc_y = 1.0f - 2.0f * pixel_y / (float)frame->height;
+    glm::vec4 near_point = inv_view_proj * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+    glm::vec4 far_point = inv_view_proj * glm::vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+    glm::vec3 direction = glm::normalize(glm::vec3(far_point) / far_point.w - origin);
+
+    for(const auto& entry : session->trackables) {
+        ArTrackable_* trackable = entry.second.get();
+        if(trackable->state != AR_TRACKING_STATE_TRACKING) continue;
+
+        glm::mat4 plane_pose = PoseRawToMatrix(trackable->plane.pose_raw);
+        glm::vec3 normal = glm::normalize(glm::vec3(plane_pose[1]));
+        glm::vec3 center = glm::vec3(plane_pose[3]);
+        float denom = glm::dot(normal, direction);
+        if(std::fabs(denom) < 1e-6f) continue;
+
+        float t = glm::dot(center - origin, normal) / denom;
+        if(t <= 0.0f) continue;
+
+        glm::vec3 hit_world = origin + t * direction;
+        glm::vec3 hit_local = glm::vec3(glm::inverse(plane_pose) * glm::vec4(hit_world, 1.0f));
+        if(!PointInPolygon(trackable->plane.polygon, hit_local.x, hit_local.z)) continue;
+
+        /* ARCore reports plane hits with the plane's orientation at the hit point */
+        glm::mat4 hit_pose = plane_pose;
+        hit_pose[3] = glm::vec4(hit_world, 1.0f);
+
+        ArHitResult_ hit;
+        MatrixToPoseRaw(hit_pose, hit.pose_raw);
+        hit.distance = t;
+        hit.trackable = trackable;
+        hit_result_list->items.push_back(hit);
+    }
+
+    std::sort(hit_result_list->items.begin(), hit_result_list->items.end(),
+              [](const ArHitResult_& a, const ArHitResult_& b) { return a.distance < b.distance; });
+}
+
+void ArHitResultList_create(const ArSession* session, ArHitResultList** out_hit_result_list) {
+    (void)session;
+    *out_hit_result_list = new ArHitResultList_();
+}
+
+void ArHitResultList_destroy(ArHitResultList* hit_result_list) {
+    delete hit_result_list;
+}
+
+void ArHitResultList_getSize(const ArSession* session, const ArHitResultList* hit_result_list, int32_t* out_size) {
+    (void)session;
+    *out_size = (int32_t)hit_result_list->items.size();
+}
+
+void ArHitResultList_getItem(const ArSession* session, const ArHitResultList* hit_result_list,
+                             int32_t index, ArHitResult* out_hit_result) {
+    (void)session;
+    *out_hit_result = hit_result_list->items[index];
+}
+
+void ArHitResult_create(const ArSession* session, ArHitResult** out_hit_result) {
+    (void)session;
+    *out_hit_result = new ArHitResult_();
+}
+
+void ArHitResult_destroy(ArHitResult* hit_result) {
+    delete hit_result;
+}
+
+void ArHitResult_getDistance(const ArSession* session, const ArHitResult* hit_result, float* out_distance) {
+    (void)session;
+    *out_distance = hit_result->distance;
+}
+
+void ArHitResult_getHitPose(const ArSession* session, const ArHitResult* hit_result, ArPose* out_pose) {
+    (void)session;
+    memcpy(out_pose->raw, hit_result->pose_raw, sizeof(out_pose->raw));
+}
+
+void ArHitResult_acquireTrackable(const ArSession* session, const ArHitResult* hit_result, ArTrackable** out_trackable) {
+    (void)session;
+    *out_trackable = hit_result->trackable;
+}
+
+} // extern "C"
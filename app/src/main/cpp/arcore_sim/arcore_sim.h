@@ -0,0 +1,45 @@
+#ifndef BUILDING_AR_ARCORE_SIM_H
+#define BUILDING_AR_ARCORE_SIM_H
+
+/*
+ * Host-side stand-in for libarcore_sdk_c.so.
+ *
+ * Implements the subset of arcore_c_api.h used by ARCoreManager (session, frame, camera,
+ * trackables, planes, poses and hit results) and replays either a synthetic trace or a
+ * recorded one, so the native frame loop can run headless on a Linux box.
+ *
+ * Trace file format (plain text, one record per line, '#' starts a comment) :
+ *
+ *   frame <timestamp_ns> <qx> <qy> <qz> <qw> <tx> <ty> <tz>
+ *   plane <id> <qx> <qy> <qz> <qw> <tx> <ty> <tz> <extent_x> <extent_z> <x0> <z0> <x1> <z1> ...
+ *
+ * A 'frame' line starts a new frame with the given camera pose (ARCore raw pose layout).
+ * The 'plane' lines that follow belong to that frame; the polygon is in the plane's local XZ.
+ * Frames are replayed in order, one per ArSession_update, and loop at the end.
+ *
+ * ARCore recording and playback map onto the same format : ArSession_setPlaybackDatasetUri
+ * replays a trace file once (then reports AR_PLAYBACK_FINISHED) and ArSession_startRecording
+ * writes the frames that are being replayed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Replays the trace at path instead of the synthetic one. Returns false if it can't be parsed */
+bool ArSim_loadTrace(const char* path);
+
+/* Generates a camera orbiting a single floor plane, frame_count frames at 30 fps */
+void ArSim_useSyntheticTrace(int32_t frame_count);
+
+/* Index of the frame produced by the last ArSession_update */
+int32_t ArSim_getFrameIndex();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BUILDING_AR_ARCORE_SIM_H
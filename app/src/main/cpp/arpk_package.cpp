@@ -0,0 +1,433 @@
+#include <arpk_package.h>
+
+#include <assimp/scene.h>
+#include <assimp/GltfMaterial.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <job_system.h>
+#include <stb_image.h>
+
+namespace {
+
+constexpr uint32_t kMaxPackedVertices = 65535;
+constexpr uint64_t kDataAlignment = 16;
+
+uint64_t Align(uint64_t offset) {
+    return (offset + kDataAlignment - 1) & ~(kDataAlignment - 1);
+}
+
+/* IEEE half, round to nearest. UVs beyond +-65504 saturate */
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if(((bits >> 23) & 0xFF) == 0xFF) return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    if(exponent >= 31) return (uint16_t)(sign | 0x7BFF);
+    if(exponent <= 0) {
+        /* Subnormal half, or zero */
+        if(exponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if((mantissa >> (shift - 1)) & 1) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    /* Rounding may carry into the exponent, which is still the right result */
+    if(mantissa & 0x1000) half++;
+    return (uint16_t)half;
+}
+
+int8_t PackSnorm8(float value) {
+    value = std::max(-1.0f, std::min(1.0f, value));
+    return (int8_t)std::lround(value * 127.0f);
+}
+
+uint32_t MipCount(uint32_t width, uint32_t height) {
+    uint32_t count = 1;
+    while(width > 1 || height > 1) {
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+        count++;
+    }
+    return count;
+}
+
+/* One draw call worth of vertices and 16 bit indices */
+struct PackedMesh {
+    std::vector<ArpkVertex> vertices;
+    std::vector<uint16_t> indices;
+    int32_t texture = -1;
+    uint8_t alphaMode = 0;
+    uint8_t alphaCutoff = 0;
+};
+
+struct PackedTexture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+    std::vector<uint8_t> texels;    // Every level, level 0 first
+};
+
+void CollectMeshes(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& out) {
+    for(unsigned int i = 0; i < node->mNumMeshes; i++) out.push_back(scene->mMeshes[node->mMeshes[i]]);
+    for(unsigned int i = 0; i < node->mNumChildren; i++) CollectMeshes(node->mChildren[i], scene, out);
+}
+
+/* Same rule as GLBModelAsync::embeddedTextureIndex() */
+int32_t EmbeddedTexture(const aiMesh* mesh, const aiScene* scene) {
+    aiString path;
+    if(scene->mMaterials[mesh->mMaterialIndex]->GetTexture(aiTextureType_DIFFUSE, 0, &path) != AI_SUCCESS) return -1;
+    if(path.C_Str()[0] != '*') return -1;
+    unsigned long index = strtoul(path.C_Str() + 1, nullptr, 10);
+    return index < scene->mNumTextures ? (int32_t)index : -1;
+}
+
+/* Same rule as GLBModelAsync::materialAlphaMode(), in ArpkMesh's encoding */
+void MaterialAlpha(const aiMesh* mesh, const aiScene* scene, uint8_t& outMode, uint8_t& outCutoff) {
+    const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    outMode = 0;
+    outCutoff = 0;
+    aiString mode;
+    if(material->Get(AI_MATKEY_GLTF_ALPHAMODE, mode) != AI_SUCCESS) return;
+    outMode = !strcmp(mode.C_Str(), "MASK") ? 2 : !strcmp(mode.C_Str(), "BLEND") ? 3 : 1;
+    float cutoff = 0.5f;
+    material->Get(AI_MATKEY_GLTF_ALPHACUTOFF, cutoff);
+    outCutoff = (uint8_t)std::max(1L, std::min(255L, std::lround(cutoff * 255.0f)));
+}
+
+ArpkVertex PackVertex(const aiMesh* mesh, unsigned int index) {
+    ArpkVertex vertex{};
+    vertex.position[0] = mesh->mVertices[index].x;
+    vertex.position[1] = mesh->mVertices[index].y;
+    vertex.position[2] = mesh->mVertices[index].z;
+    if(mesh->mNormals) {
+        vertex.normal[0] = PackSnorm8(mesh->mNormals[index].x);
+        vertex.normal[1] = PackSnorm8(mesh->mNormals[index].y);
+        vertex.normal[2] = PackSnorm8(mesh->mNormals[index].z);
+    }
+    if(mesh->mTextureCoords[0]) {
+        vertex.uv[0] = FloatToHalf(mesh->mTextureCoords[0][index].x);
+        vertex.uv[1] = FloatToHalf(mesh->mTextureCoords[0][index].y);
+    }
+    return vertex;
+}
+
+/*
+ * Splits a mesh into pieces addressable with 16 bit indices. Vertices are renumbered in order of
+ * first use by the index stream, which also keeps the vertex fetches of a draw sequential.
+ */
+void PackMesh(const aiMesh* mesh, int32_t texture, std::vector<PackedMesh>& out) {
+    std::vector<uint32_t> remap(mesh->mNumVertices);
+    std::vector<uint32_t> remapOwner(mesh->mNumVertices, 0);
+    uint32_t piece = 1;
+    PackedMesh current;
+
+    auto flush = [&]() {
+        if(current.indices.empty()) return;
+        current.texture = texture;
+        out.push_back(std::move(current));
+        current = PackedMesh();
+    };
+
+    for(unsigned int f = 0; f < mesh->mNumFaces; f++) {
+        const aiFace& face = mesh->mFaces[f];
+        /* Points and lines left over by aiProcess_Triangulate aren't drawn by the loader either */
+        if(face.mNumIndices != 3) continue;
+
+        if(current.vertices.size() + 3 > kMaxPackedVertices) {
+            flush();
+            piece++;
+        }
+        for(unsigned int j = 0; j < 3; j++) {
+            unsigned int index = face.mIndices[j];
+            if(remapOwner[index] != piece) {
+                remapOwner[index] = piece;
+                remap[index] = (uint32_t)current.vertices.size();
+                current.vertices.push_back(PackVertex(mesh, index));
+            }
+            current.indices.push_back((uint16_t)remap[index]);
+        }
+    }
+    flush();
+}
+
+/* RGBA8 level 0 plus a 2x2 box filtered chain down to 1x1 */
+bool PackTexture(const aiTexture* texture, PackedTexture& out) {
+    int width = 0, height = 0, channels = 0;
+    std::vector<uint8_t> level;
+    if(texture->mHeight == 0) {
+        unsigned char* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(texture->pcData),
+                (int)texture->mWidth, &width, &height, &channels, STBI_rgb_alpha);
+        if(!pixels) return false;
+        level.assign(pixels, pixels + (size_t)width * height * 4);
+        stbi_image_free(pixels);
+    } else {
+        width = (int)texture->mWidth;
+        height = (int)texture->mHeight;
+        level.resize((size_t)width * height * 4);
+        for(size_t i = 0; i < (size_t)width * height; i++) {
+            const aiTexel& texel = texture->pcData[i];
+            uint8_t* rgba = &level[i * 4];
+            rgba[0] = texel.r;
+            rgba[1] = texel.g;
+            rgba[2] = texel.b;
+            rgba[3] = texel.a;
+        }
+    }
+
+    out.width = (uint32_t)width;
+    out.height = (uint32_t)height;
+    out.mipCount = MipCount(out.width, out.height);
+    out.texels = level;
+
+    uint32_t levelWidth = out.width, levelHeight = out.height;
+    for(uint32_t mip = 1; mip < out.mipCount; mip++) {
+        uint32_t nextWidth = std::max(1u, levelWidth / 2);
+        uint32_t nextHeight = std::max(1u, levelHeight / 2);
+        std::vector<uint8_t> next((size_t)nextWidth * nextHeight * 4);
+        for(uint32_t y = 0; y < nextHeight; y++) {
+            /* An odd or 1 texel wide source just repeats its last row / column */
+            uint32_t y0 = std::min(y * 2, levelHeight - 1), y1 = std::min(y * 2 + 1, levelHeight - 1);
+            for(uint32_t x = 0; x < nextWidth; x++) {
+                uint32_t x0 = std::min(x * 2, levelWidth - 1), x1 = std::min(x * 2 + 1, levelWidth - 1);
+                for(int c = 0; c < 4; c++) {
+                    uint32_t sum = level[((size_t)y0 * levelWidth + x0) * 4 + c] + level[((size_t)y0 * levelWidth + x1) * 4 + c] +
+                                   level[((size_t)y1 * levelWidth + x0) * 4 + c] + level[((size_t)y1 * levelWidth + x1) * 4 + c];
+                    next[((size_t)y * nextWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+        out.texels.insert(out.texels.end(), next.begin(), next.end());
+        level.swap(next);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+    return true;
+}
+
+}
+
+bool ArpkPackage::IsArpk(const void *data, size_t size) {
+    return size >= 4 && !memcmp(data, "ARPK", 4);
+}
+
+size_t ArpkPackage::MipSize(uint32_t width, uint32_t height, uint32_t level) {
+    return (size_t)std::max(1u, width >> level) * std::max(1u, height >> level) * 4;
+}
+
+ArpkPackage::~ArpkPackage() {
+    if(mData) munmap((void*)mData, mSize);
+}
+
+bool ArpkPackage::open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        LOGE("NAT_ERROR : ArpkPackage : failed to open %s", path.c_str());
+        return false;
+    }
+    struct stat info{};
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(ArpkHeader)) {
+        close(fd);
+        LOGE("NAT_ERROR : ArpkPackage : %s is too small", path.c_str());
+        return false;
+    }
+    void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        LOGE("NAT_ERROR : ArpkPackage : mmap of %s failed", path.c_str());
+        return false;
+    }
+    /* Everything in the file gets uploaded, start paging it in now */
+    madvise(mapping, (size_t)info.st_size, MADV_WILLNEED);
+
+    mData = (const uint8_t*)mapping;
+    mSize = (size_t)info.st_size;
+    if(!validate()) {
+        LOGE("NAT_ERROR : ArpkPackage : %s is not a valid version %u package", path.c_str(), kVersion);
+        munmap(mapping, mSize);
+        mData = nullptr;
+        mSize = 0;
+        return false;
+    }
+    return true;
+}
+
+const ArpkMesh &ArpkPackage::mesh(uint32_t index) const {
+    return reinterpret_cast<const ArpkMesh*>(mData + header().meshTableOffset)[index];
+}
+
+const ArpkTexture &ArpkPackage::texture(uint32_t index) const {
+    return reinterpret_cast<const ArpkTexture*>(mData + header().textureTableOffset)[index];
+}
+
+/* Every offset the loader follows stays inside the mapping */
+bool ArpkPackage::validate() const {
+    auto inside = [this](uint64_t offset, uint64_t size) {
+        return offset <= mSize && size <= mSize - offset;
+    };
+
+    if(!IsArpk(mData, mSize)) return false;
+    const ArpkHeader& head = header();
+    if(head.version != kVersion) return false;
+    if(head.meshTableOffset % alignof(ArpkMesh) || head.textureTableOffset % alignof(ArpkTexture)) return false;
+    if(!inside(head.meshTableOffset, (uint64_t)head.meshCount * sizeof(ArpkMesh))) return false;
+    if(!inside(head.textureTableOffset, (uint64_t)head.textureCount * sizeof(ArpkTexture))) return false;
+
+    for(uint32_t i = 0; i < head.meshCount; i++) {
+        const ArpkMesh& entry = mesh(i);
+        if(entry.vertexCount > kMaxPackedVertices || entry.indexCount % 3) return false;
+        if(entry.vertexOffset % alignof(float) || entry.indexOffset % alignof(uint16_t)) return false;
+        if(!inside(entry.vertexOffset, (uint64_t)entry.vertexCount * sizeof(ArpkVertex))) return false;
+        if(!inside(entry.indexOffset, (uint64_t)entry.indexCount * sizeof(uint16_t))) return false;
+        if(entry.texture >= (int32_t)head.textureCount || entry.alphaMode > 3) return false;
+        /* Out of range indices would read past the vertex buffer on the GPU. The pass is cheap,
+         * these pages are read for the upload right after anyway */
+        const uint16_t* indices = reinterpret_cast<const uint16_t*>(mData + entry.indexOffset);
+        for(uint32_t j = 0; j < entry.indexCount; j++) {
+            if(indices[j] >= entry.vertexCount) return false;
+        }
+    }
+    for(uint32_t i = 0; i < head.textureCount; i++) {
+        const ArpkTexture& entry = texture(i);
+        if(entry.format != 0 || entry.width == 0 || entry.height == 0 || entry.mipCount == 0 || entry.mipCount > 32) return false;
+        uint64_t expected = 0;
+        for(uint32_t level = 0; level < entry.mipCount; level++) expected += MipSize(entry.width, entry.height, level);
+        if(entry.size != expected || !inside(entry.offset, entry.size)) return false;
+    }
+    return true;
+}
+
+/* Runs on a job system worker (ConversionService), mip chains are built on other workers meanwhile */
+bool ArpkPackage::Write(const aiScene *scene, const std::string &path) {
+    std::vector<PackedTexture> textures(scene->mNumTextures);
+    std::vector<char> textureOk(scene->mNumTextures, 0);
+    std::vector<JobHandle> textureJobs;
+    for(unsigned int i = 0; i < scene->mNumTextures; i++) {
+        textureJobs.push_back(JobSystem::instance().submit(PRIORITY_MIPGEN, [&, i](const CancelToken&) {
+            textureOk[i] = PackTexture(scene->mTextures[i], textures[i]);
+        }));
+    }
+
+    std::vector<const aiMesh*> sceneMeshes;
+    CollectMeshes(scene->mRootNode, scene, sceneMeshes);
+    std::vector<PackedMesh> meshes;
+    ArpkHeader header{};
+    memcpy(header.magic, "ARPK", 4);
+    header.version = kVersion;
+    for(int c = 0; c < 3; c++) {
+        header.boundsMin[c] = std::numeric_limits<float>::max();
+        header.boundsMax[c] = -std::numeric_limits<float>::max();
+    }
+    for(const aiMesh* mesh : sceneMeshes) {
+        size_t first = meshes.size();
+        PackMesh(mesh, EmbeddedTexture(mesh, scene), meshes);
+        uint8_t alphaMode, alphaCutoff;
+        MaterialAlpha(mesh, scene, alphaMode, alphaCutoff);
+        for(size_t i = first; i < meshes.size(); i++) {
+            meshes[i].alphaMode = alphaMode;
+            meshes[i].alphaCutoff = alphaCutoff;
+        }
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            const float position[3] = { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
+            for(int c = 0; c < 3; c++) {
+                header.boundsMin[c] = std::min(header.boundsMin[c], position[c]);
+                header.boundsMax[c] = std::max(header.boundsMax[c], position[c]);
+            }
+        }
+    }
+
+    for(const JobHandle& job : textureJobs) JobSystem::instance().wait(job);
+    /* An undecodable texture stays in the table as 1x1 white so the indices of the others hold */
+    for(size_t i = 0; i < textures.size(); i++) {
+        if(textureOk[i]) continue;
+        LOGE("NAT_ERROR : ArpkPackage : failed to decode texture %zu", i);
+        textures[i].width = textures[i].height = textures[i].mipCount = 1;
+        textures[i].texels.assign(4, 0xFF);
+    }
+
+    /* Layout : header, draw table, texture table, then the 16 byte aligned blocks */
+    header.meshCount = (uint32_t)meshes.size();
+    header.textureCount = (uint32_t)textures.size();
+    header.meshTableOffset = Align(sizeof(ArpkHeader));
+    header.textureTableOffset = Align(header.meshTableOffset + meshes.size() * sizeof(ArpkMesh));
+    uint64_t offset = Align(header.textureTableOffset + textures.size() * sizeof(ArpkTexture));
+
+    std::vector<ArpkMesh> meshTable(meshes.size());
+    for(size_t i = 0; i < meshes.size(); i++) {
+        ArpkMesh& entry = meshTable[i];
+        entry.vertexCount = (uint32_t)meshes[i].vertices.size();
+        entry.indexCount = (uint32_t)meshes[i].indices.size();
+        entry.texture = meshes[i].texture;
+        entry.alphaMode = meshes[i].alphaMode;
+        entry.alphaCutoff = meshes[i].alphaCutoff;
+        entry.vertexOffset = offset;
+        offset = Align(offset + meshes[i].vertices.size() * sizeof(ArpkVertex));
+        entry.indexOffset = offset;
+        offset = Align(offset + meshes[i].indices.size() * sizeof(uint16_t));
+    }
+    std::vector<ArpkTexture> textureTable(textures.size());
+    for(size_t i = 0; i < textures.size(); i++) {
+        ArpkTexture& entry = textureTable[i];
+        entry.width = textures[i].width;
+        entry.height = textures[i].height;
+        entry.mipCount = textures[i].mipCount;
+        entry.format = 0;
+        entry.offset = offset;
+        entry.size = textures[i].texels.size();
+        offset = Align(offset + entry.size);
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) {
+        LOGE("NAT_ERROR : ArpkPackage : failed to create %s", path.c_str());
+        return false;
+    }
+    bool ok = true;
+    uint64_t written = 0;
+    auto write = [&](uint64_t at, const void* data, size_t size) {
+        static const uint8_t kPadding[kDataAlignment] = {};
+        while(ok && written < at) {
+            size_t padding = (size_t)std::min<uint64_t>(at - written, kDataAlignment);
+            ok = fwrite(kPadding, 1, padding, file) == padding;
+            written += padding;
+        }
+        if(ok && size) ok = fwrite(data, 1, size, file) == size;
+        written += size;
+    };
+
+    write(0, &header, sizeof(header));
+    write(header.meshTableOffset, meshTable.data(), meshTable.size() * sizeof(ArpkMesh));
+    write(header.textureTableOffset, textureTable.data(), textureTable.size() * sizeof(ArpkTexture));
+    for(size_t i = 0; i < meshes.size(); i++) {
+        write(meshTable[i].vertexOffset, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(ArpkVertex));
+        write(meshTable[i].indexOffset, meshes[i].indices.data(), meshes[i].indices.size() * sizeof(uint16_t));
+    }
+    for(size_t i = 0; i < textures.size(); i++) {
+        write(textureTable[i].offset, textures[i].texels.data(), textures[i].texels.size());
+    }
+    ok = fclose(file) == 0 && ok;
+
+    if(!ok) {
+        LOGE("NAT_ERROR : ArpkPackage : failed to write %s", path.c_str());
+        remove(path.c_str());
+        return false;
+    }
+    LOGI("SANJU : ArpkPackage : %s | %zu draws | %zu textures | %llu bytes",
+         path.c_str(), meshes.size(), textures.size(), (unsigned long long)written);
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef BUILDING_AR_ARPK_PACKAGE_H
+#define BUILDING_AR_ARPK_PACKAGE_H
+
+#include <android/log.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct aiScene;
+
+#define LOG_TAG "ArpkPackage"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * ".arpk" ready-to-render package, written by the ConversionService and mapped by GLBModelAsync.
+ * It holds exactly what gets uploaded, so loading is mmap + glBufferData / glTexImage2D :
+ *
+ *   ArpkHeader
+ *   ArpkMesh[meshCount]          draw table, one entry per draw call
+ *   ArpkTexture[textureCount]
+ *   data blocks, 16 byte aligned
+ *
+ * Vertices are ArpkVertex (20 bytes instead of 32) and indices are 16 bit; meshes with more
+ * than 65535 vertices are split by the writer. Textures are RGBA8 with their full mip chain
+ * stored level after level. All values are little endian.
+ */
+struct ArpkHeader {
+    char magic[4];              // "ARPK"
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t meshTableOffset;
+    uint64_t textureTableOffset;
+};
+
+struct ArpkMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    int32_t texture;            // Index into the texture table, -1 for none
+    uint8_t alphaMode;          // 1 + glTF alphaMode (OPAQUE, MASK, BLEND), 0 : from the texture's alpha
+    uint8_t alphaCutoff;        // MASK threshold x 255, 0 : 0.5
+    uint16_t reserved;
+};
+
+struct ArpkTexture {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t format;            // 0 : RGBA8
+    uint64_t offset;
+    uint64_t size;              // All mip levels
+};
+
+/* position float3, normal snorm8x4 (w unused), uv half2 */
+struct ArpkVertex {
+    float position[3];
+    int8_t normal[4];
+    uint16_t uv[2];
+};
+
+static_assert(sizeof(ArpkVertex) == 20, "ArpkVertex must stay tightly packed");
+
+/* Read only mapping of a package file. Offsets are validated once in open() */
+class ArpkPackage {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    static bool IsArpk(const void* data, size_t size);
+
+    ~ArpkPackage();
+    bool open(const std::string& path);
+
+    const ArpkHeader& header() const { return *reinterpret_cast<const ArpkHeader*>(mData); }
+    const ArpkMesh& mesh(uint32_t index) const;
+    const ArpkTexture& texture(uint32_t index) const;
+    const uint8_t* at(uint64_t offset) const { return mData + offset; }
+
+    /* Byte size of one mip level */
+    static size_t MipSize(uint32_t width, uint32_t height, uint32_t level);
+
+    /* Packs an (already post-processed) Assimp scene, runs its mip generation on the JobSystem */
+    static bool Write(const aiScene* scene, const std::string& path);
+
+private:
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+
+    bool validate() const;
+};
+
+#endif //BUILDING_AR_ARPK_PACKAGE_H
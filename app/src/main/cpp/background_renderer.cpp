@@ -0,0 +1,126 @@
+#include <background_renderer.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+bool BackgroundRenderer::create(const std::string &vertexSource, const std::string &fragmentSource) {
+    /* A new surface comes with a new context, names of the previous one are already gone */
+    forget();
+
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if(!vertexShader || !fragmentShader) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return false;
+    }
+
+    mProgram = glCreateProgram();
+    glAttachShader(mProgram, vertexShader);
+    glAttachShader(mProgram, fragmentShader);
+    glLinkProgram(mProgram);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(mProgram, GL_LINK_STATUS, &linked);
+    if(!linked) {
+        LOGE("NAT_ERROR : BackgroundRenderer : camera program failed to link");
+        glDeleteProgram(mProgram);
+        mProgram = 0;
+        return false;
+    }
+
+    /* The sampler always reads unit 0, set once instead of every frame */
+    glUseProgram(mProgram);
+    glUniform1i(glGetUniformLocation(mProgram, "u_Texture"), 0);
+    glUseProgram(0);
+
+    static const float kQuadPositions[8] = { -1.0f, -1.0f,   1.0f, -1.0f,   -1.0f, 1.0f,   1.0f, 1.0f };
+
+    glGenVertexArrays(1, &mVao);
+    glBindVertexArray(mVao);
+
+    glGenBuffers(1, &mPositionVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mPositionVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(kQuadPositions), kQuadPositions, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);   // Position
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+    /* Filled on the first draw, rewritten only when the display geometry changes */
+    glGenBuffers(1, &mUvVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mUvVbo);
+    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(1);   // Texture
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mUvGeometryId = 0;
+    return true;
+}
+
+void BackgroundRenderer::destroy() {
+    /* GL names die with their context, only delete them while one is current */
+    if(mProgram && eglGetCurrentContext() != EGL_NO_CONTEXT) {
+        glDeleteProgram(mProgram);
+        glDeleteBuffers(1, &mPositionVbo);
+        glDeleteBuffers(1, &mUvVbo);
+        glDeleteVertexArrays(1, &mVao);
+    }
+    forget();
+}
+
+void BackgroundRenderer::forget() {
+    mProgram = 0;
+    mVao = 0;
+    mPositionVbo = 0;
+    mUvVbo = 0;
+    mUvGeometryId = 0;
+}
+
+void BackgroundRenderer::draw(GLStateCache &state, const TrackingSnapshot &snapshot) {
+    /* The quad overwrites every pixel : the old color contents don't have to be cleared, and
+     * invalidating them spares tiled GPUs from loading the previous frame back into tile memory */
+    const GLenum color = GL_COLOR;
+    glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &color);
+    /* glClear honours the depth mask, the previous frame's last pass may have left it off */
+    state.depthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    if(!mProgram) return;
+
+    if(snapshot.camera_uvs.geometry_id != mUvGeometryId && snapshot.camera_uvs.geometry_id != 0) {
+        state.bindBuffer(GL_ARRAY_BUFFER, mUvVbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(snapshot.camera_uvs.uvs), snapshot.camera_uvs.uvs);
+        mUvGeometryId = snapshot.camera_uvs.geometry_id;
+    }
+
+    state.setEnabled(GL_DEPTH_TEST, false);
+    state.depthMask(false);
+    state.setEnabled(GL_BLEND, false);
+
+    state.useProgram(mProgram);
+    state.bindTexture(GL_TEXTURE0, GL_TEXTURE_EXTERNAL_OES, snapshot.camera_texture);
+
+    state.bindVertexArray(mVao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+GLuint BackgroundRenderer::CompileShader(GLenum type, const std::string &source) {
+    const char* text = source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if(!compiled) {
+        char log[512] = {0};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        LOGE("NAT_ERROR : BackgroundRenderer : shader compile failed : %s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
@@ -0,0 +1,51 @@
+#ifndef BUILDING_AR_BACKGROUND_RENDERER_H
+#define BUILDING_AR_BACKGROUND_RENDERER_H
+
+#include "tracking_pipeline.h"
+#include "gl_state_cache.h"
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include <string>
+
+#define LOG_TAG "BackgroundRenderer"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * Draws the camera image as the frame's background.
+ *
+ * The quad's UVs come from ArFrame_transformCoordinates2d (see TrackingPipeline::UpdateCameraUvs)
+ * and are only re-uploaded when the display geometry changed, so a steady frame is one texture
+ * bind and one draw with no uniform or buffer updates. The quad covers every pixel, so the
+ * color buffer is never cleared, only invalidated.
+ *
+ * All calls on the GL thread.
+ */
+class BackgroundRenderer {
+public:
+    ~BackgroundRenderer() { destroy(); }
+
+    /* Once per GL context, see ARCoreManager::OnSurfaceCreated */
+    bool create(const std::string& vertexSource, const std::string& fragmentSource);
+    void destroy();
+
+    /* Clears depth and draws the camera texture of the snapshot over the whole viewport. Sets
+     * its own state through the cache and leaves it for the next pass to change */
+    void draw(GLStateCache& state, const TrackingSnapshot& snapshot);
+
+private:
+    GLuint mProgram = 0;
+    GLuint mVao = 0;
+    GLuint mPositionVbo = 0;
+    GLuint mUvVbo = 0;
+
+    /* geometry_id of the UVs in mUvVbo, 0 when they never were uploaded */
+    uint32_t mUvGeometryId = 0;
+
+    void forget();
+    static GLuint CompileShader(GLenum type, const std::string& source);
+};
+
+#endif //BUILDING_AR_BACKGROUND_RENDERER_H
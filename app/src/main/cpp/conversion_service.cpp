@@ -0,0 +1,339 @@
+#include <conversion_service.h>
+#include <arpk_package.h>
+#include <glb_reader.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/Exporter.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <dirent.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+namespace {
+
+bool StartsWith(const uint8_t* data, size_t size, const char* prefix) {
+    size_t length = strlen(prefix);
+    return size >= length && !memcmp(data, prefix, length);
+}
+
+/* Searches only the head of the file, enough for every header we look for */
+bool HeadContains(const uint8_t* data, size_t size, const char* needle) {
+    size_t head = size < 4096 ? size : 4096;
+    size_t length = strlen(needle);
+    for(size_t i = 0; i + length <= head; i++) {
+        if(!memcmp(data + i, needle, length)) return true;
+    }
+    return false;
+}
+
+/* "models/house.fbx" -> "house" */
+std::string Stem(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+}
+
+ConversionService::Format ConversionService::DetectFormat(const uint8_t *data, size_t size) {
+    if(StartsWith(data, size, "glTF")) return FORMAT_GLB;
+    if(StartsWith(data, size, "Kaydara FBX Binary")) return FORMAT_FBX;
+    if(StartsWith(data, size, "ply")) return FORMAT_PLY;
+    if(size >= 2 && data[0] == 0x4D && data[1] == 0x4D) return FORMAT_3DS;
+    if(HeadContains(data, size, "FBXHeaderExtension")) return FORMAT_FBX;
+    if(HeadContains(data, size, "<COLLADA")) return FORMAT_DAE;
+    if(HeadContains(data, size, "\"asset\"") && HeadContains(data, size, "{")) return FORMAT_GLTF;
+    if(StartsWith(data, size, "solid")) return FORMAT_STL;
+
+    /* OBJ has no magic, look for its statements at the start of a line */
+    if(HeadContains(data, size, "\nv ") || HeadContains(data, size, "\nvn ") ||
+       HeadContains(data, size, "\nf ") || StartsWith(data, size, "v ") || HeadContains(data, size, "mtllib ")) {
+        return FORMAT_OBJ;
+    }
+    /* Binary STL : 80 byte header, triangle count, 50 bytes per triangle */
+    if(size >= 84) {
+        uint32_t triangles;
+        memcpy(&triangles, data + 80, sizeof(triangles));
+        if(84 + (uint64_t)triangles * 50 == size) return FORMAT_STL;
+    }
+    return FORMAT_UNKNOWN;
+}
+
+const char* ConversionService::FormatHint(Format format) {
+    switch(format) {
+        case FORMAT_FBX: return "fbx";
+        case FORMAT_OBJ: return "obj";
+        case FORMAT_GLB: return "glb";
+        case FORMAT_GLTF: return "gltf";
+        case FORMAT_DAE: return "dae";
+        case FORMAT_STL: return "stl";
+        case FORMAT_PLY: return "ply";
+        case FORMAT_3DS: return "3ds";
+        default: return "";
+    }
+}
+
+uint64_t ConversionService::CacheKey(const uint8_t *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ kConverterVersion;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool ConversionService::openInput(const std::string &input, InputData &out) const {
+    if(!input.empty() && input[0] == '/') {
+        std::ifstream file(input, std::ios::binary | std::ios::ate);
+        if(!file.is_open()) return false;
+        out.owned.resize((size_t)file.tellg());
+        file.seekg(0, std::ios::beg);
+        if(!file.read((char*)out.owned.data(), out.owned.size())) return false;
+        out.data = out.owned.data();
+        out.size = out.owned.size();
+        return true;
+    }
+
+    if(!mAssetManager) return false;
+    out.asset = AAssetManager_open(mAssetManager, input.c_str(), AASSET_MODE_BUFFER);
+    if(!out.asset) return false;
+    out.size = (size_t)AAsset_getLength(out.asset);
+    /* Uncompressed assets are mapped in place, compressed ones get inflated once by the framework */
+    out.data = (const uint8_t*)AAsset_getBuffer(out.asset);
+    return out.data != nullptr;
+}
+
+bool ConversionService::ConvertData(const uint8_t *data, size_t size, const std::string &outputPath, Output output) {
+    Format format = DetectFormat(data, size);
+    if(format == FORMAT_UNKNOWN) {
+        LOGE("NAT_ERROR : ConversionService : unknown input format for %s", outputPath.c_str());
+        return false;
+    }
+
+    /* Now import models using Assimp */
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFileFromMemory(
+            data, size,
+            aiProcess_Triangulate |
+            aiProcess_GenNormals |
+            aiProcess_FlipUVs |
+            aiProcess_JoinIdenticalVertices |
+            aiProcess_OptimizeMeshes |
+            aiProcess_EmbedTextures |
+            aiProcess_FindInstances, FormatHint(format)
+    );
+
+    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        LOGE("NAT_ERROR : Assimp error in ConversionService: %s", importer.GetErrorString());
+        return false;
+    }
+
+    /* Written next to the target and renamed, a half written file never looks like a cached output */
+    std::string temporaryPath = outputPath + ".tmp";
+    if(output == OUTPUT_PACKAGE) {
+        /* Same import flags as GLBModelAsync's Assimp path, so the package holds what it would upload */
+        if(!ArpkPackage::Write(scene, temporaryPath)) return false;
+        return rename(temporaryPath.c_str(), outputPath.c_str()) == 0;
+    }
+
+    /* Exported to memory first to tag it with GLBReader::kPipelineMarker : GLBModelAsync then
+     * knows the post-processing above is done and doesn't run it again */
+    Assimp::Exporter exporter;
+    const aiExportDataBlob* blob = exporter.ExportToBlob(scene, "glb2", 0);
+    if(!blob) {
+        LOGE("NAT_ERROR : GLB export failed in ConversionService : %s", exporter.GetErrorString());
+        return false;
+    }
+    std::vector<uint8_t> glb((const uint8_t*)blob->data, (const uint8_t*)blob->data + blob->size);
+    if(!GLBReader::AddPipelineMarker(glb, kConverterVersion)) {
+        LOGI("SANJU : ConversionService : %s written without the pipeline marker", outputPath.c_str());
+    }
+
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    bool written = file && fwrite(glb.data(), 1, glb.size(), file) == glb.size();
+    if(file) written = fclose(file) == 0 && written;
+    if(!written) {
+        LOGE("NAT_ERROR : ConversionService : failed to write %s", temporaryPath.c_str());
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    return rename(temporaryPath.c_str(), outputPath.c_str()) == 0;
+}
+
+bool ConversionService::convert(const std::string &input, const std::string &outputPath, Output output) {
+    bool success = false;
+    JobHandle handle = JobSystem::instance().submit(PRIORITY_CONVERSION, [&](const CancelToken&) {
+        InputData data;
+        if(!openInput(input, data)) {
+            LOGE("NAT_ERROR : ConversionService : failed to open %s", input.c_str());
+            return;
+        }
+        success = ConvertData(data.data, data.size, outputPath, output);
+    });
+    JobSystem::instance().wait(handle);
+    return success;
+}
+
+std::string ConversionService::convertCached(const std::string &input, const std::string &outputDir, Output output) {
+    std::string outputPath;
+    JobHandle handle = JobSystem::instance().submit(PRIORITY_CONVERSION, [&](const CancelToken&) {
+        outputPath = convertOne(input, outputDir, output);
+    });
+    JobSystem::instance().wait(handle);
+    return outputPath;
+}
+
+/* Runs on a job system worker */
+std::string ConversionService::convertOne(const std::string &input, const std::string &outputDir, Output output) {
+    InputData data;
+    if(!openInput(input, data)) {
+        LOGE("NAT_ERROR : ConversionService : failed to open %s", input.c_str());
+        return "";
+    }
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)CacheKey(data.data, data.size));
+    std::string stem = Stem(input);
+    std::string extension = OutputExtension(output);
+    std::string outputPath = outputDir + "/" + stem + "-" + key + extension;
+
+    FILE* cached = fopen(outputPath.c_str(), "rb");
+    if(cached) {
+        fclose(cached);
+        LOGI("SANJU : ConversionService : cache hit %s", outputPath.c_str());
+        return outputPath;
+    }
+
+    if(!ConvertData(data.data, data.size, outputPath, output)) return "";
+    RemoveStaleOutputs(outputDir, stem, outputPath, extension);
+    LOGI("SANJU : ConversionService : %s -> %s", input.c_str(), outputPath.c_str());
+    return outputPath;
+}
+
+/* Outputs of older content / converter versions of the same input */
+void ConversionService::RemoveStaleOutputs(const std::string &outputDir, const std::string &stem, const std::string &keep,
+                                           const std::string &extension) {
+    DIR* dir = opendir(outputDir.c_str());
+    if(!dir) return;
+
+    std::string prefix = stem + "-";
+    /* "<stem>-" + 16 hex digits + extension */
+    size_t expectedLength = prefix.size() + 16 + extension.size();
+    while(dirent* entry = readdir(dir)) {
+        std::string name(entry->d_name);
+        if(name.size() != expectedLength || name.compare(0, prefix.size(), prefix) != 0) continue;
+        if(name.compare(name.size() - extension.size(), extension.size(), extension) != 0) continue;
+        std::string path = outputDir + "/" + name;
+        if(path != keep) remove(path.c_str());
+    }
+    closedir(dir);
+}
+
+void ConversionService::submitBatch(const std::vector<std::string> &inputs, const std::string &outputDir, ProgressCallback callback,
+                                    Output output) {
+    std::vector<Job> jobs;
+    for(const std::string& input : inputs) jobs.push_back(Job{input, output});
+    submitJobs(jobs, outputDir, std::move(callback));
+}
+
+void ConversionService::submitJobs(const std::vector<Job> &jobs, const std::string &outputDir, ProgressCallback callback) {
+    journalAdd(outputDir, jobs);
+
+    struct Batch {
+        std::atomic<int> done{0};
+        int total = 0;
+        ProgressCallback callback;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->total = (int)jobs.size();
+    batch->callback = std::move(callback);
+
+    for(const Job& job : jobs) {
+        JobSystem::instance().submit(PRIORITY_CONVERSION, [this, batch, job, outputDir](const CancelToken&) {
+            Progress progress;
+            progress.input = job.input;
+            progress.output = convertOne(job.input, outputDir, job.output);
+            journalRemove(outputDir, job);
+
+            progress.done = batch->done.fetch_add(1, std::memory_order_acq_rel) + 1;
+            progress.total = batch->total;
+            if(batch->callback) batch->callback(progress);
+        });
+    }
+}
+
+int ConversionService::resumePending(const std::string &outputDir, ProgressCallback callback) {
+    std::vector<Job> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mJournalMutex);
+        /* Inputs already queued in this process are not in danger, only resume on a fresh start */
+        if(mPending.count(outputDir)) return 0;
+    }
+
+    std::ifstream journal(outputDir + "/.conversion_queue");
+    std::string line;
+    while(std::getline(journal, line)) {
+        if(line.empty()) continue;
+        /* Journals written before packages existed hold bare inputs, which were GLB conversions */
+        size_t tab = line.find('\t');
+        if(tab == std::string::npos) {
+            jobs.push_back(Job{line, OUTPUT_GLB});
+        } else {
+            Output output = line.compare(0, tab, OutputExtension(OUTPUT_PACKAGE)) == 0 ? OUTPUT_PACKAGE : OUTPUT_GLB;
+            jobs.push_back(Job{line.substr(tab + 1), output});
+        }
+    }
+    if(jobs.empty()) return 0;
+
+    LOGI("SANJU : ConversionService : resuming %zu pending conversions", jobs.size());
+    submitJobs(jobs, outputDir, std::move(callback));
+    return (int)jobs.size();
+}
+
+std::string ConversionService::JournalEntry(const Job &job) {
+    return std::string(OutputExtension(job.output)) + "\t" + job.input;
+}
+
+void ConversionService::journalAdd(const std::string &outputDir, const std::vector<Job> &jobs) {
+    std::lock_guard<std::mutex> lock(mJournalMutex);
+    std::vector<std::string>& pending = mPending[outputDir];
+    for(const Job& job : jobs) pending.push_back(JournalEntry(job));
+    writeJournal(outputDir);
+}
+
+void ConversionService::journalRemove(const std::string &outputDir, const Job &job) {
+    std::string entry = JournalEntry(job);
+    std::lock_guard<std::mutex> lock(mJournalMutex);
+    std::vector<std::string>& pending = mPending[outputDir];
+    for(auto it = pending.begin(); it != pending.end(); ++it) {
+        if(*it == entry) {
+            pending.erase(it);
+            break;
+        }
+    }
+    writeJournal(outputDir);
+}
+
+/* Called with mJournalMutex held */
+void ConversionService::writeJournal(const std::string &outputDir) {
+    std::string path = outputDir + "/.conversion_queue";
+    const std::vector<std::string>& pending = mPending[outputDir];
+    if(pending.empty()) {
+        remove(path.c_str());
+        return;
+    }
+
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "w");
+    if(!file) return;
+    for(const std::string& entry : pending) {
+        fprintf(file, "%s\n", entry.c_str());
+    }
+    fclose(file);
+    rename(temporaryPath.c_str(), path.c_str());
+}
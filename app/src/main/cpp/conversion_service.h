@@ -0,0 +1,110 @@
+#ifndef BUILDING_AR_CONVERSION_SERVICE_H
+#define BUILDING_AR_CONVERSION_SERVICE_H
+
+#include <android/asset_manager.h>
+#include <android/log.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <job_system.h>
+
+#define LOG_TAG "ConversionService"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * Converts FBX / OBJ / ... models to GLB, or to a ready-to-render ".arpk" package (see
+ * ArpkPackage), on the JobSystem, several at a time.
+ *
+ * Inputs are Android asset paths, or absolute file paths when they start with '/'. The format is
+ * detected from the content, not the file name. Outputs are cached under
+ * "<outputDir>/<input name>-<key>.<glb|arpk>" where the key hashes the input bytes together with
+ * kConverterVersion, so changed inputs and converter upgrades both produce a new output and the
+ * stale one is removed.
+ *
+ * Pending inputs of a batch are journaled in "<outputDir>/.conversion_queue" until they finish,
+ * so a batch interrupted by the process dying can be picked up again with resumePending().
+ */
+class ConversionService {
+public:
+    /* Bump whenever the converter output (GLB or package) changes, it invalidates every cached output */
+    static constexpr uint32_t kConverterVersion = 2;
+
+    enum Output {
+        OUTPUT_GLB, OUTPUT_PACKAGE
+    };
+
+    enum Format {
+        FORMAT_UNKNOWN, FORMAT_FBX, FORMAT_OBJ, FORMAT_GLB, FORMAT_GLTF, FORMAT_DAE, FORMAT_STL, FORMAT_PLY, FORMAT_3DS
+    };
+
+    struct Progress {
+        std::string input;
+        std::string output;     // Empty if the conversion failed
+        int done = 0;
+        int total = 0;
+    };
+    /* Called on a job system worker once per input of a batch */
+    using ProgressCallback = std::function<void(const Progress&)>;
+
+    void setAssetManager(AAssetManager* manager) { mAssetManager = manager; }
+
+    /* Queues a batch and returns right away */
+    void submitBatch(const std::vector<std::string>& inputs, const std::string& outputDir, ProgressCallback callback,
+                     Output output = OUTPUT_GLB);
+    /* Queues whatever a previous process left in the journal of outputDir, returns how many */
+    int resumePending(const std::string& outputDir, ProgressCallback callback);
+
+    /* Blocking and cache aware. Returns the output path, empty on failure */
+    std::string convertCached(const std::string& input, const std::string& outputDir, Output output = OUTPUT_GLB);
+    /* Blocking, to an explicit output path without caching */
+    bool convert(const std::string& input, const std::string& outputPath, Output output = OUTPUT_GLB);
+
+    static Format DetectFormat(const uint8_t* data, size_t size);
+    static const char* FormatHint(Format format);
+    static const char* OutputExtension(Output output) { return output == OUTPUT_PACKAGE ? ".arpk" : ".glb"; }
+    /* FNV-1a 64 of the content, seeded with kConverterVersion */
+    static uint64_t CacheKey(const uint8_t* data, size_t size);
+
+private:
+    /* Input bytes, mapped straight from the APK for assets (no copy), read for files */
+    struct InputData {
+        AAsset* asset = nullptr;
+        std::vector<uint8_t> owned;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        ~InputData() { if(asset) AAsset_close(asset); }
+    };
+
+    AAssetManager* mAssetManager = nullptr;
+
+    std::mutex mJournalMutex;
+    /* outputDir -> journal entries ("<extension>\t<input>") not converted yet */
+    std::map<std::string, std::vector<std::string>> mPending;
+
+    struct Job {
+        std::string input;
+        Output output;
+    };
+
+    bool openInput(const std::string& input, InputData& out) const;
+    void submitJobs(const std::vector<Job>& jobs, const std::string& outputDir, ProgressCallback callback);
+    std::string convertOne(const std::string& input, const std::string& outputDir, Output output);
+    static bool ConvertData(const uint8_t* data, size_t size, const std::string& outputPath, Output output);
+    static void RemoveStaleOutputs(const std::string& outputDir, const std::string& stem, const std::string& keep,
+                                   const std::string& extension);
+
+    static std::string JournalEntry(const Job& job);
+    void journalAdd(const std::string& outputDir, const std::vector<Job>& jobs);
+    void journalRemove(const std::string& outputDir, const Job& job);
+    void writeJournal(const std::string& outputDir);
+};
+
+#endif //BUILDING_AR_CONVERSION_SERVICE_H
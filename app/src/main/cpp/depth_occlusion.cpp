@@ -0,0 +1,194 @@
+#include <frame_stats.h>
+#include <depth_occlusion.h>
+
+#include <EGL/egl.h>
+
+#include <chrono>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+bool DepthOcclusion::Capture(ArSession *session, ArFrame *frame, DepthFrame &out) {
+    ArImage* image = nullptr;
+    if(ArFrame_acquireDepthImage16Bits(session, frame, &image) != AR_SUCCESS || !image) return false;
+
+    /* The depth image updates slower than the camera, most frames hand back the same one */
+    int64_t timestamp = 0;
+    ArImage_getTimestamp(session, image, &timestamp);
+    if(timestamp != out.timestamp_ns) {
+        int32_t width = 0, height = 0, rowStride = 0, length = 0;
+        const uint8_t* data = nullptr;
+        ArImage_getWidth(session, image, &width);
+        ArImage_getHeight(session, image, &height);
+        ArImage_getPlaneRowStride(session, image, 0, &rowStride);
+        ArImage_getPlaneData(session, image, 0, &data, &length);
+
+        if(data && width > 0 && height > 0 && (int64_t)rowStride * (height - 1) + width * 2 <= length) {
+            /* resize() keeps the capacity, same sized images don't allocate */
+            out.meters.resize((size_t)width * height);
+            ConvertDepth16(data, rowStride, width, height, out.meters.data());
+            out.width = width;
+            out.height = height;
+            out.timestamp_ns = timestamp;
+        }
+    }
+    ArImage_release(image);
+    return out.timestamp_ns != 0;
+}
+
+void DepthOcclusion::ConvertDepth16(const uint8_t *src, int32_t rowStride, int32_t width, int32_t height, float *dst) {
+    const float scale = 0.001f;
+
+    for(int32_t y = 0; y < height; y++) {
+        /* Rows are 2 byte aligned, rowStride only tells where the next one starts */
+        const uint16_t* row = reinterpret_cast<const uint16_t*>(src + (size_t)y * rowStride);
+        float* out = dst + (size_t)y * width;
+        int32_t x = 0;
+
+#if defined(__ARM_NEON)
+        const float32x4_t vScale = vdupq_n_f32(scale);
+        const float32x4_t vUnknown = vdupq_n_f32(kUnknownDepth);
+        const uint32x4_t vZero = vdupq_n_u32(0);
+        for(; x + 8 <= width; x += 8) {
+            uint16x8_t mm = vld1q_u16(row + x);
+            uint32x4_t lo = vmovl_u16(vget_low_u16(mm));
+            uint32x4_t hi = vmovl_u16(vget_high_u16(mm));
+            float32x4_t loMeters = vmulq_f32(vcvtq_f32_u32(lo), vScale);
+            float32x4_t hiMeters = vmulq_f32(vcvtq_f32_u32(hi), vScale);
+            loMeters = vbslq_f32(vceqq_u32(lo, vZero), vUnknown, loMeters);
+            hiMeters = vbslq_f32(vceqq_u32(hi, vZero), vUnknown, hiMeters);
+            vst1q_f32(out + x, loMeters);
+            vst1q_f32(out + x + 4, hiMeters);
+        }
+#elif defined(__SSE2__)
+        const __m128 vScale = _mm_set1_ps(scale);
+        const __m128 vUnknown = _mm_set1_ps(kUnknownDepth);
+        const __m128i vZero = _mm_setzero_si128();
+        for(; x + 8 <= width; x += 8) {
+            __m128i mm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i lo = _mm_unpacklo_epi16(mm, vZero);
+            __m128i hi = _mm_unpackhi_epi16(mm, vZero);
+            __m128 loMeters = _mm_mul_ps(_mm_cvtepi32_ps(lo), vScale);
+            __m128 hiMeters = _mm_mul_ps(_mm_cvtepi32_ps(hi), vScale);
+            __m128 loUnknown = _mm_castsi128_ps(_mm_cmpeq_epi32(lo, vZero));
+            __m128 hiUnknown = _mm_castsi128_ps(_mm_cmpeq_epi32(hi, vZero));
+            loMeters = _mm_or_ps(_mm_and_ps(loUnknown, vUnknown), _mm_andnot_ps(loUnknown, loMeters));
+            hiMeters = _mm_or_ps(_mm_and_ps(hiUnknown, vUnknown), _mm_andnot_ps(hiUnknown, hiMeters));
+            _mm_storeu_ps(out + x, loMeters);
+            _mm_storeu_ps(out + x + 4, hiMeters);
+        }
+#endif
+
+        for(; x < width; x++) {
+            uint16_t mm = row[x];
+            out[x] = mm ? (float)mm * scale : kUnknownDepth;
+        }
+    }
+}
+
+void DepthOcclusion::destroy() {
+    /* GL names die with their context, only delete them while one is current */
+    if(mTexture && eglGetCurrentContext() != EGL_NO_CONTEXT) glDeleteTextures(1, &mTexture);
+    reset();
+}
+
+void DepthOcclusion::reset() {
+    mTexture = 0;
+    mWidth = 0;
+    mHeight = 0;
+    mUploadedTimestamp = 0;
+    mSeenTimestamp = 0;
+    mAverageUploadMs = 0.0;
+    mUploadStride = 1;
+    mSkipped = 0;
+    for(Locations& locations : mLocations) locations = Locations();
+    mNextLocations = 0;
+}
+
+bool DepthOcclusion::update(GLStateCache &state, const DepthFrame &depth) {
+    if(depth.timestamp_ns == 0 || depth.timestamp_ns == mSeenTimestamp) return false;
+    mSeenTimestamp = depth.timestamp_ns;
+
+    /* Over budget : let some images go, occlusion edges lag a little instead of the frame */
+    if(hasDepth() && ++mSkipped < mUploadStride) return false;
+    mSkipped = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if(!mTexture || depth.width != mWidth || depth.height != mHeight) {
+        if(mTexture) glDeleteTextures(1, &mTexture);
+        glGenTextures(1, &mTexture);
+        /* Uploaded through the unit it is sampled from, apply() then finds it already bound */
+        state.bindTexture(GL_TEXTURE0 + kTextureUnit, GL_TEXTURE_2D, mTexture);
+        /* Immutable storage, later frames only replace the texels. R32F isn't filterable in ES 3 */
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, depth.width, depth.height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        mWidth = depth.width;
+        mHeight = depth.height;
+    } else {
+        state.bindTexture(GL_TEXTURE0 + kTextureUnit, GL_TEXTURE_2D, mTexture);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, depth.width, depth.height, GL_RED, GL_FLOAT, depth.meters.data());
+    mUploadedTimestamp = depth.timestamp_ns;
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    mAverageUploadMs = mAverageUploadMs * 0.9 + elapsed.count() * 0.1;
+    if(mAverageUploadMs > kBudgetMs && mUploadStride < 4) {
+        mUploadStride *= 2;
+        LOGI("SANJU : Depth upload over budget (%.2f ms), taking 1 image in %d", mAverageUploadMs, mUploadStride);
+    } else if(mAverageUploadMs < kBudgetMs * 0.5 && mUploadStride > 1) {
+        mUploadStride /= 2;
+    }
+    return true;
+}
+
+void DepthOcclusion::apply(GLStateCache &state, GLuint program, const float cameraUvs[8], int viewportWidth, int viewportHeight,
+                           float nearPlane, float farPlane) {
+    Locations& locations = locationsOf(program);
+
+    if(!hasDepth() || viewportWidth <= 0 || viewportHeight <= 0) {
+        glUniform1i(locations.enabled, 0);
+        FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS);
+        return;
+    }
+
+    /* Screen to depth texture is affine (rotation + crop), given by the quad's corners in
+     * strip order : bottom left, bottom right, top left */
+    glUniform1i(locations.enabled, 1);
+    glUniform2f(locations.uvOrigin, cameraUvs[0], cameraUvs[1]);
+    glUniform2f(locations.uvX, cameraUvs[2] - cameraUvs[0], cameraUvs[3] - cameraUvs[1]);
+    glUniform2f(locations.uvY, cameraUvs[4] - cameraUvs[0], cameraUvs[5] - cameraUvs[1]);
+    glUniform2f(locations.invViewport, 1.0f / (float)viewportWidth, 1.0f / (float)viewportHeight);
+    glUniform2f(locations.nearFar, nearPlane, farPlane);
+    FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS, 6);
+
+    state.bindTexture(GL_TEXTURE0 + kTextureUnit, GL_TEXTURE_2D, mTexture);
+}
+
+DepthOcclusion::Locations& DepthOcclusion::locationsOf(GLuint program) {
+    for(Locations& locations : mLocations) {
+        if(locations.program == program) return locations;
+    }
+
+    Locations& locations = mLocations[mNextLocations];
+    mNextLocations = (mNextLocations + 1) % kMaxPrograms;
+    locations.program = program;
+    locations.enabled = glGetUniformLocation(program, "uOcclusionEnabled");
+    locations.texture = glGetUniformLocation(program, "uDepthTexture");
+    locations.uvOrigin = glGetUniformLocation(program, "uDepthUvOrigin");
+    locations.uvX = glGetUniformLocation(program, "uDepthUvX");
+    locations.uvY = glGetUniformLocation(program, "uDepthUvY");
+    locations.invViewport = glGetUniformLocation(program, "uInvViewport");
+    locations.nearFar = glGetUniformLocation(program, "uNearFar");
+    glUniform1i(locations.texture, kTextureUnit);
+    FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS, 8);
+    return locations;
+}
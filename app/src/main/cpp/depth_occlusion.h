@@ -0,0 +1,101 @@
+#ifndef BUILDING_AR_DEPTH_OCCLUSION_H
+#define BUILDING_AR_DEPTH_OCCLUSION_H
+
+#include "arcore_c_api.h"
+#include "gl_state_cache.h"
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include <cstdint>
+#include <vector>
+
+#define LOG_TAG "DepthOcclusion"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/* ARCore depth image of one frame, converted to meters with tightly packed rows */
+struct DepthFrame {
+    int64_t timestamp_ns = 0;   // Of the depth image, 0 while there is none
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<float> meters;
+};
+
+/*
+ * Hides the parts of the model that are behind real world surfaces, using ARCore's depth image.
+ *
+ * The tracking side (Capture) converts each new depth image once, on whichever thread runs
+ * ArSession_update. The render side uploads it into an R32F texture with glTexSubImage2D, only
+ * when a newer image arrived, and the model shader discards fragments farther away than the
+ * depth sampled under them.
+ *
+ * Depth images come at 30 Hz at most and are small (about 160x90 to 256x192), but the render
+ * side still keeps itself within kBudgetMs : when uploads average more than that, it only takes
+ * every other new image, then every fourth.
+ */
+class DepthOcclusion {
+public:
+    static constexpr double kBudgetMs = 1.0;
+    /* Meters written for pixels without depth (0 in the ARCore image), so they never occlude */
+    static constexpr float kUnknownDepth = 1.0e4f;
+    /* Texture unit of the depth texture while the model is drawn, the model itself uses 0 */
+    static constexpr int kTextureUnit = 1;
+
+    /* Tracking side. Converts the frame's depth image into out, unless out already holds it.
+     * False when the frame has no depth (depth mode disabled or not available yet) */
+    static bool Capture(ArSession* session, ArFrame* frame, DepthFrame& out);
+
+    /* uint16 millimeters with a row stride in bytes -> packed float meters. NEON or SSE2 when
+     * available, 8 pixels at a time */
+    static void ConvertDepth16(const uint8_t* src, int32_t rowStride, int32_t width, int32_t height, float* dst);
+
+    /* Render side, GL thread */
+    ~DepthOcclusion() { destroy(); }
+    void destroy();
+    /* Drops the texture without deleting it, for when its context is already gone */
+    void reset();
+
+    /* Uploads depth if it is newer than the texture. Returns true if it did */
+    bool update(GLStateCache& state, const DepthFrame& depth);
+    bool hasDepth() const { return mUploadedTimestamp != 0; }
+
+    /* Sets the occlusion uniforms of program, which must be in use, and binds the depth texture.
+     * cameraUvs are the background quad's corners (CameraUvs::uvs), depth is in the same image
+     * space as the camera texture. near / far are those of the projection the model is drawn with.
+     * Locations are kept for up to kMaxPrograms programs, e.g. the model's shader variants */
+    void apply(GLStateCache& state, GLuint program, const float cameraUvs[8], int viewportWidth, int viewportHeight,
+               float nearPlane, float farPlane);
+
+    static constexpr int kMaxPrograms = 4;
+
+private:
+    struct Locations {
+        GLuint program = 0;
+        GLint enabled = -1;
+        GLint texture = -1;
+        GLint uvOrigin = -1;
+        GLint uvX = -1;
+        GLint uvY = -1;
+        GLint invViewport = -1;
+        GLint nearFar = -1;
+    };
+
+    GLuint mTexture = 0;
+    int32_t mWidth = 0;
+    int32_t mHeight = 0;
+    int64_t mUploadedTimestamp = 0;
+    int64_t mSeenTimestamp = 0;
+
+    /* Budget : moving average of the upload time and how many new images to skip per upload */
+    double mAverageUploadMs = 0.0;
+    int mUploadStride = 1;
+    int mSkipped = 0;
+
+    Locations mLocations[kMaxPrograms];
+    int mNextLocations = 0;     // Slot replaced when a new program shows up
+
+    Locations& locationsOf(GLuint program);
+};
+
+#endif //BUILDING_AR_DEPTH_OCCLUSION_H
@@ -0,0 +1,69 @@
+#include <egl_shared_context.h>
+
+bool EGLSharedContext::create() {
+    destroy();
+
+    EGLDisplay display = eglGetCurrentDisplay();
+    EGLContext shareContext = eglGetCurrentContext();
+    if(display == EGL_NO_DISPLAY || shareContext == EGL_NO_CONTEXT) {
+        LOGE("NAT_ERROR : EGLSharedContext::create needs a current render context");
+        return false;
+    }
+
+    /* Use the render context's config so both contexts are compatible for sharing */
+    EGLint configId = 0;
+    eglQueryContext(display, shareContext, EGL_CONFIG_ID, &configId);
+    const EGLint configAttribs[] = { EGL_CONFIG_ID, configId, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    if(!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs < 1) {
+        LOGE("NAT_ERROR : EGLSharedContext : no config for id %d", configId);
+        return false;
+    }
+
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, shareContext, contextAttribs);
+    if(context == EGL_NO_CONTEXT) {
+        LOGE("NAT_ERROR : eglCreateContext (shared) failed : 0x%x", eglGetError());
+        return false;
+    }
+
+    /* Not every config supports pbuffers. Surfaceless is fine for a context that never draws */
+    const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    if(surface == EGL_NO_SURFACE) {
+        LOGI("SANJU : EGLSharedContext : no pbuffer surface, using EGL_NO_SURFACE");
+    }
+
+    mDisplay = display;
+    mContext = context;
+    mSurface = surface;
+    return true;
+}
+
+bool EGLSharedContext::makeCurrent() {
+    if(!isValid()) return false;
+    if(!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+        LOGE("NAT_ERROR : EGLSharedContext : eglMakeCurrent failed : 0x%x", eglGetError());
+        return false;
+    }
+    return true;
+}
+
+void EGLSharedContext::release() {
+    if(mDisplay != EGL_NO_DISPLAY) {
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+}
+
+void EGLSharedContext::destroy() {
+    if(mSurface != EGL_NO_SURFACE) {
+        eglDestroySurface(mDisplay, mSurface);
+        mSurface = EGL_NO_SURFACE;
+    }
+    if(mContext != EGL_NO_CONTEXT) {
+        eglDestroyContext(mDisplay, mContext);
+        mContext = EGL_NO_CONTEXT;
+    }
+    mDisplay = EGL_NO_DISPLAY;
+}
@@ -0,0 +1,34 @@
+#ifndef BUILDING_AR_EGL_SHARED_CONTEXT_H
+#define BUILDING_AR_EGL_SHARED_CONTEXT_H
+
+#include <EGL/egl.h>
+#include <android/log.h>
+
+#define LOG_TAG "EGLSharedContext"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * A GLES 3 context on a 1x1 pbuffer that shares objects (textures, buffers, syncs) with the
+ * render thread's context, so a worker thread can issue GL calls of its own.
+ *
+ * create() must be called on the render thread while its context is current. makeCurrent()
+ * and release() are then called on the worker thread.
+ */
+class EGLSharedContext {
+public:
+    ~EGLSharedContext() { destroy(); }
+
+    bool create();
+    bool makeCurrent();
+    void release();
+    void destroy();
+    bool isValid() const { return mContext != EGL_NO_CONTEXT; }
+
+private:
+    EGLDisplay mDisplay = EGL_NO_DISPLAY;
+    EGLContext mContext = EGL_NO_CONTEXT;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+};
+
+#endif //BUILDING_AR_EGL_SHARED_CONTEXT_H
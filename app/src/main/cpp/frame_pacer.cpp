@@ -0,0 +1,63 @@
+#include <frame_pacer.h>
+
+#include <cmath>
+
+void FramePacer::setFrameRateCaps(int maxFps, int stationaryFps) {
+    mMaxFps.store(maxFps > 0 ? maxFps : 0, std::memory_order_relaxed);
+    mStationaryFps.store(stationaryFps > 0 ? stationaryFps : 0, std::memory_order_relaxed);
+    LOGI("SANJU : Frame rate caps : %d fps, %d fps when stationary (0 : uncapped)", maxFps, stationaryFps);
+}
+
+FramePacer::Decision FramePacer::onVsync(int64_t vsyncNs, int64_t latestCameraNs, bool busy) {
+    bool dirty = mDirty.load(std::memory_order_acquire);
+    if(!dirty && !busy && latestCameraNs != 0 && latestCameraNs == mRequestedCameraNs) {
+        mSkippedUnchanged.fetch_add(1, std::memory_order_relaxed);
+        return SKIP_UNCHANGED;
+    }
+
+    int fps = mMaxFps.load(std::memory_order_relaxed);
+    int stationaryFps = mStationaryFps.load(std::memory_order_relaxed);
+    if(stationaryFps > 0 && isStationary() && (fps == 0 || stationaryFps < fps)) fps = stationaryFps;
+    if(fps > 0 && mRequestedVsyncNs != 0 && vsyncNs - mRequestedVsyncNs + kVsyncSlackNs < 1000000000LL / fps) {
+        /* A pending change stays dirty for the next vsync the cap lets through */
+        mSkippedCap.fetch_add(1, std::memory_order_relaxed);
+        return SKIP_CAP;
+    }
+
+    mDirty.store(false, std::memory_order_release);
+    mRequestedCameraNs = latestCameraNs;
+    mRequestedVsyncNs = vsyncNs;
+    mRendered.fetch_add(1, std::memory_order_relaxed);
+    return RENDER;
+}
+
+void FramePacer::onFrameRendered(int64_t cameraNs, const glm::mat4 &view) {
+    /* Relative to the pose the camera was still at, so slow drift adds up and ends the stillness */
+    glm::mat4 relative = view * glm::inverse(mStillView);
+    float travel = glm::length(glm::vec3(relative[3]));
+    /* Angle of the relative rotation from its trace */
+    float cosAngle = (relative[0][0] + relative[1][1] + relative[2][2] - 1.0f) * 0.5f;
+    bool moved = travel > kStationaryMeters || cosAngle < std::cos(glm::radians(kStationaryDegrees));
+
+    if(mStillSinceNs < 0 || moved || cameraNs < mStillSinceNs) {
+        mStillView = view;
+        mStillSinceNs = cameraNs;
+        mStationary.store(false, std::memory_order_relaxed);
+        return;
+    }
+    mStationary.store(cameraNs - mStillSinceNs >= kStationaryNs, std::memory_order_relaxed);
+}
+
+FramePacer::Counts FramePacer::counts() const {
+    Counts counts;
+    counts.rendered = mRendered.load(std::memory_order_relaxed);
+    counts.skippedUnchanged = mSkippedUnchanged.load(std::memory_order_relaxed);
+    counts.skippedCap = mSkippedCap.load(std::memory_order_relaxed);
+    return counts;
+}
+
+void FramePacer::resetCounts() {
+    mRendered.store(0, std::memory_order_relaxed);
+    mSkippedUnchanged.store(0, std::memory_order_relaxed);
+    mSkippedCap.store(0, std::memory_order_relaxed);
+}
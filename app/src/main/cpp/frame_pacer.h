@@ -0,0 +1,86 @@
+#ifndef BUILDING_AR_FRAME_PACER_H
+#define BUILDING_AR_FRAME_PACER_H
+
+#include <android/log.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#define LOG_TAG "FramePacer"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * Decides once per display vsync whether the GL thread renders a frame at all.
+ *
+ * The surface renders on demand and the decision is taken before requestRender() : GLSurfaceView
+ * swaps after every onDrawFrame, so a frame that was asked for has to be drawn in full. A vsync
+ * is skipped when
+ *   - the newest camera frame is the one already rendered and nothing else changed (no input,
+ *     no model load in progress), or
+ *   - it comes sooner than the frame rate cap allows. While the camera hasn't moved for
+ *     kStationaryNs the stationary cap applies instead.
+ *
+ * The camera timestamp is only known ahead of the GL thread when the TrackingPipeline publishes
+ * it. On the synchronous path ArSession_update blocks for the next camera image, which already
+ * keeps rendering at the camera rate, and only the caps apply.
+ */
+class FramePacer {
+public:
+    enum Decision {
+        RENDER, SKIP_UNCHANGED, SKIP_CAP
+    };
+
+    struct Counts {
+        uint64_t rendered = 0;
+        uint64_t skippedUnchanged = 0;
+        uint64_t skippedCap = 0;
+    };
+
+    /* The camera counts as stationary once it stayed within these of one pose for kStationaryNs */
+    static constexpr float kStationaryMeters = 0.01f;
+    static constexpr float kStationaryDegrees = 1.0f;
+    static constexpr int64_t kStationaryNs = 500000000;
+
+    /* Any thread. 0 leaves that cap off */
+    void setFrameRateCaps(int maxFps, int stationaryFps);
+    /* Any thread : something visible changed besides the camera frame (input, model placement) */
+    void markDirty() { mDirty.store(true, std::memory_order_release); }
+
+    /* Main thread, once per vsync. latestCameraNs : newest camera timestamp, 0 when unknown.
+     * busy : work that needs frames to progress, e.g. a model upload */
+    Decision onVsync(int64_t vsyncNs, int64_t latestCameraNs, bool busy);
+
+    /* GL thread, after each rendered frame. Feeds the stationary detection */
+    void onFrameRendered(int64_t cameraNs, const glm::mat4& view);
+    bool isStationary() const { return mStationary.load(std::memory_order_relaxed); }
+
+    /* Any thread */
+    Counts counts() const;
+    void resetCounts();
+
+private:
+    /* Vsync timestamps jitter, a frame this early still counts as on time for the cap */
+    static constexpr int64_t kVsyncSlackNs = 2000000;
+
+    std::atomic<int> mMaxFps{0};
+    std::atomic<int> mStationaryFps{0};
+    std::atomic<bool> mDirty{true};
+    std::atomic<bool> mStationary{false};
+
+    std::atomic<uint64_t> mRendered{0};
+    std::atomic<uint64_t> mSkippedUnchanged{0};
+    std::atomic<uint64_t> mSkippedCap{0};
+
+    /* Main thread */
+    int64_t mRequestedCameraNs = 0;
+    int64_t mRequestedVsyncNs = 0;
+
+    /* GL thread */
+    glm::mat4 mStillView = glm::mat4(1.0f);
+    int64_t mStillSinceNs = -1;
+};
+
+#endif //BUILDING_AR_FRAME_PACER_H
@@ -0,0 +1,147 @@
+#include <frame_stats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+unsigned int FrameStats::sFrameCounts[COUNTER_COUNT] = {0};
+
+void FrameStats::begin(const std::string &reportPath) {
+    LOGI("SANJU : FrameStats::begin : %s", reportPath.c_str());
+    mReportPath = reportPath;
+    for(auto& samples : mSamples) {
+        samples.clear();
+        /* About a minute of frames at 60 fps, so recording doesn't allocate mid-benchmark */
+        samples.reserve(4096);
+    }
+    for(auto& samples : mCounterSamples) {
+        samples.clear();
+        samples.reserve(4096);
+    }
+    mEvents.clear();
+    mActive = true;
+}
+
+void FrameStats::record(Stage stage, double ms) {
+    if(!mActive) return;
+    mSamples[stage].push_back(ms);
+}
+
+void FrameStats::endFrame() {
+    for(int i = 0; i < COUNTER_COUNT; i++) {
+        if(mActive) mCounterSamples[i].push_back((double)sFrameCounts[i]);
+        sFrameCounts[i] = 0;
+    }
+}
+
+void FrameStats::recordEvent(const std::string &name, double value) {
+    if(!mActive) return;
+    mEvents.emplace_back(name, value);
+}
+
+bool FrameStats::end() {
+    if(!mActive) return false;
+    mActive = false;
+
+    FILE* file = fopen(mReportPath.c_str(), "w");
+    if(!file) {
+        LOGE("NAT_ERROR : Failed to open the benchmark report : %s", mReportPath.c_str());
+        return false;
+    }
+
+    fprintf(file, "%-16s %8s %10s %10s %10s\n", "stage", "samples", "p50_ms", "p95_ms", "p99_ms");
+    for(int i = 0; i < STAGE_COUNT; i++) {
+        std::vector<double>& samples = mSamples[i];
+        std::sort(samples.begin(), samples.end());
+        double p50 = percentile(samples, 0.50);
+        double p95 = percentile(samples, 0.95);
+        double p99 = percentile(samples, 0.99);
+        fprintf(file, "%-16s %8zu %10.3f %10.3f %10.3f\n", stageName((Stage)i), samples.size(), p50, p95, p99);
+        LOGI("SANJU : Benchmark %s : p50 = %.3f ms | p95 = %.3f ms | p99 = %.3f ms",
+             stageName((Stage)i), p50, p95, p99);
+    }
+
+    fprintf(file, "\n%-16s %8s %10s %10s %10s\n", "counter", "frames", "p50", "p95", "max");
+    for(int i = 0; i < COUNTER_COUNT; i++) {
+        std::vector<double>& samples = mCounterSamples[i];
+        std::sort(samples.begin(), samples.end());
+        double max = samples.empty() ? 0.0 : samples.back();
+        fprintf(file, "%-16s %8zu %10.0f %10.0f %10.0f\n", counterName((Counter)i), samples.size(),
+                percentile(samples, 0.50), percentile(samples, 0.95), max);
+        LOGI("SANJU : Benchmark %s per frame : p50 = %.0f | max = %.0f",
+             counterName((Counter)i), percentile(samples, 0.50), max);
+    }
+
+    if(!mEvents.empty()) {
+        fprintf(file, "\n%-24s %10s\n", "event", "value");
+        for(const auto& event : mEvents) {
+            fprintf(file, "%-24s %10.3f\n", event.first.c_str(), event.second);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+const char* FrameStats::stageName(Stage stage) {
+    switch(stage) {
+        case STAGE_UPDATE: return "update";
+        case STAGE_CAMERA: return "camera";
+        case STAGE_CAMERA_GPU: return "camera_gpu";
+        case STAGE_PLANES: return "planes";
+        case STAGE_PLANES_GPU: return "planes_gpu";
+        case STAGE_DEPTH: return "depth";
+        case STAGE_MODEL: return "model";
+        case STAGE_MODEL_OPAQUE_GPU: return "model_opaque_gpu";
+        case STAGE_MODEL_MASK_GPU: return "model_mask_gpu";
+        case STAGE_MODEL_BLEND_GPU: return "model_blend_gpu";
+        case STAGE_COMPOSITE_GPU: return "composite_gpu";
+        case STAGE_TOUCH_TO_MOTION: return "touch_to_motion";
+        case STAGE_FRAME: return "frame";
+        default: return "unknown";
+    }
+}
+
+const char* FrameStats::counterName(Counter counter) {
+    switch(counter) {
+        case COUNTER_UNIFORM_CALLS: return "uniform_calls";
+        case COUNTER_STATE_CALLS: return "state_calls";
+        case COUNTER_STATE_SKIPPED: return "state_skipped";
+        case COUNTER_SCENE_SCALE: return "scene_scale_pct";
+        default: return "unknown";
+    }
+}
+
+/* Nearest-rank percentile of an already sorted sample set */
+double FrameStats::percentile(const std::vector<double>& sorted, double p) {
+    if(sorted.empty()) return 0.0;
+    size_t rank = (size_t)std::ceil(p * (double)sorted.size());
+    if(rank == 0) rank = 1;
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+long FrameStats::ProcStatusKb(const char *field) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if(!file) return -1;
+
+    char line[256];
+    long value = -1;
+    size_t length = strlen(field);
+    while(fgets(line, sizeof(line), file)) {
+        if(!strncmp(line, field, length) && line[length] == ':') {
+            value = strtol(line + length + 1, nullptr, 10);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+bool FrameStats::ResetPeakRss() {
+    /* "5" resets the peak RSS of the process, see proc(5) */
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if(!file) return false;
+    bool ok = fputs("5", file) >= 0;
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,92 @@
+#ifndef BUILDING_AR_FRAME_STATS_H
+#define BUILDING_AR_FRAME_STATS_H
+
+#include <android/log.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define LOG_TAG "FrameStats"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/* Collects per-stage CPU frame times while a benchmark is running and writes p50/p95/p99 to a file */
+class FrameStats {
+public:
+    enum Stage {
+        STAGE_UPDATE,   // ArSession_update
+        STAGE_CAMERA,   // Camera background pass
+        STAGE_CAMERA_GPU, // Camera background pass, GPU time (GL_EXT_disjoint_timer_query)
+        STAGE_PLANES,   // Plane query + draw
+        STAGE_PLANES_GPU, // Plane pass, GPU time
+        STAGE_DEPTH,    // Depth occlusion texture upload
+        STAGE_MODEL,    // Model upload + draw
+        STAGE_MODEL_OPAQUE_GPU, // Model passes, GPU time : opaque meshes
+        STAGE_MODEL_MASK_GPU,   // alpha tested meshes
+        STAGE_MODEL_BLEND_GPU,  // blended meshes
+        STAGE_COMPOSITE_GPU,    // Scaled 3D passes composited over the camera, GPU time
+        STAGE_TOUCH_TO_MOTION,  // Drag touch event to the end of the frame that moved the model
+        STAGE_FRAME,    // Whole OnDrawFrame
+        STAGE_COUNT
+    };
+
+    /* Per frame values (mostly GL calls), reported with the same percentiles as the stages */
+    enum Counter {
+        COUNTER_UNIFORM_CALLS,  // glUniform*, glGetUniformLocation and uniform buffer writes
+        COUNTER_STATE_CALLS,    // State changes GLStateCache issued
+        COUNTER_STATE_SKIPPED,  // Redundant state changes GLStateCache filtered out
+        COUNTER_SCENE_SCALE,    // Render scale of the 3D passes in percent, see ResolutionController
+        COUNTER_COUNT
+    };
+
+    /* Times the enclosing scope into a stage. Does nothing when the stats aren't active */
+    class ScopedTimer {
+    public:
+        ScopedTimer(FrameStats& stats, Stage stage)
+            : mStats(stats), mStage(stage), mStart(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer() {
+            if(!mStats.isActive()) return;
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - mStart;
+            mStats.record(mStage, elapsed.count());
+        }
+    private:
+        FrameStats& mStats;
+        Stage mStage;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+    void begin(const std::string& reportPath);
+    bool end();
+    bool isActive() const { return mActive; }
+    void record(Stage stage, double ms);
+    /* One-off measurements reported as they are, e.g. model load time to first pixel. In ms,
+     * unless the name says otherwise (*_kb) */
+    void recordEvent(const std::string& name, double value);
+
+    /* Static so renderers can count without a FrameStats at hand. GL thread only */
+    static void Count(Counter counter, unsigned int calls = 1) { sFrameCounts[counter] += calls; }
+    /* Closes the frame's counters : their totals become one sample each, then they restart at 0 */
+    void endFrame();
+
+    static const char* stageName(Stage stage);
+    static const char* counterName(Counter counter);
+
+    /* A "<field>: <n> kB" line of /proc/self/status (VmRSS, VmHWM, ...), -1 if unavailable */
+    static long ProcStatusKb(const char* field);
+    /* Resets VmHWM to the current RSS so a following peak can be measured */
+    static bool ResetPeakRss();
+
+private:
+    bool mActive = false;
+    std::string mReportPath;
+    std::vector<double> mSamples[STAGE_COUNT];
+    std::vector<double> mCounterSamples[COUNTER_COUNT];
+    std::vector<std::pair<std::string, double>> mEvents;
+
+    static unsigned int sFrameCounts[COUNTER_COUNT];
+
+    static double percentile(const std::vector<double>& sorted, double p);
+};
+
+#endif //BUILDING_AR_FRAME_STATS_H
@@ -0,0 +1,80 @@
+#include <frame_stats.h>
+#include <frame_uniforms.h>
+
+#include <EGL/egl.h>
+
+#include <cstring>
+
+bool FrameUniforms::create() {
+    /* A new surface comes with a new context, the names of the previous one are already gone */
+    mBuffer = 0;
+    mSlot = 0;
+    for(GLsync& fence : mFences) fence = nullptr;
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment <= 0) alignment = 256;
+    mSlotSize = ((GLsizeiptr)sizeof(Block) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, mSlotSize * kRingSize, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return mBuffer != 0;
+}
+
+void FrameUniforms::destroy() {
+    if(eglGetCurrentContext() != EGL_NO_CONTEXT) {
+        for(GLsync& fence : mFences) {
+            if(fence) glDeleteSync(fence);
+        }
+        if(mBuffer) glDeleteBuffers(1, &mBuffer);
+    }
+    for(GLsync& fence : mFences) fence = nullptr;
+    mBuffer = 0;
+}
+
+void FrameUniforms::Attach(GLuint program) {
+    GLuint index = glGetUniformBlockIndex(program, "Frame");
+    if(index == GL_INVALID_INDEX) {
+        LOGE("NAT_ERROR : FrameUniforms : program %u has no Frame block", program);
+        return;
+    }
+    glUniformBlockBinding(program, index, kBindingPoint);
+}
+
+void FrameUniforms::update(const glm::mat4 &view, const glm::mat4 &projection) {
+    mBlock.view = view;
+    mBlock.projection = projection;
+    mBlock.viewProjection = projection * view;
+    mBlock.cameraPosition = glm::inverse(view)[3];
+    if(!mBuffer) return;
+
+    mSlot = (mSlot + 1) % kRingSize;
+
+    /* Written kRingSize frames ago, the GPU is practically always done with it by now */
+    if(mFences[mSlot]) {
+        glClientWaitSync(mFences[mSlot], 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(mFences[mSlot]);
+        mFences[mSlot] = nullptr;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    void* slot = glMapBufferRange(GL_UNIFORM_BUFFER, mSlotSize * mSlot, sizeof(Block),
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(slot) {
+        memcpy(slot, &mBlock, sizeof(Block));
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    } else {
+        glBufferSubData(GL_UNIFORM_BUFFER, mSlotSize * mSlot, sizeof(Block), &mBlock);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferRange(GL_UNIFORM_BUFFER, kBindingPoint, mBuffer, mSlotSize * mSlot, sizeof(Block));
+    FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS);
+}
+
+void FrameUniforms::endFrame() {
+    if(!mBuffer) return;
+    if(mFences[mSlot]) glDeleteSync(mFences[mSlot]);
+    mFences[mSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,60 @@
+#ifndef BUILDING_AR_FRAME_UNIFORMS_H
+#define BUILDING_AR_FRAME_UNIFORMS_H
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include "glm/glm.hpp"
+
+#define LOG_TAG "FrameUniforms"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * Per-frame camera data shared by every program through the "Frame" uniform block : written
+ * once per frame, bound once, and each draw only supplies its own model matrix.
+ *
+ * The buffer is a ring of kRingSize slots so the frame being written never is one the GPU may
+ * still read. Each slot is fenced when its frame has been submitted and the fence is checked
+ * (normally long signalled) before the slot comes around again.
+ *
+ * Light data lives in its own block (see LightEstimation), it changes a lot less often.
+ */
+class FrameUniforms {
+public:
+    /* Uniform buffer binding point of the block, LightEstimation uses 0 */
+    static constexpr GLuint kBindingPoint = 1;
+    static constexpr int kRingSize = 3;
+
+    /* std140 layout of the block in the shaders */
+    struct Block {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::mat4 viewProjection;
+        glm::vec4 cameraPosition;   // World space, w = 1
+    };
+    static_assert(sizeof(Block) == 208, "Block must match the std140 layout of Frame");
+
+    /* GL thread. create() once per GL context */
+    ~FrameUniforms() { destroy(); }
+    bool create();
+    void destroy();
+    /* Points the program's "Frame" block at kBindingPoint, once after linking */
+    static void Attach(GLuint program);
+
+    /* Writes the frame's block into the next slot and binds that slot */
+    void update(const glm::mat4& view, const glm::mat4& projection);
+    /* After the frame's last draw using the block */
+    void endFrame();
+
+    const Block& block() const { return mBlock; }
+
+private:
+    GLuint mBuffer = 0;
+    GLsizeiptr mSlotSize = 0;       // sizeof(Block) rounded up to the offset alignment
+    int mSlot = 0;
+    GLsync mFences[kRingSize] = {nullptr};
+    Block mBlock{};
+};
+
+#endif //BUILDING_AR_FRAME_UNIFORMS_H
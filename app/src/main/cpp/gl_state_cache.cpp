@@ -0,0 +1,113 @@
+#include <gl_state_cache.h>
+
+#include <GLES2/gl2ext.h>
+
+const GLBackend& GLBackend::Native() {
+    static const GLBackend backend = {
+            glUseProgram, glBindVertexArray, glActiveTexture, glBindTexture, glBindBuffer,
+            glEnable, glDisable, glBlendFunc, glBlendFuncSeparate, glDepthFunc, glDepthMask
+    };
+    return backend;
+}
+
+void GLStateCache::invalidate() {
+    mProgram = kUnknown;
+    mVertexArray = kUnknown;
+    mActiveUnit = kUnknown;
+    for(auto& unit : mTextures) {
+        for(GLuint& texture : unit) texture = kUnknown;
+    }
+    mArrayBuffer = kUnknown;
+    mUniformBuffer = kUnknown;
+    for(int8_t& cap : mCaps) cap = -1;
+    mBlendSrc = kUnknown;
+    mBlendDst = kUnknown;
+    mBlendSrcAlpha = kUnknown;
+    mBlendDstAlpha = kUnknown;
+    mDepthFunc = kUnknown;
+    mDepthMask = -1;
+}
+
+void GLStateCache::useProgram(GLuint program) {
+    if(change(mProgram, program)) mGL.useProgram(program);
+}
+
+void GLStateCache::bindVertexArray(GLuint array) {
+    if(change(mVertexArray, array)) mGL.bindVertexArray(array);
+}
+
+void GLStateCache::activeTexture(GLenum unit) {
+    if(change(mActiveUnit, unit)) mGL.activeTexture(unit);
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture) {
+    int index = target == GL_TEXTURE_2D ? TARGET_2D : target == GL_TEXTURE_EXTERNAL_OES ? TARGET_EXTERNAL : -1;
+    GLuint unit = mActiveUnit - GL_TEXTURE0;
+    /* Unknown unit or untracked target : forward, and forget what the unit may hold */
+    if(index < 0 || mActiveUnit == kUnknown || unit >= (GLuint)kTextureUnits) {
+        if(mActiveUnit != kUnknown && unit < (GLuint)kTextureUnits) {
+            for(GLuint& bound : mTextures[unit]) bound = kUnknown;
+        }
+        mCounters.issued++;
+        mGL.bindTexture(target, texture);
+        return;
+    }
+    if(change(mTextures[unit][index], texture)) mGL.bindTexture(target, texture);
+}
+
+void GLStateCache::bindTexture(GLenum unit, GLenum target, GLuint texture) {
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    GLuint* shadow = target == GL_ARRAY_BUFFER ? &mArrayBuffer : target == GL_UNIFORM_BUFFER ? &mUniformBuffer : nullptr;
+    if(!shadow) {
+        mCounters.issued++;
+        mGL.bindBuffer(target, buffer);
+        return;
+    }
+    if(change(*shadow, buffer)) mGL.bindBuffer(target, buffer);
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled) {
+    int index = cap == GL_DEPTH_TEST ? CAP_DEPTH_TEST : cap == GL_BLEND ? CAP_BLEND : cap == GL_CULL_FACE ? CAP_CULL_FACE : -1;
+    if(index < 0 || change(mCaps[index], (int8_t)(enabled ? 1 : 0))) {
+        if(index < 0) mCounters.issued++;
+        if(enabled) mGL.enable(cap);
+        else mGL.disable(cap);
+    }
+}
+
+void GLStateCache::blendFunc(GLenum sfactor, GLenum dfactor) {
+    /* One call sets all factors, counted as one */
+    if(mBlendSrc == sfactor && mBlendDst == dfactor && mBlendSrcAlpha == sfactor && mBlendDstAlpha == dfactor) {
+        mCounters.skipped++;
+        return;
+    }
+    mBlendSrc = mBlendSrcAlpha = sfactor;
+    mBlendDst = mBlendDstAlpha = dfactor;
+    mCounters.issued++;
+    mGL.blendFunc(sfactor, dfactor);
+}
+
+void GLStateCache::blendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha) {
+    if(mBlendSrc == srcRGB && mBlendDst == dstRGB && mBlendSrcAlpha == srcAlpha && mBlendDstAlpha == dstAlpha) {
+        mCounters.skipped++;
+        return;
+    }
+    mBlendSrc = srcRGB;
+    mBlendDst = dstRGB;
+    mBlendSrcAlpha = srcAlpha;
+    mBlendDstAlpha = dstAlpha;
+    mCounters.issued++;
+    mGL.blendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+}
+
+void GLStateCache::depthFunc(GLenum func) {
+    if(change(mDepthFunc, func)) mGL.depthFunc(func);
+}
+
+void GLStateCache::depthMask(bool enabled) {
+    if(change(mDepthMask, (int8_t)(enabled ? 1 : 0))) mGL.depthMask(enabled ? GL_TRUE : GL_FALSE);
+}
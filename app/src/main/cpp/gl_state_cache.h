@@ -0,0 +1,112 @@
+#ifndef BUILDING_AR_GL_STATE_CACHE_H
+#define BUILDING_AR_GL_STATE_CACHE_H
+
+#include <GLES3/gl3.h>
+
+#include <cstdint>
+
+/*
+ * The GL entry points GLStateCache forwards to. Native() is the driver; tests substitute
+ * recording functions so the cache can be checked on a host without a context.
+ */
+struct GLBackend {
+    void (*useProgram)(GLuint program);
+    void (*bindVertexArray)(GLuint array);
+    void (*activeTexture)(GLenum unit);
+    void (*bindTexture)(GLenum target, GLuint texture);
+    void (*bindBuffer)(GLenum target, GLuint buffer);
+    void (*enable)(GLenum cap);
+    void (*disable)(GLenum cap);
+    void (*blendFunc)(GLenum sfactor, GLenum dfactor);
+    void (*blendFuncSeparate)(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+    void (*depthFunc)(GLenum func);
+    void (*depthMask)(GLboolean flag);
+
+    static const GLBackend& Native();
+};
+
+/*
+ * Shadows the render context's pipeline state and only forwards calls that change something.
+ *
+ * Every pass sets the full state it needs through the cache instead of restoring defaults
+ * afterwards, so consecutive passes and draws that agree cost nothing. Anything that changes
+ * tracked state behind the cache's back (ArSession_update latching the camera texture, the
+ * model's uploads) must be followed by invalidate(), after which every value is unknown and
+ * the next call for it is always issued.
+ *
+ * Tracks the program, VAO, active texture unit, 2D / external texture per unit, array and
+ * uniform buffer bindings, depth test / blend / cull face, blend funcs, depth func and mask.
+ * GL thread only.
+ */
+class GLStateCache {
+public:
+    static constexpr int kTextureUnits = 8;
+
+    struct Counters {
+        uint64_t issued = 0;
+        uint64_t skipped = 0;
+    };
+
+    explicit GLStateCache(const GLBackend& backend = GLBackend::Native()) : mGL(backend) { invalidate(); }
+
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint array);
+    /* unit as in glActiveTexture, GL_TEXTURE0 + n */
+    void activeTexture(GLenum unit);
+    /* Binds on the active unit. Targets other than 2D / external OES are forwarded untracked */
+    void bindTexture(GLenum target, GLuint texture);
+    /* Shortcut for activeTexture + bindTexture */
+    void bindTexture(GLenum unit, GLenum target, GLuint texture);
+    /* GL_ARRAY_BUFFER and GL_UNIFORM_BUFFER are tracked, other targets are forwarded */
+    void bindBuffer(GLenum target, GLuint buffer);
+    /* GL_DEPTH_TEST, GL_BLEND and GL_CULL_FACE are tracked, other caps are forwarded */
+    void setEnabled(GLenum cap, bool enabled);
+    void blendFunc(GLenum sfactor, GLenum dfactor);
+    /* Shares the shadow with blendFunc, which is the case of equal color and alpha factors */
+    void blendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+    void depthFunc(GLenum func);
+    void depthMask(bool enabled);
+
+    const Counters& counters() const { return mCounters; }
+    void resetCounters() { mCounters = Counters(); }
+
+private:
+    /* Value no GL name or enum takes, marks unknown state */
+    static constexpr GLuint kUnknown = 0xFFFFFFFFu;
+
+    enum Cap { CAP_DEPTH_TEST, CAP_BLEND, CAP_CULL_FACE, CAP_COUNT };
+    enum TextureTarget { TARGET_2D, TARGET_EXTERNAL, TARGET_COUNT };
+
+    const GLBackend& mGL;
+    Counters mCounters;
+
+    GLuint mProgram;
+    GLuint mVertexArray;
+    GLenum mActiveUnit;
+    GLuint mTextures[kTextureUnits][TARGET_COUNT];
+    GLuint mArrayBuffer;
+    GLuint mUniformBuffer;
+    int8_t mCaps[CAP_COUNT];    // -1 unknown, 0 disabled, 1 enabled
+    GLenum mBlendSrc;
+    GLenum mBlendDst;
+    GLenum mBlendSrcAlpha;
+    GLenum mBlendDstAlpha;
+    GLenum mDepthFunc;
+    int8_t mDepthMask;
+
+    /* Compares and updates one shadowed value, counts the outcome. True if the call must be issued */
+    template <typename T>
+    bool change(T& shadow, T value) {
+        if(shadow == value) {
+            mCounters.skipped++;
+            return false;
+        }
+        shadow = value;
+        mCounters.issued++;
+        return true;
+    }
+};
+
+#endif //BUILDING_AR_GL_STATE_CACHE_H
@@ -0,0 +1,157 @@
+#include <gl_uploader.h>
+
+#include <EGL/egl.h>
+
+#include <chrono>
+
+namespace {
+
+/* stop() waits this long per leftover fence, the uploads are flushed and take milliseconds at most */
+constexpr GLuint64 kStopFenceTimeoutNs = 100000000;
+
+}
+
+/* Runs on the GL thread */
+bool GLUploader::start() {
+    if(isRunning()) return true;
+
+    if(!mContext.create()) {
+        LOGE("NAT_ERROR : GLUploader : shared context unavailable, uploads stay on the GL thread");
+        return false;
+    }
+
+    mUploadMicros.store(0, std::memory_order_relaxed);
+    mFinished.store(false, std::memory_order_release);
+    mHealthy.store(true, std::memory_order_release);
+    mRunning.store(true, std::memory_order_release);
+    mThread = std::thread(&GLUploader::run, this);
+    LOGI("SANJU : GLUploader started");
+    return true;
+}
+
+/* Runs on the GL thread */
+void GLUploader::stop() {
+    if(!isRunning()) return;
+
+    /* Without a context the completions couldn't do their GL work, and the objects die with it anyway */
+    bool current = eglGetCurrentContext() != EGL_NO_CONTEXT;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning.store(false, std::memory_order_release);
+        if(!current) mQueued.clear();
+    }
+    mWake.notify_one();
+
+    /* The upload thread may be waiting for room in mFenced */
+    std::unique_ptr<Upload> upload;
+    while(!mFinished.load(std::memory_order_acquire)) {
+        while(mFenced.pop(upload)) mWaiting.push_back(std::move(upload));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    mThread.join();
+    while(mFenced.pop(upload)) mWaiting.push_back(std::move(upload));
+
+    /* Left behind by a thread that couldn't bind its context : the names are shared, upload them here */
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(std::unique_ptr<Upload>& queued : mQueued) {
+            if(current) queued->task();
+            mWaiting.push_back(std::move(queued));
+        }
+        mQueued.clear();
+    }
+
+    for(std::unique_ptr<Upload>& waiting : mWaiting) {
+        if(!current) continue;
+        if(waiting->fence) glClientWaitSync(waiting->fence, GL_SYNC_FLUSH_COMMANDS_BIT, kStopFenceTimeoutNs);
+        complete(waiting);
+    }
+    mWaiting.clear();
+    mPending = 0;
+
+    mContext.destroy();
+    mHealthy.store(false, std::memory_order_release);
+    LOGI("SANJU : GLUploader stopped, %.1f ms of uploads off the GL thread", uploadMicros() / 1000.0);
+}
+
+/* Runs on the GL thread */
+bool GLUploader::submit(Task task, Completion done) {
+    if(!isRunning() || !isHealthy()) return false;
+
+    std::unique_ptr<Upload> upload(new Upload());
+    upload->task = std::move(task);
+    upload->done = std::move(done);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueued.push_back(std::move(upload));
+    }
+    mWake.notify_one();
+    mPending++;
+    return true;
+}
+
+/* Runs on the GL thread */
+int GLUploader::poll() {
+    std::unique_ptr<Upload> upload;
+    while(mFenced.pop(upload)) mWaiting.push_back(std::move(upload));
+
+    /* In order : the first unsignaled fence holds back the ones after it */
+    int completed = 0;
+    while(!mWaiting.empty()) {
+        GLenum status = glClientWaitSync(mWaiting.front()->fence, 0, 0);
+        if(status == GL_TIMEOUT_EXPIRED) break;
+        if(status == GL_WAIT_FAILED) {
+            /* The objects exist either way, the driver serializes their first use */
+            LOGE("NAT_ERROR : GLUploader : glClientWaitSync failed : 0x%x", glGetError());
+        }
+        complete(mWaiting.front());
+        mWaiting.pop_front();
+        completed++;
+    }
+    return completed;
+}
+
+/* Runs on the GL thread */
+void GLUploader::complete(std::unique_ptr<Upload> &upload) {
+    if(upload->fence) glDeleteSync(upload->fence);
+    upload->fence = nullptr;
+    if(upload->done) upload->done();
+    mPending--;
+}
+
+/* Runs on the upload thread */
+void GLUploader::run() {
+    if(!mContext.makeCurrent()) {
+        mHealthy.store(false, std::memory_order_release);
+        mFinished.store(true, std::memory_order_release);
+        return;
+    }
+
+    for(;;) {
+        std::unique_ptr<Upload> upload;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this] { return !mQueued.empty() || !mRunning.load(std::memory_order_acquire); });
+            /* Stopping only once everything queued is uploaded */
+            if(mQueued.empty()) break;
+            upload = std::move(mQueued.front());
+            mQueued.pop_front();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        upload->task();
+        upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        /* Unflushed, the fence might never reach the GPU and the GL thread would poll it forever */
+        glFlush();
+        mUploadMicros.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+        /* The GL thread drains it every frame (stop() too), a full queue only holds this thread back */
+        while(!mFenced.push(std::move(upload))) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    mContext.release();
+    mFinished.store(true, std::memory_order_release);
+}
@@ -0,0 +1,96 @@
+#ifndef BUILDING_AR_GL_UPLOADER_H
+#define BUILDING_AR_GL_UPLOADER_H
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "egl_shared_context.h"
+#include "spsc_queue.h"
+
+#define LOG_TAG "GLUploader"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * Runs GL uploads (buffer data, texture images) on a thread of its own, with an EGL context
+ * shared with the render context, so the render thread only sees the finished objects.
+ *
+ * Each upload is followed by a fence and a flush on the upload thread. poll() checks the oldest
+ * fences with glClientWaitSync and a zero timeout, never waiting, and runs the completions whose
+ * uploads the GPU has finished, in submission order. Only names and data cross over : container
+ * objects (VAOs, framebuffers) aren't shared between contexts and are made by the completion.
+ *
+ * Without a shared context start() fails and the caller keeps uploading itself. If the thread
+ * dies later (isHealthy() turns false), stop() runs whatever it left on the calling thread, so
+ * no upload is lost either way.
+ */
+class GLUploader {
+public:
+    /* Upload thread, shared context current */
+    using Task = std::function<void()>;
+    /* GL thread, once the task's objects are ready to use in the render context */
+    using Completion = std::function<void()>;
+
+    ~GLUploader() { stop(); }
+
+    /* GL thread, with the render context current */
+    bool start();
+    /* GL thread. Lets the upload thread finish what is queued, then runs every completion. With no
+     * context current (teardown) everything left is dropped instead, nothing runs */
+    void stop();
+    bool isRunning() const { return mThread.joinable(); }
+    /* False once the upload thread gave up, e.g. it couldn't bind its context */
+    bool isHealthy() const { return mHealthy.load(std::memory_order_acquire); }
+
+    /* GL thread. False when not running, nothing was queued then */
+    bool submit(Task task, Completion done);
+    /* GL thread, once per frame. Runs the completions whose fence signaled, returns how many */
+    int poll();
+    /* GL thread. Submitted uploads whose completion hasn't run yet */
+    size_t pending() const { return mPending; }
+
+    /* Any thread. Time the upload thread spent in tasks since start(), fences included */
+    uint64_t uploadMicros() const { return mUploadMicros.load(std::memory_order_relaxed); }
+
+private:
+    struct Upload {
+        Task task;
+        Completion done;
+        GLsync fence = nullptr;
+    };
+
+    void run();
+    /* GL thread. Runs the completion and drops the fence */
+    void complete(std::unique_ptr<Upload>& upload);
+
+    EGLSharedContext mContext;
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mHealthy{false};
+    /* Set by the upload thread as it exits, stop() keeps draining mFenced until then */
+    std::atomic<bool> mFinished{false};
+    std::atomic<uint64_t> mUploadMicros{0};
+
+    /* GL thread -> upload thread. The upload thread sleeps on it, so a plain locked queue */
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::deque<std::unique_ptr<Upload>> mQueued;
+
+    /* Upload thread -> GL thread, fenced */
+    SpscQueue<std::unique_ptr<Upload>, 64> mFenced;
+
+    /* GL thread only. Popped from mFenced, the oldest still waiting for its fence */
+    std::deque<std::unique_ptr<Upload>> mWaiting;
+    size_t mPending = 0;
+};
+
+#endif //BUILDING_AR_GL_UPLOADER_H
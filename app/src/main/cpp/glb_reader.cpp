@@ -0,0 +1,478 @@
+#include <glb_reader.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t kGLBMagic = 0x46546C67;      // "glTF"
+constexpr uint32_t kChunkJSON = 0x4E4F534A;     // "JSON"
+constexpr uint32_t kChunkBIN = 0x004E4942;      // "BIN\0"
+
+/* Deep enough for any glTF, shallow enough that a hostile file can't blow the stack */
+constexpr int kMaxJsonDepth = 64;
+constexpr int kMaxNodeDepth = 256;
+
+uint32_t ReadU32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+int ComponentCount(const JsonDocument::Node* type) {
+    if(JsonDocument::equals(type, "SCALAR")) return 1;
+    if(JsonDocument::equals(type, "VEC2")) return 2;
+    if(JsonDocument::equals(type, "VEC3")) return 3;
+    if(JsonDocument::equals(type, "VEC4")) return 4;
+    return 0;
+}
+
+size_t ComponentSize(int componentType) {
+    switch(componentType) {
+        case 5120: case 5121: return 1;    // BYTE, UNSIGNED_BYTE
+        case 5122: case 5123: return 2;    // SHORT, UNSIGNED_SHORT
+        case 5125: case 5126: return 4;    // UNSIGNED_INT, FLOAT
+        default: return 0;
+    }
+}
+
+}
+
+/****************** JsonDocument *************/
+
+bool JsonDocument::parse(const char *text, size_t length) {
+    mCursor = text;
+    mEnd = text + length;
+    mNodes.clear();
+    /* glTF JSON averages well above 16 bytes per value, so this is usually the only allocation */
+    mNodes.reserve(length / 16 + 16);
+
+    if(parseValue(0) != 0) return false;
+    skipWhitespace();
+    /* The JSON chunk may be padded with spaces, nothing else */
+    return mCursor == mEnd || *mCursor == '\0';
+}
+
+void JsonDocument::skipWhitespace() {
+    while(mCursor < mEnd && (*mCursor == ' ' || *mCursor == '\n' || *mCursor == '\r' || *mCursor == '\t')) mCursor++;
+}
+
+bool JsonDocument::parseString(const char *&start, uint32_t &length) {
+    if(mCursor >= mEnd || *mCursor != '"') return false;
+    start = ++mCursor;
+    while(mCursor < mEnd && *mCursor != '"') {
+        /* Escapes are kept as they are, only skipped over */
+        if(*mCursor == '\\') mCursor++;
+        mCursor++;
+    }
+    if(mCursor >= mEnd) return false;
+    length = (uint32_t)(mCursor - start);
+    mCursor++;
+    return true;
+}
+
+/* Returns the index of the parsed node, -1 on a syntax error */
+int32_t JsonDocument::parseValue(int depth) {
+    if(depth > kMaxJsonDepth) return -1;
+    skipWhitespace();
+    if(mCursor >= mEnd) return -1;
+
+    int32_t index = (int32_t)mNodes.size();
+    mNodes.emplace_back();
+    char c = *mCursor;
+
+    if(c == '{' || c == '[') {
+        bool isObject = c == '{';
+        mNodes[index].type = isObject ? JSON_OBJECT : JSON_ARRAY;
+        mNodes[index].text = mCursor++;
+        int32_t previous = -1;
+
+        skipWhitespace();
+        if(mCursor < mEnd && *mCursor == (isObject ? '}' : ']')) {
+            mCursor++;
+            return index;
+        }
+        while(true) {
+            const char* key = nullptr;
+            uint32_t keyLength = 0;
+            if(isObject) {
+                skipWhitespace();
+                if(!parseString(key, keyLength)) return -1;
+                skipWhitespace();
+                if(mCursor >= mEnd || *mCursor++ != ':') return -1;
+            }
+
+            int32_t child = parseValue(depth + 1);
+            if(child < 0) return -1;
+            /* mNodes may have grown, always index, never keep references across parseValue() */
+            mNodes[child].key = key;
+            mNodes[child].keyLength = keyLength;
+            if(previous < 0) mNodes[index].firstChild = child;
+            else mNodes[previous].nextSibling = child;
+            previous = child;
+            mNodes[index].childCount++;
+
+            skipWhitespace();
+            if(mCursor >= mEnd) return -1;
+            char separator = *mCursor++;
+            if(separator == ',') continue;
+            if(separator == (isObject ? '}' : ']')) break;
+            return -1;
+        }
+        mNodes[index].length = (uint32_t)(mCursor - mNodes[index].text);
+        return index;
+    }
+
+    if(c == '"') {
+        const char* start;
+        uint32_t length;
+        if(!parseString(start, length)) return -1;
+        mNodes[index].type = JSON_STRING;
+        mNodes[index].text = start;
+        mNodes[index].length = length;
+        return index;
+    }
+
+    /* Literals and numbers run until the next delimiter */
+    const char* start = mCursor;
+    while(mCursor < mEnd && *mCursor != ',' && *mCursor != '}' && *mCursor != ']' &&
+          *mCursor != ' ' && *mCursor != '\n' && *mCursor != '\r' && *mCursor != '\t') mCursor++;
+    uint32_t length = (uint32_t)(mCursor - start);
+    if(length == 0) return -1;
+
+    mNodes[index].text = start;
+    mNodes[index].length = length;
+    if((length == 4 && !strncmp(start, "true", 4)) || (length == 5 && !strncmp(start, "false", 5))) {
+        mNodes[index].type = JSON_BOOL;
+    } else if(length == 4 && !strncmp(start, "null", 4)) {
+        mNodes[index].type = JSON_NULL;
+    } else if(c == '-' || (c >= '0' && c <= '9')) {
+        mNodes[index].type = JSON_NUMBER;
+    } else {
+        return -1;
+    }
+    return index;
+}
+
+const JsonDocument::Node* JsonDocument::member(const Node *object, const char *key) const {
+    if(!object || object->type != JSON_OBJECT) return nullptr;
+    size_t keyLength = strlen(key);
+    for(const Node* child = first(object); child; child = next(child)) {
+        if(child->keyLength == keyLength && !memcmp(child->key, key, keyLength)) return child;
+    }
+    return nullptr;
+}
+
+const JsonDocument::Node* JsonDocument::element(const Node *array, uint32_t index) const {
+    if(!array || array->type != JSON_ARRAY || index >= array->childCount) return nullptr;
+    const Node* child = first(array);
+    while(index-- > 0) child = next(child);
+    return child;
+}
+
+double JsonDocument::asNumber(const Node *node, double fallback) {
+    if(!node || node->type != JSON_NUMBER) return fallback;
+    /* The number is always followed by a delimiter inside the chunk, strtod stops there */
+    return strtod(node->text, nullptr);
+}
+
+bool JsonDocument::equals(const Node *node, const char *value) {
+    if(!node || node->type != JSON_STRING) return false;
+    size_t length = strlen(value);
+    return node->length == length && !memcmp(node->text, value, length);
+}
+
+/****************** GLBAccessorView *************/
+
+float GLBAccessorView::readFloat(size_t index, int component) const {
+    const uint8_t* element = data + index * stride;
+    switch(componentType) {
+        case 5126: {
+            float value;
+            memcpy(&value, element + component * sizeof(float), sizeof(float));
+            return value;
+        }
+        /* Normalized integer formats (KHR_mesh_quantization style texcoords / normals) */
+        case 5121: return normalized ? element[component] / 255.0f : (float)element[component];
+        case 5120: {
+            float value = (float)(int8_t)element[component];
+            return normalized ? (value / 127.0f < -1.0f ? -1.0f : value / 127.0f) : value;
+        }
+        case 5123: {
+            uint16_t value;
+            memcpy(&value, element + component * 2, 2);
+            return normalized ? value / 65535.0f : (float)value;
+        }
+        case 5122: {
+            int16_t value;
+            memcpy(&value, element + component * 2, 2);
+            return normalized ? (value / 32767.0f < -1.0f ? -1.0f : value / 32767.0f) : (float)value;
+        }
+        default: return 0.0f;
+    }
+}
+
+uint32_t GLBAccessorView::readIndex(size_t index) const {
+    const uint8_t* element = data + index * stride;
+    switch(componentType) {
+        case 5121: return element[0];
+        case 5123: {
+            uint16_t value;
+            memcpy(&value, element, 2);
+            return value;
+        }
+        case 5125: {
+            uint32_t value;
+            memcpy(&value, element, 4);
+            return value;
+        }
+        default: return 0;
+    }
+}
+
+/****************** GLBReader *************/
+
+bool GLBReader::IsGLB(const void *data, size_t size) {
+    return size >= 12 && ReadU32((const uint8_t*)data) == kGLBMagic;
+}
+
+bool GLBReader::parse(const uint8_t *data, size_t size) {
+    mBin = nullptr;
+    mBinSize = 0;
+
+    if(!IsGLB(data, size) || ReadU32(data + 4) != 2) {
+        mError = "not a glTF 2.0 binary";
+        return false;
+    }
+    size_t total = ReadU32(data + 8);
+    if(total > size) {
+        mError = "truncated file";
+        return false;
+    }
+
+    const uint8_t* json = nullptr;
+    size_t jsonSize = 0;
+    size_t offset = 12;
+    while(offset + 8 <= total) {
+        size_t chunkSize = ReadU32(data + offset);
+        uint32_t chunkType = ReadU32(data + offset + 4);
+        if(chunkSize > total - offset - 8) {
+            mError = "chunk out of bounds";
+            return false;
+        }
+        if(chunkType == kChunkJSON && !json) {
+            json = data + offset + 8;
+            jsonSize = chunkSize;
+        } else if(chunkType == kChunkBIN && !mBin) {
+            mBin = data + offset + 8;
+            mBinSize = chunkSize;
+        }
+        /* Chunks are 4 byte aligned */
+        offset += 8 + ((chunkSize + 3) & ~(size_t)3);
+    }
+
+    if(!json || !mJson.parse((const char*)json, jsonSize)) {
+        mError = "invalid JSON chunk";
+        return false;
+    }
+
+    /* Index the top level arrays once, accessors etc. are looked up by index all the time */
+    static const char* const kTableNames[TABLE_COUNT] = {
+            "accessors", "bufferViews", "buffers", "meshes", "nodes", "materials", "textures", "images", "scenes"
+    };
+    for(int table = 0; table < TABLE_COUNT; table++) {
+        mTables[table].clear();
+        const JsonDocument::Node* array = mJson.member(mJson.root(), kTableNames[table]);
+        if(!array || array->type != JsonDocument::JSON_ARRAY) continue;
+        mTables[table].reserve(array->childCount);
+        for(const JsonDocument::Node* item = mJson.first(array); item; item = mJson.next(item)) {
+            mTables[table].push_back(item);
+        }
+    }
+    return true;
+}
+
+int GLBReader::pipelineMarker() const {
+    const JsonDocument::Node* asset = mJson.member(mJson.root(), "asset");
+    const JsonDocument::Node* extras = asset ? mJson.member(asset, "extras") : nullptr;
+    return extras ? JsonDocument::asInt(mJson.member(extras, kPipelineMarker), -1) : -1;
+}
+
+/* The member goes first in the asset object, everything after the JSON chunk just moves */
+bool GLBReader::AddPipelineMarker(std::vector<uint8_t> &glb, uint32_t converterVersion) {
+    if(!IsGLB(glb.data(), glb.size()) || glb.size() < 20 || ReadU32(glb.data() + 16) != kChunkJSON) return false;
+    size_t jsonSize = ReadU32(glb.data() + 12);
+    if(jsonSize > glb.size() - 20) return false;
+
+    const char* json = (const char*)glb.data() + 20;
+    JsonDocument document;
+    if(!document.parse(json, jsonSize)) return false;
+    const JsonDocument::Node* asset = document.member(document.root(), "asset");
+    /* Existing extras are left alone, the file then simply loads as an unmarked one */
+    if(!asset || asset->type != JsonDocument::JSON_OBJECT || document.member(asset, "extras")) return false;
+
+    std::string member = std::string("\"extras\":{\"") + kPipelineMarker + "\":" + std::to_string(converterVersion) + "}";
+    if(asset->childCount > 0) member += ",";
+    size_t insertAt = 20 + (size_t)(asset->text - json) + 1;
+
+    /* JSON chunks are padded with spaces to 4 bytes */
+    size_t padding = (4 - (jsonSize + member.size()) % 4) % 4;
+    member.append(padding, ' ');
+    glb.insert(glb.begin() + insertAt, member.begin(), member.end());
+
+    uint32_t newJsonSize = (uint32_t)(jsonSize + member.size());
+    uint32_t total = (uint32_t)glb.size();
+    memcpy(glb.data() + 12, &newJsonSize, sizeof(newJsonSize));
+    memcpy(glb.data() + 8, &total, sizeof(total));
+    return true;
+}
+
+const JsonDocument::Node* GLBReader::arrayElement(Table table, int index) const {
+    if(index < 0 || (size_t)index >= mTables[table].size()) return nullptr;
+    return mTables[table][index];
+}
+
+void GLBReader::collectScenePrimitives(std::vector<Primitive> &out) const {
+    const JsonDocument::Node* root = mJson.root();
+    int sceneIndex = JsonDocument::asInt(mJson.member(root, "scene"), 0);
+    const JsonDocument::Node* scene = arrayElement(TABLE_SCENES, sceneIndex);
+
+    if(scene) {
+        const JsonDocument::Node* nodes = mJson.member(scene, "nodes");
+        for(const JsonDocument::Node* node = nodes ? mJson.first(nodes) : nullptr; node; node = mJson.next(node)) {
+            collectNode(JsonDocument::asInt(node, -1), out, 0);
+        }
+        return;
+    }
+
+    /* No scene, take every mesh once */
+    const JsonDocument::Node* meshes = mJson.member(root, "meshes");
+    for(const JsonDocument::Node* mesh = meshes ? mJson.first(meshes) : nullptr; mesh; mesh = mJson.next(mesh)) {
+        appendPrimitives(mesh, out);
+    }
+}
+
+void GLBReader::appendPrimitives(const JsonDocument::Node *mesh, std::vector<Primitive> &out) const {
+    const JsonDocument::Node* primitives = mJson.member(mesh, "primitives");
+    for(const JsonDocument::Node* p = primitives ? mJson.first(primitives) : nullptr; p; p = mJson.next(p)) {
+        const JsonDocument::Node* attributes = mJson.member(p, "attributes");
+        Primitive primitive;
+        primitive.position = JsonDocument::asInt(mJson.member(attributes, "POSITION"), -1);
+        primitive.normal = JsonDocument::asInt(mJson.member(attributes, "NORMAL"), -1);
+        primitive.texcoord = JsonDocument::asInt(mJson.member(attributes, "TEXCOORD_0"), -1);
+        primitive.indices = JsonDocument::asInt(mJson.member(p, "indices"), -1);
+        primitive.material = JsonDocument::asInt(mJson.member(p, "material"), -1);
+        primitive.mode = JsonDocument::asInt(mJson.member(p, "mode"), 4);
+        out.push_back(primitive);
+    }
+}
+
+void GLBReader::collectNode(int nodeIndex, std::vector<Primitive> &out, int depth) const {
+    const JsonDocument::Node* node = arrayElement(TABLE_NODES, nodeIndex);
+    if(!node || depth > kMaxNodeDepth) return;
+
+    appendPrimitives(arrayElement(TABLE_MESHES, JsonDocument::asInt(mJson.member(node, "mesh"), -1)), out);
+
+    const JsonDocument::Node* children = mJson.member(node, "children");
+    for(const JsonDocument::Node* child = children ? mJson.first(children) : nullptr; child; child = mJson.next(child)) {
+        collectNode(JsonDocument::asInt(child, -1), out, depth + 1);
+    }
+}
+
+bool GLBReader::supportsAll(const std::vector<Primitive> &primitives) const {
+    const JsonDocument::Node* root = mJson.root();
+    if(mJson.member(root, "extensionsRequired")) return false;
+
+    for(const Primitive& primitive : primitives) {
+        GLBAccessorView view;
+        if(primitive.mode != 4 || !accessor(primitive.position, view) || view.components != 3) return false;
+        if(primitive.normal >= 0 && (!accessor(primitive.normal, view) || view.components != 3)) return false;
+        if(primitive.texcoord >= 0 && (!accessor(primitive.texcoord, view) || view.components != 2)) return false;
+        if(primitive.indices >= 0 && (!accessor(primitive.indices, view) || view.components != 1)) return false;
+    }
+    return true;
+}
+
+bool GLBReader::bufferView(int index, const uint8_t *&outData, size_t &outSize) const {
+    const JsonDocument::Node* view = arrayElement(TABLE_BUFFER_VIEWS, index);
+    if(!view || !mBin) return false;
+
+    /* Only the GLB's own BIN chunk (buffer 0 without a uri) is supported */
+    const JsonDocument::Node* buffer = arrayElement(TABLE_BUFFERS, JsonDocument::asInt(mJson.member(view, "buffer"), -1));
+    if(!buffer || mJson.member(buffer, "uri")) return false;
+
+    size_t offset = (size_t)JsonDocument::asNumber(mJson.member(view, "byteOffset"), 0);
+    size_t length = (size_t)JsonDocument::asNumber(mJson.member(view, "byteLength"), 0);
+    if(offset > mBinSize || length > mBinSize - offset) return false;
+
+    outData = mBin + offset;
+    outSize = length;
+    return true;
+}
+
+bool GLBReader::accessor(int index, GLBAccessorView &out) const {
+    const JsonDocument::Node* accessor = arrayElement(TABLE_ACCESSORS, index);
+    if(!accessor || mJson.member(accessor, "sparse")) return false;
+
+    out.componentType = JsonDocument::asInt(mJson.member(accessor, "componentType"), 0);
+    out.components = ComponentCount(mJson.member(accessor, "type"));
+    out.count = (size_t)JsonDocument::asNumber(mJson.member(accessor, "count"), 0);
+    const JsonDocument::Node* normalized = mJson.member(accessor, "normalized");
+    out.normalized = normalized && normalized->type == JsonDocument::JSON_BOOL && normalized->text[0] == 't';
+
+    size_t elementSize = ComponentSize(out.componentType) * out.components;
+    if(elementSize == 0) return false;
+
+    const uint8_t* viewData;
+    size_t viewSize;
+    int viewIndex = JsonDocument::asInt(mJson.member(accessor, "bufferView"), -1);
+    if(!bufferView(viewIndex, viewData, viewSize)) return false;
+
+    size_t offset = (size_t)JsonDocument::asNumber(mJson.member(accessor, "byteOffset"), 0);
+    size_t stride = (size_t)JsonDocument::asNumber(mJson.member(arrayElement(TABLE_BUFFER_VIEWS, viewIndex), "byteStride"), 0);
+    out.stride = stride ? stride : elementSize;
+
+    /* The last element only needs elementSize bytes, not a whole stride */
+    if(out.count > 0 && (offset > viewSize || (out.count - 1) * out.stride + elementSize > viewSize - offset)) return false;
+    out.data = viewData + offset;
+    return true;
+}
+
+bool GLBReader::accessorBounds(int index, float outMin[3], float outMax[3]) const {
+    const JsonDocument::Node* accessor = arrayElement(TABLE_ACCESSORS, index);
+    const JsonDocument::Node* min = mJson.member(accessor, "min");
+    const JsonDocument::Node* max = mJson.member(accessor, "max");
+    if(!min || !max || min->childCount < 3 || max->childCount < 3) return false;
+
+    for(uint32_t i = 0; i < 3; i++) {
+        outMin[i] = (float)JsonDocument::asNumber(mJson.element(min, i), 0.0);
+        outMax[i] = (float)JsonDocument::asNumber(mJson.element(max, i), 0.0);
+    }
+    return true;
+}
+
+int GLBReader::imageCount() const {
+    return (int)mTables[TABLE_IMAGES].size();
+}
+
+bool GLBReader::imageData(int image, const uint8_t *&outData, size_t &outSize) const {
+    const JsonDocument::Node* node = arrayElement(TABLE_IMAGES, image);
+    return node && bufferView(JsonDocument::asInt(mJson.member(node, "bufferView"), -1), outData, outSize);
+}
+
+int GLBReader::baseColorImage(int material) const {
+    const JsonDocument::Node* node = arrayElement(TABLE_MATERIALS, material);
+    const JsonDocument::Node* pbr = mJson.member(node, "pbrMetallicRoughness");
+    const JsonDocument::Node* baseColor = mJson.member(pbr, "baseColorTexture");
+    int texture = JsonDocument::asInt(mJson.member(baseColor, "index"), -1);
+    return JsonDocument::asInt(mJson.member(arrayElement(TABLE_TEXTURES, texture), "source"), -1);
+}
+
+int GLBReader::alphaMode(int material, float &outCutoff) const {
+    const JsonDocument::Node* node = arrayElement(TABLE_MATERIALS, material);
+    outCutoff = (float)JsonDocument::asNumber(mJson.member(node, "alphaCutoff"), 0.5);
+    const JsonDocument::Node* mode = mJson.member(node, "alphaMode");
+    if(JsonDocument::equals(mode, "MASK")) return 1;
+    if(JsonDocument::equals(mode, "BLEND")) return 2;
+    return 0;
+}
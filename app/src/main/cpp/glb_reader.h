@@ -0,0 +1,141 @@
+#ifndef BUILDING_AR_GLB_READER_H
+#define BUILDING_AR_GLB_READER_H
+
+#include <android/log.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define LOG_TAG "GLBReader"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * Minimal JSON DOM for the glTF JSON chunk. All nodes live in one flat array and refer back
+ * into the source text, nothing is copied or unescaped.
+ */
+class JsonDocument {
+public:
+    enum Type {
+        JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT
+    };
+
+    struct Node {
+        Type type = JSON_NULL;
+        /* Raw text of the value (string contents without quotes) and of its key, if in an object */
+        const char* text = nullptr;
+        uint32_t length = 0;
+        const char* key = nullptr;
+        uint32_t keyLength = 0;
+        int32_t firstChild = -1;
+        int32_t nextSibling = -1;
+        uint32_t childCount = 0;
+    };
+
+    bool parse(const char* text, size_t length);
+    const Node* root() const { return mNodes.empty() ? nullptr : &mNodes[0]; }
+
+    /* Accessors return nullptr / the fallback on a missing member or a type mismatch */
+    const Node* member(const Node* object, const char* key) const;
+    const Node* element(const Node* array, uint32_t index) const;
+    const Node* next(const Node* node) const { return node->nextSibling < 0 ? nullptr : &mNodes[node->nextSibling]; }
+    const Node* first(const Node* node) const { return node->firstChild < 0 ? nullptr : &mNodes[node->firstChild]; }
+    static double asNumber(const Node* node, double fallback);
+    static int asInt(const Node* node, int fallback) { return (int)asNumber(node, fallback); }
+    static bool equals(const Node* node, const char* value);
+
+private:
+    const char* mCursor = nullptr;
+    const char* mEnd = nullptr;
+    std::vector<Node> mNodes;
+
+    int32_t parseValue(int depth);
+    void skipWhitespace();
+    bool parseString(const char*& start, uint32_t& length);
+};
+
+/* Strided view of a glTF accessor, pointing straight into the BIN chunk */
+struct GLBAccessorView {
+    const uint8_t* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+
+    float readFloat(size_t index, int component) const;
+    uint32_t readIndex(size_t index) const;
+    /* True when the elements are plain floats with no gaps, i.e. usable as a float array in place */
+    bool isTightFloat() const { return componentType == 5126 && stride == (size_t)components * sizeof(float); }
+};
+
+/*
+ * Reader for binary glTF 2.0 (.glb). parse() only indexes the file : the JSON chunk is parsed
+ * into a JsonDocument and accessors / buffer views are resolved to pointers into the BIN chunk
+ * on demand. The caller keeps the file bytes alive for as long as the reader is used.
+ *
+ * Only what the renderer needs is supported : triangle primitives with POSITION, NORMAL and
+ * TEXCOORD_0, embedded (buffer view) images and base color textures. Anything else (external
+ * buffers, sparse accessors, compression extensions) makes supportsAll() fail so the caller can
+ * fall back to Assimp.
+ */
+class GLBReader {
+public:
+    struct Primitive {
+        int position = -1;
+        int normal = -1;
+        int texcoord = -1;
+        int indices = -1;
+        int material = -1;
+        int mode = 4;
+    };
+
+    /* asset.extras member tagging files written by our own converter, its value is the converter version */
+    static constexpr const char* kPipelineMarker = "buildingarConverter";
+
+    static bool IsGLB(const void* data, size_t size);
+    /* Adds kPipelineMarker to a GLB in memory, false (and untouched) if it can't */
+    static bool AddPipelineMarker(std::vector<uint8_t>& glb, uint32_t converterVersion);
+
+    bool parse(const uint8_t* data, size_t size);
+    const std::string& error() const { return mError; }
+
+    /* Primitives of the default scene's node hierarchy, in depth first order */
+    void collectScenePrimitives(std::vector<Primitive>& out) const;
+    bool supportsAll(const std::vector<Primitive>& primitives) const;
+
+    bool accessor(int index, GLBAccessorView& out) const;
+    bool accessorBounds(int index, float outMin[3], float outMax[3]) const;
+    bool bufferView(int index, const uint8_t*& outData, size_t& outSize) const;
+
+    /* Converter version from kPipelineMarker, -1 for files from anywhere else */
+    int pipelineMarker() const;
+
+    int imageCount() const;
+    bool imageData(int image, const uint8_t*& outData, size_t& outSize) const;
+    /* Image index of a material's base color texture, -1 if it has none */
+    int baseColorImage(int material) const;
+    /* glTF alphaMode of a material as 0 OPAQUE, 1 MASK, 2 BLEND (OPAQUE when unset or without
+     * a material, as in the spec), with its alphaCutoff (0.5 when unset) */
+    int alphaMode(int material, float& outCutoff) const;
+
+private:
+    enum Table {
+        TABLE_ACCESSORS, TABLE_BUFFER_VIEWS, TABLE_BUFFERS, TABLE_MESHES, TABLE_NODES,
+        TABLE_MATERIALS, TABLE_TEXTURES, TABLE_IMAGES, TABLE_SCENES, TABLE_COUNT
+    };
+
+    JsonDocument mJson;
+    std::vector<const JsonDocument::Node*> mTables[TABLE_COUNT];
+    const uint8_t* mBin = nullptr;
+    size_t mBinSize = 0;
+    std::string mError;
+
+    void collectNode(int node, std::vector<Primitive>& out, int depth) const;
+    void appendPrimitives(const JsonDocument::Node* mesh, std::vector<Primitive>& out) const;
+    const JsonDocument::Node* arrayElement(Table table, int index) const;
+};
+
+#endif //BUILDING_AR_GLB_READER_H
@@ -1,98 +1,986 @@
 #include <glb_renderer_async.h>
 
-bool GLBModelAsync::load(const std::string &fileName) {
+#include <assimp/ProgressHandler.hpp>
+#include <assimp/GltfMaterial.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace {
+
+/* Vertices per published mesh batch, small enough to upload within a frame */
+constexpr size_t kMeshBatchVertices = 65536;
+
+/* Alpha this close to 0 or 255 still counts as binary, a mask pass draws it the same */
+constexpr unsigned char kAlphaTolerance = 16;
+
+/* Lets Assimp abort an import as soon as a newer load() cancels it */
+class CancelProgressHandler : public Assimp::ProgressHandler {
+public:
+    explicit CancelProgressHandler(const CancelToken& token) : mToken(token) {}
+
+    bool Update(float percentage) override {
+        return !mToken.isCancelled();
+    }
+
+private:
+    CancelToken mToken;
+};
+
+}
+
+GLBModelAsync::~GLBModelAsync() {
+    LOGI("SANJU : ~GLBModelAsync() called");
+    mLoadToken.cancel();
+    /* Jobs hold a pointer to this model, cancelled ones finish at their next checkpoint. What they
+     * published before seeing the cancel is dropped as it comes, staging slots included */
+    std::unique_ptr<LoadResult> result;
+    while(mJobsInFlight.load(std::memory_order_acquire) > 0) {
+        while(mResults.pop(result)) {}
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while(mResults.pop(result)) {}
+    /* Its completions point at this model, they run (or are dropped without a context) before release() */
+    mUploader.stop();
+    release();
+}
+
+GLBModelAsync::LoadResult::~LoadResult() {
+    if(image.imageBytes && !package) stbi_image_free(image.imageBytes);
+    /* Dropped before its upload (superseded, cancelled) */
+    if(staging && stagingTicket >= 0) staging->cancel(stagingTicket);
+}
+
+/* Runs on the GL thread */
+uint32_t GLBModelAsync::load(const std::string &fileName, const LoadOptions &options) {
     LOGI("SANJU : GLBModelAsync::load");
     release();
 
-    loadingFuture = std::async(std::launch::async, [this, fileName](){
-        try {
-            std::ifstream file(fileName, std::ios::binary | std::ios::ate);
-            if(!file.is_open()) {
-                LOGE("NAT_ERROR : Failed to open the model file : %s", fileName.c_str());
-                return;
+    /* Superseded loads stop at their next checkpoint, their results are dropped by poll() */
+    mLoadToken.cancel();
+    mLoadToken = CancelToken();
+    CancelToken token = mLoadToken;
+
+    uint32_t generation = mGeneration.fetch_add(1, std::memory_order_acq_rel) + 1;
+    mState.store(LOADING, std::memory_order_release);
+    mLoadStart = std::chrono::steady_clock::now();
+    mTimeline = LoadTimeline();
+    mRetainCpuCopies = options.retainCpuCopies;
+    mPickable = options.pickable;
+
+    /* The peak is measured from here, release() above already dropped the previous model */
+    mMemory = LoadMemory();
+    mTextureStats = LoadTextures();
+    FrameStats::ResetPeakRss();
+    mMemory.baselineKb = FrameStats::ProcStatusKb("VmRSS");
+
+    /* Submitted without the token on purpose : the job must always run to balance mJobsInFlight,
+     * runLoad() returns right away when the load was cancelled while still queued */
+    mJobsInFlight.fetch_add(1, std::memory_order_acq_rel);
+    JobSystem::instance().submit(PRIORITY_PARSE, [this, fileName, options, generation, token](const CancelToken&) {
+        runLoad(fileName, options, generation, token);
+        mJobsInFlight.fetch_sub(1, std::memory_order_acq_rel);
+    });
+    return generation;
+}
+
+/* Runs on a job system worker, only ever writes into the LoadResults it publishes */
+void GLBModelAsync::runLoad(const std::string &fileName, const LoadOptions &options, uint32_t generation, const CancelToken& token) {
+    LOG_TID("THREAD_TEST : Thread of GLBModelAsync::runLoad()");
+    if(token.isCancelled()) return;
+
+    std::unique_ptr<LoadResult> failed = std::make_unique<LoadResult>();
+    failed->generation = generation;
+    failed->kind = RESULT_FAILED;
+
+    try {
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if(!file.is_open()) {
+            LOGE("NAT_ERROR : Failed to open the model file : %s", fileName.c_str());
+            publish(failed, token);
+            return;
+        }
+        LOGI("SANJU : Model file is successfully opened!");
+
+        /* Packages are mapped, not read */
+        char magic[4] = {};
+        file.read(magic, sizeof(magic));
+        if(ArpkPackage::IsArpk(magic, (size_t)file.gcount())) {
+            file.close();
+            if(!runPackageLoad(fileName, generation, token) && !token.isCancelled()) publish(failed, token);
+            return;
+        }
+        file.clear();
+        file.seekg(0, std::ios::end);
+
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+
+        /* Reading the file into memory. Shared with the texture decode jobs of the GLB path */
+        std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>(size);
+        if(!file.read(buffer->data(), size)) {
+            LOGE("NAT_ERROR : Failed to read the model file: %s", fileName.c_str());
+            publish(failed, token);
+            return;
+        }
+        if(token.isCancelled()) return;
+
+        /* GLB files go through GLBReader, Assimp only handles what it can't */
+        unsigned int postProcess = options.postProcess;
+        if(GLBReader::IsGLB(buffer->data(), buffer->size())) {
+            GLBReader reader;
+            if(reader.parse((const uint8_t*)buffer->data(), buffer->size())) {
+                if(runGLBLoad(reader, buffer, generation, token)) return;
+                LOGI("SANJU : GLBReader can't handle %s, falling back to Assimp", fileName.c_str());
+                if(options.skipRedundantPasses && reader.pipelineMarker() >= 0) {
+                    postProcess = LoadOptions::kPipelinePostProcess;
+                }
+            } else {
+                LOGE("NAT_ERROR : GLBReader : %s", reader.error().c_str());
             }
-            LOGI("SANJU : Model file is successfully opened!");
+        }
+        if(!runAssimpLoad(*buffer, postProcess, generation, token) && !token.isCancelled()) {
+            publish(failed, token);
+        }
+    } catch(...) {
+        LOGE("NAT_ERROR : Exception while loading %s", fileName.c_str());
+        publish(failed, token);
+    }
+}
 
-            std::streamsize size = file.tellg();
-            file.seekg(0, std::ios::beg);
+/* Nothing left to parse or decode : the draw table becomes meshes pointing into the mapping and
+ * the stored mip chains go to the GL thread as they are. Meshes go first, for the first pixel */
+bool GLBModelAsync::runPackageLoad(const std::string &fileName, uint32_t generation, const CancelToken &token) {
+    std::shared_ptr<ArpkPackage> package = std::make_shared<ArpkPackage>();
+    if(!package->open(fileName)) return false;
+    const ArpkHeader& header = package->header();
 
-            /* Reading the file into memory */
-            std::vector<char> buffer(size);
-            if(!file.read(buffer.data(), size)) {
-                LOGE("NAT_ERROR : Failed to read the model file: %s", fileName.c_str());
-                return;
+    std::unique_ptr<LoadResult> bounds = std::make_unique<LoadResult>();
+    bounds->generation = generation;
+    bounds->kind = RESULT_BOUNDS;
+    bounds->boundsMin = glm::make_vec3(header.boundsMin);
+    bounds->boundsMax = glm::make_vec3(header.boundsMax);
+    if(header.meshCount > 0 && !publish(bounds, token)) return true;
+
+    bool published = publishMeshBatches(header.meshCount, [&](size_t i) {
+        Mesh mesh{};
+        mesh.mode = GL_TRIANGLES;
+        mesh.indexType = GL_UNSIGNED_SHORT;
+        mesh.package = package;
+        mesh.packed = &package->mesh((uint32_t)i);
+        mesh.indexCount = mesh.packed->indexCount;
+        mesh.textureIndex = mesh.packed->texture;
+        mesh.declaredAlpha = (int)mesh.packed->alphaMode - 1;
+        if(mesh.packed->alphaCutoff) mesh.alphaCutoff = mesh.packed->alphaCutoff / 255.0f;
+        mesh.center = boundsCenter(package->at(mesh.packed->vertexOffset), mesh.packed->vertexCount, sizeof(ArpkVertex));
+        return mesh;
+    }, (int)header.textureCount, generation, token);
+    if(!published) return true;
+
+    for(uint32_t i = 0; i < header.textureCount; i++) {
+        const ArpkTexture& texture = package->texture(i);
+        std::unique_ptr<LoadResult> result = std::make_unique<LoadResult>();
+        result->generation = generation;
+        result->kind = RESULT_TEXTURE;
+        result->textureIndex = (int)i;
+        result->package = package;
+        result->image.width = (int)texture.width;
+        result->image.height = (int)texture.height;
+        result->image.channels = 4;
+        result->image.mipCount = (int)texture.mipCount;
+        result->image.imageBytes = const_cast<unsigned char*>(package->at(texture.offset));
+        /* Level 0 decides, the smaller levels are its averages */
+        result->alpha = classifyAlpha(result->image.imageBytes, (size_t)texture.width * texture.height);
+        stageTexels(*result);
+        if(!publish(result, token)) return true;
+    }
+    return true;
+}
+
+/* Returns false, without having published anything, if the file needs the Assimp fallback */
+bool GLBModelAsync::runGLBLoad(const GLBReader& reader, const std::shared_ptr<std::vector<char>>& buffer,
+                               uint32_t generation, const CancelToken& token) {
+    std::vector<GLBReader::Primitive> primitives;
+    reader.collectScenePrimitives(primitives);
+    if(!reader.supportsAll(primitives)) return false;
+
+    /* 1. Bounding box straight from the POSITION accessors' min / max, no vertex touched */
+    std::unique_ptr<LoadResult> bounds = std::make_unique<LoadResult>();
+    bounds->generation = generation;
+    bounds->kind = RESULT_BOUNDS;
+    bounds->boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    bounds->boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for(const GLBReader::Primitive& primitive : primitives) {
+        glm::vec3 lo, hi;
+        if(reader.accessorBounds(primitive.position, glm::value_ptr(lo), glm::value_ptr(hi))) {
+            bounds->boundsMin = glm::min(bounds->boundsMin, lo);
+            bounds->boundsMax = glm::max(bounds->boundsMax, hi);
+        }
+    }
+    if(!primitives.empty() && bounds->boundsMin.x <= bounds->boundsMax.x && !publish(bounds, token)) return true;
+
+    /* 2. Images are decoded straight out of the BIN chunk */
+    int imageCount = reader.imageCount();
+    for(int i = 0; i < imageCount; i++) {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        reader.imageData(i, data, size);
+        submitTextureDecode(buffer, data, size, 0, 0, i, generation, token);
+    }
+
+    /* 3. Meshes, interleaved directly from the accessors into this load's arena */
+    std::shared_ptr<LinearArena> arena = std::make_shared<LinearArena>();
+    publishMeshBatches(primitives.size(), [&](size_t i) {
+        const GLBReader::Primitive& primitive = primitives[i];
+        Mesh mesh = extractGLBPrimitive(reader, primitive, arena);
+        int image = reader.baseColorImage(primitive.material);
+        if(image >= 0 && image < imageCount) mesh.textureIndex = image;
+        mesh.declaredAlpha = reader.alphaMode(primitive.material, mesh.alphaCutoff);
+        return mesh;
+    }, imageCount, generation, token);
+    logArenaStats(*arena, generation);
+    return true;
+}
+
+bool GLBModelAsync::runAssimpLoad(const std::vector<char>& buffer, unsigned int postProcess, uint32_t generation, const CancelToken& token) {
+    /* Now parsing the model using Assimp. The importer owns the scene and is shared with the
+     * texture decode jobs, whichever finishes last frees it */
+    std::shared_ptr<Assimp::Importer> importer = std::make_shared<Assimp::Importer>();
+    importer->SetProgressHandler(new CancelProgressHandler(token));
+    auto start = std::chrono::steady_clock::now();
+    const aiScene* scene = importer->ReadFileFromMemory(buffer.data(), buffer.size(), postProcess, "glb");
+    std::chrono::duration<double, std::milli> importTime = std::chrono::steady_clock::now() - start;
+    LOGI("SANJU : Assimp import took %.1f ms (post-process flags 0x%x%s)", importTime.count(), postProcess,
+         postProcess == LoadOptions::kPipelinePostProcess ? ", pipeline output" : "");
+    if(token.isCancelled()) {
+        LOGI("SANJU : Load of generation %u cancelled", generation);
+        return false;
+    }
+    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        LOGE("NAT_ERROR : Assimp Error | %s", importer->GetErrorString());
+        return false;
+    }
+    LOGI("SANJU : scene->mNumTextures = %d", scene->mNumTextures);
+
+    std::vector<aiMesh*> sceneMeshes;
+    collectNodeMeshes(scene->mRootNode, scene, sceneMeshes);
+
+    /* 1. Bounding box, drawable right away */
+    std::unique_ptr<LoadResult> bounds = std::make_unique<LoadResult>();
+    bounds->generation = generation;
+    bounds->kind = RESULT_BOUNDS;
+    bounds->boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    bounds->boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for(aiMesh* mesh : sceneMeshes) {
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            bounds->boundsMin = glm::min(bounds->boundsMin, position);
+            bounds->boundsMax = glm::max(bounds->boundsMax, position);
+        }
+    }
+    if(!sceneMeshes.empty() && !publish(bounds, token)) return true;
+
+    /* 2. Texture decoding runs in parallel with the mesh extraction below */
+    for(unsigned int i = 0; i < scene->mNumTextures; i++) {
+        const aiTexture* texture = scene->mTextures[i];
+        /* mHeight == 0 : compressed (png / jpg) bytes, otherwise raw texels */
+        size_t size = texture->mHeight == 0 ? texture->mWidth : (size_t)texture->mWidth * texture->mHeight * 4;
+        submitTextureDecode(importer, reinterpret_cast<const uint8_t*>(texture->pcData), size,
+                            texture->mHeight == 0 ? 0 : (int)texture->mWidth, (int)texture->mHeight,
+                            (int)i, generation, token);
+    }
+
+    /* 3. Meshes, published in batches as they are extracted into this load's arena */
+    std::shared_ptr<LinearArena> arena = std::make_shared<LinearArena>();
+    publishMeshBatches(sceneMeshes.size(), [&](size_t i) {
+        Mesh mesh = extractVertAndIndMesh(sceneMeshes[i], scene, arena);
+        mesh.textureIndex = embeddedTextureIndex(sceneMeshes[i], scene);
+        mesh.declaredAlpha = materialAlphaMode(sceneMeshes[i], scene, mesh.alphaCutoff);
+        return mesh;
+    }, (int)scene->mNumTextures, generation, token);
+    logArenaStats(*arena, generation);
+    return true;
+}
+
+/* Publishes meshes in batches of about kMeshBatchVertices, the last batch (possibly empty)
+ * carries the texture count. Returns false if cancelled */
+bool GLBModelAsync::publishMeshBatches(size_t meshCount, const std::function<Mesh(size_t)>& extract,
+                                       int textureCount, uint32_t generation, const CancelToken& token) {
+    std::unique_ptr<LoadResult> batch;
+    size_t batchVertices = 0;
+    for(size_t i = 0; ; i++) {
+        if(!batch) {
+            batch = std::make_unique<LoadResult>();
+            batch->generation = generation;
+            batch->kind = RESULT_MESHES;
+            batchVertices = 0;
+        }
+        if(i < meshCount) {
+            if(token.isCancelled()) return false;
+            batch->meshes.push_back(extract(i));
+            const Mesh& mesh = batch->meshes.back();
+            batchVertices += mesh.packed ? mesh.packed->vertexCount : mesh.vertices.size() / 8;
+        }
+
+        bool last = i + 1 >= meshCount;
+        if(last || batchVertices >= kMeshBatchVertices) {
+            batch->lastBatch = last;
+            batch->textureCount = textureCount;
+            if(!publish(batch, token)) return false;
+            batch.reset();
+            if(last) return true;
+        }
+    }
+}
+
+/* Decodes one texture on its own job. owner keeps data alive. rawWidth > 0 means data already
+ * holds RGBA texels. Always publishes (possibly without pixels) so the GL thread can count the
+ * textures of the load down to READY */
+void GLBModelAsync::submitTextureDecode(std::shared_ptr<const void> owner, const uint8_t* data, size_t size,
+                                        int rawWidth, int rawHeight, int index,
+                                        uint32_t generation, const CancelToken& token) {
+    mJobsInFlight.fetch_add(1, std::memory_order_acq_rel);
+    JobSystem::instance().submit(PRIORITY_DECODE, [this, owner, data, size, rawWidth, rawHeight, index, generation, token](const CancelToken&) {
+        if(!token.isCancelled()) {
+            std::unique_ptr<LoadResult> result = std::make_unique<LoadResult>();
+            result->generation = generation;
+            result->kind = RESULT_TEXTURE;
+            result->textureIndex = index;
+
+            textureImageData& image = result->image;
+            if(rawWidth == 0 && data) {
+                image.imageBytes = stbi_load_from_memory(data, (int)size,
+                        &image.width, &image.height, &image.channels, STBI_rgb_alpha);
+            } else if(data) {
+                /* Raw texels, copied so the result doesn't depend on the owner */
+                image.imageBytes = (unsigned char*)malloc(size);
+                memcpy(image.imageBytes, data, size);
+                image.width = rawWidth;
+                image.height = rawHeight;
+                image.channels = 4;
             }
+            if(image.imageBytes) {
+                result->alpha = classifyAlpha(image.imageBytes, (size_t)image.width * image.height);
+                stageTexels(*result);
+            }
+            publish(result, token);
+        }
+        mJobsInFlight.fetch_sub(1, std::memory_order_acq_rel);
+    });
+}
 
-            /* Now parsing the model using Assimp */
-            mImporter = std::make_unique<Assimp::Importer>();
-            mScene = mImporter->ReadFileFromMemory(
-                    buffer.data(), size,
-                    aiProcess_Triangulate |
-                    aiProcess_GenNormals |
-                    aiProcess_FlipUVs |
-                    aiProcess_JoinIdenticalVertices |
-                    aiProcess_OptimizeMeshes |
-                    aiProcess_EmbedTextures |
-                    aiProcess_FindInstances, "glb"
-            );
-            if(!mScene || mScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !mScene->mRootNode) {
-                LOGE("NAT_ERROR : Assimp Error | %s", mImporter->GetErrorString());
-                return;
+/* File bytes to meshes (vertex / index vectors, no textures) for both parsers, best of a few
+ * runs each. Peak memory is the VmHWM rise above the RSS at the start of a run */
+bool GLBModelAsync::BenchmarkParsers(const std::string &fileName, const std::string &reportPath) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if(!file.is_open()) {
+        LOGE("NAT_ERROR : BenchmarkParsers : failed to open %s", fileName.c_str());
+        return false;
+    }
+    std::vector<char> buffer((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(buffer.data(), buffer.size());
+
+    GLBReader markerReader;
+    int marker = markerReader.parse((const uint8_t*)buffer.data(), buffer.size()) ? markerReader.pipelineMarker() : -1;
+
+    /* assimp_pipeline is what a file from our converter costs when GLBReader can't take it. The
+     * *_arena rows extract into a LinearArena like load() does, mesh_allocs counts the mesh
+     * vector allocations that reach malloc (Assimp's own are not included) */
+    struct Parser {
+        const char* name;
+        bool glbReader;
+        bool arena;
+        unsigned int postProcess;
+    };
+    const Parser parsers[] = {
+            { "glb_reader", true, false, 0 },
+            { "glb_reader_arena", true, true, 0 },
+            { "assimp", false, false, LoadOptions::kFullPostProcess },
+            { "assimp_arena", false, true, LoadOptions::kFullPostProcess },
+            { "assimp_pipeline", false, true, LoadOptions::kPipelinePostProcess },
+    };
+    const int kRuns = 5;
+    const int kParsers = sizeof(parsers) / sizeof(parsers[0]);
+    double bestMs[kParsers];
+    long peakKb[kParsers];
+    size_t vertexCount[kParsers];
+    size_t allocations[kParsers];
+    for(int parser = 0; parser < kParsers; parser++) {
+        bestMs[parser] = -1.0;
+        peakKb[parser] = 0;
+        vertexCount[parser] = 0;
+        allocations[parser] = 0;
+    }
+
+    for(int parser = 0; parser < kParsers; parser++) {
+        const Parser& config = parsers[parser];
+        for(int run = 0; run < kRuns; run++) {
+            FrameStats::ResetPeakRss();
+            long startRss = FrameStats::ProcStatusKb("VmRSS");
+            size_t startHeap = LinearArena::HeapAllocations().load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            size_t vertices = 0;
+
+            std::shared_ptr<LinearArena> arena = config.arena ? std::make_shared<LinearArena>() : nullptr;
+            if(config.glbReader) {
+                GLBReader reader;
+                std::vector<GLBReader::Primitive> primitives;
+                if(!reader.parse((const uint8_t*)buffer.data(), buffer.size())) break;
+                reader.collectScenePrimitives(primitives);
+                if(!reader.supportsAll(primitives)) break;
+                std::vector<Mesh> meshes;
+                meshes.reserve(primitives.size());
+                for(const auto& primitive : primitives) meshes.push_back(extractGLBPrimitive(reader, primitive, arena));
+                for(const auto& mesh : meshes) vertices += mesh.vertices.size() / 8;
+            } else {
+                Assimp::Importer importer;
+                const aiScene* scene = importer.ReadFileFromMemory(buffer.data(), buffer.size(), config.postProcess, "glb");
+                if(!scene || !scene->mRootNode) break;
+                std::vector<aiMesh*> sceneMeshes;
+                collectNodeMeshes(scene->mRootNode, scene, sceneMeshes);
+                std::vector<Mesh> meshes;
+                meshes.reserve(sceneMeshes.size());
+                for(aiMesh* mesh : sceneMeshes) meshes.push_back(extractVertAndIndMesh(mesh, scene, arena));
+                for(const auto& mesh : meshes) vertices += mesh.vertices.size() / 8;
             }
 
-            LOGI("SANJU : scene->mNumTextures = %d", mScene->mNumTextures);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            long peak = FrameStats::ProcStatusKb("VmHWM") - startRss;
+            if(bestMs[parser] < 0.0 || elapsed.count() < bestMs[parser]) bestMs[parser] = elapsed.count();
+            peakKb[parser] = std::max(peakKb[parser], peak);
+            vertexCount[parser] = vertices;
+            allocations[parser] = LinearArena::HeapAllocations().load(std::memory_order_relaxed) - startHeap +
+                                  (arena ? arena->stats().blocks : 0);
+        }
+    }
+
+    FILE* report = fopen(reportPath.c_str(), "w");
+    if(!report) {
+        LOGE("NAT_ERROR : BenchmarkParsers : failed to open the report %s", reportPath.c_str());
+        return false;
+    }
+    fprintf(report, "file %s (%zu bytes), best of %d runs\n", fileName.c_str(), buffer.size(), kRuns);
+    fprintf(report, "pipeline marker %s\n", marker >= 0 ? std::to_string(marker).c_str() : "none");
+    fprintf(report, "%-16s %10s %14s %10s %12s\n", "parser", "parse_ms", "peak_delta_kb", "vertices", "mesh_allocs");
+    for(int parser = 0; parser < kParsers; parser++) {
+        fprintf(report, "%-16s %10.3f %14ld %10zu %12zu\n", parsers[parser].name, bestMs[parser], peakKb[parser],
+                vertexCount[parser], allocations[parser]);
+        LOGI("SANJU : BenchmarkParsers %s : %.3f ms | peak +%ld kB | %zu vertices | %zu mesh allocations",
+             parsers[parser].name, bestMs[parser], peakKb[parser], vertexCount[parser], allocations[parser]);
+    }
+    fclose(report);
+    return true;
+}
+
+bool GLBModelAsync::BenchmarkPicking(const std::string &fileName, const std::string &reportPath) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if(!file.is_open()) {
+        LOGE("NAT_ERROR : BenchmarkPicking : failed to open %s", fileName.c_str());
+        return false;
+    }
+    std::vector<char> buffer((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(buffer.data(), buffer.size());
 
-            /* These two methods are not depended on Gl thread and thus can be made to run in std::async() */
-            // This call fills  std::vector<Mesh> mMeshes(without textureId and vao/vbo/ebo)
-            LOG_TID("THREAD_TEST : Thread of GLBModelAsync::load() -> async");
-            extractVertAndIndNode(mScene->mRootNode, mScene);
-            extractTextureImages(mScene);
-            LOGI("SANJU : mMeshes.vertices.size = %d", mMeshes.size());
-            mState = LOADED;
-        } catch(...) {
+    /* Extracted the way load() does : GLBReader when it supports the file, Assimp otherwise */
+    std::shared_ptr<LinearArena> arena = std::make_shared<LinearArena>();
+    std::vector<Mesh> meshes;
+    GLBReader reader;
+    std::vector<GLBReader::Primitive> primitives;
+    bool supported = reader.parse((const uint8_t*)buffer.data(), buffer.size());
+    if(supported) {
+        reader.collectScenePrimitives(primitives);
+        supported = reader.supportsAll(primitives);
+    }
+    Assimp::Importer importer;
+    if(supported) {
+        for(const auto& primitive : primitives) meshes.push_back(extractGLBPrimitive(reader, primitive, arena));
+    } else {
+        const aiScene* scene = importer.ReadFileFromMemory(buffer.data(), buffer.size(), LoadOptions::kFullPostProcess, "glb");
+        if(!scene || !scene->mRootNode) {
+            LOGE("NAT_ERROR : BenchmarkPicking : failed to parse %s", fileName.c_str());
+            return false;
+        }
+        std::vector<aiMesh*> sceneMeshes;
+        collectNodeMeshes(scene->mRootNode, scene, sceneMeshes);
+        for(aiMesh* mesh : sceneMeshes) meshes.push_back(extractVertAndIndMesh(mesh, scene, arena));
+    }
 
+    std::vector<MeshBvh::Source> sources(meshes.size());
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for(size_t i = 0; i < meshes.size(); i++) {
+        const Mesh& mesh = meshes[i];
+        MeshBvh::Source& source = sources[i];
+        source.positions = reinterpret_cast<const uint8_t*>(mesh.vertices.data());
+        source.stride = 8 * sizeof(float);
+        source.vertexCount = mesh.vertices.size() / 8;
+        source.indices = mesh.indices.data();
+        source.indexCount = mesh.indices.size();
+        for(size_t vertex = 0; vertex < source.vertexCount; vertex++) {
+            glm::vec3 position = glm::make_vec3(&mesh.vertices[vertex * 8]);
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
         }
-    });
+    }
+
+    /* Best build of a few, the last one is cast against */
+    const int kRuns = 3;
+    double bestBuildMs = -1.0;
+    MeshBvh bvh;
+    for(int run = 0; run < kRuns; run++) {
+        if(!bvh.build(sources, CancelToken())) {
+            LOGE("NAT_ERROR : BenchmarkPicking : no triangle in %s", fileName.c_str());
+            return false;
+        }
+        if(bestBuildMs < 0.0 || bvh.stats().buildMs < bestBuildMs) bestBuildMs = bvh.stats().buildMs;
+    }
+
+    /* Rays from a sphere around the model towards random points of its box, like taps on it from
+     * all around. Seeded, every run casts the same rays */
+    const int kRays = 100000;
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - boundsMin);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> normal;
+    std::vector<glm::vec3> origins(kRays), directions(kRays);
+    for(int ray = 0; ray < kRays; ray++) {
+        glm::vec3 around = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)) + glm::vec3(1e-6f));
+        glm::vec3 target = boundsMin + glm::vec3(unit(random), unit(random), unit(random)) * (boundsMax - boundsMin);
+        origins[ray] = center + around * radius;
+        directions[ray] = glm::normalize(target - origins[ray]);
+    }
+
+    int hits = 0;
+    double worstUs = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for(int ray = 0; ray < kRays; ray++) {
+        auto rayStart = std::chrono::steady_clock::now();
+        MeshBvh::Hit hit;
+        if(bvh.intersect(origins[ray], directions[ray], std::numeric_limits<float>::max(), hit)) hits++;
+        std::chrono::duration<double, std::micro> rayElapsed = std::chrono::steady_clock::now() - rayStart;
+        worstUs = std::max(worstUs, rayElapsed.count());
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    double raysPerSecond = kRays / (elapsed.count() / 1000.0);
+
+    FILE* report = fopen(reportPath.c_str(), "w");
+    if(!report) {
+        LOGE("NAT_ERROR : BenchmarkPicking : failed to open the report %s", reportPath.c_str());
+        return false;
+    }
+    const MeshBvh::Stats& stats = bvh.stats();
+    fprintf(report, "file %s (%zu bytes), %zu meshes, best build of %d runs\n", fileName.c_str(), buffer.size(), meshes.size(), kRuns);
+    fprintf(report, "triangles %zu\nbuild_ms %.3f\nnodes %zu\nleaves %zu\ndepth %d\nbvh_mb %.2f\nbytes_per_triangle %.1f\n",
+            stats.triangles, bestBuildMs, stats.nodes, stats.leaves, stats.depth, stats.bytes / (1024.0 * 1024.0),
+            (double)stats.bytes / stats.triangles);
+    fprintf(report, "rays %d\nrays_per_second %.0f\nray_avg_us %.3f\nray_worst_us %.3f\nhit_ratio %.3f\n",
+            kRays, raysPerSecond, elapsed.count() * 1000.0 / kRays, worstUs, (double)hits / kRays);
+    fclose(report);
+    LOGI("SANJU : BenchmarkPicking : %zu triangles | build %.1f ms | %.1f MB | %.0f rays/s, worst %.1f us",
+         stats.triangles, bestBuildMs, stats.bytes / (1024.0 * 1024.0), raysPerSecond, worstUs);
+    return true;
+}
+
+/* Any job. Returns false if the load was cancelled, the result is then dropped by the caller */
+bool GLBModelAsync::publish(std::unique_ptr<LoadResult> &result, const CancelToken &token) {
+    if(token.isCancelled()) return false;
+    /* Never waits, a paused GL thread leaves the results queued rather than the workers parked */
+    mResults.push(std::move(result));
+    return true;
+}
+
+/* Runs on a job system worker. The copy into the slot is the whole client side cost of the upload */
+bool GLBModelAsync::stageTexels(LoadResult &result) {
+    textureImageData& image = result.image;
+    if(!image.imageBytes) return false;
+
+    size_t bytes = texelBytes(image);
+    int mipCount = image.mipCount;
+    /* A prebuilt chain too big for a slot goes with level 0 alone, the GPU generates the rest */
+    if(bytes > PixelUnpackRing::kSlotBytes && mipCount > 1) {
+        bytes = ArpkPackage::MipSize(image.width, image.height, 0);
+        mipCount = 0;
+    }
+    int ticket = mStaging.claim(bytes);
+    if(ticket < 0) return false;
+    unsigned char* slot = mStaging.data(ticket);
+    /* The GL context was recreated since the claim : uploaded from client memory instead */
+    if(!slot) {
+        mStaging.cancel(ticket);
+        return false;
+    }
+
+    memcpy(slot, image.imageBytes, bytes);
+    if(!result.package) stbi_image_free(image.imageBytes);
+    image.imageBytes = nullptr;
+    image.mipCount = mipCount;
+    result.package.reset();
+    result.stagingTicket = ticket;
+    result.staging = &mStaging;
     return true;
 }
 
-void GLBModelAsync::update() {
-    LOGI("SANJU : GLBModelAsync::update");
-    processTextures(mScene);
-    unsigned int globalMeshIndex = 0;
-    bindMeshToTextureNode(mScene->mRootNode, mScene, globalMeshIndex);
-    bindMesh();
+double GLBModelAsync::elapsedSinceLoad() const {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - mLoadStart;
+    return elapsed.count();
+}
+
+/* Runs on the GL thread */
+bool GLBModelAsync::poll(GLStateCache &stateCache) {
+    mBecameReady = false;
+
+    /* A dead upload thread hands its leftovers back, they are uploaded here from now on */
+    if(mUploader.isRunning() && !mUploader.isHealthy()) {
+        LOGE("NAT_ERROR : GLBModelAsync : upload thread stopped, uploading on the GL thread");
+        mUploader.stop();
+        stateCache.invalidate();
+    }
+    /* Finished background uploads are older than anything still queued. Completions build VAOs */
+    if(mUploader.poll() > 0) stateCache.invalidate();
+    /* Staging slots whose texels the GPU has copied become claimable again */
+    if(mStaging.isAvailable()) mStaging.recycle();
+
+    std::unique_ptr<LoadResult> result;
+    while(mResults.pop(result)) {
+        /* Results of superseded loads are simply dropped, LoadResult frees their images */
+        if(result->generation != generation()) continue;
+
+        /* Bounds are a few lines and staged textures a copy the GPU schedules, neither is worth a round trip */
+        bool staged = result->kind == RESULT_TEXTURE && result->stagingTicket >= 0;
+        if(mUploader.isRunning() && (result->kind == RESULT_MESHES || (result->kind == RESULT_TEXTURE && !staged))) {
+            submitUpload(std::move(result));
+            continue;
+        }
+
+        /* The uploads bind buffers, VAOs and textures directly */
+        stateCache.invalidate();
+        apply(*result);
+    }
+    return mBecameReady;
+}
+
+/* Runs on the GL thread */
+void GLBModelAsync::apply(LoadResult &result) {
+    switch(result.kind) {
+        case RESULT_BOUNDS: onBounds(result); break;
+        case RESULT_MESHES: onMeshes(result); break;
+        case RESULT_TEXTURE: onTexture(result); break;
+        case RESULT_PICKING: onPicking(result); break;
+        case RESULT_FAILED:
+            mState.store(ERROR, std::memory_order_release);
+            return;
+    }
+
+    if(mState.load(std::memory_order_relaxed) == LOADING) {
+        mState.store(STREAMING, std::memory_order_release);
+        mTimeline.firstDrawable = elapsedSinceLoad();
+    }
+    if(mGeometryComplete && mReceivedTextures == mExpectedTextures && state() == STREAMING) {
+        mState.store(READY, std::memory_order_release);
+        mTimeline.ready = elapsedSinceLoad();
+        mMemory.peakKb = FrameStats::ProcStatusKb("VmHWM");
+        mMemory.steadyKb = FrameStats::ProcStatusKb("VmRSS");
+        LOGI("SANJU : Load timeline : first drawable = %.1f ms | geometry = %.1f ms | ready = %.1f ms",
+             mTimeline.firstDrawable, mTimeline.geometryComplete, mTimeline.ready);
+        LOGI("SANJU : Load memory : baseline = %ld kB | peak = %ld kB | steady = %ld kB%s",
+             mMemory.baselineKb, mMemory.peakKb, mMemory.steadyKb, mRetainCpuCopies ? " (CPU copies retained)" : "");
+        LOGI("SANJU : Load textures : %d staged | %d direct | %d background | %.1f MB, %.2f ms on the GL thread",
+             mTextureStats.staged, mTextureStats.direct, mTextureStats.background, mTextureStats.megabytes, mTextureStats.glThreadMs);
+        if(mUploader.isRunning()) {
+            LOGI("SANJU : Uploads : %.1f ms on the upload thread so far", mUploader.uploadMicros() / 1000.0);
+        }
+        mBecameReady = true;
+    }
+}
+
+/* Runs on the GL thread */
+bool GLBModelAsync::setBackgroundUploads(bool enabled) {
+    /* Restarted even when running : the upload context must share with the current context */
+    mUploader.stop();
+    return enabled && mUploader.start();
+}
+
+/* Runs on the GL thread. The task only touches the result, which the completion then applies */
+void GLBModelAsync::submitUpload(std::unique_ptr<LoadResult> result) {
+    std::shared_ptr<LoadResult> shared(std::move(result));
+    GLUploader::Task task;
+    if(shared->kind == RESULT_MESHES) {
+        task = [this, shared]() {
+            /* Superseded while queued, nothing to upload (generation() is safe from any thread) */
+            if(shared->generation != generation()) return;
+            for(Mesh& mesh : shared->meshes) uploadMeshBuffers(mesh);
+        };
+    } else {
+        task = [this, shared]() {
+            if(shared->generation != generation() || !shared->image.imageBytes) return;
+            shared->uploadedTexture = bindTextures(shared->image);
+        };
+    }
+    if(!mUploader.submit(std::move(task), [this, shared]() { finishUpload(*shared); })) {
+        apply(*shared);
+    }
+}
+
+/* Runs on the GL thread */
+void GLBModelAsync::finishUpload(LoadResult &result) {
+    if(result.generation == generation() && state() != ERROR) {
+        apply(result);
+        return;
+    }
+    /* Superseded after its upload, the objects were never handed to anything */
+    for(Mesh& mesh : result.meshes) {
+        if(mesh.vbo) glDeleteBuffers(1, &mesh.vbo);
+        if(mesh.ebo) glDeleteBuffers(1, &mesh.ebo);
+    }
+    if(result.uploadedTexture) glDeleteTextures(1, &result.uploadedTexture);
+}
 
-    mImporter.reset();
-    mScene = nullptr;
-    mState = READY;
+/* Runs on the GL thread. A line box standing in for the model until its meshes arrive */
+void GLBModelAsync::onBounds(const LoadResult &result) {
+    const glm::vec3& lo = result.boundsMin;
+    const glm::vec3& hi = result.boundsMax;
+
+    mBoundsMesh = Mesh{};
+    for(int corner = 0; corner < 8; corner++) {
+        glm::vec3 position((corner & 1) ? hi.x : lo.x, (corner & 2) ? hi.y : lo.y, (corner & 4) ? hi.z : lo.z);
+        /* position, normal, uv */
+        const float vertex[8] = { position.x, position.y, position.z, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+        mBoundsMesh.vertices.insert(mBoundsMesh.vertices.end(), vertex, vertex + 8);
+    }
+    /* The 12 edges join corners differing in exactly one axis bit */
+    for(unsigned int corner = 0; corner < 8; corner++) {
+        for(unsigned int axis = 1; axis < 8; axis <<= 1) {
+            if(!(corner & axis)) {
+                mBoundsMesh.indices.push_back(corner);
+                mBoundsMesh.indices.push_back(corner | axis);
+            }
+        }
+    }
+    mBoundsMesh.indexCount = mBoundsMesh.indices.size();
+    mBoundsMesh.mode = GL_LINES;
+    mBoundsMesh.textureId = createDefaultTexture();
+    bindMesh(mBoundsMesh);
+    releaseCpuCopies(mBoundsMesh);
+    mHasBounds = true;
 }
 
-void GLBModelAsync::extractVertAndIndNode(aiNode *node, const aiScene *scene) {
-    LOGI("SANJU : GLBModelAsync::extractVertAndIndNode");
+/* Runs on the GL thread */
+void GLBModelAsync::onMeshes(LoadResult &result) {
+    for(Mesh& mesh : result.meshes) {
+        bindMesh(mesh);
+        if(mPickable) collectPickPart(mesh);
+        /* Uploaded, the mapping only has to outlive the textures still to come */
+        mesh.package.reset();
+        mesh.packed = nullptr;
+        if(!mRetainCpuCopies) releaseCpuCopies(mesh);
+
+        if(mesh.textureIndex < 0) {
+            mesh.textureId = createDefaultTexture();
+        } else {
+            /* The texture may already be in, otherwise it is swapped in by onTexture() */
+            bool arrived = (size_t)mesh.textureIndex < mTextures.size() && mTextures[mesh.textureIndex];
+            mesh.textureId = arrived ? mTextures[mesh.textureIndex] : createPendingTexture();
+        }
+        classify(mesh);
+        mMeshes.push_back(std::move(mesh));
+    }
+
+    if(result.lastBatch) {
+        mGeometryComplete = true;
+        mExpectedTextures = result.textureCount;
+        mTimeline.geometryComplete = elapsedSinceLoad();
+        LOGI("SANJU : mMeshes.size = %zu", mMeshes.size());
+
+        /* Full geometry is in, the box has done its job */
+        if(mHasBounds) {
+            glDeleteVertexArrays(1, &mBoundsMesh.vao);
+            glDeleteBuffers(1, &mBoundsMesh.vbo);
+            glDeleteBuffers(1, &mBoundsMesh.ebo);
+            mBoundsMesh = Mesh{};
+            mHasBounds = false;
+        }
+        if(mPickable) submitPickingBuild(result.generation);
+    }
+}
+
+/* Runs on the GL thread, before the mesh lets go of its CPU copies and mapping */
+void GLBModelAsync::collectPickPart(Mesh &mesh) {
+    if(!mPickParts) mPickParts = std::make_shared<std::vector<PickPart>>();
+    mPickParts->emplace_back();
+    PickPart& part = mPickParts->back();
+    if(mesh.mode != GL_TRIANGLES) return;
+
+    if(mesh.packed) {
+        part.package = mesh.package;
+        part.packed = mesh.packed;
+    } else if(mRetainCpuCopies) {
+        /* On the heap, the mesh keeps its own */
+        part.vertices.assign(mesh.vertices.begin(), mesh.vertices.end());
+        part.indices.assign(mesh.indices.begin(), mesh.indices.end());
+    } else {
+        part.arena = mesh.arena;
+        part.vertices = std::move(mesh.vertices);
+        part.indices = std::move(mesh.indices);
+    }
+}
+
+/* Runs on the GL thread. The job owns the parts, their memory goes once the BVH is built */
+void GLBModelAsync::submitPickingBuild(uint32_t generation) {
+    std::shared_ptr<std::vector<PickPart>> parts = std::move(mPickParts);
+    if(!parts) return;
+
+    CancelToken token = mLoadToken;
+    mJobsInFlight.fetch_add(1, std::memory_order_acq_rel);
+    JobSystem::instance().submit(PRIORITY_PICKING, [this, parts, generation, token](const CancelToken&) {
+        std::vector<MeshBvh::Source> sources(parts->size());
+        for(size_t i = 0; i < parts->size(); i++) {
+            const PickPart& part = (*parts)[i];
+            MeshBvh::Source& source = sources[i];
+            if(part.packed) {
+                source.positions = part.package->at(part.packed->vertexOffset);
+                source.stride = sizeof(ArpkVertex);
+                source.vertexCount = part.packed->vertexCount;
+                source.indices = part.package->at(part.packed->indexOffset);
+                source.shortIndices = true;
+                source.indexCount = part.packed->indexCount;
+            } else {
+                source.positions = reinterpret_cast<const uint8_t*>(part.vertices.data());
+                source.stride = 8 * sizeof(float);
+                source.vertexCount = part.vertices.size() / 8;
+                source.indices = part.indices.data();
+                source.indexCount = part.indices.size();
+            }
+        }
+
+        std::unique_ptr<LoadResult> result = std::make_unique<LoadResult>();
+        result->generation = generation;
+        result->kind = RESULT_PICKING;
+        result->bvh = std::make_unique<MeshBvh>();
+        if(result->bvh->build(sources, token)) {
+            publish(result, token);
+        } else if(!token.isCancelled()) {
+            LOGE("NAT_ERROR : No triangle to pick in load %u", generation);
+        }
+        mJobsInFlight.fetch_sub(1, std::memory_order_acq_rel);
+    });
+}
+
+/* Runs on the GL thread */
+void GLBModelAsync::onPicking(LoadResult &result) {
+    mBvh = std::move(result.bvh);
+    const MeshBvh::Stats& stats = mBvh->stats();
+    LOGI("SANJU : Picking BVH : %zu triangles | %zu nodes, %zu leaves, depth %d | %.1f ms | %.1f MB",
+         stats.triangles, stats.nodes, stats.leaves, stats.depth, stats.buildMs, stats.bytes / (1024.0 * 1024.0));
+}
+
+/* Runs on the GL thread */
+bool GLBModelAsync::pick(const glm::vec3 &origin, const glm::vec3 &direction, MeshBvh::Hit &hit) const {
+    return mBvh && mBvh->intersect(origin, direction, std::numeric_limits<float>::max(), hit);
+}
+
+/* Runs on the GL thread */
+void GLBModelAsync::onTexture(LoadResult &result) {
+    mReceivedTextures++;
+    if(!result.image.imageBytes && result.stagingTicket < 0 && !result.uploadedTexture) {
+        LOGE("NAT_ERROR : Failed to decode texture *%d", result.textureIndex);
+        return;
+    }
+
+    double megabytes = texelBytes(result.image) / (1024.0 * 1024.0);
+    GLuint textureId = result.uploadedTexture;
+    if(textureId) {
+        mTextureStats.background++;
+    } else {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(result.stagingTicket >= 0) {
+            bool bound = mStaging.begin(result.stagingTicket);
+            int ticket = result.stagingTicket;
+            result.stagingTicket = -1;
+            if(!bound) {
+                LOGE("NAT_ERROR : Staged texels of texture *%d were lost", result.textureIndex);
+                return;
+            }
+            /* Only schedules a copy out of the slot */
+            textureId = bindTextures(result.image);
+            mStaging.end(ticket);
+            mTextureStats.staged++;
+        } else {
+            textureId = bindTextures(result.image);
+            mTextureStats.direct++;
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        mTextureStats.glThreadMs += elapsed.count();
+    }
+    mTextureStats.megabytes += megabytes;
+
+    if((size_t)result.textureIndex >= mTextures.size()) {
+        mTextures.resize(result.textureIndex + 1, 0);
+        mTextureAlpha.resize(result.textureIndex + 1, ALPHA_OPAQUE);
+    }
+    mTextures[result.textureIndex] = textureId;
+    mTextureAlpha[result.textureIndex] = result.alpha;
+    for(Mesh& mesh : mMeshes) {
+        if(mesh.textureIndex != result.textureIndex) continue;
+        mesh.textureId = textureId;
+        classify(mesh);
+    }
+}
+
+/* Runs on the GL thread. The placeholder textures are opaque, a mesh moves to a cheaper or
+ * costlier pass when its real texture arrives */
+void GLBModelAsync::classify(Mesh &mesh) {
+    bool arrived = mesh.textureIndex >= 0 && (size_t)mesh.textureIndex < mTextures.size() && mTextures[mesh.textureIndex];
+    AlphaMode content = arrived ? mTextureAlpha[mesh.textureIndex] : ALPHA_OPAQUE;
+    /* The material is the upper bound (an OPAQUE material ignores alpha), the texels the actual need */
+    mesh.alphaMode = mesh.declaredAlpha < 0 ? content : std::min((AlphaMode)mesh.declaredAlpha, content);
+    mPassesDirty = true;
+}
+
+/* Runs on the GL thread */
+void GLBModelAsync::rebuildPasses() {
+    for(Pass& pass : mPasses) pass.meshes.clear();
+    for(size_t i = 0; i < mMeshes.size(); i++) {
+        mPasses[mMeshes[i].alphaMode].meshes.push_back((uint32_t)i);
+    }
+    mMeshDistances.resize(mMeshes.size());
+    mPassesDirty = false;
+    LOGI("SANJU : Model passes : %zu opaque | %zu alpha tested | %zu blended", mPasses[ALPHA_OPAQUE].meshes.size(),
+         mPasses[ALPHA_MASK].meshes.size(), mPasses[ALPHA_BLEND].meshes.size());
+}
+
+void GLBModelAsync::collectNodeMeshes(aiNode *node, const aiScene *scene, std::vector<aiMesh*>& meshes) {
     for(unsigned int i = 0; i < node->mNumMeshes; i++) {
-//        LOGI("SANJU : Inside first loop");
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        mMeshes.push_back(extractVertAndIndMesh(mesh, scene));
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
 
     /* Process child nodes */
     for(unsigned int i = 0; i < node->mNumChildren; i++) {
-//        LOGI("SANJU : Inside second loop");
-        extractVertAndIndNode(node->mChildren[i], scene);
+        collectNodeMeshes(node->mChildren[i], scene, meshes);
     }
 }
 
-GLBModelAsync::Mesh GLBModelAsync::extractVertAndIndMesh(aiMesh *mesh, const aiScene *scene) {
+GLBModelAsync::Mesh GLBModelAsync::extractVertAndIndMesh(aiMesh *mesh, const aiScene *scene, const std::shared_ptr<LinearArena>& arena) {
     LOGI("SANJU :  GLBModelAsync::extractVertAndIndMesh : [mesh->mNumVertices = %d]", mesh->mNumVertices);
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+    Mesh result{};
+    result.arena = arena;
+    result.vertices = decltype(result.vertices)(ArenaAllocator<float>(arena.get()));
+    result.indices = decltype(result.indices)(ArenaAllocator<unsigned int>(arena.get()));
+    result.mode = GL_TRIANGLES;
 
-    /* Just to fill the Mesh{} */
-    GLuint vao = 0;
-    GLuint vbo = 0;
-    GLuint ebo = 0;
-    GLuint textureId = 0;
+    /* Sized up front, growing would leave every outgrown buffer behind in the arena */
+    auto& vertices = result.vertices;
+    auto& indices = result.indices;
+    vertices.reserve((size_t)mesh->mNumVertices * 8);
+    /* Faces are only all triangles when the post-processing had aiProcess_Triangulate */
+    size_t triangleCount = 0;
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        if(mesh->mFaces[i].mNumIndices >= 3) triangleCount += mesh->mFaces[i].mNumIndices - 2;
+    }
+    indices.reserve(triangleCount * 3);
 
     /* Process vertices */
     for(unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -101,10 +989,16 @@ GLBModelAsync::Mesh GLBModelAsync::extractVertAndIndMesh(aiMesh *mesh, const aiS
         vertices.push_back(mesh->mVertices[i].y);
         vertices.push_back(mesh->mVertices[i].z);
 
-        /* Normals */
-        vertices.push_back(mesh->mNormals[i].x);
-        vertices.push_back(mesh->mNormals[i].y);
-        vertices.push_back(mesh->mNormals[i].z);
+        /* Normals. Only missing when the caller's LoadOptions left out aiProcess_GenNormals */
+        if(mesh->mNormals) {
+            vertices.push_back(mesh->mNormals[i].x);
+            vertices.push_back(mesh->mNormals[i].y);
+            vertices.push_back(mesh->mNormals[i].z);
+        } else {
+            vertices.push_back(0.0f);
+            vertices.push_back(1.0f);
+            vertices.push_back(0.0f);
+        }
 
         /* Texture Coordinates */
         if(mesh->mTextureCoords[0]) {
@@ -116,153 +1010,278 @@ GLBModelAsync::Mesh GLBModelAsync::extractVertAndIndMesh(aiMesh *mesh, const aiS
         }
     }
 
-    /* Process Indices */
+    /* Process Indices. Polygons are fanned out, points and lines have no place in GL_TRIANGLES */
     for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for(unsigned int j = 0; j < face.mNumIndices; j++) {
+        const aiFace& face = mesh->mFaces[i];
+        for(unsigned int j = 2; j < face.mNumIndices; j++) {
+            indices.push_back(face.mIndices[0]);
+            indices.push_back(face.mIndices[j - 1]);
             indices.push_back(face.mIndices[j]);
         }
     }
 
-    return Mesh {
-        vertices, indices,
-        vao, vbo, ebo,
-        indices.size(),
-        textureId
-    };
+    result.indexCount = indices.size();
+    result.center = boundsCenter(reinterpret_cast<const uint8_t*>(vertices.data()), mesh->mNumVertices, 8 * sizeof(float));
+    return result;
 }
 
-/* Can be run on background thread using std::async() */
-void GLBModelAsync::extractTextureImages(const aiScene *scene) {
-    LOGI("SANJU : GLBModelAsync::extractTextureImages");
-    for(unsigned  int i = 0; i < scene->mNumTextures; i++) {
-        aiTexture* texture = scene->mTextures[i];
-        std::string texName = "*" + std::to_string(i);
-        textureImageData texImageData{};
-        texImageData.imageBytes =  stbi_load_from_memory(
-                reinterpret_cast<unsigned char*>(texture->pcData),
-                texture->mWidth,
-                &texImageData.width, &texImageData.height, &texImageData.channels, STBI_rgb_alpha
-        );
+/* One glTF primitive into our interleaved position / normal / uv layout. Accessors are read in
+ * place from the BIN chunk, this is the only copy of the vertex data */
+GLBModelAsync::Mesh GLBModelAsync::extractGLBPrimitive(const GLBReader &reader, const GLBReader::Primitive &primitive,
+                                                       const std::shared_ptr<LinearArena>& arena) {
+    Mesh mesh{};
+    mesh.arena = arena;
+    mesh.vertices = decltype(mesh.vertices)(ArenaAllocator<float>(arena.get()));
+    mesh.indices = decltype(mesh.indices)(ArenaAllocator<unsigned int>(arena.get()));
+    mesh.mode = GL_TRIANGLES;
+
+    GLBAccessorView positions, normals, texcoords, indices;
+    reader.accessor(primitive.position, positions);
+    bool hasNormals = primitive.normal >= 0 && reader.accessor(primitive.normal, normals) && normals.count == positions.count;
+    bool hasTexcoords = primitive.texcoord >= 0 && reader.accessor(primitive.texcoord, texcoords) && texcoords.count == positions.count;
+
+    size_t count = positions.count;
+    mesh.vertices.resize(count * 8, 0.0f);
+    float* out = mesh.vertices.data();
+    for(size_t i = 0; i < count; i++, out += 8) {
+        if(positions.isTightFloat()) {
+            memcpy(out, positions.data + i * positions.stride, 3 * sizeof(float));
+        } else {
+            for(int c = 0; c < 3; c++) out[c] = positions.readFloat(i, c);
+        }
+        if(hasNormals) {
+            for(int c = 0; c < 3; c++) out[3 + c] = normals.readFloat(i, c);
+        }
+        /* glTF's UV origin is top left like our textures, so no flip (Assimp flips on import and
+         * aiProcess_FlipUVs flips back) */
+        if(hasTexcoords) {
+            out[6] = texcoords.readFloat(i, 0);
+            out[7] = texcoords.readFloat(i, 1);
+        }
+    }
 
-        mTextureImages[texName] = texImageData;
+    if(primitive.indices >= 0 && reader.accessor(primitive.indices, indices)) {
+        mesh.indices.resize(indices.count);
+        if(indices.componentType == 5125 && indices.stride == sizeof(uint32_t)) {
+            memcpy(mesh.indices.data(), indices.data, indices.count * sizeof(uint32_t));
+        } else {
+            for(size_t i = 0; i < indices.count; i++) mesh.indices[i] = indices.readIndex(i);
+        }
+        /* Out of range indices would read past the vertex buffer on the GPU */
+        for(unsigned int& index : mesh.indices) {
+            if(index >= count) index = 0;
+        }
+    } else {
+        mesh.indices.resize(count);
+        for(size_t i = 0; i < count; i++) mesh.indices[i] = (unsigned int)i;
     }
-    LOGI("SANJU : mTextureImages.size() - %d", mTextureImages.size());
+    mesh.indices.resize(mesh.indices.size() - mesh.indices.size() % 3);
+    mesh.indexCount = mesh.indices.size();
+
+    /* Same job as aiProcess_GenNormals, but smooth (area weighted) instead of split per face */
+    if(!hasNormals) {
+        for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            float* a = &mesh.vertices[mesh.indices[i] * 8];
+            float* b = &mesh.vertices[mesh.indices[i + 1] * 8];
+            float* c = &mesh.vertices[mesh.indices[i + 2] * 8];
+            glm::vec3 faceNormal = glm::cross(glm::make_vec3(b) - glm::make_vec3(a), glm::make_vec3(c) - glm::make_vec3(a));
+            for(float* vertex : {a, b, c}) {
+                vertex[3] += faceNormal.x;
+                vertex[4] += faceNormal.y;
+                vertex[5] += faceNormal.z;
+            }
+        }
+        for(size_t i = 0; i < count; i++) {
+            glm::vec3 normal = glm::make_vec3(&mesh.vertices[i * 8 + 3]);
+            float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+            memcpy(&mesh.vertices[i * 8 + 3], glm::value_ptr(normal), 3 * sizeof(float));
+        }
+    }
+    mesh.center = boundsCenter(reinterpret_cast<const uint8_t*>(mesh.vertices.data()), count, 8 * sizeof(float));
+    return mesh;
 }
 
-/* Running on the GL thread */
-void GLBModelAsync::processTextures(const aiScene *scene) {
-    LOGI("SANJU : GLBModelAsync::processTextures");
-    for(unsigned int i = 0; i < scene->mNumTextures; i++) {
-        aiTexture* texture = scene->mTextures[i];
-        std::string texName = "*" + std::to_string(i);
-        mTextures[texName] = bindTextures(texture, texName);
+/* Index of the embedded diffuse texture of a mesh, -1 if it has none we can load */
+int GLBModelAsync::embeddedTextureIndex(aiMesh *mesh, const aiScene *scene) {
+    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    aiString texPath;
+    if(material->GetTexture(aiTextureType_DIFFUSE, 0, &texPath) != AI_SUCCESS) return -1;
+
+    /* Only embedded textures ("*<index>") are loaded, see aiProcess_EmbedTextures */
+    const char* path = texPath.C_Str();
+    if(path[0] != '*') return -1;
+    unsigned long index = strtoul(path + 1, nullptr, 10);
+    return index < scene->mNumTextures ? (int)index : -1;
+}
+
+/* Assimp keeps glTF's alphaMode as a material property, other formats don't have one */
+int GLBModelAsync::materialAlphaMode(aiMesh *mesh, const aiScene *scene, float &outCutoff) {
+    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    outCutoff = 0.5f;
+    aiString mode;
+    if(material->Get(AI_MATKEY_GLTF_ALPHAMODE, mode) != AI_SUCCESS) return -1;
+    material->Get(AI_MATKEY_GLTF_ALPHACUTOFF, outCutoff);
+    if(!strcmp(mode.C_Str(), "MASK")) return ALPHA_MASK;
+    if(!strcmp(mode.C_Str(), "BLEND")) return ALPHA_BLEND;
+    return ALPHA_OPAQUE;
+}
+
+/* Runs on a decode job, stops at the first texel that needs blending */
+GLBModelAsync::AlphaMode GLBModelAsync::classifyAlpha(const unsigned char *rgba, size_t texelCount) {
+    AlphaMode mode = ALPHA_OPAQUE;
+    for(size_t i = 0; i < texelCount; i++) {
+        unsigned char alpha = rgba[i * 4 + 3];
+        if(alpha >= 255 - kAlphaTolerance) continue;
+        if(alpha > kAlphaTolerance) return ALPHA_BLEND;
+        mode = ALPHA_MASK;
     }
+    return mode;
 }
 
-GLuint GLBModelAsync::bindTextures(aiTexture *texture, const std::string& texName) {
+/* Center of the axis aligned bounds of count positions (3 floats each) stride bytes apart */
+glm::vec3 GLBModelAsync::boundsCenter(const uint8_t *positions, size_t count, size_t stride) {
+    if(count == 0) return glm::vec3(0.0f);
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(-std::numeric_limits<float>::max());
+    for(size_t i = 0; i < count; i++) {
+        glm::vec3 position;
+        memcpy(glm::value_ptr(position), positions + i * stride, sizeof(position));
+        lo = glm::min(lo, position);
+        hi = glm::max(hi, position);
+    }
+    return (lo + hi) * 0.5f;
+}
+
+void GLBModelAsync::logArenaStats(const LinearArena &arena, uint32_t generation) {
+    const LinearArena::Stats& stats = arena.stats();
+    LOGI("SANJU : Load %u arena : %zu allocations (%zu kB) served by %zu blocks (%zu kB)", generation,
+         stats.allocations, stats.bytes / 1024, stats.blocks, stats.blockBytes / 1024);
+}
+
+/* Runs on the GL thread */
+GLuint GLBModelAsync::bindTextures(const textureImageData& image) {
+    /* Storage for the full chain, the levels a package doesn't carry are generated */
+    GLsizei levels = image.mipCount > 0 ? image.mipCount : 1 + (GLsizei)std::log2((double)std::max(image.width, image.height));
+
     GLuint textureId;
     glGenTextures(1, &textureId);
     glBindTexture(GL_TEXTURE_2D, textureId);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, image.width, image.height);
 
-    textureImageData texImgData = mTextureImages[texName];
-
-    /* Handling compressed texture */
-    if(texture->mHeight == 0) {
-        if(texImgData.imageBytes) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texImgData.width, texImgData.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texImgData.imageBytes);
-        }
-    } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->mWidth, texture->mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture->pcData);
+    /* A client pointer or an offset into the bound unpack buffer, the levels back to back either way */
+    uintptr_t texels = reinterpret_cast<uintptr_t>(image.imageBytes);
+    int given = image.mipCount > 0 ? image.mipCount : 1;
+    for(int mip = 0; mip < given; mip++) {
+        GLsizei width = std::max(1, image.width >> mip);
+        GLsizei height = std::max(1, image.height >> mip);
+        glTexSubImage2D(GL_TEXTURE_2D, mip, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(texels));
+        texels += ArpkPackage::MipSize(image.width, image.height, mip);
     }
 
-    glGenerateMipmap(GL_TEXTURE_2D);
-
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    if(image.mipCount == 0) glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     return textureId;
 }
 
-void GLBModelAsync::bindMesh() {
-    for(unsigned int i = 0; i < mMeshes.size(); i++) {
-        glGenVertexArrays(1, &mMeshes[i].vao);
-        glGenBuffers(1, &mMeshes[i].vbo);
-        glGenBuffers(1, &mMeshes[i].ebo);
-
-        glBindVertexArray(mMeshes[i].vao);
+size_t GLBModelAsync::texelBytes(const textureImageData &image) {
+    size_t bytes = 0;
+    int given = image.mipCount > 0 ? image.mipCount : 1;
+    for(int mip = 0; mip < given; mip++) bytes += ArpkPackage::MipSize(image.width, image.height, mip);
+    return bytes;
+}
 
-        /* Vertex buffer */
-        glBindBuffer(GL_ARRAY_BUFFER, mMeshes[i].vbo);
-        glBufferData(GL_ARRAY_BUFFER, mMeshes[i].vertices.size() * sizeof(float), mMeshes[i].vertices.data(), GL_STATIC_DRAW);
+/* Packed meshes upload straight from the package mapping */
+void GLBModelAsync::uploadMeshBuffers(Mesh &mesh) {
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
 
-        /* Element buffer */
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMeshes[i].ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mMeshes[i].indices.size() * sizeof(unsigned int), mMeshes[i].indices.data(), GL_STATIC_DRAW);
+    /* Vertex buffer */
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    if(mesh.packed) {
+        glBufferData(GL_ARRAY_BUFFER, mesh.packed->vertexCount * sizeof(ArpkVertex), mesh.package->at(mesh.packed->vertexOffset), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        /* Vertex attributes */
-        /* Position (location n= 0) */
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    /* Element buffer. Outside of any VAO, the binding sticks to the VAO once made */
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    if(mesh.packed) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.packed->indexCount * sizeof(uint16_t), mesh.package->at(mesh.packed->indexOffset), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
-        /* Normal (location = 1) */
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+void GLBModelAsync::bindMesh(Mesh& mesh) {
+    if(!mesh.vbo) uploadMeshBuffers(mesh);
 
-        /* Texture Coords. (location = 2) */
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glGenVertexArrays(1, &mesh.vao);
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
 
+    if(mesh.packed) {
+        bindPackedMesh(mesh);
         glBindVertexArray(0);
+        return;
     }
-}
 
-void GLBModelAsync::bindMeshToTextureNode(aiNode* node, const aiScene* scene, unsigned int& globalMeshIndex) {
-    for(unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        bindMeshToTextureMesh(mesh, scene, globalMeshIndex);
-        globalMeshIndex++;
-    }
+    /* Vertex attributes */
+    /* Position (location n= 0) */
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
 
-    for(unsigned int i = 0; i < node->mNumChildren; i++) {
-        bindMeshToTextureNode(node->mChildren[i], scene, globalMeshIndex);
-    }
+    /* Normal (location = 1) */
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+
+    /* Texture Coords. (location = 2) */
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+    glBindVertexArray(0);
 }
 
-void GLBModelAsync::bindMeshToTextureMesh(aiMesh* mesh, const aiScene* scene, unsigned int globalMeshIndex) {
-    if(mesh->mMaterialIndex >= 0 ) {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        aiString texPath;
-        if(material->GetTexture(aiTextureType_DIFFUSE, 0, &texPath) == AI_SUCCESS) {
-            LOGI("SANJU : Inside GetTexture()");
-            std::string pathStr(texPath.C_Str());
-            LOGI("SANJU : %s", pathStr.c_str());
-            if(mTextures.find(pathStr) != mTextures.end()) {
-                mMeshes[globalMeshIndex].textureId = mTextures[pathStr];
-                LOGI("SANJU : textureId = %d", mMeshes[globalMeshIndex].textureId);
-            }
-        }
-    }
+/* The arena goes with the last mesh of its load that lets go of it */
+void GLBModelAsync::releaseCpuCopies(Mesh &mesh) {
+    /* swap, clear() would keep the capacity */
+    decltype(mesh.vertices)().swap(mesh.vertices);
+    decltype(mesh.indices)().swap(mesh.indices);
+    mesh.arena.reset();
+}
 
-    if(mMeshes[globalMeshIndex].textureId == 0) {
-        mMeshes[globalMeshIndex].textureId = createDefaultTexture();
-    }
+/* ArpkVertex layout : the shader still sees vec3 / vec3 / vec2, the GPU expands the snorm8
+ * normals and half float UVs on fetch. Called with the mesh's VAO and buffers bound */
+void GLBModelAsync::bindPackedMesh(Mesh &mesh) {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ArpkVertex), (void*)offsetof(ArpkVertex, position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_BYTE, GL_TRUE, sizeof(ArpkVertex), (void*)offsetof(ArpkVertex, normal));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(ArpkVertex), (void*)offsetof(ArpkVertex, uv));
 }
 
+/* Checkerboard for meshes without a texture, shared by all of them */
 GLuint GLBModelAsync::createDefaultTexture() {
+    if(mDefaultTexture) return mDefaultTexture;
     LOGI("SANJU : Inside createDefaultTexture()");
-    GLuint textureId;
     const uint32_t texData[] = {
             0xFFFFFFFF, 0xFF000000,
             0xFF000000, 0xFFFFFFFF
     };
 
-    glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    glGenTextures(1, &mDefaultTexture);
+    glBindTexture(GL_TEXTURE_2D, mDefaultTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, texData);
 
 
@@ -274,43 +1293,113 @@ GLuint GLBModelAsync::createDefaultTexture() {
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    return textureId;
+    return mDefaultTexture;
 }
 
-void GLBModelAsync::draw(const float *mvp) {
-    glUseProgram(program);
+/* Flat grey shown while a mesh's real texture is still decoding */
+GLuint GLBModelAsync::createPendingTexture() {
+    if(mPendingTexture) return mPendingTexture;
+    const uint32_t texData = 0xFFB0B0B0;
 
-    glEnable(GL_DEPTH_TEST);
-    /* Accept fragment if it closer to the camera than the former one */
-    glDepthFunc(GL_LESS);
+    glGenTextures(1, &mPendingTexture);
+    glBindTexture(GL_TEXTURE_2D, mPendingTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texData);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    return mPendingTexture;
+}
 
-    /* Set uniforms */
-    GLuint mvpLoc = glGetUniformLocation(program, "mvp");
-    glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, mvp);
+void GLBModelAsync::setPrograms(const GLuint programs[ALPHA_MODE_COUNT]) {
+    for(int mode = 0; mode < ALPHA_MODE_COUNT; mode++) {
+        Pass& pass = mPasses[mode];
+        pass.program = programs[mode];
+        pass.modelLocation = glGetUniformLocation(pass.program, "model");
+        pass.normalMatrixLocation = glGetUniformLocation(pass.program, "normalMatrix");
+        /* Only the ALPHA_MASK variant has it */
+        pass.alphaCutoffLocation = glGetUniformLocation(pass.program, "uAlphaCutoff");
+        pass.alphaCutoff = -1.0f;
 
-    /* Drawing all meshes */
-    for(const auto& mesh : mMeshes) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mesh.textureId);
+        /* Every mesh samples unit 0, the sampler uniform never changes */
+        glUseProgram(pass.program);
+        glUniform1i(glGetUniformLocation(pass.program, "uTexture"), 0);
 
-        if(glGetError() != GL_NO_ERROR) {
-            LOGE("NAT_ERROR : Error binding texture %d", mesh.textureId);
-        }
+        pass.timer.create();
+        pass.gpuMs = -1.0;
+    }
+    glUseProgram(0);
 
-        GLint texLoc = glGetUniformLocation(program, "uTexture");
-        glUniform1i(texLoc, 0);
+    /* Same lifetime as the programs : once per GL context */
+    mStaging.create();
+}
 
-        glBindVertexArray(mesh.vao);
-        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, nullptr);
-        glBindVertexArray(0);
+void GLBModelAsync::draw(GLStateCache &stateCache, const float *model, const float *normalMatrix, const float *cameraPosition,
+                         const std::function<void(GLuint)>& prepareProgram) {
+    if(mTimeline.firstPixel < 0.0) {
+        mTimeline.firstPixel = elapsedSinceLoad();
+        LOGI("SANJU : Time to first pixel = %.1f ms", mTimeline.firstPixel);
     }
+    if(mPassesDirty) rebuildPasses();
 
-    glUseProgram(0);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    /* World space distance to the camera of each mesh, squared */
+    glm::mat4 modelMatrix = glm::make_mat4(model);
+    glm::vec3 camera = glm::make_vec3(cameraPosition);
+    for(size_t i = 0; i < mMeshes.size(); i++) {
+        glm::vec3 offset = glm::vec3(modelMatrix * glm::vec4(mMeshes[i].center, 1.0f)) - camera;
+        mMeshDistances[i] = glm::dot(offset, offset);
+    }
+    const float* distances = mMeshDistances.data();
+
+    auto drawMesh = [&stateCache](const Mesh& mesh) {
+        stateCache.bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, mesh.textureId);
+        stateCache.bindVertexArray(mesh.vao);
+        glDrawElements(mesh.mode, mesh.indexCount, mesh.indexType, nullptr);
+    };
+
+    for(int mode = 0; mode < ALPHA_MODE_COUNT; mode++) {
+        Pass& pass = mPasses[mode];
+        pass.gpuMs = -1.0;
+        /* The bounding box stands in for opaque geometry */
+        bool drawBounds = mode == ALPHA_OPAQUE && mHasBounds;
+        if(pass.meshes.empty() && !drawBounds) continue;
+
+        /* Front to back lets early depth testing reject what is hidden, blending needs back to front */
+        if(mode == ALPHA_BLEND) {
+            std::sort(pass.meshes.begin(), pass.meshes.end(), [distances](uint32_t a, uint32_t b) { return distances[a] > distances[b]; });
+        } else {
+            std::sort(pass.meshes.begin(), pass.meshes.end(), [distances](uint32_t a, uint32_t b) { return distances[a] < distances[b]; });
+        }
+
+        pass.timer.begin();
+        stateCache.useProgram(pass.program);
+        stateCache.setEnabled(GL_DEPTH_TEST, true);
+        /* Accept fragment if it closer to the camera than the former one */
+        stateCache.depthFunc(GL_LESS);
+        /* Blended surfaces are tested but don't hide what is drawn behind them after */
+        stateCache.depthMask(mode != ALPHA_BLEND);
+        stateCache.setEnabled(GL_BLEND, mode == ALPHA_BLEND);
+        /* Alpha accumulates coverage, so an offscreen target holds premultiplied color (see SceneTarget) */
+        if(mode == ALPHA_BLEND) stateCache.blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        /* Per pass, not per mesh : the meshes only differ by their VAO and texture (and cutoff) */
+        glUniformMatrix4fv(pass.modelLocation, 1, GL_FALSE, model);
+        glUniformMatrix3fv(pass.normalMatrixLocation, 1, GL_FALSE, normalMatrix);
+        FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS, 2);
+        if(prepareProgram) prepareProgram(pass.program);
+
+        if(drawBounds) drawMesh(mBoundsMesh);
+        for(uint32_t index : pass.meshes) {
+            const Mesh& mesh = mMeshes[index];
+            if(mode == ALPHA_MASK && mesh.alphaCutoff != pass.alphaCutoff) {
+                glUniform1f(pass.alphaCutoffLocation, mesh.alphaCutoff);
+                pass.alphaCutoff = mesh.alphaCutoff;
+                FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS);
+            }
+            drawMesh(mesh);
+        }
+        pass.gpuMs = pass.timer.end();
+    }
 }
 
 void GLBModelAsync::release() {
@@ -320,9 +1409,34 @@ void GLBModelAsync::release() {
         glDeleteBuffers(1, &mesh.ebo);
     }
     mMeshes.clear();
+    for(Pass& pass : mPasses) pass.meshes.clear();
+    mMeshDistances.clear();
+    mPassesDirty = false;
 
-    for(auto& tex : mTextures) {
-        glDeleteTextures(1, &tex.second);
+    if(mHasBounds) {
+        glDeleteVertexArrays(1, &mBoundsMesh.vao);
+        glDeleteBuffers(1, &mBoundsMesh.vbo);
+        glDeleteBuffers(1, &mBoundsMesh.ebo);
+        mBoundsMesh = Mesh{};
+        mHasBounds = false;
+    }
+
+    for(GLuint texture : mTextures) {
+        if(texture) glDeleteTextures(1, &texture);
     }
     mTextures.clear();
+    mTextureAlpha.clear();
+
+    if(mDefaultTexture) glDeleteTextures(1, &mDefaultTexture);
+    if(mPendingTexture) glDeleteTextures(1, &mPendingTexture);
+    mDefaultTexture = 0;
+    mPendingTexture = 0;
+
+    mGeometryComplete = false;
+    mExpectedTextures = 0;
+    mReceivedTextures = 0;
+
+    /* A BVH job still running owns its parts, it is cancelled along with its load */
+    mPickParts.reset();
+    mBvh.reset();
 }
@@ -17,7 +17,22 @@
 #include <fstream>
 #include <sstream>
 #include <sys/syscall.h>
-#include <future>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include <mpsc_queue.h>
+#include <job_system.h>
+#include <glb_reader.h>
+#include <arpk_package.h>
+#include <frame_stats.h>
+#include <linear_arena.h>
+#include <gl_state_cache.h>
+#include <gpu_timer.h>
+#include <gl_uploader.h>
+#include <pixel_unpack_ring.h>
+#include <mesh_bvh.h>
 
 #include <stb_image.h>
 #include <glm/glm.hpp>
@@ -29,60 +44,330 @@
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOG_TID(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "[TID:%ld] " __VA_ARGS__, syscall(SYS_gettid))
 
+/*
+ * Loads a GLB model (or a ".arpk" package, which is mapped and uploaded as is, see ArpkPackage)
+ * on the JobSystem and uploads it on the GL thread, progressively : the
+ * model's bounding box is drawable right after parsing, meshes stream in batch by batch with a
+ * placeholder texture, and the real textures are swapped in as their decode jobs finish.
+ *
+ * Every load() bumps a generation counter, which acts as the handle of that load, and cancels
+ * the previous load's token so superseded jobs bail out at their next checkpoint (including in
+ * the middle of Assimp's import). Results are handed to the GL thread through a
+ * multi-producer/single-consumer queue that never makes a job wait; poll() drops stale
+ * generations and uploads the current one. Jobs never touch the members the GL thread reads.
+ *
+ * Meshes are drawn in three passes by how their material uses alpha : opaque (front to back, no
+ * blending, no alpha discard), alpha tested (front to back, discard under the cutoff) and blended
+ * (back to front, no depth writes). The class comes from the glTF alphaMode and is lowered to
+ * what the base color texture's alpha actually needs once it is decoded, so only the meshes that
+ * really blend or discard give up early depth rejection and hidden surface removal.
+ *
+ * A pickable load also builds a MeshBvh over all the triangles on the JobSystem once the last
+ * mesh batch is in, pick() works from then on.
+ */
 class GLBModelAsync {
 public:
     enum State {
-        NOT_LOADED, LOADED, READY, ERROR
+        NOT_LOADED, LOADING, STREAMING, READY, ERROR
+    };
+
+    /* Milliseconds since load(), -1 until reached */
+    struct LoadTimeline {
+        double firstDrawable = -1.0;     // Bounding box uploaded
+        double firstPixel = -1.0;        // First draw() of this load
+        double geometryComplete = -1.0;  // Last mesh batch uploaded
+        double ready = -1.0;             // Last texture swapped in
+    };
+
+    /* Texture uploads of a load. GL thread time covers the staged and direct ones */
+    struct LoadTextures {
+        int staged = 0;         // Written into a PixelUnpackRing slot by the decode job
+        int direct = 0;         // From client memory on the GL thread
+        int background = 0;     // From client memory on the GLUploader thread
+        double megabytes = 0.0; // Texels of all of them
+        double glThreadMs = 0.0;
     };
-    State mState = NOT_LOADED;
 
-    void update();
+    /* Resident memory of a load in kB. Peak and steady are taken at READY, after the CPU copies are gone */
+    struct LoadMemory {
+        long baselineKb = -1;   // At load()
+        long peakKb = -1;
+        long steadyKb = -1;
+    };
+
+    /* Material classes, drawn as separate passes in this order. Each pass has its own program,
+     * the model shader compiled with ALPHA_MASK / ALPHA_BLEND defined or neither */
+    enum AlphaMode {
+        ALPHA_OPAQUE, ALPHA_MASK, ALPHA_BLEND, ALPHA_MODE_COUNT
+    };
+
+    /* Any thread */
+    State state() const { return mState.load(std::memory_order_acquire); }
+    uint32_t generation() const { return mGeneration.load(std::memory_order_acquire); }
+    bool isDrawable() const { State current = state(); return current == STREAMING || current == READY; }
+
+    /* GL thread, once per frame. Returns true when the model became READY. Invalidates the
+     * state cache when anything was uploaded */
+    bool poll(GLStateCache& stateCache);
+    /* GL thread, with the render context current. Moves buffer and texture uploads to a
+     * GLUploader thread, the GL thread then only builds VAOs. Call again for a new context.
+     * False when there is no shared context, uploads stay on the GL thread */
+    bool setBackgroundUploads(bool enabled);
+    bool hasBackgroundUploads() const { return mUploader.isRunning(); }
+    const LoadTimeline& loadTimeline() const { return mTimeline; }
+    const LoadMemory& loadMemory() const { return mMemory; }
+    const LoadTextures& loadTextures() const { return mTextureStats; }
 
     struct Mesh {
-        std::vector<float> vertices;
-        std::vector<unsigned int> indices;
-        GLuint vao, vbo, ebo;
+        /* Holds the memory of vertices / indices extracted by a load job, declared first to go last */
+        std::shared_ptr<LinearArena> arena;
+        /* CPU copies, empty once uploaded unless LoadOptions::retainCpuCopies */
+        std::vector<float, ArenaAllocator<float>> vertices;
+        std::vector<unsigned int, ArenaAllocator<unsigned int>> indices;
+        /* vbo / ebo may already be filled by the upload thread, the vao never is */
+        GLuint vao = 0, vbo = 0, ebo = 0;
         size_t indexCount;
         GLuint textureId;
+        /* Embedded texture ("*0", "*1", ... as an index) this mesh waits for, -1 if it has none */
+        int textureIndex = -1;
+        GLenum mode = GL_TRIANGLES;
+        GLenum indexType = GL_UNSIGNED_INT;
+        /* AlphaMode of the material, -1 when it has none (the texture's alpha decides alone) */
+        int declaredAlpha = -1;
+        float alphaCutoff = 0.5f;
+        /* Pass the mesh is drawn in, declaredAlpha lowered to what its current texture needs */
+        AlphaMode alphaMode = ALPHA_OPAQUE;
+        /* Of the vertex bounds, model space. Sorts the draws of a pass */
+        glm::vec3 center = glm::vec3(0.0f);
+        /* Package meshes upload straight from the mapping instead of vertices / indices */
+        std::shared_ptr<const ArpkPackage> package;
+        const ArpkMesh* packed = nullptr;
     };
 
-    ~GLBModelAsync() {
-        LOGI("SANJU : ~GLBModelAsync() called");
-        release();
-    }
+    /* Assimp post-processing of a load. GLBReader handles the GLBs it supports without any */
+    struct LoadOptions {
+        static constexpr unsigned int kFullPostProcess =
+                aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices |
+                aiProcess_OptimizeMeshes | aiProcess_EmbedTextures | aiProcess_FindInstances;
+        /* What is left to do on a GLB the ConversionService already ran kFullPostProcess on : glTF
+         * stores UVs unflipped, and textures still have to come out as embedded "*<index>" ones.
+         * Triangulate stays, it costs nothing on triangle meshes and the file may not be ours */
+        static constexpr unsigned int kPipelinePostProcess =
+                aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_EmbedTextures;
 
-    bool load(const std::string& fileName);
-    void draw(const float mvp[16]);
+        unsigned int postProcess = kFullPostProcess;
+        /* Files carrying GLBReader::kPipelineMarker get kPipelinePostProcess instead */
+        bool skipRedundantPasses = true;
+        /* Keep the meshes' vertices / indices for CPU side features (picking), otherwise they are
+         * freed right after their upload */
+        bool retainCpuCopies = false;
+        /* Build a MeshBvh for pick() after the geometry is in. Its job takes the CPU copies over
+         * (copies them under retainCpuCopies) and keeps package mappings until it is done */
+        bool pickable = false;
+    };
+
+
+    ~GLBModelAsync();
+
+    /* GL thread. Supersedes any load in flight and returns the generation of the new one */
+    uint32_t load(const std::string& fileName) { return load(fileName, LoadOptions()); }
+    uint32_t load(const std::string& fileName, const LoadOptions& options);
+    /* The camera comes from the programs' Frame block (FrameUniforms), cameraPosition (world
+     * space) only orders the draws. normalMatrix : inverse transpose of the model matrix, both
+     * column major. Sets its own state through the cache. prepareProgram runs once per non empty
+     * pass with that pass's program in use, for the uniforms owned by others (depth occlusion) */
+    void draw(GLStateCache& stateCache, const float model[16], const float normalMatrix[9], const float cameraPosition[3],
+              const std::function<void(GLuint)>& prepareProgram);
     void release();
-    void setProgram(GLuint program_) { program = program_; }
+    /* Once per GL context, after linking, with one program per AlphaMode : looks their uniform
+     * locations up once instead of per frame, creates the per pass GPU timers and the texture
+     * staging slots */
+    void setPrograms(const GLuint programs[ALPHA_MODE_COUNT]);
+    /* GPU time of a pass, latest finished measurement, -1 when there is nothing new. Read once
+     * per frame after draw() */
+    double passGpuMs(AlphaMode mode) const { return mPasses[mode].gpuMs; }
 
-private:
+    /* Parse time, peak memory and mesh allocations of GLBReader vs Assimp (full and pipeline
+     * post-processing, heap vs load arena) on the same file, any thread but the GL one */
+    static bool BenchmarkParsers(const std::string& fileName, const std::string& reportPath);
+    /* MeshBvh build time, size and rays per second over a GLB's triangles, any thread but the GL one */
+    static bool BenchmarkPicking(const std::string& fileName, const std::string& reportPath);
 
-    std::unique_ptr<Assimp::Importer> mImporter;
-    const aiScene* mScene = nullptr;
-    std::future<void> loadingFuture;
+    /* GL thread. Whether the current load's BVH is in */
+    bool isPickable() const { return mBvh != nullptr; }
+    /* GL thread. Nearest triangle along a model space ray, hit.source indexes the meshes in load
+     * order. False until isPickable() */
+    bool pick(const glm::vec3& origin, const glm::vec3& direction, MeshBvh::Hit& hit) const;
 
-    GLuint program = 0;
-    std::vector<Mesh> mMeshes;
-    std::unordered_map<std::string, GLuint> mTextures;
+private:
 
     struct textureImageData {
         int width, height, channels;
         unsigned char* imageBytes;
+        /* > 0 : imageBytes holds that many levels back to back, no glGenerateMipmap needed */
+        int mipCount;
     };
-    std::unordered_map<std::string, textureImageData> mTextureImages;
 
-    void extractVertAndIndNode(aiNode* node, const aiScene* scene);
-    Mesh extractVertAndIndMesh(aiMesh* mesh, const aiScene* scene);
+    enum ResultKind {
+        RESULT_BOUNDS, RESULT_MESHES, RESULT_TEXTURE, RESULT_PICKING, RESULT_FAILED
+    };
+
+    /* One step of a load, owned by the queue until poll() */
+    struct LoadResult {
+        uint32_t generation = 0;
+        ResultKind kind = RESULT_FAILED;
+
+        /* RESULT_BOUNDS */
+        glm::vec3 boundsMin = glm::vec3(0.0f);
+        glm::vec3 boundsMax = glm::vec3(0.0f);
+
+        /* RESULT_MESHES. The last batch also tells how many textures are still to come */
+        std::vector<Mesh> meshes;
+        bool lastBatch = false;
+        int textureCount = 0;
+
+        /* RESULT_TEXTURE */
+        int textureIndex = -1;
+        textureImageData image{};
+        /* What the texels' alpha needs, classified by the decode job */
+        AlphaMode alpha = ALPHA_OPAQUE;
+        /* Set when image points into a mapped package, which then owns the texels */
+        std::shared_ptr<const ArpkPackage> package;
+        /* Made from image by the upload thread, 0 when the GL thread uploads it */
+        GLuint uploadedTexture = 0;
+        /* PixelUnpackRing ticket holding the texels instead of imageBytes, -1 if not staged */
+        int stagingTicket = -1;
+        PixelUnpackRing* staging = nullptr;
+
+        /* RESULT_PICKING */
+        std::unique_ptr<MeshBvh> bvh;
+
+        /* Link in mResults */
+        LoadResult* next = nullptr;
+
+        ~LoadResult();
+    };
+
+    /* Triangles of one mesh for the BVH job, empty for meshes that aren't triangle lists */
+    struct PickPart {
+        std::shared_ptr<LinearArena> arena;
+        std::vector<float, ArenaAllocator<float>> vertices;
+        std::vector<unsigned int, ArenaAllocator<unsigned int>> indices;
+        std::shared_ptr<const ArpkPackage> package;
+        const ArpkMesh* packed = nullptr;
+    };
+
+    std::atomic<State> mState{NOT_LOADED};
+    std::atomic<uint32_t> mGeneration{0};
+
+    CancelToken mLoadToken;
+    std::atomic<int> mJobsInFlight{0};
+
+    /* Jobs write decoded texels into its slots. Declared before the queue, a result still holding a
+     * slot gives it back on destruction */
+    PixelUnpackRing mStaging;
+
+    /* Jobs of one or several generations publish concurrently and never wait for the GL thread */
+    MpscQueue<LoadResult> mResults;
+
+    void runLoad(const std::string& fileName, const LoadOptions& options, uint32_t generation, const CancelToken& token);
+    bool runPackageLoad(const std::string& fileName, uint32_t generation, const CancelToken& token);
+    bool runGLBLoad(const GLBReader& reader, const std::shared_ptr<std::vector<char>>& buffer,
+                    uint32_t generation, const CancelToken& token);
+    bool runAssimpLoad(const std::vector<char>& buffer, unsigned int postProcess, uint32_t generation, const CancelToken& token);
+    bool publishMeshBatches(size_t meshCount, const std::function<Mesh(size_t)>& extract,
+                            int textureCount, uint32_t generation, const CancelToken& token);
+    void submitTextureDecode(std::shared_ptr<const void> owner, const uint8_t* data, size_t size,
+                             int rawWidth, int rawHeight, int index,
+                             uint32_t generation, const CancelToken& token);
+    bool publish(std::unique_ptr<LoadResult>& result, const CancelToken& token);
+    /* Job side : moves a texture result's texels into a staging slot and frees its copy. False
+     * (no free slot, too big) leaves it for an upload from client memory */
+    bool stageTexels(LoadResult& result);
+
+    struct Pass {
+        GLuint program = 0;
+        GLint modelLocation = -1;
+        GLint normalMatrixLocation = -1;
+        GLint alphaCutoffLocation = -1;
+        float alphaCutoff = -1.0f;      // Last value set on the program
+        /* Indices into mMeshes, sorted by distance every frame */
+        std::vector<uint32_t> meshes;
+        GpuTimer timer;
+        double gpuMs = -1.0;
+    };
+
+    /* Buffer and texture uploads off the GL thread, when enabled */
+    GLUploader mUploader;
+
+    /* GL thread only */
+    Pass mPasses[ALPHA_MODE_COUNT];
+    bool mPassesDirty = false;
+    /* Camera distance (squared) of each mesh of mMeshes, scratch of draw() */
+    std::vector<float> mMeshDistances;
+    std::vector<Mesh> mMeshes;
+    Mesh mBoundsMesh{};
+    bool mHasBounds = false;
+    /* By embedded texture index, 0 until it arrives */
+    std::vector<GLuint> mTextures;
+    std::vector<AlphaMode> mTextureAlpha;
+    GLuint mPendingTexture = 0;
+    GLuint mDefaultTexture = 0;
+    bool mGeometryComplete = false;
+    int mExpectedTextures = 0;
+    int mReceivedTextures = 0;
+    std::chrono::steady_clock::time_point mLoadStart;
+    LoadTimeline mTimeline;
+    LoadMemory mMemory;
+    LoadTextures mTextureStats;
+    bool mRetainCpuCopies = false;
+    bool mPickable = false;
+    /* One per mesh of mMeshes, handed to the BVH job with the last batch */
+    std::shared_ptr<std::vector<PickPart>> mPickParts;
+    std::unique_ptr<MeshBvh> mBvh;
+    /* Set by apply(), returned by poll() */
+    bool mBecameReady = false;
+
+    double elapsedSinceLoad() const;
+    /* Uploads what the result still needs and adds it to the model, advancing the state */
+    void apply(LoadResult& result);
+    void submitUpload(std::unique_ptr<LoadResult> result);
+    /* GL thread, completion of submitUpload() */
+    void finishUpload(LoadResult& result);
+    void onBounds(const LoadResult& result);
+    void onMeshes(LoadResult& result);
+    void onTexture(LoadResult& result);
+    void onPicking(LoadResult& result);
+    void collectPickPart(Mesh& mesh);
+    void submitPickingBuild(uint32_t generation);
+    void classify(Mesh& mesh);
+    void rebuildPasses();
 
-    void bindMesh();
-    void bindMeshToTextureNode(aiNode* node, const aiScene* scene, unsigned int& globalMeshIndex);
-    void bindMeshToTextureMesh(aiMesh* mesh, const aiScene* scene, unsigned int globalMeshIndex);
-    void extractTextureImages(const aiScene *scene);
+    static void collectNodeMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes);
+    /* A null arena puts the mesh on the heap */
+    static Mesh extractVertAndIndMesh(aiMesh* mesh, const aiScene* scene, const std::shared_ptr<LinearArena>& arena);
+    static Mesh extractGLBPrimitive(const GLBReader& reader, const GLBReader::Primitive& primitive,
+                                    const std::shared_ptr<LinearArena>& arena);
+    static int embeddedTextureIndex(aiMesh* mesh, const aiScene* scene);
+    /* glTF alphaMode of the mesh's material as an AlphaMode, -1 for non glTF materials */
+    static int materialAlphaMode(aiMesh* mesh, const aiScene* scene, float& outCutoff);
+    /* Whether RGBA8 texels are all opaque, all (nearly) opaque or transparent, or really blend */
+    static AlphaMode classifyAlpha(const unsigned char* rgba, size_t texelCount);
+    static glm::vec3 boundsCenter(const uint8_t* positions, size_t count, size_t stride);
+    static void logArenaStats(const LinearArena& arena, uint32_t generation);
 
-    void processTextures(const aiScene* scene);
-    GLuint bindTextures(aiTexture* texture, const std::string& texName);
+    /* Buffers on the current thread (GL or upload), then the VAO on the GL thread */
+    static void uploadMeshBuffers(Mesh& mesh);
+    void bindMesh(Mesh& mesh);
+    static void releaseCpuCopies(Mesh& mesh);
+    void bindPackedMesh(Mesh& mesh);
+    /* Any thread with a context sharing the render context's objects. Immutable storage. Null
+     * imageBytes reads the texels from offset 0 of the bound GL_PIXEL_UNPACK_BUFFER */
+    static GLuint bindTextures(const textureImageData& image);
+    /* Bytes of the levels image holds (level 0 alone without a prebuilt chain) */
+    static size_t texelBytes(const textureImageData& image);
     GLuint createDefaultTexture();
+    GLuint createPendingTexture();
 };
 
 #endif //BUILDING_AR_GLB_RENDERER_ASYNC_H
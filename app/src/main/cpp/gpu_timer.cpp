@@ -0,0 +1,81 @@
+#include <gpu_timer.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include <cstring>
+
+bool GpuTimer::create() {
+    /* A new surface comes with a new context, queries of the previous one are already gone */
+    memset(mQueries, 0, sizeof(mQueries));
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    bool supported = false;
+    for(GLint i = 0; i < count && !supported; i++) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        supported = name && strcmp(name, "GL_EXT_disjoint_timer_query") == 0;
+    }
+    if(!supported) {
+        LOGI("SANJU : GpuTimer : GL_EXT_disjoint_timer_query unavailable, GPU times won't be measured");
+        return false;
+    }
+
+    /* On ES 3 the extension makes the core query entry points accept GL_TIME_ELAPSED_EXT */
+    glGenQueries(kQueryCount, mQueries);
+    for(bool& pending : mPending) pending = false;
+    mNext = 0;
+    mActive = false;
+
+    /* Clears a disjoint event left over from before, it would discard the first results */
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    return true;
+}
+
+void GpuTimer::destroy() {
+    if(!isAvailable() || eglGetCurrentContext() == EGL_NO_CONTEXT) return;
+    glDeleteQueries(kQueryCount, mQueries);
+    memset(mQueries, 0, sizeof(mQueries));
+    mActive = false;
+}
+
+void GpuTimer::begin() {
+    /* The GPU is a whole ring behind, skip this range instead of waiting for the slot */
+    if(!isAvailable() || mPending[mNext]) return;
+    glBeginQuery(GL_TIME_ELAPSED_EXT, mQueries[mNext]);
+    mActive = true;
+}
+
+double GpuTimer::end() {
+    if(!isAvailable()) return -1.0;
+
+    if(mActive) {
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+        mPending[mNext] = true;
+        mNext = (mNext + 1) % kQueryCount;
+        mActive = false;
+    }
+
+    /* Results become available in submission order, oldest slot first */
+    GLuint latestNs = 0;
+    bool found = false;
+    for(int i = 0; i < kQueryCount; i++) {
+        int slot = (mNext + i) % kQueryCount;
+        if(!mPending[slot]) continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(mQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) break;
+
+        /* 32 bits of nanoseconds are 4 s, plenty for one pass */
+        glGetQueryObjectuiv(mQueries[slot], GL_QUERY_RESULT, &latestNs);
+        mPending[slot] = false;
+        found = true;
+    }
+
+    /* A disjoint event (frequency change, context loss...) makes the finished results meaningless */
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if(!found || disjoint) return -1.0;
+    return (double)latestNs / 1.0e6;
+}
@@ -0,0 +1,40 @@
+#ifndef BUILDING_AR_GPU_TIMER_H
+#define BUILDING_AR_GPU_TIMER_H
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#define LOG_TAG "GpuTimer"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * GPU time of a range of GL commands, through GL_EXT_disjoint_timer_query.
+ *
+ * Queries are read back a few frames later so the render thread never stalls on them : end()
+ * returns the most recent finished measurement, or -1 while there is none yet. Does nothing
+ * on drivers without the extension. All calls on the GL thread, with the context current.
+ */
+class GpuTimer {
+public:
+    static constexpr int kQueryCount = 4;
+
+    ~GpuTimer() { destroy(); }
+
+    /* Once per GL context. False when the extension is missing, begin()/end() are then no-ops */
+    bool create();
+    void destroy();
+    bool isAvailable() const { return mQueries[0] != 0; }
+
+    void begin();
+    /* Milliseconds of the latest finished range, -1 when nothing new is available */
+    double end();
+
+private:
+    GLuint mQueries[kQueryCount] = {0};
+    bool mPending[kQueryCount] = {false};
+    int mNext = 0;
+    bool mActive = false;
+};
+
+#endif //BUILDING_AR_GPU_TIMER_H
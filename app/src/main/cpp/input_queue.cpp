@@ -0,0 +1,48 @@
+#include <input_queue.h>
+
+bool InputQueue::push(CommandType type, float x, float y, float z, int64_t timeNs) {
+    Command command;
+    command.type = type;
+    command.x = x;
+    command.y = y;
+    command.z = z;
+    command.timeNs = timeNs;
+    return mCommands.push(std::move(command));
+}
+
+bool InputQueue::pop(Command &out) {
+    if(!mHasPeeked && !mCommands.pop(mPeeked)) return false;
+    out = mPeeked;
+    mHasPeeked = false;
+    if(out.type != COMMAND_TRANSLATE && out.type != COMMAND_DRAG_MOVE) return true;
+
+    while(mCommands.pop(mPeeked)) {
+        if(mPeeked.type != out.type) {
+            mHasPeeked = true;
+            break;
+        }
+        if(out.type == COMMAND_DRAG_MOVE) {
+            /* Drag positions are absolute, the newest one is where the model goes */
+            out = mPeeked;
+        } else {
+            /* The steps are projected onto the plane with the same view, their sum moves the model the same */
+            out.x += mPeeked.x;
+            out.y += mPeeked.y;
+            out.z += mPeeked.z;
+        }
+    }
+    return true;
+}
+
+InputQueue::Gestures InputQueue::takeGestures() {
+    Gestures gestures;
+    gestures.rotateDegrees = mRotateDegrees.exchange(0.0f, std::memory_order_acq_rel);
+    gestures.scale = mScale.exchange(0.0f, std::memory_order_acq_rel);
+    return gestures;
+}
+
+void InputQueue::Accumulate(std::atomic<float> &total, float delta) {
+    /* No fetch_add for floats before C++20. Only the GL thread's exchange can make it retry */
+    float current = total.load(std::memory_order_relaxed);
+    while(!total.compare_exchange_weak(current, current + delta, std::memory_order_acq_rel, std::memory_order_relaxed)) {}
+}
@@ -0,0 +1,71 @@
+#ifndef BUILDING_AR_INPUT_QUEUE_H
+#define BUILDING_AR_INPUT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "spsc_queue.h"
+
+/*
+ * Carries touch and gesture input from the UI thread to the GL thread, which owns everything
+ * input changes : the model pose, and the ArFrame hit tests have to run against.
+ *
+ * Discrete commands (taps, long presses, translation steps, drags) go through an SpscQueue and are applied in
+ * order. Runs of translation steps come out summed and runs of drag moves as the newest only.
+ * Continuous gestures (rotate, scale) only add into an accumulator, so a fast gesture never
+ * fills the queue and the GL thread applies one combined step per frame. Neither side ever
+ * waits : a command that finds the queue full is dropped, the push says so.
+ */
+class InputQueue {
+public:
+    enum CommandType { COMMAND_TAP, COMMAND_PICK, COMMAND_TRANSLATE, COMMAND_DRAG_START, COMMAND_DRAG_MOVE, COMMAND_DRAG_END };
+
+    struct Command {
+        CommandType type = COMMAND_TAP;
+        /* Screen position of a tap, pick or drag, or the camera space step of a translation */
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        /* Drags : CLOCK_MONOTONIC time of the touch event, for the touch to motion latency */
+        int64_t timeNs = 0;
+    };
+
+    /* Rotate and scale input since the previous takeGestures() */
+    struct Gestures {
+        float rotateDegrees = 0.0f;
+        float scale = 0.0f;
+    };
+
+    static constexpr size_t kCapacity = 64;
+
+    /* UI thread, the only producer. False when the queue was full and the command dropped */
+    bool pushTap(float x, float y) { return push(COMMAND_TAP, x, y, 0.0f, 0); }
+    bool pushPick(float x, float y) { return push(COMMAND_PICK, x, y, 0.0f, 0); }
+    bool pushTranslate(float x, float y, float z) { return push(COMMAND_TRANSLATE, x, y, z, 0); }
+    /* type is one of the COMMAND_DRAG_* */
+    bool pushDrag(CommandType type, float x, float y, int64_t timeNs) { return push(type, x, y, 0.0f, timeNs); }
+    /* UI thread */
+    void addRotate(float degrees) { Accumulate(mRotateDegrees, degrees); }
+    void addScale(float scale) { Accumulate(mScale, scale); }
+
+    /* GL thread, the only consumer. The next command in order, back to back translations come
+     * out summed as one and back to back drag moves as the newest */
+    bool pop(Command& out);
+    /* GL thread. Hands over the accumulated gestures and starts again from zero */
+    Gestures takeGestures();
+
+private:
+    bool push(CommandType type, float x, float y, float z, int64_t timeNs);
+    static void Accumulate(std::atomic<float>& total, float delta);
+
+    SpscQueue<Command, kCapacity> mCommands;
+    /* GL thread. Popped while merging a run but not part of it, returned next */
+    Command mPeeked;
+    bool mHasPeeked = false;
+
+    std::atomic<float> mRotateDegrees{0.0f};
+    std::atomic<float> mScale{0.0f};
+};
+
+#endif //BUILDING_AR_INPUT_QUEUE_H
@@ -0,0 +1,199 @@
+#include <job_system.h>
+
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+namespace {
+
+/* Index of the worker running on this thread, -1 on any other thread */
+thread_local int tWorkerIndex = -1;
+
+constexpr int kMaxWorkers = 4;
+/* A waiting worker that found nothing to steal this many times in a row blocks on the job */
+constexpr int kFailedStealsBeforeBlocking = 64;
+
+}
+
+JobSystem& JobSystem::instance() {
+    static JobSystem system;
+    return system;
+}
+
+std::vector<std::pair<int, long>> JobSystem::ReadMaxFrequencies() {
+    int cpuCount = (int)std::thread::hardware_concurrency();
+    std::vector<std::pair<int, long>> frequencies;
+    for(int cpu = 0; cpu < cpuCount; cpu++) {
+        std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq");
+        long frequency = 0;
+        if(!(file >> frequency)) continue;
+        frequencies.emplace_back(cpu, frequency);
+    }
+    return frequencies;
+}
+
+std::vector<int> JobSystem::BigCores(const std::vector<std::pair<int, long>> &maxFrequencies) {
+    if(maxFrequencies.empty()) return {};
+    long minFrequency = maxFrequencies[0].second;
+    for(const auto& entry : maxFrequencies) minFrequency = std::min(minFrequency, entry.second);
+
+    /* 1+3+4 SoCs : the lone prime core and the 3 big ones, not the prime core alone */
+    std::vector<int> cores;
+    for(const auto& entry : maxFrequencies) {
+        if(entry.second > minFrequency) cores.push_back(entry.first);
+    }
+    if(cores.empty()) {
+        for(const auto& entry : maxFrequencies) cores.push_back(entry.first);
+    }
+    return cores;
+}
+
+JobSystem::JobSystem() {
+    mBigCores = BigCores(ReadMaxFrequencies());
+
+    /* Stable worker count : the big cores, or half of all cores when cpufreq is not available.
+     * Never less than 2, a single worker would make the pool serial and leave wait() nothing to steal */
+    int count = !mBigCores.empty() ? (int)mBigCores.size() : (int)std::thread::hardware_concurrency() / 2;
+    count = std::max(2, std::min(count, kMaxWorkers));
+    /* Two workers pinned to one core would only take turns on the core the render thread wants */
+    if(mBigCores.size() < 2) mBigCores.clear();
+
+    for(int i = 0; i < count; i++) {
+        mWorkers.push_back(std::make_unique<Worker>());
+    }
+    for(int i = 0; i < count; i++) {
+        mWorkers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+    }
+    LOGI("SANJU : JobSystem started %d workers, %zu big cores", count, mBigCores.size());
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mQuit.store(true, std::memory_order_release);
+    }
+    mSleepCv.notify_all();
+    for(auto& worker : mWorkers) {
+        if(worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+JobHandle JobSystem::submit(JobPriority priority, const CancelToken &token, Job job) {
+    JobHandle handle;
+    handle.mState = std::make_shared<JobHandle::State>();
+
+    /* Jobs spawned by a job stay on their worker (cache warm), others are spread round robin */
+    int index = tWorkerIndex >= 0 ? tWorkerIndex
+                                  : (int)(mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkers.size());
+    {
+        std::lock_guard<std::mutex> lock(mWorkers[index]->mutex);
+        mWorkers[index]->queues[priority].push_back(Task{std::move(job), token, handle.mState});
+    }
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mPending.fetch_add(1, std::memory_order_release);
+    }
+    mSleepCv.notify_one();
+    return handle;
+}
+
+bool JobSystem::tryPop(int index, Task &out) {
+    int count = (int)mWorkers.size();
+    for(int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        /* Own queue first, newest job */
+        if(index >= 0) {
+            Worker& own = *mWorkers[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if(!own.queues[priority].empty()) {
+                out = std::move(own.queues[priority].back());
+                own.queues[priority].pop_back();
+                return true;
+            }
+        }
+        /* Then steal the oldest job of the same priority */
+        for(int offset = 1; offset <= count; offset++) {
+            int victim = ((index < 0 ? 0 : index) + offset) % count;
+            if(victim == index) continue;
+            Worker& other = *mWorkers[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if(!other.queues[priority].empty()) {
+                out = std::move(other.queues[priority].front());
+                other.queues[priority].pop_front();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Task &task) {
+    mPending.fetch_sub(1, std::memory_order_acq_rel);
+
+    /* Cancelled before it started, don't even run it */
+    if(!task.token.isCancelled()) {
+        try {
+            task.job(task.token);
+        } catch(...) {
+            LOGE("NAT_ERROR : JobSystem : job threw an exception");
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(task.state->mutex);
+        task.state->done.store(true, std::memory_order_release);
+    }
+    task.state->cv.notify_all();
+}
+
+void JobSystem::workerLoop(int index) {
+    tWorkerIndex = index;
+
+    if(!mBigCores.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : mBigCores) CPU_SET(cpu, &set);
+        /* Pin to the big cluster as a whole, the scheduler still balances within it */
+        if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+            LOGE("NAT_ERROR : JobSystem : sched_setaffinity failed for worker %d", index);
+        }
+    }
+
+    while(!mQuit.load(std::memory_order_acquire)) {
+        Task task;
+        if(tryPop(index, task)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mSleepCv.wait(lock, [this] {
+            return mQuit.load(std::memory_order_acquire) || mPending.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+
+void JobSystem::wait(const JobHandle &handle) {
+    if(!handle.mState) return;
+
+    /* A worker waiting on another job helps out instead, so nested waits can't deadlock the pool.
+     * With every queue empty the job has been popped and runs on another worker : rather than
+     * spin on its core until it finishes, block like any other thread */
+    if(tWorkerIndex >= 0) {
+        int failedSteals = 0;
+        while(!handle.isDone() && failedSteals < kFailedStealsBeforeBlocking) {
+            Task task;
+            if(tryPop(tWorkerIndex, task)) {
+                execute(task);
+                failedSteals = 0;
+            } else {
+                failedSteals++;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(handle.mState->mutex);
+    handle.mState->cv.wait(lock, [&] { return handle.mState->done.load(std::memory_order_acquire); });
+}
@@ -0,0 +1,120 @@
+#ifndef BUILDING_AR_JOB_SYSTEM_H
+#define BUILDING_AR_JOB_SYSTEM_H
+
+#include <android/log.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define LOG_TAG "JobSystem"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/* Lower value runs first. Anything that gets a model on screen beats background conversion */
+enum JobPriority {
+    PRIORITY_PARSE,         // Model parsing (Assimp / GLB reader)
+    PRIORITY_DECODE,        // Texture image decoding
+    PRIORITY_MIPGEN,        // Mip chain generation
+    PRIORITY_PICKING,       // Picking BVH of a loaded model
+    PRIORITY_CONVERSION,    // Asset conversion to GLB, batch work
+    PRIORITY_COUNT
+};
+
+/* Shared cancellation flag. Jobs poll isCancelled() at checkpoints, queued jobs are skipped */
+class CancelToken {
+public:
+    CancelToken() : mFlag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { mFlag->store(true, std::memory_order_release); }
+    bool isCancelled() const { return mFlag->load(std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> mFlag;
+};
+
+/* Completion of one submitted job */
+class JobHandle {
+public:
+    bool isValid() const { return mState != nullptr; }
+    bool isDone() const { return !mState || mState->done.load(std::memory_order_acquire); }
+
+private:
+    friend class JobSystem;
+    struct State {
+        std::atomic<bool> done{false};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    std::shared_ptr<State> mState;
+};
+
+/*
+ * Fixed pool of worker threads with one queue per priority per worker. Workers take their own
+ * newest job first and steal the oldest job of another worker when they run dry, always
+ * looking at higher priorities first.
+ *
+ * The worker count is decided once from the big cores of the SoC (every cluster but the one
+ * with the lowest cpuinfo_max_freq), at least 2, and the workers are pinned to them so decoding
+ * never competes with the render thread for a little core.
+ */
+class JobSystem {
+public:
+    using Job = std::function<void(const CancelToken&)>;
+
+    static JobSystem& instance();
+
+    JobHandle submit(JobPriority priority, const CancelToken& token, Job job);
+    JobHandle submit(JobPriority priority, Job job) { return submit(priority, CancelToken(), std::move(job)); }
+
+    /* Blocks until the job ran or was skipped. On a worker thread it runs other jobs meanwhile,
+     * and only blocks once there is nothing left to steal */
+    void wait(const JobHandle& handle);
+
+    int workerCount() const { return (int)mWorkers.size(); }
+
+    /* Cores outside the lowest frequency cluster, given (cpu, cpuinfo_max_freq) pairs. A prime
+     * core counts with the rest of the big ones. All of them when every core runs as fast */
+    static std::vector<int> BigCores(const std::vector<std::pair<int, long>>& maxFrequencies);
+
+    ~JobSystem();
+
+private:
+    JobSystem();
+
+    struct Task {
+        Job job;
+        CancelToken token;
+        std::shared_ptr<JobHandle::State> state;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> queues[PRIORITY_COUNT];
+        std::thread thread;
+    };
+
+    void workerLoop(int index);
+    bool tryPop(int index, Task& out);
+    void execute(Task& task);
+
+    /* Empty if cpufreq isn't readable */
+    static std::vector<std::pair<int, long>> ReadMaxFrequencies();
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::vector<int> mBigCores;
+    std::atomic<uint32_t> mNextWorker{0};
+
+    /* Sleeping workers wait for mPending to become non zero */
+    std::atomic<int> mPending{0};
+    std::mutex mSleepMutex;
+    std::condition_variable mSleepCv;
+    std::atomic<bool> mQuit{false};
+};
+
+#endif //BUILDING_AR_JOB_SYSTEM_H
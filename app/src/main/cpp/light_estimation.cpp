@@ -0,0 +1,113 @@
+#include <frame_stats.h>
+#include <light_estimation.h>
+
+#include <EGL/egl.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+/* Cosine lobe convolution and SH basis normalization per coefficient, so the shader evaluates
+ * irradiance as a plain weighted sum of the basis polynomials */
+const float kSphericalHarmonicFactors[9] = {
+        0.282095f, -0.325735f, 0.325735f, -0.325735f, 0.273137f, -0.273137f, 0.078848f, -0.273137f, 0.136569f
+};
+
+}
+
+bool LightEstimation::Capture(ArSession *session, ArFrame *frame, LightEstimate &out) {
+    ArLightEstimate* light_estimate = nullptr;
+    ArLightEstimate_create(session, &light_estimate);
+    ArFrame_getLightEstimate(session, frame, light_estimate);
+
+    /* An invalid estimate keeps the last good one, the lighting shouldn't flicker back to defaults */
+    ArLightEstimateState state = AR_LIGHT_ESTIMATE_STATE_NOT_VALID;
+    ArLightEstimate_getState(session, light_estimate, &state);
+    if(state == AR_LIGHT_ESTIMATE_STATE_VALID) {
+        int64_t timestamp = 0;
+        ArLightEstimate_getTimestamp(session, light_estimate, &timestamp);
+        if(timestamp != out.timestamp_ns) {
+            ArLightEstimate_getEnvironmentalHdrMainLightDirection(session, light_estimate, out.mainLightDirection);
+            ArLightEstimate_getEnvironmentalHdrMainLightIntensity(session, light_estimate, out.mainLightIntensity);
+            ArLightEstimate_getEnvironmentalHdrAmbientSphericalHarmonics(session, light_estimate, out.sphericalHarmonics);
+            out.timestamp_ns = timestamp;
+        }
+    }
+    ArLightEstimate_destroy(light_estimate);
+    return out.timestamp_ns != 0;
+}
+
+bool LightEstimation::create() {
+    /* A new surface comes with a new context, the buffer of the previous one is already gone */
+    mBuffer = 0;
+    mUploadedTimestamp = 0;
+
+    Block block;
+    FillBlock(LightEstimate(), block);
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return mBuffer != 0;
+}
+
+void LightEstimation::destroy() {
+    if(mBuffer && eglGetCurrentContext() != EGL_NO_CONTEXT) glDeleteBuffers(1, &mBuffer);
+    mBuffer = 0;
+    mUploadedTimestamp = 0;
+}
+
+void LightEstimation::Attach(GLuint program) {
+    GLuint index = glGetUniformBlockIndex(program, "Lighting");
+    if(index == GL_INVALID_INDEX) {
+        LOGE("NAT_ERROR : LightEstimation : program %u has no Lighting block", program);
+        return;
+    }
+    glUniformBlockBinding(program, index, kBindingPoint);
+}
+
+bool LightEstimation::update(const LightEstimate &estimate) {
+    if(!mBuffer) return false;
+
+    bool rewritten = false;
+    if(estimate.timestamp_ns != 0 && estimate.timestamp_ns != mUploadedTimestamp) {
+        Block block;
+        FillBlock(estimate, block);
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        mUploadedTimestamp = estimate.timestamp_ns;
+        rewritten = true;
+        FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS);
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, kBindingPoint, mBuffer);
+    return rewritten;
+}
+
+void LightEstimation::FillBlock(const LightEstimate &estimate, Block &block) {
+    memset(&block, 0, sizeof(block));
+
+    if(estimate.timestamp_ns == 0) {
+        /* No estimate yet : a white light from above and to the side over a flat 0.7 ambient */
+        const float component = 1.0f / std::sqrt(3.0f);
+        for(int i = 0; i < 3; i++) {
+            block.mainLightDirection[i] = component;
+            block.mainLightIntensity[i] = 0.3f;
+            block.sphericalHarmonics[0][i] = 0.7f;
+        }
+        return;
+    }
+
+    for(int i = 0; i < 3; i++) {
+        block.mainLightDirection[i] = estimate.mainLightDirection[i];
+        block.mainLightIntensity[i] = estimate.mainLightIntensity[i];
+    }
+    for(int coefficient = 0; coefficient < 9; coefficient++) {
+        for(int channel = 0; channel < 3; channel++) {
+            block.sphericalHarmonics[coefficient][channel] =
+                    estimate.sphericalHarmonics[coefficient * 3 + channel] * kSphericalHarmonicFactors[coefficient];
+        }
+    }
+}
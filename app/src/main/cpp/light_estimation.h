@@ -0,0 +1,63 @@
+#ifndef BUILDING_AR_LIGHT_ESTIMATION_H
+#define BUILDING_AR_LIGHT_ESTIMATION_H
+
+#include "arcore_c_api.h"
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include <cstdint>
+
+#define LOG_TAG "LightEstimation"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/* ARCore environmental HDR light estimate of one frame, world space */
+struct LightEstimate {
+    int64_t timestamp_ns = 0;       // 0 while ARCore has no valid estimate
+    float mainLightDirection[3] = {0.0f, 1.0f, 0.0f};   // Towards the light
+    float mainLightIntensity[3] = {0.0f, 0.0f, 0.0f};
+    float sphericalHarmonics[27] = {0};                 // 9 rgb coefficients
+};
+
+/*
+ * Feeds the light estimate to the model shader through the "Lighting" uniform block.
+ *
+ * The block is rewritten only when ARCore hands out an estimate with a new timestamp, binding it
+ * is one glBindBufferBase per frame, so the cost doesn't depend on how many meshes are drawn.
+ * Until the first estimate arrives the block holds a fixed light close to the old hardcoded one.
+ */
+class LightEstimation {
+public:
+    /* Uniform buffer binding point of the block, shared by every program that declares it */
+    static constexpr GLuint kBindingPoint = 0;
+
+    /* Tracking side. Copies the frame's estimate into out unless out already holds it */
+    static bool Capture(ArSession* session, ArFrame* frame, LightEstimate& out);
+
+    /* Render side, GL thread. create() once per GL context */
+    ~LightEstimation() { destroy(); }
+    bool create();
+    void destroy();
+    /* Points the program's "Lighting" block at kBindingPoint, once after linking */
+    static void Attach(GLuint program);
+
+    /* Rewrites the block if estimate is newer, then binds it. Returns true if it was rewritten */
+    bool update(const LightEstimate& estimate);
+
+private:
+    /* std140 layout of the block in model.frag */
+    struct Block {
+        float mainLightDirection[4];    // xyz, w unused
+        float mainLightIntensity[4];    // rgb
+        float sphericalHarmonics[9][4]; // rgb, premultiplied for irradiance
+    };
+    static_assert(sizeof(Block) == 176, "Block must match the std140 layout of Lighting");
+
+    GLuint mBuffer = 0;
+    int64_t mUploadedTimestamp = 0;
+
+    static void FillBlock(const LightEstimate& estimate, Block& block);
+};
+
+#endif //BUILDING_AR_LIGHT_ESTIMATION_H
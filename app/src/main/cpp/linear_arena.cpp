@@ -0,0 +1,68 @@
+#include <linear_arena.h>
+
+#include <cstdlib>
+
+namespace {
+
+uint8_t* AlignUp(uint8_t* pointer, size_t alignment) {
+    uintptr_t value = reinterpret_cast<uintptr_t>(pointer);
+    return reinterpret_cast<uint8_t*>((value + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+}
+
+std::atomic<size_t>& LinearArena::HeapAllocations() {
+    static std::atomic<size_t> count{0};
+    return count;
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment) {
+    mStats.allocations++;
+    mStats.bytes += size;
+
+    uint8_t* start = mCursor ? AlignUp(mCursor, alignment) : nullptr;
+    if(start && size <= (size_t)(mEnd - start)) {
+        mCursor = start + size;
+        return start;
+    }
+    return allocateBlock(size, alignment);
+}
+
+/* Big requests get a block of their own so the current block keeps serving small ones */
+void* LinearArena::allocateBlock(size_t size, size_t alignment) {
+    bool dedicated = size > mBlockSize / 4;
+    size_t payload = dedicated ? size + alignment : mBlockSize;
+    size_t total = sizeof(Block) + payload;
+
+    Block* block = static_cast<Block*>(malloc(total));
+    if(!block) throw std::bad_alloc();
+    mStats.blocks++;
+    mStats.blockBytes += total;
+
+    uint8_t* begin = reinterpret_cast<uint8_t*>(block + 1);
+    uint8_t* end = reinterpret_cast<uint8_t*>(block) + total;
+    uint8_t* start = AlignUp(begin, alignment);
+    block->size = total;
+
+    if(dedicated && mHead) {
+        /* Linked behind the current block, which stays the bump target */
+        block->next = mHead->next;
+        mHead->next = block;
+        return start;
+    }
+    block->next = mHead;
+    mHead = block;
+    mCursor = start + size;
+    mEnd = end;
+    return start;
+}
+
+void LinearArena::release() {
+    while(mHead) {
+        Block* next = mHead->next;
+        free(mHead);
+        mHead = next;
+    }
+    mCursor = nullptr;
+    mEnd = nullptr;
+}
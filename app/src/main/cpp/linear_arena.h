@@ -0,0 +1,94 @@
+#ifndef BUILDING_AR_LINEAR_ARENA_H
+#define BUILDING_AR_LINEAR_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/*
+ * Monotonic arena for the scratch data of one load. Allocation bumps a pointer inside large
+ * blocks, deallocation does nothing and everything is freed at once when the arena goes away.
+ *
+ * Not thread safe : one thread allocates at a time (the load job). Memory handed out may be
+ * freed from any thread, since freeing is a no-op. Vectors that grow by doubling leave their
+ * old buffers behind, so reserve() what is known up front.
+ */
+class LinearArena {
+public:
+    struct Stats {
+        size_t allocations = 0;
+        size_t bytes = 0;           // Requested
+        size_t blocks = 0;          // malloc calls behind them
+        size_t blockBytes = 0;
+    };
+
+    explicit LinearArena(size_t blockSize = 256 * 1024) : mBlockSize(blockSize) {}
+    ~LinearArena() { release(); }
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+    /* Frees every block, all memory handed out becomes invalid */
+    void release();
+    const Stats& stats() const { return mStats; }
+
+    /* Heap allocations made by arena-less ArenaAllocators, since process start */
+    static std::atomic<size_t>& HeapAllocations();
+
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    size_t mBlockSize;
+    Block* mHead = nullptr;
+    uint8_t* mCursor = nullptr;
+    uint8_t* mEnd = nullptr;
+    Stats mStats;
+
+    void* allocateBlock(size_t size, size_t alignment);
+};
+
+/*
+ * Standard allocator over a LinearArena, or over the heap when it has none (a default constructed
+ * one), so containers can mix both. Heap allocations made through it are counted, which is what
+ * the arena is measured against.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() = default;
+    explicit ArenaAllocator(LinearArena* arena) : mArena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.arena()) {}
+
+    T* allocate(size_t count) {
+        if(mArena) return static_cast<T*>(mArena->allocate(count * sizeof(T), alignof(T)));
+        LinearArena::HeapAllocations().fetch_add(1, std::memory_order_relaxed);
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        if(!mArena) ::operator delete(pointer);
+    }
+
+    LinearArena* arena() const { return mArena; }
+
+private:
+    LinearArena* mArena = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() == b.arena(); }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() != b.arena(); }
+
+#endif //BUILDING_AR_LINEAR_ARENA_H
@@ -0,0 +1,411 @@
+#include <mesh_bvh.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+/* BUILDINGAR_BVH_SCALAR forces the plain lanes, which the host tests check next to the vector ones */
+#if defined(__ARM_NEON) && !defined(BUILDINGAR_BVH_SCALAR)
+#define BVH_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) && !defined(BUILDINGAR_BVH_SCALAR)
+#define BVH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/* Checked for cancellation every this many nodes */
+constexpr uint32_t kCancelCheckNodes = 1024;
+/* Ray-triangle determinant under which the ray counts as parallel to the triangle */
+constexpr float kParallelEpsilon = 1e-12f;
+
+/* 4 lanes of floats and lane masks, the only operations the packet test needs */
+#if defined(BVH_NEON)
+typedef float32x4_t F4;
+typedef uint32x4_t M4;
+inline F4 Load4(const float* p) { return vld1q_f32(p); }
+inline F4 Splat4(float x) { return vdupq_n_f32(x); }
+inline F4 Add4(F4 a, F4 b) { return vaddq_f32(a, b); }
+inline F4 Sub4(F4 a, F4 b) { return vsubq_f32(a, b); }
+inline F4 Mul4(F4 a, F4 b) { return vmulq_f32(a, b); }
+inline F4 Abs4(F4 a) { return vabsq_f32(a); }
+inline F4 Div4(F4 a, F4 b) {
+#if defined(__aarch64__)
+    return vdivq_f32(a, b);
+#else
+    /* No divide on 32 bit NEON : estimate refined twice, close to a float division */
+    F4 r = vrecpeq_f32(b);
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    return vmulq_f32(a, r);
+#endif
+}
+inline M4 Gt4(F4 a, F4 b) { return vcgtq_f32(a, b); }
+inline M4 Ge4(F4 a, F4 b) { return vcgeq_f32(a, b); }
+inline M4 Lt4(F4 a, F4 b) { return vcltq_f32(a, b); }
+inline M4 Le4(F4 a, F4 b) { return vcleq_f32(a, b); }
+inline M4 And4(M4 a, M4 b) { return vandq_u32(a, b); }
+inline int Bits4(M4 m) {
+    uint32_t lanes[4];
+    vst1q_u32(lanes, m);
+    return (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+}
+inline void Store4(float* p, F4 a) { vst1q_f32(p, a); }
+#elif defined(BVH_SSE2)
+typedef __m128 F4;
+typedef __m128 M4;
+inline F4 Load4(const float* p) { return _mm_load_ps(p); }
+inline F4 Splat4(float x) { return _mm_set1_ps(x); }
+inline F4 Add4(F4 a, F4 b) { return _mm_add_ps(a, b); }
+inline F4 Sub4(F4 a, F4 b) { return _mm_sub_ps(a, b); }
+inline F4 Mul4(F4 a, F4 b) { return _mm_mul_ps(a, b); }
+inline F4 Abs4(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline F4 Div4(F4 a, F4 b) { return _mm_div_ps(a, b); }
+inline M4 Gt4(F4 a, F4 b) { return _mm_cmpgt_ps(a, b); }
+inline M4 Ge4(F4 a, F4 b) { return _mm_cmpge_ps(a, b); }
+inline M4 Lt4(F4 a, F4 b) { return _mm_cmplt_ps(a, b); }
+inline M4 Le4(F4 a, F4 b) { return _mm_cmple_ps(a, b); }
+inline M4 And4(M4 a, M4 b) { return _mm_and_ps(a, b); }
+inline int Bits4(M4 m) { return _mm_movemask_ps(m); }
+inline void Store4(float* p, F4 a) { _mm_storeu_ps(p, a); }
+#else
+struct F4 { float v[4]; };
+typedef int M4;
+inline F4 Load4(const float* p) { return F4{{p[0], p[1], p[2], p[3]}}; }
+inline F4 Splat4(float x) { return F4{{x, x, x, x}}; }
+#define BVH_LANES(expr) F4 r; for(int i = 0; i < 4; i++) r.v[i] = (expr); return r
+inline F4 Add4(F4 a, F4 b) { BVH_LANES(a.v[i] + b.v[i]); }
+inline F4 Sub4(F4 a, F4 b) { BVH_LANES(a.v[i] - b.v[i]); }
+inline F4 Mul4(F4 a, F4 b) { BVH_LANES(a.v[i] * b.v[i]); }
+inline F4 Div4(F4 a, F4 b) { BVH_LANES(a.v[i] / b.v[i]); }
+inline F4 Abs4(F4 a) { BVH_LANES(std::fabs(a.v[i])); }
+#undef BVH_LANES
+#define BVH_MASK(op) M4 m = 0; for(int i = 0; i < 4; i++) m |= (a.v[i] op b.v[i]) << i; return m
+inline M4 Gt4(F4 a, F4 b) { BVH_MASK(>); }
+inline M4 Ge4(F4 a, F4 b) { BVH_MASK(>=); }
+inline M4 Lt4(F4 a, F4 b) { BVH_MASK(<); }
+inline M4 Le4(F4 a, F4 b) { BVH_MASK(<=); }
+#undef BVH_MASK
+inline M4 And4(M4 a, M4 b) { return a & b; }
+inline int Bits4(M4 m) { return m; }
+inline void Store4(float* p, F4 a) { for(int i = 0; i < 4; i++) p[i] = a.v[i]; }
+#endif
+
+static_assert(MeshBvh::kLeafSize == 4, "The packet test is 4 lanes wide");
+
+}
+
+bool MeshBvh::build(const std::vector<Source> &sources, const CancelToken &token, int maxDepth) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    maxDepth = std::max(1, std::min(maxDepth, kMaxDepth));
+    mNodes.clear();
+    mPackets.clear();
+    mSourceFirst.clear();
+    mStats = Stats();
+
+    /* One ref per triangle, its bounds are all the split decisions look at */
+    std::vector<Ref> refs;
+    size_t total = 0;
+    for(const Source& source : sources) total += source.indexCount / 3;
+    refs.reserve(total);
+    /* Global triangle numbers count the left out triangles too, they map back to their source */
+    uint32_t first = 0;
+    for(const Source& source : sources) {
+        mSourceFirst.push_back(first);
+        size_t triangles = source.indexCount / 3;
+        for(size_t triangle = 0; triangle < triangles; triangle++) {
+            glm::vec3 corners[3];
+            if(!Corners(source, triangle, corners)) continue;
+            Ref ref;
+            ref.min = glm::min(corners[0], glm::min(corners[1], corners[2]));
+            ref.max = glm::max(corners[0], glm::max(corners[1], corners[2]));
+            ref.triangle = first + (uint32_t)triangle;
+            refs.push_back(ref);
+        }
+        first += (uint32_t)triangles;
+        if(token.isCancelled()) return false;
+    }
+    if(refs.empty()) return false;
+
+    /* The root's bounds, every other node gets its own from the split that made it */
+    Range root;
+    root.node = 0;
+    root.first = 0;
+    root.count = (uint32_t)refs.size();
+    root.depth = 1;
+    for(const Ref& ref : refs) {
+        root.bounds.grow(ref.min);
+        root.bounds.grow(ref.max);
+        root.centroids.grow((ref.min + ref.max) * 0.5f);
+    }
+
+    std::vector<Range> stack;
+    /* At most 2 x leaves - 1 nodes, and leaves mostly hold several triangles */
+    mNodes.reserve(refs.size() + 1);
+    mNodes.push_back(Node());
+    stack.push_back(root);
+
+    while(!stack.empty()) {
+        Range range = stack.back();
+        stack.pop_back();
+        if(mNodes.size() % kCancelCheckNodes == 0 && token.isCancelled()) return false;
+
+        Node& node = mNodes[range.node];
+        for(int axis = 0; axis < 3; axis++) {
+            node.min[axis] = range.bounds.min[axis];
+            node.max[axis] = range.bounds.max[axis];
+        }
+        mStats.depth = std::max(mStats.depth, range.depth);
+
+        Range left, right;
+        if(range.count <= (uint32_t)kLeafSize || range.depth >= maxDepth || !Split(refs, range, left, right)) {
+            /* Only reachable past kLeafSize at maxDepth, the extra triangles spill into more packets */
+            node.first = (uint32_t)mPackets.size();
+            node.count = range.count;
+            for(uint32_t packed = 0; packed < range.count; packed += kLeafSize) mPackets.push_back(Packet());
+            for(uint32_t i = 0; i < range.count; i++) {
+                uint32_t triangle = refs[range.first + i].triangle;
+                uint32_t source = (uint32_t)(std::upper_bound(mSourceFirst.begin(), mSourceFirst.end(), triangle) - mSourceFirst.begin()) - 1;
+                glm::vec3 corners[3];
+                Corners(sources[source], triangle - mSourceFirst[source], corners);
+                Packet& packet = mPackets[node.first + i / kLeafSize];
+                int lane = (int)(i % kLeafSize);
+                for(int axis = 0; axis < 3; axis++) {
+                    packet.v0[axis][lane] = corners[0][axis];
+                    packet.e1[axis][lane] = corners[1][axis] - corners[0][axis];
+                    packet.e2[axis][lane] = corners[2][axis] - corners[0][axis];
+                }
+                packet.triangle[lane] = triangle;
+            }
+            mStats.leaves++;
+            continue;
+        }
+
+        left.node = (uint32_t)mNodes.size();
+        right.node = left.node + 1;
+        left.depth = right.depth = range.depth + 1;
+        node.first = left.node;
+        node.count = 0;
+        /* node is dangling from here on */
+        mNodes.push_back(Node());
+        mNodes.push_back(Node());
+        stack.push_back(left);
+        stack.push_back(right);
+    }
+
+    mStats.triangles = refs.size();
+    mStats.nodes = mNodes.size();
+    mStats.bytes = mNodes.size() * sizeof(Node) + mPackets.size() * sizeof(Packet) + mSourceFirst.size() * sizeof(uint32_t);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    mStats.buildMs = elapsed.count();
+    return true;
+}
+
+bool MeshBvh::Split(std::vector<Ref> &refs, const Range &range, Range &left, Range &right) {
+    struct Bin {
+        Bounds bounds;
+        uint32_t count = 0;
+    };
+
+    /* Binned along the axis the centroids spread most on, the other two rarely split better */
+    const glm::vec3 base = range.centroids.min;
+    const glm::vec3 extent = range.centroids.max - range.centroids.min;
+    int axis = extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2) : (extent.y >= extent.z ? 1 : 2);
+    const float scale = extent[axis] > 0.0f ? kBinCount / extent[axis] : 0.0f;
+    Bin bins[kBinCount];
+    for(uint32_t i = range.first; i < range.first + range.count; i++) {
+        const Ref& ref = refs[i];
+        Bin& bin = bins[std::min(kBinCount - 1, (int)(((ref.min[axis] + ref.max[axis]) * 0.5f - base[axis]) * scale))];
+        bin.bounds.grow(ref.min);
+        bin.bounds.grow(ref.max);
+        bin.count++;
+    }
+
+    /* Cost of splitting after bin i : area x count of each side, swept from both ends */
+    float bestCost = std::numeric_limits<float>::max();
+    int bestBin = -1;
+    if(extent[axis] > 0.0f) {
+        float rightCost[kBinCount];
+        Bin sweep;
+        for(int bin = kBinCount - 1; bin > 0; bin--) {
+            sweep.bounds.grow(bins[bin].bounds);
+            sweep.count += bins[bin].count;
+            rightCost[bin - 1] = sweep.count ? HalfArea(sweep.bounds.min, sweep.bounds.max) * sweep.count : 0.0f;
+        }
+        sweep = Bin();
+        for(int bin = 0; bin < kBinCount - 1; bin++) {
+            sweep.bounds.grow(bins[bin].bounds);
+            sweep.count += bins[bin].count;
+            if(sweep.count == 0 || sweep.count == range.count) continue;
+            float cost = HalfArea(sweep.bounds.min, sweep.bounds.max) * sweep.count + rightCost[bin];
+            if(cost < bestCost) {
+                bestCost = cost;
+                bestBin = bin;
+            }
+        }
+    }
+
+    /* Both sides' centroid bounds come out of the partition, their bounds out of the bins */
+    Ref* begin = refs.data() + range.first;
+    Ref* end = begin + range.count;
+    Ref* middle;
+    left.bounds = Bounds();
+    left.centroids = Bounds();
+    right.bounds = Bounds();
+    right.centroids = Bounds();
+    if(bestBin < 0) {
+        /* All centroids in one spot, halves by count still keep leaves at kLeafSize */
+        middle = begin + range.count / 2;
+        for(Ref* ref = begin; ref < end; ref++) {
+            Range& side = ref < middle ? left : right;
+            side.bounds.grow(ref->min);
+            side.bounds.grow(ref->max);
+            side.centroids.grow((ref->min + ref->max) * 0.5f);
+        }
+    } else {
+        for(int bin = 0; bin < kBinCount; bin++) (bin <= bestBin ? left : right).bounds.grow(bins[bin].bounds);
+        Ref* low = begin;
+        Ref* high = end;
+        while(low < high) {
+            glm::vec3 centroid = (low->min + low->max) * 0.5f;
+            if(std::min(kBinCount - 1, (int)((centroid[axis] - base[axis]) * scale)) <= bestBin) {
+                left.centroids.grow(centroid);
+                low++;
+            } else {
+                right.centroids.grow(centroid);
+                std::swap(*low, *--high);
+            }
+        }
+        middle = low;
+    }
+
+    left.first = range.first;
+    left.count = (uint32_t)(middle - begin);
+    right.first = left.first + left.count;
+    right.count = range.count - left.count;
+    return left.count > 0 && right.count > 0;
+}
+
+float MeshBvh::HalfArea(const glm::vec3 &min, const glm::vec3 &max) {
+    glm::vec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool MeshBvh::Corners(const Source &source, size_t triangle, glm::vec3 *corners) {
+    for(int corner = 0; corner < 3; corner++) {
+        size_t at = triangle * 3 + corner;
+        size_t index = source.shortIndices ? reinterpret_cast<const uint16_t*>(source.indices)[at]
+                                           : reinterpret_cast<const uint32_t*>(source.indices)[at];
+        if(index >= source.vertexCount) return false;
+        const float* position = reinterpret_cast<const float*>(source.positions + index * source.stride);
+        corners[corner] = glm::vec3(position[0], position[1], position[2]);
+    }
+    return true;
+}
+
+bool MeshBvh::intersect(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Hit &hit) const {
+    if(mNodes.empty()) return false;
+
+    /* A zero component would make 0 x inf slabs, a huge inverse keeps the test ordered */
+    glm::vec3 inverse;
+    for(int axis = 0; axis < 3; axis++) {
+        float component = direction[axis];
+        inverse[axis] = std::fabs(component) > 1e-20f ? 1.0f / component : std::copysign(1e30f, component);
+    }
+
+    const F4 ox = Splat4(origin.x), oy = Splat4(origin.y), oz = Splat4(origin.z);
+    const F4 dx = Splat4(direction.x), dy = Splat4(direction.y), dz = Splat4(direction.z);
+    const F4 zero = Splat4(0.0f), one = Splat4(1.0f), epsilon = Splat4(kParallelEpsilon);
+
+    float best = maxDistance;
+    uint32_t bestTriangle = std::numeric_limits<uint32_t>::max();
+    float bestU = 0.0f, bestV = 0.0f;
+
+    /* Entry distance of a node's box, +inf when the ray misses it or it is beyond best */
+    auto enter = [&](const Node& node) {
+        float near = 0.0f, far = best;
+        for(int axis = 0; axis < 3; axis++) {
+            float t0 = (node.min[axis] - origin[axis]) * inverse[axis];
+            float t1 = (node.max[axis] - origin[axis]) * inverse[axis];
+            near = std::max(near, std::min(t0, t1));
+            far = std::min(far, std::max(t0, t1));
+        }
+        return near <= far ? near : std::numeric_limits<float>::infinity();
+    };
+
+    uint32_t stack[kMaxDepth * 2];
+    int top = 0;
+    if(enter(mNodes[0]) == std::numeric_limits<float>::infinity()) return false;
+    stack[top++] = 0;
+
+    while(top > 0) {
+        const Node& node = mNodes[stack[--top]];
+        if(node.count == 0) {
+            /* Nearer child on top, the farther one is often culled by then */
+            uint32_t near = node.first, far = node.first + 1;
+            float nearT = enter(mNodes[near]), farT = enter(mNodes[far]);
+            if(farT < nearT) {
+                std::swap(near, far);
+                std::swap(nearT, farT);
+            }
+            if(farT != std::numeric_limits<float>::infinity()) stack[top++] = far;
+            if(nearT != std::numeric_limits<float>::infinity()) stack[top++] = near;
+            continue;
+        }
+        /* Popped nodes were entered with an older best, recheck before the triangles */
+        if(enter(node) == std::numeric_limits<float>::infinity()) continue;
+
+        uint32_t packets = (node.count + kLeafSize - 1) / kLeafSize;
+        for(uint32_t p = 0; p < packets; p++) {
+            const Packet& packet = mPackets[node.first + p];
+            const F4 e1x = Load4(packet.e1[0]), e1y = Load4(packet.e1[1]), e1z = Load4(packet.e1[2]);
+            const F4 e2x = Load4(packet.e2[0]), e2y = Load4(packet.e2[1]), e2z = Load4(packet.e2[2]);
+
+            /* Moller-Trumbore, 4 triangles at once */
+            F4 px = Sub4(Mul4(dy, e2z), Mul4(dz, e2y));
+            F4 py = Sub4(Mul4(dz, e2x), Mul4(dx, e2z));
+            F4 pz = Sub4(Mul4(dx, e2y), Mul4(dy, e2x));
+            F4 det = Add4(Add4(Mul4(e1x, px), Mul4(e1y, py)), Mul4(e1z, pz));
+            F4 inverseDet = Div4(one, det);
+
+            F4 tx = Sub4(ox, Load4(packet.v0[0]));
+            F4 ty = Sub4(oy, Load4(packet.v0[1]));
+            F4 tz = Sub4(oz, Load4(packet.v0[2]));
+            F4 u = Mul4(Add4(Add4(Mul4(tx, px), Mul4(ty, py)), Mul4(tz, pz)), inverseDet);
+
+            F4 qx = Sub4(Mul4(ty, e1z), Mul4(tz, e1y));
+            F4 qy = Sub4(Mul4(tz, e1x), Mul4(tx, e1z));
+            F4 qz = Sub4(Mul4(tx, e1y), Mul4(ty, e1x));
+            F4 v = Mul4(Add4(Add4(Mul4(dx, qx), Mul4(dy, qy)), Mul4(dz, qz)), inverseDet);
+            F4 t = Mul4(Add4(Add4(Mul4(e2x, qx), Mul4(e2y, qy)), Mul4(e2z, qz)), inverseDet);
+
+            /* Degenerate padding lanes have det 0 and fail the first test (and NaN the others) */
+            M4 valid = And4(Gt4(Abs4(det), epsilon), And4(Ge4(u, zero), Ge4(v, zero)));
+            valid = And4(valid, And4(Le4(Add4(u, v), one), And4(Gt4(t, zero), Lt4(t, Splat4(best)))));
+            int lanes = Bits4(valid);
+            if(!lanes) continue;
+
+            float ts[4], us[4], vs[4];
+            Store4(ts, t);
+            Store4(us, u);
+            Store4(vs, v);
+            for(int lane = 0; lane < kLeafSize; lane++) {
+                if(!(lanes & (1 << lane)) || ts[lane] >= best) continue;
+                best = ts[lane];
+                bestTriangle = packet.triangle[lane];
+                bestU = us[lane];
+                bestV = vs[lane];
+            }
+        }
+    }
+
+    if(bestTriangle == std::numeric_limits<uint32_t>::max()) return false;
+    hit.source = (uint32_t)(std::upper_bound(mSourceFirst.begin(), mSourceFirst.end(), bestTriangle) - mSourceFirst.begin()) - 1;
+    hit.triangle = bestTriangle - mSourceFirst[hit.source];
+    hit.distance = best;
+    hit.u = bestU;
+    hit.v = bestV;
+    return true;
+}
@@ -0,0 +1,124 @@
+#ifndef BUILDING_AR_MESH_BVH_H
+#define BUILDING_AR_MESH_BVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <job_system.h>
+
+/*
+ * Bounding volume hierarchy over the triangles of a model, for picking on the CPU.
+ *
+ * Built top down with the surface area heuristic, evaluated over kBinCount centroid bins along
+ * the axis the node's centroids spread most on. A node of at most kLeafSize triangles becomes a leaf, and each leaf is a single packet
+ * laid out for a 4 wide ray-triangle test (NEON, SSE2, or scalar lanes otherwise).
+ *
+ * Only the packets are kept : the source vertices and indices can be freed once build() returns.
+ * That costs about 65 bytes per triangle with the nodes, and twice that while building.
+ */
+class MeshBvh {
+public:
+    static constexpr int kLeafSize = 4;
+    static constexpr int kBinCount = 16;
+    /* Sizes the traversal stack, enough for any tree a sane SAH build makes */
+    static constexpr int kMaxDepth = 64;
+
+    /* One indexed triangle list, positions are the first 3 floats of each vertex */
+    struct Source {
+        const uint8_t* positions = nullptr;
+        size_t stride = 0;
+        size_t vertexCount = 0;
+        /* uint32_t, or uint16_t with shortIndices */
+        const void* indices = nullptr;
+        bool shortIndices = false;
+        size_t indexCount = 0;
+    };
+
+    struct Hit {
+        /* Index into the build()'s sources, and of the triangle within it */
+        uint32_t source = 0;
+        uint32_t triangle = 0;
+        /* Along the ray direction, in its units */
+        float distance = 0.0f;
+        /* Barycentric coordinates of the hit point on the triangle */
+        float u = 0.0f;
+        float v = 0.0f;
+    };
+
+    struct Stats {
+        size_t triangles = 0;
+        size_t nodes = 0;
+        size_t leaves = 0;
+        int depth = 0;
+        double buildMs = 0.0;
+        size_t bytes = 0;
+    };
+
+    /* Any thread. False when cancelled or there is no triangle. Triangles with an index out of
+     * range are left out. Nodes at maxDepth (at most kMaxDepth) are leaves whatever their count */
+    bool build(const std::vector<Source>& sources, const CancelToken& token, int maxDepth = kMaxDepth);
+    bool isEmpty() const { return mNodes.empty(); }
+    const Stats& stats() const { return mStats; }
+
+    /* Any thread once built. Nearest triangle within maxDistance, both faces count */
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const;
+
+private:
+    /* Leaves : first is the packet, count its triangles. Inner nodes : first is the left child,
+     * the right one follows it */
+    struct Node {
+        float min[3];
+        uint32_t first;
+        float max[3];
+        uint32_t count;
+    };
+
+    /* Corner 0 and the two edges from it of kLeafSize triangles, lane by lane. Unused lanes are
+     * degenerate and never hit */
+    struct alignas(16) Packet {
+        float v0[3][kLeafSize];
+        float e1[3][kLeafSize];
+        float e2[3][kLeafSize];
+        uint32_t triangle[kLeafSize];
+    };
+
+    /* Build time only */
+    struct Ref {
+        glm::vec3 min;
+        glm::vec3 max;
+        uint32_t triangle;
+    };
+
+    struct Bounds {
+        glm::vec3 min = glm::vec3(3.4e38f);
+        glm::vec3 max = glm::vec3(-3.4e38f);
+
+        void grow(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+        void grow(const Bounds& other) { min = glm::min(min, other.min); max = glm::max(max, other.max); }
+    };
+
+    /* Node bounds and the bounds of its triangles' centroids, which the bins divide */
+    struct Range {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        int depth;
+        Bounds bounds;
+        Bounds centroids;
+    };
+
+    std::vector<Node> mNodes;
+    std::vector<Packet> mPackets;
+    /* First global triangle of each source, for Hit::source / Hit::triangle */
+    std::vector<uint32_t> mSourceFirst;
+    Stats mStats;
+
+    /* Splits the range's refs in place into left and right, false when it should stay a leaf */
+    static bool Split(std::vector<Ref>& refs, const Range& range, Range& left, Range& right);
+    static float HalfArea(const glm::vec3& min, const glm::vec3& max);
+    static bool Corners(const Source& source, size_t triangle, glm::vec3 corners[3]);
+};
+
+#endif //BUILDING_AR_MESH_BVH_H
@@ -76,6 +76,7 @@ void Model::processNode(aiNode *node, const aiScene *scene) {
     for(unsigned int i = 0; i < node->mNumMeshes; i++) {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
         meshes.push_back(processMesh(mesh, scene));
+        if(!retainCpuData) meshes.back().ReleaseCpuData();
     }
 
     /* Process children recursively */
@@ -165,7 +166,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
     }
 
-    return Mesh(vertices, indices, textures);
+    return Mesh(std::move(vertices), std::move(indices), std::move(textures));
 }
 
 std::vector<Texture> Model::loadMaterialTextures(const aiMaterial* mat,
@@ -244,12 +245,16 @@ GLuint Model::TextureFromFileOrEmbedded(const aiTexture* embedTexture) {
 
     if(data) {
         GLenum format = GL_RGBA;
-        if(channels == 1) format = GL_RED;
-        else if(channels == 3) format = GL_RGB;
-        else if(channels == 4) format = GL_RGBA;
-
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
-                     format, GL_UNSIGNED_BYTE, data);
+        GLenum internalFormat = GL_RGBA8;
+        if(channels == 1) { format = GL_RED; internalFormat = GL_R8; }
+        else if(channels == 3) { format = GL_RGB; internalFormat = GL_RGB8; }
+
+        /* Immutable storage for the full chain : the driver allocates it once, complete */
+        GLsizei levels = 1;
+        for(int size = width > height ? width : height; size > 1; size >>= 1) levels++;
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                        format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -264,20 +269,28 @@ GLuint Model::TextureFromFileOrEmbedded(const aiTexture* embedTexture) {
         }
     } else {
         LOGE("Failed to load embedded texture");
+        glDeleteTextures(1, &textureID);
         return createDefaultTexture();
     }
 
     return textureID;
 }
 
-Mesh::Mesh(const std::vector<Vertex>& vertices,
-           const std::vector<unsigned int>& indices,
-           const std::vector<Texture>& textures)
-        : vertices(vertices), indices(indices), textures(textures)
+Mesh::Mesh(std::vector<Vertex> vertices,
+           std::vector<unsigned int> indices,
+           std::vector<Texture> textures)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
 {
+    indexCount = static_cast<GLsizei>(this->indices.size());
     setupMesh();
 }
 
+void Mesh::ReleaseCpuData() {
+    /* swap, clear() would keep the capacity */
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+}
+
 void Mesh::setupMesh() {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -351,7 +364,7 @@ void Mesh::Draw(GLuint shaderProgram) {
 
     // Draw mesh
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()),
+    glDrawElements(GL_TRIANGLES, indexCount,
                    GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
 
@@ -38,22 +38,26 @@ struct Texture {
 
 class Mesh {
 public:
-    /* Mesh data */
+    /* Mesh data. Empty after ReleaseCpuData(), the GPU buffers are all that's drawn */
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    GLsizei indexCount = 0;
 
     /* OpenGL buffers */
     GLuint  VAO, VBO, EBO;
 
-    /* Constructor */
-    Mesh(const std::vector<Vertex>& vertices,
-         const std::vector<unsigned int>& indices,
-         const std::vector<Texture>& textures);
+    /* Constructor, uploads right away */
+    Mesh(std::vector<Vertex> vertices,
+         std::vector<unsigned int> indices,
+         std::vector<Texture> textures);
 
     /* Render the mesh */
     void Draw(GLuint shaderProgram);
 
+    /* Frees the vertex / index copies once they are uploaded */
+    void ReleaseCpuData();
+
     /* Cleanup OpenGL resources */
     void Cleanup();
 
@@ -70,6 +74,8 @@ public:
     void Cleanup();
     bool SetShaderProgram(GLuint program);
     const std::string& GetLastError() const { return lastError; }
+    /* Keep the meshes' vertices / indices after upload, for CPU side features like picking. Set before LoadFromFile() */
+    void SetRetainCpuData(bool retain) { retainCpuData = retain; }
 
 private:
 
@@ -78,6 +84,7 @@ private:
     std::vector<Texture> textures_loaded;
     GLuint shaderProgram = 0;
     std::string lastError;
+    bool retainCpuData = false;
 
     /* Assimp processing functions */
     void processNode(aiNode* node, const aiScene* scene);
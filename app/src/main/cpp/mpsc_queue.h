@@ -0,0 +1,56 @@
+#ifndef BUILDING_AR_MPSC_QUEUE_H
+#define BUILDING_AR_MPSC_QUEUE_H
+
+#include <atomic>
+#include <memory>
+
+/*
+ * Unbounded lock-free queue of heap nodes for any number of producer threads and one consumer
+ * thread. T carries the link itself, a `T* next` member, so pushing never allocates.
+ *
+ * Producers push onto a shared stack with one CAS and never wait for the consumer. The consumer
+ * takes the whole stack in one exchange and reverses it, so nodes come out in the order each
+ * producer pushed them. Nothing is recycled while producers can see it, so there is no ABA.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    ~MpscQueue() {
+        std::unique_ptr<T> node;
+        while(pop(node)) {}
+    }
+
+    /* Any thread. Never fails */
+    void push(std::unique_ptr<T> node) {
+        T* raw = node.release();
+        raw->next = mPushed.load(std::memory_order_relaxed);
+        while(!mPushed.compare_exchange_weak(raw->next, raw, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    /* Consumer side */
+    bool pop(std::unique_ptr<T>& out) {
+        if(!mTaken) {
+            T* pushed = mPushed.exchange(nullptr, std::memory_order_acquire);
+            /* Newest first on the stack, oldest first once reversed */
+            while(pushed) {
+                T* next = pushed->next;
+                pushed->next = mTaken;
+                mTaken = pushed;
+                pushed = next;
+            }
+            if(!mTaken) return false;
+        }
+        T* node = mTaken;
+        mTaken = node->next;
+        node->next = nullptr;
+        out.reset(node);
+        return true;
+    }
+
+private:
+    std::atomic<T*> mPushed{nullptr};
+    /* Consumer only, already in order */
+    T* mTaken = nullptr;
+};
+
+#endif //BUILDING_AR_MPSC_QUEUE_H
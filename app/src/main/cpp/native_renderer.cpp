@@ -20,6 +20,85 @@ Java_com_example_buildingar_ARNative_onCreate(JNIEnv *env, jobject thiz, jobject
     manager->Initialize(env, context, asset_manager);
 }
 
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_buildingar_ARNative_nativeStartRecording(JNIEnv *env, jobject thiz, jstring dataset_uri) {
+    if(!manager) return JNI_FALSE;
+    const char* uri = env->GetStringUTFChars(dataset_uri, nullptr);
+    bool success = manager->StartRecording(uri);
+    env->ReleaseStringUTFChars(dataset_uri, uri);
+    return success ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_buildingar_ARNative_nativeStopRecording(JNIEnv *env, jobject thiz) {
+    if(!manager) return JNI_FALSE;
+    return manager->StopRecording() ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_buildingar_ARNative_nativeSetPlaybackDataset(JNIEnv *env, jobject thiz, jstring dataset_uri) {
+    if(!manager) return JNI_FALSE;
+    const char* uri = env->GetStringUTFChars(dataset_uri, nullptr);
+    bool success = manager->SetPlaybackDataset(uri);
+    env->ReleaseStringUTFChars(dataset_uri, uri);
+    return success ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_nativeStartBenchmark(JNIEnv *env, jobject thiz, jstring report_path) {
+    if(!manager) return;
+    const char* path = env->GetStringUTFChars(report_path, nullptr);
+    manager->StartBenchmark(path);
+    env->ReleaseStringUTFChars(report_path, path);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_buildingar_ARNative_nativeStopBenchmark(JNIEnv *env, jobject thiz) {
+    if(!manager) return JNI_FALSE;
+    return manager->StopBenchmark() ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_buildingar_ARNative_nativeBenchmarkParsers(JNIEnv *env, jobject thiz, jstring model_path, jstring report_path) {
+    const char* modelPath = env->GetStringUTFChars(model_path, nullptr);
+    const char* reportPath = env->GetStringUTFChars(report_path, nullptr);
+    bool success = GLBModelAsync::BenchmarkParsers(modelPath, reportPath);
+    env->ReleaseStringUTFChars(model_path, modelPath);
+    env->ReleaseStringUTFChars(report_path, reportPath);
+    return success ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_buildingar_ARNative_nativeBenchmarkPicking(JNIEnv *env, jobject thiz, jstring model_path, jstring report_path) {
+    const char* modelPath = env->GetStringUTFChars(model_path, nullptr);
+    const char* reportPath = env->GetStringUTFChars(report_path, nullptr);
+    bool success = GLBModelAsync::BenchmarkPicking(modelPath, reportPath);
+    env->ReleaseStringUTFChars(model_path, modelPath);
+    env->ReleaseStringUTFChars(report_path, reportPath);
+    return success ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_nativeSetTrackingPipelineEnabled(JNIEnv *env, jobject thiz, jboolean enabled) {
+    if(!manager) return;
+    manager->SetTrackingPipelineEnabled(enabled == JNI_TRUE);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_nativeSetBackgroundUploadsEnabled(JNIEnv *env, jobject thiz, jboolean enabled) {
+    if(!manager) return;
+    manager->SetBackgroundUploadsEnabled(enabled == JNI_TRUE);
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_example_buildingar_ARNative_onResume(JNIEnv *env, jobject thiz, jobject activity) {
@@ -44,12 +123,38 @@ Java_com_example_buildingar_ARNative_onDrawFrame(JNIEnv *env, jobject thiz, jint
     manager->OnDrawFrame(width, height, display_rotation);
 }
 
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_buildingar_ARNative_nativeShouldRender(JNIEnv *env, jobject thiz, jlong frame_time_nanos) {
+    if(!manager) return JNI_FALSE;
+    return manager->ShouldRender(frame_time_nanos) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_nativeSetFrameRateCaps(JNIEnv *env, jobject thiz, jint max_fps, jint stationary_fps) {
+    if(manager) manager->SetFrameRateCaps(max_fps, stationary_fps);
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_example_buildingar_ARNative_onTouch(JNIEnv *env, jobject thiz, jfloat x, jfloat y) {
     manager->OnTouch(x, y);
 }
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_onLongPress(JNIEnv *env, jobject thiz, jfloat x, jfloat y) {
+    if(manager) manager->OnLongPress(x, y);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_nativeOnDrag(JNIEnv *env, jobject thiz, jint phase, jfloat x, jfloat y, jlong event_time_millis) {
+    /* MotionEvent times are uptimeMillis, i.e. CLOCK_MONOTONIC */
+    if(manager) manager->OnDrag(phase, x, y, (int64_t)event_time_millis * 1000000);
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_example_buildingar_ARNative_onRotateCube(JNIEnv *env, jobject thiz, jfloat degrees) {
@@ -85,6 +190,125 @@ Java_com_example_buildingar_ARNative_nativeConvertToGLB(JNIEnv *env, jobject thi
     return success ? JNI_TRUE : JNI_FALSE;
 }
 
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_example_buildingar_ARNative_nativeConvertCached(JNIEnv *env, jobject thiz, jstring input_path, jstring output_dir,
+                                                         jboolean packaged) {
+    if(!manager) return env->NewStringUTF("");
+    const char* inputPath = env->GetStringUTFChars(input_path, nullptr);
+    const char* outputDir = env->GetStringUTFChars(output_dir, nullptr);
+
+    std::string output = manager->GetConversionService().convertCached(inputPath, outputDir,
+            packaged ? ConversionService::OUTPUT_PACKAGE : ConversionService::OUTPUT_GLB);
+
+    env->ReleaseStringUTFChars(input_path, inputPath);
+    env->ReleaseStringUTFChars(output_dir, outputDir);
+    return env->NewStringUTF(output.c_str());
+}
+
+/* Global reference to a Kotlin listener, released by whichever thread drops the last copy */
+struct JavaListener {
+    JavaVM* vm = nullptr;
+    jobject ref = nullptr;
+    jmethodID method = nullptr;
+
+    ~JavaListener() {
+        JNIEnv* env = nullptr;
+        bool attached = false;
+        if(vm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_EDETACHED) {
+            if(vm->AttachCurrentThread(&env, nullptr) != JNI_OK) return;
+            attached = true;
+        }
+        env->DeleteGlobalRef(ref);
+        if(attached) vm->DetachCurrentThread();
+    }
+};
+
+/* Progress is reported on job system workers, which are attached to the VM only for the callback */
+static ConversionService::ProgressCallback MakeConversionCallback(JNIEnv *env, jobject listener) {
+    if(!listener) return nullptr;
+
+    std::shared_ptr<JavaListener> java_listener = std::make_shared<JavaListener>();
+    env->GetJavaVM(&java_listener->vm);
+    java_listener->ref = env->NewGlobalRef(listener);
+    jclass listener_class = env->GetObjectClass(listener);
+    java_listener->method = env->GetMethodID(listener_class, "onConversionProgress", "(Ljava/lang/String;Ljava/lang/String;II)V");
+
+    return [java_listener](const ConversionService::Progress& progress) {
+        JNIEnv* thread_env = nullptr;
+        if(java_listener->vm->AttachCurrentThread(&thread_env, nullptr) != JNI_OK) return;
+
+        jstring input = thread_env->NewStringUTF(progress.input.c_str());
+        jstring output = thread_env->NewStringUTF(progress.output.c_str());
+        thread_env->CallVoidMethod(java_listener->ref, java_listener->method, input, output, progress.done, progress.total);
+        thread_env->DeleteLocalRef(input);
+        thread_env->DeleteLocalRef(output);
+
+        java_listener->vm->DetachCurrentThread();
+    };
+}
+
+/* Picks are reported on the GL thread, a Java thread already : it is only attached here when it isn't */
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_nativeSetPickListener(JNIEnv *env, jobject thiz, jobject listener) {
+    if(!manager) return;
+    if(!listener) {
+        manager->SetPickCallback(nullptr);
+        return;
+    }
+
+    std::shared_ptr<JavaListener> java_listener = std::make_shared<JavaListener>();
+    env->GetJavaVM(&java_listener->vm);
+    java_listener->ref = env->NewGlobalRef(listener);
+    jclass listener_class = env->GetObjectClass(listener);
+    java_listener->method = env->GetMethodID(listener_class, "onModelPicked", "(IIFFFF)V");
+
+    manager->SetPickCallback([java_listener](const ARCoreManager::PickResult& pick) {
+        JNIEnv* thread_env = nullptr;
+        bool attached = false;
+        if(java_listener->vm->GetEnv((void**)&thread_env, JNI_VERSION_1_6) == JNI_EDETACHED) {
+            if(java_listener->vm->AttachCurrentThread(&thread_env, nullptr) != JNI_OK) return;
+            attached = true;
+        }
+        thread_env->CallVoidMethod(java_listener->ref, java_listener->method, (jint)pick.mesh, (jint)pick.triangle,
+                                   pick.point.x, pick.point.y, pick.point.z, pick.distance_from_previous);
+        if(attached) java_listener->vm->DetachCurrentThread();
+    });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_buildingar_ARNative_nativeConvertBatch(JNIEnv *env, jobject thiz, jobjectArray input_paths,
+                                                        jstring output_dir, jboolean packaged, jobject listener) {
+    if(!manager) return;
+    std::vector<std::string> inputs;
+    jsize count = env->GetArrayLength(input_paths);
+    for(jsize i = 0; i < count; i++) {
+        jstring path = (jstring)env->GetObjectArrayElement(input_paths, i);
+        const char* chars = env->GetStringUTFChars(path, nullptr);
+        inputs.emplace_back(chars);
+        env->ReleaseStringUTFChars(path, chars);
+        env->DeleteLocalRef(path);
+    }
+    if(inputs.empty()) return;
+
+    const char* outputDir = env->GetStringUTFChars(output_dir, nullptr);
+    manager->GetConversionService().submitBatch(inputs, outputDir, MakeConversionCallback(env, listener),
+            packaged ? ConversionService::OUTPUT_PACKAGE : ConversionService::OUTPUT_GLB);
+    env->ReleaseStringUTFChars(output_dir, outputDir);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_buildingar_ARNative_nativeResumeConversions(JNIEnv *env, jobject thiz, jstring output_dir, jobject listener) {
+    if(!manager) return 0;
+    const char* outputDir = env->GetStringUTFChars(output_dir, nullptr);
+    int resumed = manager->GetConversionService().resumePending(outputDir, MakeConversionCallback(env, listener));
+    env->ReleaseStringUTFChars(output_dir, outputDir);
+    return resumed;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_example_buildingar_ARNative_setModelPath(JNIEnv *env, jobject thiz, jstring model_path) {
@@ -0,0 +1,148 @@
+#include <pixel_unpack_ring.h>
+
+#include <EGL/egl.h>
+
+bool PixelUnpackRing::create() {
+    /* A new surface comes with a new context, names and mappings of the previous one are gone.
+     * Claims still held from it are refused by the new epoch */
+    forget();
+
+    GLuint buffers[kSlotCount] = {0};
+    glGenBuffers(kSlotCount, buffers);
+    for(int i = 0; i < kSlotCount; i++) {
+        Slot& slot = mSlots[i];
+        slot.buffer = buffers[i];
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, kSlotBytes, nullptr, GL_STREAM_DRAW);
+        /* A slot a writer still holds is mapped by recycle() once its ticket is let go */
+        if(stateOf(slot.state.load(std::memory_order_acquire)) == SLOT_UNMAPPED) map(slot);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    LOGI("SANJU : PixelUnpackRing : %d x %zu MB staging slots", kSlotCount, kSlotBytes >> 20);
+    return true;
+}
+
+void PixelUnpackRing::destroy() {
+    /* GL names die with their context, only delete them while one is current. Nothing may be
+     * writing into a claimed slot by now, the owner drained its jobs */
+    if(isAvailable() && eglGetCurrentContext() != EGL_NO_CONTEXT) {
+        for(Slot& slot : mSlots) {
+            if(slot.fence) glDeleteSync(slot.fence);
+            /* Deleting a mapped buffer unmaps it */
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+    forget();
+}
+
+void PixelUnpackRing::recycle() {
+    for(Slot& slot : mSlots) {
+        int word = slot.state.load(std::memory_order_acquire);
+        int state = stateOf(word);
+        /* Cancelled back to mapped as the context changed : the mapping is the old context's */
+        if(state == SLOT_MAPPED && !current(word) &&
+           slot.state.compare_exchange_strong(word, SLOT_UNMAPPED, std::memory_order_acq_rel)) {
+            state = SLOT_UNMAPPED;
+        }
+        if(state == SLOT_IN_FLIGHT) {
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if(status == GL_TIMEOUT_EXPIRED) continue;
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            slot.state.store(SLOT_UNMAPPED, std::memory_order_release);
+            state = SLOT_UNMAPPED;
+        }
+        if(state == SLOT_UNMAPPED && slot.buffer) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            map(slot);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+    }
+}
+
+int PixelUnpackRing::claim(size_t bytes) {
+    if(bytes > kSlotBytes) return -1;
+    for(int i = 0; i < kSlotCount; i++) {
+        int word = mSlots[i].state.load(std::memory_order_acquire);
+        if(stateOf(word) != SLOT_MAPPED || !current(word)) continue;
+        /* The ticket carries the epoch of the mapping, not whatever mEpoch reads by now */
+        int ticket = (word & ~0xFF) | i;
+        if(mSlots[i].state.compare_exchange_strong(word, claimedBy(ticket), std::memory_order_acq_rel)) {
+            return ticket;
+        }
+    }
+    return -1;
+}
+
+unsigned char* PixelUnpackRing::data(int ticket) const {
+    if(!current(ticket)) return nullptr;
+    const Slot& slot = mSlots[slotOf(ticket)];
+    if(slot.state.load(std::memory_order_acquire) != claimedBy(ticket)) return nullptr;
+    return slot.data;
+}
+
+void PixelUnpackRing::cancel(int ticket) {
+    if(ticket < 0) return;
+    int expected = claimedBy(ticket);
+    /* A slot claimed in a previous context goes back unmapped, recycle() maps it in this one */
+    int released = current(ticket) ? (ticket & ~0xFF) | SLOT_MAPPED : SLOT_UNMAPPED;
+    mSlots[slotOf(ticket)].state.compare_exchange_strong(expected, released, std::memory_order_acq_rel);
+}
+
+bool PixelUnpackRing::begin(int ticket) {
+    if(ticket < 0) return false;
+    if(!current(ticket)) {
+        /* Filled for a previous context, nothing to upload : the slot is free again */
+        cancel(ticket);
+        return false;
+    }
+    Slot& slot = mSlots[slotOf(ticket)];
+    if(slot.state.load(std::memory_order_acquire) != claimedBy(ticket)) return false;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    GLboolean intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    slot.data = nullptr;
+    if(!intact) {
+        /* The driver may drop a mapping's contents (e.g. on a mode switch), remapped by recycle() */
+        LOGE("NAT_ERROR : PixelUnpackRing : slot %d contents lost on unmap", slotOf(ticket));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.state.store(SLOT_UNMAPPED, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void PixelUnpackRing::end(int ticket) {
+    Slot& slot = mSlots[slotOf(ticket)];
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    /* Reused only once the GPU copied the texels out */
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state.store(SLOT_IN_FLIGHT, std::memory_order_release);
+}
+
+/* Called with the slot's buffer bound to GL_PIXEL_UNPACK_BUFFER */
+void PixelUnpackRing::map(Slot &slot) {
+    /* Unsynchronized : the slot's fence already told the GPU is done with the previous contents */
+    slot.data = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, kSlotBytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(!slot.data) {
+        LOGE("NAT_ERROR : PixelUnpackRing : glMapBufferRange failed : 0x%x", glGetError());
+        return;
+    }
+    slot.state.store((mEpoch.load(std::memory_order_relaxed) << 8) | SLOT_MAPPED, std::memory_order_release);
+}
+
+void PixelUnpackRing::forget() {
+    for(Slot& slot : mSlots) {
+        slot.buffer = 0;
+        slot.fence = nullptr;
+        /* A claimed slot stays claimed, its writer may be copying into it : the new epoch makes
+         * the ticket stale and cancel() or begin() hands the slot back. The rest start over */
+        int word = slot.state.load(std::memory_order_acquire);
+        while(stateOf(word) != SLOT_CLAIMED &&
+              !slot.state.compare_exchange_weak(word, SLOT_UNMAPPED, std::memory_order_acq_rel)) {
+        }
+        if(stateOf(word) != SLOT_CLAIMED) slot.data = nullptr;
+    }
+    mEpoch.fetch_add(1, std::memory_order_acq_rel);
+}
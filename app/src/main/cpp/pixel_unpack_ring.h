@@ -0,0 +1,86 @@
+#ifndef BUILDING_AR_PIXEL_UNPACK_RING_H
+#define BUILDING_AR_PIXEL_UNPACK_RING_H
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include <atomic>
+#include <cstddef>
+
+#define LOG_TAG "PixelUnpackRing"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * A few GL_PIXEL_UNPACK_BUFFER slots kept mapped, so texture texels can be written straight
+ * into driver memory by any thread and uploaded by the GL thread with a glTexSubImage2D that
+ * only schedules a copy.
+ *
+ * A slot cycles through
+ *   mapped    (GL thread)  : free, claim() hands it to a writer
+ *   claimed   (any thread) : being filled, then carried to the GL thread with its result
+ *   in flight (GL thread)  : unmapped, bound for the uploads between begin() and end(), fenced
+ *   unmapped  (GL thread)  : recycle() maps it again once the fence says the GPU copied out
+ *
+ * Claims are tickets tagged with the context the slot was mapped in. create() for a new context
+ * starts a new epoch : data() and begin() refuse tickets of the old one, and a slot claimed
+ * in the old context stays claimed, out of the new context's reach, until its ticket is
+ * cancelled or refused by begin(). Only then is it mapped again, so no two writers share a slot.
+ */
+class PixelUnpackRing {
+public:
+    static constexpr int kSlotCount = 3;
+    /* A 2048 x 2048 RGBA8 level 0. Textures beyond that are uploaded from client memory */
+    static constexpr size_t kSlotBytes = 16u << 20;
+
+    ~PixelUnpackRing() { destroy(); }
+
+    /* GL thread, once per GL context */
+    bool create();
+    void destroy();
+    bool isAvailable() const { return mSlots[0].buffer != 0; }
+
+    /* GL thread, once per frame : maps again the slots the GPU is done copying from */
+    void recycle();
+
+    /* Any thread. A mapped slot with room for bytes, -1 when none is free or bytes don't fit */
+    int claim(size_t bytes);
+    /* Any thread, between claim() and begin(). Null for a ticket of a previous context : the
+     * writer cancels it instead of filling the slot */
+    unsigned char* data(int ticket) const;
+    /* Any thread : a claim that won't be uploaded goes back to the mapped slots, or to recycle()
+     * when it is from a previous context */
+    void cancel(int ticket);
+
+    /* GL thread. Unmaps the claimed slot and binds it to GL_PIXEL_UNPACK_BUFFER : texel pointers
+     * are offsets into the slot until end(). False for a ticket of a previous context, which
+     * releases its slot, or when the driver lost the mapping's contents, nothing is bound then */
+    bool begin(int ticket);
+    void end(int ticket);
+
+private:
+    enum SlotState { SLOT_UNMAPPED, SLOT_MAPPED, SLOT_CLAIMED, SLOT_IN_FLIGHT };
+
+    struct Slot {
+        GLuint buffer = 0;
+        /* Written by the GL thread before the slot is published as mapped, left alone while claimed */
+        unsigned char* data = nullptr;
+        GLsync fence = nullptr;
+        /* (epoch << 8) | SlotState : a claim keeps the epoch of the mapping it took */
+        std::atomic<int> state{SLOT_UNMAPPED};
+    };
+
+    Slot mSlots[kSlotCount];
+    /* Bumped by forget(), the upper bits of every ticket */
+    std::atomic<int> mEpoch{0};
+
+    static int slotOf(int ticket) { return ticket & 0xFF; }
+    static int stateOf(int word) { return word & 0xFF; }
+    /* The state word of the slot while ticket holds it */
+    static int claimedBy(int ticket) { return (ticket & ~0xFF) | SLOT_CLAIMED; }
+    bool current(int ticket) const { return ticket >= 0 && (ticket >> 8) == mEpoch.load(std::memory_order_acquire); }
+    void map(Slot& slot);
+    void forget();
+};
+
+#endif //BUILDING_AR_PIXEL_UNPACK_RING_H
@@ -0,0 +1,65 @@
+#include <resolution_controller.h>
+
+#include <algorithm>
+#include <cmath>
+
+void ResolutionController::setConfig(const Config &config) {
+    mConfig = config;
+    mScale = quantize(mScale);
+}
+
+void ResolutionController::reset() {
+    mScale = quantize(mConfig.maxScale);
+    mAverageMs = 0.0;
+    mSettle = 0;
+    mAveraged = 0;
+}
+
+bool ResolutionController::addSample(double gpuMs) {
+    if(gpuMs < 0.0) return false;
+    if(mSettle > 0) {
+        mSettle--;
+        return false;
+    }
+
+    /* The first sample ever starts the average, after a change it continues from the prediction */
+    if(mAverageMs <= 0.0) mAverageMs = gpuMs;
+    else mAverageMs += (gpuMs - mAverageMs) * mConfig.smoothing;
+    if(++mAveraged < mConfig.settleSamples) return false;
+
+    if(mAverageMs > mConfig.targetMs && mScale > mConfig.minScale) {
+        /* Straight to the scale whose pixel count fits the budget, at least one step down */
+        float next = quantize(mScale * (float)std::sqrt(mConfig.targetMs / mAverageMs));
+        if(next >= mScale) next = quantize(mScale - mConfig.step);
+        change(next);
+        return true;
+    }
+
+    if(mAverageMs < mConfig.targetMs * mConfig.growBelow && mScale < mConfig.maxScale) {
+        float next = quantize(mScale + mConfig.step);
+        /* Only when the bigger scale is predicted to stay within budget too */
+        double ratio = (double)next / mScale;
+        if(next > mScale && mAverageMs * ratio * ratio <= mConfig.targetMs) {
+            change(next);
+            return true;
+        }
+    }
+    return false;
+}
+
+float ResolutionController::quantize(float scale) const {
+    scale = std::min(std::max(scale, mConfig.minScale), mConfig.maxScale);
+    if(mConfig.step <= 0.0f) return scale;
+    /* The epsilon keeps a sum like 0.55 + 0.05 from flooring back to 0.55 */
+    float stepped = std::floor(scale / mConfig.step + 1e-3f) * mConfig.step;
+    return std::max(stepped, mConfig.minScale);
+}
+
+void ResolutionController::change(float scale) {
+    /* Predict the average at the new pixel count so the next decision doesn't start from scratch */
+    double ratio = (double)scale / mScale;
+    mAverageMs *= ratio * ratio;
+    mScale = scale;
+    mSettle = mConfig.settleSamples;
+    mAveraged = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef BUILDING_AR_RESOLUTION_CONTROLLER_H
+#define BUILDING_AR_RESOLUTION_CONTROLLER_H
+
+/*
+ * Picks the render scale of the 3D passes (planes + model) from their measured GPU time.
+ *
+ * Samples are smoothed with an exponential moving average. Above the budget the scale drops
+ * straight to the one predicted to fit, fragment cost being proportional to the pixel count
+ * (scale squared). Well below the budget it grows back one step at a time, so the gap between
+ * the two thresholds keeps it from oscillating. After every change a few samples are ignored :
+ * GPU timings lag the frame (see GpuTimer) and would still describe the old scale, and as many
+ * again are averaged before the next decision, so a single slow frame never changes it.
+ *
+ * Scales are multiples of step, so the offscreen size only changes in coarse increments.
+ * No GL, no clock : fed with plain numbers, GL thread in practice.
+ */
+class ResolutionController {
+public:
+    struct Config {
+        double targetMs = 6.0;      // GPU budget of the scaled passes
+        double growBelow = 0.7;     // grow once the average is under targetMs * growBelow
+        double smoothing = 0.2;     // weight of a new sample in the average
+        int settleSamples = 6;      // samples ignored after a change, and averaged before deciding
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        float step = 0.05f;
+    };
+
+    ResolutionController() { reset(); }
+    explicit ResolutionController(const Config& config) : mConfig(config) { reset(); }
+
+    const Config& config() const { return mConfig; }
+    void setConfig(const Config& config);
+
+    /* Back to maxScale with no history, e.g. for a new surface */
+    void reset();
+
+    /* GPU time of one frame's scaled passes, rendered at scale(). True when scale() changed */
+    bool addSample(double gpuMs);
+
+    float scale() const { return mScale; }
+    /* Smoothed GPU time, 0 before the first sample */
+    double averageMs() const { return mAverageMs; }
+
+private:
+    Config mConfig;
+    float mScale;
+    double mAverageMs;
+    int mSettle;
+    /* Samples averaged since the last change or reset */
+    int mAveraged;
+
+    /* Nearest step multiple at or below scale, within [minScale, maxScale] */
+    float quantize(float scale) const;
+    void change(float scale);
+};
+
+#endif //BUILDING_AR_RESOLUTION_CONTROLLER_H
@@ -0,0 +1,181 @@
+#include <scene_target.h>
+#include <frame_stats.h>
+
+#include <EGL/egl.h>
+
+#include <algorithm>
+
+bool SceneTarget::create(const std::string &vertexSource, const std::string &fragmentSource) {
+    /* A new surface comes with a new context, names of the previous one are already gone */
+    forget();
+
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if(!vertexShader || !fragmentShader) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return false;
+    }
+
+    mProgram = glCreateProgram();
+    glAttachShader(mProgram, vertexShader);
+    glAttachShader(mProgram, fragmentShader);
+    glLinkProgram(mProgram);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(mProgram, GL_LINK_STATUS, &linked);
+    if(!linked) {
+        LOGE("NAT_ERROR : SceneTarget : composite program failed to link");
+        glDeleteProgram(mProgram);
+        mProgram = 0;
+        return false;
+    }
+
+    mUvScaleLocation = glGetUniformLocation(mProgram, "uUvScale");
+    mUvMaxLocation = glGetUniformLocation(mProgram, "uUvMax");
+    /* The sampler always reads unit 0, set once instead of every frame */
+    glUseProgram(mProgram);
+    glUniform1i(glGetUniformLocation(mProgram, "uScene"), 0);
+    glUseProgram(0);
+
+    /* The triangle comes from gl_VertexID, the VAO has no attributes */
+    glGenVertexArrays(1, &mVao);
+    return true;
+}
+
+void SceneTarget::destroy() {
+    /* GL names die with their context, only delete them while one is current */
+    if(mProgram && eglGetCurrentContext() != EGL_NO_CONTEXT) {
+        glDeleteProgram(mProgram);
+        glDeleteVertexArrays(1, &mVao);
+        release();
+    }
+    forget();
+}
+
+bool SceneTarget::begin(GLStateCache &state, int width, int height, float scale) {
+    if(!mProgram || width <= 0 || height <= 0) return false;
+    if((width != mWidth || height != mHeight) && !allocate(state, width, height)) return false;
+    if(!mFramebuffer) return false;
+
+    mViewportWidth = std::max(1, (int)(width * scale + 0.5f));
+    mViewportHeight = std::max(1, (int)(height * scale + 0.5f));
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glViewport(0, 0, mViewportWidth, mViewportHeight);
+
+    /* A full clear, not only the viewport, is the cheap one on tilers */
+    state.depthMask(true);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+void SceneTarget::end() {
+    const GLenum depth = GL_DEPTH_ATTACHMENT;
+    glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &depth);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, mWidth, mHeight);
+}
+
+void SceneTarget::composite(GLStateCache &state) {
+    state.setEnabled(GL_DEPTH_TEST, false);
+    state.depthMask(false);
+    state.setEnabled(GL_BLEND, true);
+    state.blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    state.useProgram(mProgram);
+    state.bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, mColor);
+    state.bindVertexArray(mVao);
+
+    /* Only rewritten when the scale changed */
+    if(mViewportWidth != mUniformWidth || mViewportHeight != mUniformHeight) {
+        glUniform2f(mUvScaleLocation, (float)mViewportWidth / mWidth, (float)mViewportHeight / mHeight);
+        glUniform2f(mUvMaxLocation, (mViewportWidth - 0.5f) / mWidth, (mViewportHeight - 0.5f) / mHeight);
+        mUniformWidth = mViewportWidth;
+        mUniformHeight = mViewportHeight;
+        FrameStats::Count(FrameStats::COUNTER_UNIFORM_CALLS, 2);
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+bool SceneTarget::allocate(GLStateCache &state, int width, int height) {
+    release();
+    mWidth = width;
+    mHeight = height;
+    mUniformWidth = 0;
+    mUniformHeight = 0;
+
+    /* Immutable storage, the size never changes until the next surface size */
+    glGenTextures(1, &mColor);
+    state.bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, mColor);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &mDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, mDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &mFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        /* Kept for this size so it isn't retried every frame, mFramebuffer == 0 marks it unusable */
+        LOGE("NAT_ERROR : SceneTarget : framebuffer incomplete (0x%x) at %dx%d", status, width, height);
+        release();
+        return false;
+    }
+    LOGI("SANJU : SceneTarget : allocated %dx%d", width, height);
+    return true;
+}
+
+void SceneTarget::release() {
+    if(mFramebuffer) glDeleteFramebuffers(1, &mFramebuffer);
+    if(mColor) glDeleteTextures(1, &mColor);
+    if(mDepth) glDeleteRenderbuffers(1, &mDepth);
+    mFramebuffer = 0;
+    mColor = 0;
+    mDepth = 0;
+}
+
+void SceneTarget::forget() {
+    mProgram = 0;
+    mVao = 0;
+    mUvScaleLocation = -1;
+    mUvMaxLocation = -1;
+    mFramebuffer = 0;
+    mColor = 0;
+    mDepth = 0;
+    mWidth = 0;
+    mHeight = 0;
+    mViewportWidth = 0;
+    mViewportHeight = 0;
+    mUniformWidth = 0;
+    mUniformHeight = 0;
+}
+
+GLuint SceneTarget::CompileShader(GLenum type, const std::string &source) {
+    const char* text = source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if(!compiled) {
+        char log[512] = {0};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        LOGE("NAT_ERROR : SceneTarget : shader compile failed : %s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
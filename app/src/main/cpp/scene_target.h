@@ -0,0 +1,71 @@
+#ifndef BUILDING_AR_SCENE_TARGET_H
+#define BUILDING_AR_SCENE_TARGET_H
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include <string>
+
+#include "gl_state_cache.h"
+
+#define LOG_TAG "SceneTarget"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/*
+ * Offscreen color + depth target the 3D passes render into at a reduced scale, composited over
+ * the camera background, which stays at full resolution.
+ *
+ * Storage has the size of the surface and a scale only shrinks the viewport into its lower left
+ * corner, so a new scale costs nothing. The target is cleared to transparent black and the
+ * passes blend alpha as coverage (GL_ONE, GL_ONE_MINUS_SRC_ALPHA for alpha), so it ends up
+ * holding premultiplied color, composited with the same factors. Depth is invalidated before
+ * the composite and never leaves the tile memory on tilers.
+ *
+ * The framebuffer binding and viewport aren't tracked by GLStateCache, begin() / end() restore
+ * the default framebuffer's. All calls on the GL thread.
+ */
+class SceneTarget {
+public:
+    ~SceneTarget() { destroy(); }
+
+    /* Once per GL context, see ARCoreManager::OnSurfaceCreated */
+    bool create(const std::string& vertexSource, const std::string& fragmentSource);
+    void destroy();
+    bool isAvailable() const { return mProgram != 0; }
+
+    /* Binds the target with a viewport of the scaled size and clears it. Reallocates when the
+     * surface size changed. False if the target can't be used, nothing is bound then */
+    bool begin(GLStateCache& state, int width, int height, float scale);
+    int viewportWidth() const { return mViewportWidth; }
+    int viewportHeight() const { return mViewportHeight; }
+    /* Drops the depth, rebinds the default framebuffer with the full viewport */
+    void end();
+    /* Draws the scaled image over the default framebuffer, filtered up */
+    void composite(GLStateCache& state);
+
+private:
+    GLuint mProgram = 0;
+    GLuint mVao = 0;
+    GLint mUvScaleLocation = -1;
+    GLint mUvMaxLocation = -1;
+
+    GLuint mFramebuffer = 0;
+    GLuint mColor = 0;
+    GLuint mDepth = 0;
+    /* Storage size, the surface's */
+    int mWidth = 0;
+    int mHeight = 0;
+    int mViewportWidth = 0;
+    int mViewportHeight = 0;
+    /* Viewport the composite uniforms were set for */
+    int mUniformWidth = 0;
+    int mUniformHeight = 0;
+
+    bool allocate(GLStateCache& state, int width, int height);
+    void release();
+    void forget();
+    static GLuint CompileShader(GLenum type, const std::string& source);
+};
+
+#endif //BUILDING_AR_SCENE_TARGET_H
@@ -0,0 +1,48 @@
+#ifndef BUILDING_AR_SPSC_QUEUE_H
+#define BUILDING_AR_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/*
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * Capacity must be a power of two. push() fails instead of waiting when the queue is full and
+ * pop() fails when it is empty, so neither side can ever block the other.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /* Producer side. Only moves from value on success */
+    bool push(T&& value) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if(tail - mHead.load(std::memory_order_acquire) == Capacity) return false;
+        mSlots[tail & (Capacity - 1)] = std::move(value);
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Consumer side */
+    bool pop(T& out) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if(head == mTail.load(std::memory_order_acquire)) return false;
+        out = std::move(mSlots[head & (Capacity - 1)]);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+    }
+
+private:
+    T mSlots[Capacity];
+    /* Separate cache lines, head is written by the consumer and tail by the producer */
+    alignas(64) std::atomic<size_t> mHead{0};
+    alignas(64) std::atomic<size_t> mTail{0};
+};
+
+#endif //BUILDING_AR_SPSC_QUEUE_H
@@ -0,0 +1,335 @@
+#include <tracking_pipeline.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include <chrono>
+#include <cstring>
+
+#include "glm/gtc/type_ptr.hpp"
+
+/* Runs on the render thread */
+bool TrackingPipeline::start(ArSession *session, GLuint restoreCameraTexture) {
+    if(isRunning() || !session) return false;
+
+    if(!mContext.create()) {
+        LOGE("NAT_ERROR : TrackingPipeline : shared context unavailable, staying synchronous");
+        return false;
+    }
+
+    glGenTextures(kCameraTextureCount, mCameraTextures);
+    for(GLuint texture : mCameraTextures) {
+        glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
+        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+    ArSession_setCameraTextureNames(session, kCameraTextureCount, mCameraTextures);
+
+    /* ArFrame is only ever touched by the tracking thread from here on */
+    mSession = session;
+    mRestoreCameraTexture = restoreCameraTexture;
+    ArFrame_create(mSession, &mFrame);
+    mHasSnapshot = false;
+    mHeldTexture.store(0, std::memory_order_relaxed);
+    mPublishedTimestamp.store(0, std::memory_order_release);
+
+    mRunning.store(true, std::memory_order_release);
+    mThread = std::thread(&TrackingPipeline::run, this);
+    LOGI("SANJU : TrackingPipeline started");
+    return true;
+}
+
+/* Runs on the render thread */
+void TrackingPipeline::stop() {
+    if(!isRunning()) return;
+    join();
+
+    /* GL names die with their context, only delete them while one is current */
+    if(eglGetCurrentContext() != EGL_NO_CONTEXT) {
+        /* Fences left in any of the three snapshot slots */
+        for(int i = 0; i < 3; i++) {
+            GLsync fence = mSnapshots.slot(i).camera_ready;
+            if(fence) glDeleteSync(fence);
+        }
+        for(std::atomic<GLsync>& fence : mReleaseFences) {
+            GLsync released = fence.load(std::memory_order_relaxed);
+            if(released) glDeleteSync(released);
+        }
+        glDeleteTextures(kCameraTextureCount, mCameraTextures);
+    }
+    forgetObjects();
+    LOGI("SANJU : TrackingPipeline stopped");
+}
+
+/* Runs on the render thread, with the new surface's context current */
+void TrackingPipeline::forget() {
+    if(!isRunning()) return;
+    join();
+    forgetObjects();
+    LOGI("SANJU : TrackingPipeline dropped with its render context");
+}
+
+void TrackingPipeline::join() {
+    mRunning.store(false, std::memory_order_release);
+    mThread.join();
+
+    /* ARCore must stop using our textures before they are deleted or forgotten */
+    ArSession_setCameraTextureName(mSession, mRestoreCameraTexture);
+
+    ArFrame_destroy(mFrame);
+    mFrame = nullptr;
+    mSession = nullptr;
+    /* EGL objects belong to the display rather than a context, always safe to destroy */
+    mContext.destroy();
+    mHasSnapshot = false;
+    mPublishedTimestamp.store(0, std::memory_order_release);
+}
+
+void TrackingPipeline::forgetObjects() {
+    for(int i = 0; i < 3; i++) mSnapshots.slot(i).camera_ready = nullptr;
+    for(std::atomic<GLsync>& fence : mReleaseFences) fence.store(nullptr, std::memory_order_relaxed);
+    mHeldTexture.store(0, std::memory_order_relaxed);
+    memset(mCameraTextures, 0, sizeof(mCameraTextures));
+}
+
+bool TrackingPipeline::acquire() {
+    GLuint previousTexture = mSnapshots.front().camera_texture;
+    if(mSnapshots.acquire()) {
+        /* Everything that sampled the previous texture has been issued by now, the fence goes
+         * out with this frame's swap */
+        int previous = mHasSnapshot ? textureIndex(previousTexture) : -1;
+        if(previous >= 0) {
+            GLsync release = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            GLsync unclaimed = mReleaseFences[previous].exchange(release, std::memory_order_relaxed);
+            if(unclaimed) glDeleteSync(unclaimed);
+        }
+        /* Release ordered after the fence store, the tracking thread checks the held texture first */
+        mHeldTexture.store(mSnapshots.front().camera_texture, std::memory_order_release);
+        mHasSnapshot = true;
+        /* GPU-side wait, the render thread itself does not block */
+        if(mSnapshots.front().camera_ready) {
+            glWaitSync(mSnapshots.front().camera_ready, 0, GL_TIMEOUT_IGNORED);
+        }
+    }
+    return mHasSnapshot;
+}
+
+int TrackingPipeline::textureIndex(GLuint texture) const {
+    for(int i = 0; i < kCameraTextureCount; i++) {
+        if(texture && mCameraTextures[i] == texture) return i;
+    }
+    return -1;
+}
+
+void TrackingPipeline::setDisplayGeometry(int rotation, int width, int height) {
+    uint64_t packed = ((uint64_t)(rotation & 0xFF) << 56) |
+                      ((uint64_t)(width & 0xFFFFFFF) << 28) |
+                      (uint64_t)(height & 0xFFFFFFF);
+    mDisplayGeometry.store(packed, std::memory_order_relaxed);
+}
+
+void TrackingPipeline::requestHitTest(float x, float y) {
+    uint32_t bits[2];
+    memcpy(&bits[0], &x, sizeof(float));
+    memcpy(&bits[1], &y, sizeof(float));
+    mHitPoint.store(((uint64_t)bits[0] << 32) | bits[1], std::memory_order_relaxed);
+    mHitRequestId.fetch_add(1, std::memory_order_release);
+}
+
+/* Runs on the tracking thread */
+void TrackingPipeline::run() {
+    if(!mContext.makeCurrent()) {
+        mRunning.store(false, std::memory_order_release);
+        return;
+    }
+
+    uint64_t appliedGeometry = 0;
+    CameraUvs cameraUvs;
+    uint32_t answeredHitRequest = 0;
+    bool hitValid = false;
+    float hitPose[16] = {0};
+    /* ARCore starts over at the first name after setCameraTextureNames, then goes round */
+    int nextTexture = 0;
+
+    while(mRunning.load(std::memory_order_acquire)) {
+        /* The render thread is two snapshots behind and still samples the texture ARCore would
+         * latch into next : leave the camera frame to ARCore until it moves on */
+        if(mHeldTexture.load(std::memory_order_acquire) == mCameraTextures[nextTexture]) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        GLsync release = mReleaseFences[nextTexture].exchange(nullptr, std::memory_order_relaxed);
+        if(release) {
+            if(glClientWaitSync(release, 0, kReleaseWaitNs) == GL_TIMEOUT_EXPIRED) {
+                /* The render thread can't hold this texture again before ARCore latches it, so
+                 * nothing else has written the slot meanwhile */
+                mReleaseFences[nextTexture].store(release, std::memory_order_relaxed);
+                continue;
+            }
+            glDeleteSync(release);
+        }
+
+        uint64_t geometry = mDisplayGeometry.load(std::memory_order_relaxed);
+        if(geometry != appliedGeometry) {
+            ArSession_setDisplayGeometry(mSession, (int32_t)(geometry >> 56),
+                                         (int32_t)((geometry >> 28) & 0xFFFFFFF),
+                                         (int32_t)(geometry & 0xFFFFFFF));
+            appliedGeometry = geometry;
+        }
+
+        /* Blocks until the next camera frame, which is exactly what the render thread no longer does */
+        if(ArSession_update(mSession, mFrame) != AR_SUCCESS) {
+            /* Paused session, don't spin */
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        TrackingSnapshot& snapshot = mSnapshots.back();
+        CaptureFrame(mSession, mFrame, snapshot);
+        int latched = textureIndex(snapshot.camera_texture);
+        if(latched >= 0) nextTexture = (latched + 1) % kCameraTextureCount;
+        /* Kept here rather than in the snapshot slots, which are three frames apart */
+        UpdateCameraUvs(mSession, mFrame, cameraUvs);
+        snapshot.camera_uvs = cameraUvs;
+
+        uint32_t hitRequest = mHitRequestId.load(std::memory_order_acquire);
+        if(hitRequest != answeredHitRequest) {
+            uint64_t packed = mHitPoint.load(std::memory_order_relaxed);
+            uint32_t bits[2] = { (uint32_t)(packed >> 32), (uint32_t)packed };
+            float x, y;
+            memcpy(&x, &bits[0], sizeof(float));
+            memcpy(&y, &bits[1], sizeof(float));
+            hitValid = HitTestPlane(mSession, mFrame, x, y, hitPose);
+            answeredHitRequest = hitRequest;
+        }
+        /* Every snapshot carries the latest answer, the render thread may skip snapshots */
+        snapshot.hit_request_id = answeredHitRequest;
+        snapshot.hit_valid = hitValid;
+        memcpy(snapshot.hit_pose_matrix, hitPose, sizeof(hitPose));
+
+        if(snapshot.camera_ready) glDeleteSync(snapshot.camera_ready);
+        snapshot.camera_ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        int64_t timestamp = snapshot.timestamp_ns;
+        mSnapshots.publish();
+        mPublishedTimestamp.store(timestamp, std::memory_order_release);
+    }
+
+    mContext.release();
+}
+
+void TrackingPipeline::CaptureFrame(ArSession *session, ArFrame *frame, TrackingSnapshot &snapshot) {
+    ArFrame_getTimestamp(session, frame, &snapshot.timestamp_ns);
+    ArFrame_getCameraTextureName(session, frame, &snapshot.camera_texture);
+
+    ArCamera* camera;
+    ArFrame_acquireCamera(session, frame, &camera);
+    ArCamera_getViewMatrix(session, camera, glm::value_ptr(snapshot.view));
+    ArCamera_getProjectionMatrix(session, camera, kNearPlane, kFarPlane, glm::value_ptr(snapshot.proj));
+    ArCamera_release(camera);
+
+    /* Converted here so the render thread only uploads it, a no-op while depth is disabled */
+    DepthOcclusion::Capture(session, frame, snapshot.depth);
+    LightEstimation::Capture(session, frame, snapshot.light);
+
+    /* clear() keeps the capacity, so steady state capture doesn't allocate */
+    snapshot.plane_vertices.clear();
+    snapshot.plane_vertex_counts.clear();
+
+    ArTrackableList* planes;
+    ArTrackableList_create(session, &planes);
+    ArSession_getAllTrackables(session, AR_TRACKABLE_PLANE, planes);
+
+    int32_t count = 0;
+    ArTrackableList_getSize(session, planes, &count);
+
+    ArPose* center_pose = nullptr;
+    ArPose_create(session, nullptr, &center_pose);
+    std::vector<float> polygon;
+
+    for(int32_t i = 0; i < count; i++) {
+        ArTrackable* trackable;
+        ArTrackableList_acquireItem(session, planes, i, &trackable);
+        ArTrackingState state;
+        ArTrackable_getTrackingState(session, trackable, &state);
+
+        if(state == AR_TRACKING_STATE_TRACKING) {
+            ArPlane* plane = reinterpret_cast<ArPlane*>(trackable);
+            ArPlane_getCenterPose(session, plane, center_pose);
+
+            glm::mat4 model_matrix;
+            ArPose_getMatrix(session, center_pose, glm::value_ptr(model_matrix));
+
+            int32_t polygon_size = 0;
+            ArPlane_getPolygonSize(session, plane, &polygon_size);
+            polygon.resize(polygon_size);
+            ArPlane_getPolygon(session, plane, polygon.data());
+
+            /* Transforming the planes' polygon vertices from local to world coordinates */
+            for(int32_t j = 0; j + 1 < polygon_size; j += 2) {
+                glm::vec4 world_point = model_matrix * glm::vec4(polygon[j], 0.0f, polygon[j + 1], 1.0f);
+                snapshot.plane_vertices.push_back(world_point.x);
+                snapshot.plane_vertices.push_back(world_point.y);
+                snapshot.plane_vertices.push_back(world_point.z);
+            }
+            snapshot.plane_vertex_counts.push_back(polygon_size / 2);
+        }
+        ArTrackable_release(trackable);
+    }
+
+    ArPose_destroy(center_pose);
+    ArTrackableList_destroy(planes);
+}
+
+void TrackingPipeline::UpdateCameraUvs(ArSession *session, ArFrame *frame, CameraUvs &uvs) {
+    int32_t changed = 0;
+    ArFrame_getDisplayGeometryChanged(session, frame, &changed);
+    if(!changed && uvs.geometry_id != 0) return;
+
+    /* Corners of the background quad, in its triangle strip order */
+    static const float kQuadNdc[8] = { -1.0f, -1.0f,   1.0f, -1.0f,   -1.0f, 1.0f,   1.0f, 1.0f };
+    ArFrame_transformCoordinates2d(session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+                                   4, kQuadNdc, AR_COORDINATES_2D_TEXTURE_NORMALIZED, uvs.uvs);
+
+    /* Shared by the synchronous path and the tracking thread, ids must not repeat across them */
+    static std::atomic<uint32_t> sNextGeometryId{1};
+    uvs.geometry_id = sNextGeometryId.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TrackingPipeline::HitTestPlane(ArSession *session, ArFrame *frame, float x, float y, float out_pose_matrix[16]) {
+    ArHitResultList* hit_result_list = nullptr;
+    ArHitResultList_create(session, &hit_result_list);
+    ArFrame_hitTest(session, frame, x, y, hit_result_list);
+
+    int32_t hit_result_list_size = 0;
+    ArHitResultList_getSize(session, hit_result_list, &hit_result_list_size);
+
+    bool hit_plane = false;
+    if(hit_result_list_size > 0) {
+        ArHitResult* hit_result = nullptr;
+        ArHitResult_create(session, &hit_result);
+        ArHitResultList_getItem(session, hit_result_list, 0, hit_result);
+
+        ArTrackable* trackable = nullptr;
+        ArHitResult_acquireTrackable(session, hit_result, &trackable);
+        ArTrackableType trackableType;
+        ArTrackable_getType(session, trackable, &trackableType);
+
+        if(trackableType == AR_TRACKABLE_PLANE) {
+            ArPose* pose = nullptr;
+            ArPose_create(session, nullptr, &pose);
+            ArHitResult_getHitPose(session, hit_result, pose);
+            ArPose_getMatrix(session, pose, out_pose_matrix);
+            ArPose_destroy(pose);
+            hit_plane = true;
+        }
+
+        ArTrackable_release(trackable);
+        ArHitResult_destroy(hit_result);
+    }
+    ArHitResultList_destroy(hit_result_list);
+    return hit_plane;
+}
@@ -0,0 +1,137 @@
+#ifndef BUILDING_AR_TRACKING_PIPELINE_H
+#define BUILDING_AR_TRACKING_PIPELINE_H
+
+#include "arcore_c_api.h"
+#include "triple_buffer.h"
+#include "egl_shared_context.h"
+#include "depth_occlusion.h"
+#include "light_estimation.h"
+
+#include <GLES3/gl3.h>
+#include <android/log.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#define LOG_TAG "TrackingPipeline"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/* Camera texture UVs for the corners of the full screen quad, see BackgroundRenderer */
+struct CameraUvs {
+    /* 0 until computed, otherwise unique per computation so a renderer can tell it's seen them */
+    uint32_t geometry_id = 0;
+    float uvs[8] = {0};
+};
+
+/* Everything the render thread needs from one ARCore frame */
+struct TrackingSnapshot {
+    int64_t timestamp_ns = 0;
+    uint32_t camera_texture = 0;
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 proj = glm::mat4(1.0f);
+    CameraUvs camera_uvs;
+    /* Latest depth image, carried over unchanged while ARCore has no newer one */
+    DepthFrame depth;
+    /* Latest valid light estimate, same carry over */
+    LightEstimate light;
+
+    /* World space xyz of every tracked plane polygon, back to back */
+    std::vector<float> plane_vertices;
+    std::vector<int32_t> plane_vertex_counts;
+
+    /* Answer to the latest hit test request, see TrackingPipeline::requestHitTest() */
+    uint32_t hit_request_id = 0;
+    bool hit_valid = false;
+    float hit_pose_matrix[16] = {0};
+
+    /* Signalled once the camera texture of this frame is ready to sample */
+    GLsync camera_ready = nullptr;
+};
+
+/*
+ * Runs ArSession_update on a dedicated thread and publishes a TrackingSnapshot per camera frame
+ * through a triple buffer, so the render thread never waits for camera sync.
+ *
+ * ArSession_update has to run with a GL context current because it latches the camera image
+ * into the camera texture. The tracking thread therefore gets a context shared with the render
+ * context, and ARCore rotates through kCameraTextureCount camera textures. Rotation alone doesn't
+ * keep the texture the render thread samples out of ARCore's way once the tracking thread runs
+ * more than two frames ahead, so the render thread hands each texture back : acquire() marks the
+ * new front texture held and fences the one it lets go of. The tracking thread skips
+ * ArSession_update while the texture ARCore latches next is held, and waits for its release
+ * fence before letting ARCore write it.
+ */
+class TrackingPipeline {
+public:
+    static constexpr int kCameraTextureCount = 3;
+    /* Clip planes of TrackingSnapshot::proj */
+    static constexpr float kNearPlane = 0.1f;
+    static constexpr float kFarPlane = 100.0f;
+
+    ~TrackingPipeline() { stop(); }
+
+    /* Render thread, with the render context current. stop() hands restoreCameraTexture back to ARCore */
+    bool start(ArSession* session, GLuint restoreCameraTexture);
+    void stop();
+    /* stop() for a new surface : the context owning the textures and fences is already gone,
+     * their names are only dropped. Call it before the new context touches the session */
+    void forget();
+    bool isRunning() const { return mThread.joinable(); }
+    /* False once the tracking thread gave up, e.g. it couldn't bind its context */
+    bool isHealthy() const { return mRunning.load(std::memory_order_acquire); }
+
+    /* Render thread. Returns false until the first snapshot has been published. The camera
+     * texture of latest() stays held until the next acquire() that returns a new snapshot */
+    bool acquire();
+    const TrackingSnapshot& latest() const { return mSnapshots.front(); }
+
+    /* Any thread */
+    void setDisplayGeometry(int rotation, int width, int height);
+    void requestHitTest(float x, float y);
+    /* Camera timestamp of the newest published snapshot, 0 while there is none */
+    int64_t publishedTimestamp() const { return mPublishedTimestamp.load(std::memory_order_acquire); }
+
+    /* Helpers shared with the synchronous path */
+    static void CaptureFrame(ArSession* session, ArFrame* frame, TrackingSnapshot& snapshot);
+    /* Recomputes the UVs only when ARCore reports a display geometry change (or they never were) */
+    static void UpdateCameraUvs(ArSession* session, ArFrame* frame, CameraUvs& uvs);
+    static bool HitTestPlane(ArSession* session, ArFrame* frame, float x, float y, float out_pose_matrix[16]);
+
+private:
+    /* Wait for the render thread to let go of a camera texture, bounded so stop() isn't held up */
+    static constexpr GLuint64 kReleaseWaitNs = 4000000;
+
+    void run();
+    /* Stops the thread and gives ARCore restoreCameraTexture back, GL objects are left alone */
+    void join();
+    void forgetObjects();
+    int textureIndex(GLuint texture) const;
+
+    ArSession* mSession = nullptr;
+    ArFrame* mFrame = nullptr;
+    EGLSharedContext mContext;
+    GLuint mCameraTextures[kCameraTextureCount] = {0};
+    GLuint mRestoreCameraTexture = 0;
+
+    /* Camera texture of front(), never handed to ArSession_update while held */
+    std::atomic<GLuint> mHeldTexture{0};
+    /* Per camera texture, signalled once the render thread's last sampling of it has executed */
+    std::atomic<GLsync> mReleaseFences[kCameraTextureCount] = {};
+
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+    bool mHasSnapshot = false;
+    TripleBuffer<TrackingSnapshot> mSnapshots;
+
+    std::atomic<uint64_t> mDisplayGeometry{0};
+    std::atomic<uint64_t> mHitPoint{0};
+    std::atomic<uint32_t> mHitRequestId{0};
+    std::atomic<int64_t> mPublishedTimestamp{0};
+};
+
+#endif //BUILDING_AR_TRACKING_PIPELINE_H
@@ -0,0 +1,49 @@
+#ifndef BUILDING_AR_TRIPLE_BUFFER_H
+#define BUILDING_AR_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Lock-free triple buffer for one producer thread and one consumer thread.
+ *
+ * The producer fills back(), then publish() swaps it with the shared middle slot. The consumer
+ * calls acquire(), which swaps the middle slot into front() only if something new was published.
+ * Neither side ever waits for the other; the consumer always sees the latest complete value.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    /* Producer side */
+    T& back() { return mSlots[mBack]; }
+
+    void publish() {
+        uint8_t previous = mMiddle.exchange(mBack | kFreshBit, std::memory_order_acq_rel);
+        mBack = previous & kIndexMask;
+    }
+
+    /* Consumer side. Returns true if front() changed */
+    bool acquire() {
+        if(!(mMiddle.load(std::memory_order_relaxed) & kFreshBit)) return false;
+        uint8_t previous = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+        mFront = previous & kIndexMask;
+        return true;
+    }
+
+    const T& front() const { return mSlots[mFront]; }
+    T& front() { return mSlots[mFront]; }
+
+    /* Only safe while neither side is running */
+    T& slot(int index) { return mSlots[index]; }
+
+private:
+    static constexpr uint8_t kFreshBit = 0x4;
+    static constexpr uint8_t kIndexMask = 0x3;
+
+    T mSlots[3];
+    uint8_t mBack = 0;
+    uint8_t mFront = 1;
+    std::atomic<uint8_t> mMiddle{2};
+};
+
+#endif //BUILDING_AR_TRIPLE_BUFFER_H
@@ -1,7 +1,17 @@
 #include <arcore_manager.h>
-#include <assimp/Exporter.hpp>
+#include <chrono>
 #include <fstream>
 
+namespace {
+
+/* A drag only follows rays at least this steep to the plane, grazing ones land near the horizon */
+constexpr float kDragMinFacing = 0.05f;
+/* A hit this far off the placement plane, or tilted this much against it, is on another plane */
+constexpr float kSamePlaneMeters = 0.03f;
+constexpr float kSamePlaneCos = 0.985f;
+
+}
+
 void ARCoreManager::TransformPoint(const float model_matrix[16], const float local_point[3], float world_point[3]) {
     /* Convert the local point to homogeneous coordinates */
     float local_point_homogeneous[4] = {local_point[0], local_point[1], local_point[2], 1.0f};
@@ -24,20 +34,19 @@ void ARCoreManager::TransformPoint(const float model_matrix[16], const float loc
 bool ARCoreManager::IsDepthSupported() {
     if(!ar_session) return false;
 
-    ArConfig* ar_config = nullptr;
-    ArConfig_create(ar_session, &ar_config);
-    bool isSupported = false;
-    ArSession_isDepthModeSupported(ar_session, AR_DEPTH_MODE_AUTOMATIC,
-                                   reinterpret_cast<int32_t *>(&isSupported));
-    return isSupported;
+    int32_t isSupported = 0;
+    ArSession_isDepthModeSupported(ar_session, AR_DEPTH_MODE_AUTOMATIC, &isSupported);
+    return isSupported != 0;
 }
 
 void ARCoreManager::RotateCube(float degrees) {
-    cube_rotation_angle += glm::radians(degrees);
+    input_queue.addRotate(degrees);
+    frame_pacer.markDirty();
 }
 
 void ARCoreManager::ScaleCube(float scale) {
-    scaling_factor += scale;
+    input_queue.addScale(scale);
+    frame_pacer.markDirty();
 }
 
 void ARCoreManager::DrawVector(glm::vec3 start, glm::vec3 end) {
@@ -53,54 +62,210 @@ void ARCoreManager::DrawVector(glm::vec3 start, glm::vec3 end) {
 void ARCoreManager::OnTouch(float x, float y) {
 //    LOG_TID("SANJU : ARCoreManager::OnTouch - ");
     if(ar_session == nullptr || ar_frame == nullptr) return;
+    if(!input_queue.pushTap(x, y)) {
+        LOGE("NAT_ERROR : Input queue full, tap at %.0f, %.0f dropped", x, y);
+        return;
+    }
+    frame_pacer.markDirty();
+}
 
-    /* Reset the translation vector */
-    cube_translation_vector = glm::vec3(0.0f);
+void ARCoreManager::OnLongPress(float x, float y) {
+    if(ar_session == nullptr || ar_frame == nullptr) return;
+    if(!input_queue.pushPick(x, y)) {
+        LOGE("NAT_ERROR : Input queue full, long press at %.0f, %.0f dropped", x, y);
+        return;
+    }
+    frame_pacer.markDirty();
+}
 
-    ArHitResultList* hit_result_list = nullptr;
-    ArHitResultList_create(ar_session, &hit_result_list);
-    ArFrame_hitTest(ar_session, ar_frame, x, y, hit_result_list);
+/* Runs on the GL thread */
+void ARCoreManager::ApplyInput() {
+    InputQueue::Command command;
+    while(input_queue.pop(command)) {
+        if(command.type == InputQueue::COMMAND_TAP) HitTest(command.x, command.y, false);
+        else if(command.type == InputQueue::COMMAND_PICK) PickModel(command.x, command.y);
+        else if(command.type == InputQueue::COMMAND_TRANSLATE) ApplyTranslation(command.x, command.y, command.z);
+        else ApplyDrag(command);
+    }
 
-    int32_t hit_result_list_size = 0;
-    ArHitResultList_getSize(ar_session, hit_result_list, &hit_result_list_size);
+    /* Everything the gestures did since the previous frame, in one step */
+    InputQueue::Gestures gestures = input_queue.takeGestures();
+    cube_rotation_angle += glm::radians(gestures.rotateDegrees);
+    scaling_factor += gestures.scale;
+}
 
-    if(hit_result_list_size > 0) {
-        ArHitResult* hit_result = nullptr;
-        ArHitResult_create(ar_session, &hit_result);
-        ArHitResultList_getItem(ar_session, hit_result_list, 0, hit_result);
+/* Runs on the GL thread */
+void ARCoreManager::HitTest(float x, float y, bool plane_change_only) {
+    /* Only the latest request is answered, its flag is the one that counts */
+    hit_plane_change_only = plane_change_only;
 
-        ArTrackable* trackable = nullptr;
-        ArHitResult_acquireTrackable(ar_session, hit_result, &trackable);
-        ArTrackableType trackableType;
-        ArTrackable_getType(ar_session, trackable, &trackableType);
+    /* The tracking thread owns the frame while pipelined, the answer comes back with a snapshot */
+    if(tracking_pipeline.isRunning()) {
+        tracking_pipeline.requestHitTest(x, y);
+        return;
+    }
 
-        if(trackableType == AR_TRACKABLE_PLANE) {
-            ArPose* pose = nullptr;
-            ArPose_create(ar_session, nullptr, &pose);
-            ArHitResult_getHitPose(ar_session, hit_result, pose);
+    /* ar_frame holds this frame's update, nothing else touches it on this path */
+    float pose_matrix[16];
+    bool valid = TrackingPipeline::HitTestPlane(ar_session, ar_frame, x, y, pose_matrix);
+    OnHitResult(valid, pose_matrix);
+}
 
-            float pose_matrix[16];
-            ArPose_getMatrix(ar_session, pose, pose_matrix);
+/* Runs on the GL thread */
+void ARCoreManager::OnHitResult(bool valid, const float pose_matrix[16]) {
+    bool plane_change_only = hit_plane_change_only;
+    hit_plane_change_only = false;
+    if(!valid) return;
+    if(plane_change_only && model_place && !IsOtherPlane(pose_matrix)) return;
+    PlaceModel(pose_matrix);
+}
 
-            plane_normal = glm::vec3(pose_matrix[4], pose_matrix[5], pose_matrix[6]);
-            plane_normal = glm::normalize(plane_normal);
+bool ARCoreManager::IsOtherPlane(const float pose_matrix[16]) const {
+    glm::vec3 normal = glm::normalize(glm::vec3(pose_matrix[4], pose_matrix[5], pose_matrix[6]));
+    glm::vec3 point = glm::vec3(pose_matrix[12], pose_matrix[13], pose_matrix[14]);
+    float offset = glm::dot(point - glm::vec3(hit_pose_matrix[3]), plane_normal);
+    return glm::dot(normal, plane_normal) < kSamePlaneCos || glm::abs(offset) > kSamePlaneMeters;
+}
 
-            hit_pose_matrix = glm::make_mat4(pose_matrix);
+void ARCoreManager::OnDrag(int phase, float x, float y, int64_t eventTimeNs) {
+    if(phase < 0 || phase > InputQueue::COMMAND_DRAG_END - InputQueue::COMMAND_DRAG_START) return;
+    InputQueue::CommandType type = (InputQueue::CommandType)(InputQueue::COMMAND_DRAG_START + phase);
+    if(!input_queue.pushDrag(type, x, y, eventTimeNs)) {
+        LOGE("NAT_ERROR : Input queue full, drag event dropped");
+        return;
+    }
+    frame_pacer.markDirty();
+}
 
-//            hit_pose_matrix = glm::translate(hit_pose_matrix, glm::vec3(0.0f, 0.5 * scaling_factor, 0.0f));
+/* Runs on the GL thread. No hit tests while dragging : the touch ray meets the placement plane
+ * analytically, only the release point is hit tested in case it is over another plane */
+void ARCoreManager::ApplyDrag(const InputQueue::Command &command) {
+    if(command.type == InputQueue::COMMAND_DRAG_START) {
+        dragging = model_place && IntersectPlacementPlane(command.x, command.y, drag_start_point);
+        drag_start_translation = cube_translation_vector;
+        drag_moves = 0;
+        drag_latency_total_ms = 0.0;
+        drag_latency_max_ms = 0.0;
+        return;
+    }
+    if(!dragging) return;
+
+    if(command.type == InputQueue::COMMAND_DRAG_MOVE) {
+        /* Relative to where the drag started, the model doesn't jump under the finger */
+        glm::vec3 point;
+        if(!IntersectPlacementPlane(command.x, command.y, point)) return;
+        cube_translation_vector = drag_start_translation + (point - drag_start_point);
+        drag_motion_event_ns = command.timeNs;
+        return;
+    }
 
-            model_place = true;
-        }
+    dragging = false;
+    HitTest(command.x, command.y, true);
+    if(drag_moves > 0) {
+        LOGI("SANJU : Drag : %d frames moved, touch to motion %.2f ms average, %.2f ms max",
+             drag_moves, drag_latency_total_ms / drag_moves, drag_latency_max_ms);
     }
 }
 
+void ARCoreManager::TouchRay(float x, float y, glm::vec3 &origin, glm::vec3 &direction) const {
+    float ndc_x = 2.0f * x / (float)screen_width - 1.0f;
+    float ndc_y = 1.0f - 2.0f * y / (float)screen_height;
+    glm::vec4 near_point = inverse_view_proj * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+    glm::vec4 far_point = inverse_view_proj * glm::vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+    origin = glm::vec3(near_point) / near_point.w;
+    direction = glm::normalize(glm::vec3(far_point) / far_point.w - origin);
+}
+
+bool ARCoreManager::IntersectPlacementPlane(float x, float y, glm::vec3 &point) const {
+    if(screen_width <= 0 || screen_height <= 0) return false;
+
+    glm::vec3 origin, direction;
+    TouchRay(x, y, origin, direction);
+    float facing = glm::dot(direction, plane_normal);
+    if(glm::abs(facing) < kDragMinFacing) return false;
+
+    /* The plane goes through the placement hit point */
+    float distance = glm::dot(glm::vec3(hit_pose_matrix[3]) - origin, plane_normal) / facing;
+    if(distance <= 0.0f || distance > TrackingPipeline::kFarPlane) return false;
+    point = origin + distance * direction;
+    return true;
+}
+
+glm::mat4 ARCoreManager::ModelMatrix() const {
+    glm::mat4 model_scale = glm::scale(glm::mat4(1.0f), glm::vec3(scaling_factor));
+    glm::mat4 model_rotation = glm::rotate(glm::mat4(1.0f), cube_rotation_angle, cube_rotation_axis);
+    glm::mat4 model_translation = glm::translate(glm::mat4(1.0f), cube_translation_vector);
+    return model_translation * hit_pose_matrix * model_rotation * model_scale;
+}
+
+/* Runs on the GL thread, after the frame's matrices and gestures are in */
+bool ARCoreManager::PickModel(float x, float y) {
+    if(!model_place || !glb_model.isPickable() || screen_width <= 0 || screen_height <= 0) return false;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    glm::vec3 origin, direction;
+    TouchRay(x, y, origin, direction);
+
+    /* Into model space, where the BVH is. The direction is left unnormalized so the hit distance
+     * stays the world space one */
+    glm::mat4 model_to_world = ModelMatrix();
+    glm::mat4 world_to_model = glm::inverse(model_to_world);
+    glm::vec3 model_origin = glm::vec3(world_to_model * glm::vec4(origin, 1.0f));
+    glm::vec3 model_direction = glm::vec3(world_to_model * glm::vec4(direction, 0.0f));
+
+    MeshBvh::Hit hit;
+    bool picked = glb_model.pick(model_origin, model_direction, hit) && hit.distance <= TrackingPipeline::kFarPlane;
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    if(frame_stats.isActive()) frame_stats.recordEvent("pick_us", elapsed.count());
+    if(!picked) return false;
+
+    PickResult result;
+    result.mesh = hit.source;
+    result.triangle = hit.triangle;
+    result.point = origin + hit.distance * direction;
+    /* The previous point is brought to where the model is now, it moved with it */
+    if(model_picked) result.distance_from_previous = glm::distance(result.point, glm::vec3(model_to_world * glm::vec4(picked_point, 1.0f)));
+
+    model_picked = true;
+    picked_mesh = hit.source;
+    picked_triangle = hit.triangle;
+    picked_point = model_origin + hit.distance * model_direction;
+    LOGI("SANJU : Picked mesh %u triangle %u at %.3f, %.3f, %.3f (%.2f m away) in %.1f us", picked_mesh, picked_triangle,
+         result.point.x, result.point.y, result.point.z, hit.distance, elapsed.count());
+    if(pick_callback) pick_callback(result);
+    return true;
+}
+
+void ARCoreManager::PlaceModel(const float pose_matrix[16]) {
+    /* Reset the translation vector */
+    cube_translation_vector = glm::vec3(0.0f);
+
+    plane_normal = glm::vec3(pose_matrix[4], pose_matrix[5], pose_matrix[6]);
+    plane_normal = glm::normalize(plane_normal);
+
+    hit_pose_matrix = glm::make_mat4(pose_matrix);
+
+//    hit_pose_matrix = glm::translate(hit_pose_matrix, glm::vec3(0.0f, 0.5 * scaling_factor, 0.0f));
+
+    model_place = true;
+    frame_pacer.markDirty();
+}
+
 void ARCoreManager::TranslateCube(float x, float y, float z) {
+    if(!input_queue.pushTranslate(x, y, z)) {
+        LOGE("NAT_ERROR : Input queue full, translation dropped");
+        return;
+    }
+    frame_pacer.markDirty();
+}
+
+/* Runs on the GL thread, inverse_view is the current frame's */
+void ARCoreManager::ApplyTranslation(float x, float y, float z) {
     /* Homogenous coordinate(w) set to 0 -
      * because we don't want the translation part of the view matrix to affect the inverse calculation */
     glm::vec4 raw_direction = glm::vec4(x, y, z, 0);
 //    LOGI("SANJU : Raw direction : %f %f %f", raw_direction[0], raw_direction[1], raw_direction[2]);
-    glm::mat4 inv_view = glm::inverse(view);
-    glm::vec3 direction_in_camera_space = inv_view * raw_direction;
+    glm::vec3 direction_in_camera_space = inverse_view * raw_direction;
 //    LOGI("SANJU : After inverse direction : %f %f %f", direction_in_camera_space[0], direction_in_camera_space[1], direction_in_camera_space[2]);
 
     /* Now extracting the orientation of the hit point */
@@ -174,47 +339,58 @@ std::string ARCoreManager::LoadShaderFromAsset(const char *shaderPath) {
     return shaderCode;
 }
 
-bool ARCoreManager::ConvertToGLB(const char *inputAssetPath, const char *outputFilePath) {
-    /* Read the asset from Android assets */
-    AAsset *asset = AAssetManager_open(asset_manager, inputAssetPath, AASSET_MODE_BUFFER);
-    if(!asset) {
-        LOGE("NAT_ERROR : Failed to open in ARCoreManager::ConvertToGLB : %s", inputAssetPath);
-        return false;
+GLuint ARCoreManager::CreateModelProgram(const std::string &vertexCode, const std::string &fragmentCode, const char *define) {
+    /* The define has to come right after #version, which must stay the first line */
+    auto withDefine = [define](const std::string& code) {
+        if(!define) return code;
+        size_t lineEnd = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+        std::string line = std::string("#define ") + define + "\n";
+        return lineEnd == std::string::npos ? line + code : code.substr(0, lineEnd + 1) + line + code.substr(lineEnd + 1);
+    };
+
+    GLuint shaders[2] = { glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER) };
+    const std::string sources[2] = { withDefine(vertexCode), withDefine(fragmentCode) };
+    GLint status = 0;
+    for(int i = 0; i < 2; i++) {
+        const char* source = sources[i].c_str();
+        glShaderSource(shaders[i], 1, &source, nullptr);
+        glCompileShader(shaders[i]);
+
+        /* Checking for error */
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &status);
+        if(status == GL_FALSE) {
+            GLint logLen = 0;
+            glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &logLen);
+            std::vector<char> log(logLen);
+            glGetShaderInfoLog(shaders[i], logLen, nullptr, log.data());
+            LOGI("SANJU : Failed to compile model %s shader (%s) : %s", i == 0 ? "vertex" : "fragment",
+                 define ? define : "opaque", log.data());
+        }
     }
 
-    size_t length = AAsset_getLength(asset);
-    void *data = malloc(length);
-    AAsset_read(asset, data, length);
-    AAsset_close(asset);
-
-    /* Now import models using Assimp */
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFileFromMemory(
-            data, length,
-            aiProcess_Triangulate |
-            aiProcess_GenNormals |
-            aiProcess_FlipUVs |
-            aiProcess_JoinIdenticalVertices |
-            aiProcess_OptimizeMeshes |
-            aiProcess_EmbedTextures |
-            aiProcess_FindInstances, "fbx"
-    );
-    free(data);
-
-    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        LOGE("NAT_ERROR : Assimp error in ConvertToGLB: %s", importer.GetErrorString());
-        return false;
-    }
-
-    /* Now exporting as GLB */
-    Assimp::Exporter exporter;
-    aiReturn result = exporter.Export(scene, "glb2", outputFilePath, 0);
-
-    if(result != AI_SUCCESS) {
-        LOGE("NAT_ERROR : GLB export failed in ConvertToGLB : %s", exporter.GetErrorString());
-        return false;
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shaders[0]);
+    glAttachShader(program, shaders[1]);
+    glLinkProgram(program);
+    /* Flagged only, they go with the program */
+    glDeleteShader(shaders[0]);
+    glDeleteShader(shaders[1]);
+
+    /* Checking for error */
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status == GL_FALSE) {
+        GLint logLen = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLen);
+        std::vector<char> log(logLen);
+        glGetProgramInfoLog(program, logLen, nullptr, log.data());
+        LOGI("SANJU : Failed to link model program (%s) : %s", define ? define : "opaque", log.data());
     }
-    return true;
+    return program;
+}
+
+/* Conversion runs as a low priority job, so it never delays a model load that is in flight */
+bool ARCoreManager::ConvertToGLB(const char *inputAssetPath, const char *outputFilePath) {
+    return conversion_service.convert(inputAssetPath, outputFilePath);
 }
 
 void ARCoreManager::SetModelPath(const std::string &path) {
@@ -4,12 +4,23 @@ import android.app.Activity
 import android.content.Context
 import java.lang.ref.WeakReference
 
+/* Called on the GL thread for each long press that hits the placed model. x, y, z : world space
+ * point on the triangle. distanceFromPrevious : meters to the previous pick, -1 for the first */
+interface PickListener {
+    fun onModelPicked(mesh : Int, triangle : Int, x : Float, y : Float, z : Float, distanceFromPrevious : Float)
+}
+
 object ARNative {
     init {
         System.loadLibrary("buildingar")
         println("SANJU : ARNative::Init")
     }
 
+    /* Phases of nativeOnDrag */
+    const val DRAG_START = 0
+    const val DRAG_MOVE = 1
+    const val DRAG_END = 2
+
     private var isSurfaceCreated : Boolean = false
     private var pendingModelPath : String? = null
     private val lock = Any()
@@ -49,19 +60,79 @@ object ARNative {
         arSurfaceViewWeak?.get()?.runOnGLThread(action)
     }
 
+    /* The frame-time benchmark lives on the GL thread next to the frame loop it measures */
+    fun startBenchmark(reportPath : String) {
+        println("SANJU : ARNative::startBenchmark")
+        runOnGLThread { nativeStartBenchmark(reportPath) }
+    }
+
+    fun stopBenchmark() {
+        println("SANJU : ARNative::stopBenchmark")
+        runOnGLThread { nativeStopBenchmark() }
+    }
+
+    /* Any thread. Caps the render rate, stationaryFps while the camera doesn't move. 0 : uncapped */
+    fun setFrameRateCaps(maxFps : Int, stationaryFps : Int) {
+        println("SANJU : ARNative::setFrameRateCaps $maxFps / $stationaryFps")
+        nativeSetFrameRateCaps(maxFps, stationaryFps)
+    }
+
+    /* ArSession_update on its own thread, the render thread only picks up the latest frame */
+    fun setTrackingPipelineEnabled(enabled : Boolean) {
+        println("SANJU : ARNative::setTrackingPipelineEnabled $enabled")
+        runOnGLThread { nativeSetTrackingPipelineEnabled(enabled) }
+    }
+
+    /* Model buffers and textures uploaded on a native thread with a shared EGL context */
+    fun setBackgroundUploadsEnabled(enabled : Boolean) {
+        println("SANJU : ARNative::setBackgroundUploadsEnabled $enabled")
+        runOnGLThread { nativeSetBackgroundUploadsEnabled(enabled) }
+    }
+
+    /* The pick callback lives on the GL thread next to the picks. null stops the reports */
+    fun setPickListener(listener : PickListener?) {
+        println("SANJU : ARNative::setPickListener")
+        runOnGLThread { nativeSetPickListener(listener) }
+    }
+
     external fun onCreate(context: Context)
     external fun onResume(activity: Activity)
     external fun onPause()
     external fun nativeOnSurfaceCreated()
     external fun onDrawFrame(width : Int, height : Int, displayRotation : Int)
+    /* Main thread, once per vsync : false when the frame would show nothing new or the cap holds it back */
+    external fun nativeShouldRender(frameTimeNanos : Long) : Boolean
+    external fun nativeSetFrameRateCaps(maxFps : Int, stationaryFps : Int)
     external fun onTouch(x : Float, y : Float)
+    /* Picks the model's triangle under the point, see PickListener */
+    external fun onLongPress(x : Float, y : Float)
+    external fun nativeSetPickListener(listener : PickListener?)
+    /* phase : DRAG_START, DRAG_MOVE or DRAG_END. eventTimeMillis : the touch event's uptimeMillis */
+    external fun nativeOnDrag(phase : Int, x : Float, y : Float, eventTimeMillis : Long)
 
     external fun onRotateCube(degrees : Float)
     external fun onScaleCube(scale : Float)
     external fun onTranslateCube(x : Float, y : Float, z : Float)
 
     external fun nativeConvertToGLB(inputPath : String, outputPath : String) : Boolean
+    /* Blocking, returns the cached (or freshly converted) GLB / .arpk package path, empty on failure */
+    external fun nativeConvertCached(inputPath : String, outputDir : String, packaged : Boolean) : String
+    /* Returns right away, the listener is called on a native worker thread per input */
+    external fun nativeConvertBatch(inputPaths : Array<String>, outputDir : String, packaged : Boolean, listener : ConversionListener?)
+    external fun nativeResumeConversions(outputDir : String, listener : ConversionListener?) : Int
     external fun setModelPath(modelPath : String)
     external fun nativeLoadModel(modelPath : String)
 
+    external fun nativeStartRecording(datasetUri : String) : Boolean
+    external fun nativeStopRecording() : Boolean
+    external fun nativeSetPlaybackDataset(datasetUri : String) : Boolean
+    external fun nativeStartBenchmark(reportPath : String)
+    external fun nativeStopBenchmark() : Boolean
+    external fun nativeSetTrackingPipelineEnabled(enabled : Boolean)
+    external fun nativeSetBackgroundUploadsEnabled(enabled : Boolean)
+    /* Blocking, call it off the main and GL threads */
+    external fun nativeBenchmarkParsers(modelPath : String, reportPath : String) : Boolean
+    /* Blocking, call it off the main and GL threads */
+    external fun nativeBenchmarkPicking(modelPath : String, reportPath : String) : Boolean
+
 }
\ No newline at end of file
@@ -4,6 +4,7 @@ import android.content.Context
 import android.hardware.display.DisplayManager
 import android.opengl.GLES20
 import android.opengl.GLSurfaceView
+import android.view.Choreographer
 import android.view.Display
 import android.view.Surface
 import android.view.SurfaceHolder
@@ -13,7 +14,7 @@ import kotlinx.coroutines.flow.StateFlow
 import javax.microedition.khronos.egl.EGLConfig
 import javax.microedition.khronos.opengles.GL10
 
-class ARSurfaceView(context: Context) : GLSurfaceView(context), GLSurfaceView.Renderer {
+class ARSurfaceView(context: Context) : GLSurfaceView(context), GLSurfaceView.Renderer, Choreographer.FrameCallback {
 
     enum class SurfaceState { INITIAL, CREATED, CHANGED, PAUSED, DESTROYED }
     private val _surfaceState = MutableStateFlow<SurfaceState>(SurfaceState.INITIAL)
@@ -22,6 +23,8 @@ class ARSurfaceView(context: Context) : GLSurfaceView(context), GLSurfaceView.Re
     private var displayRotation : Int = 0
     private val displayManager  = context.getSystemService(Context.DISPLAY_SERVICE) as DisplayManager
     private val display : Display? = displayManager.getDisplay(Display.DEFAULT_DISPLAY)
+    /* Main thread only */
+    private var pacing = false
 
     init {
         /* Called on the main thread */
@@ -35,7 +38,9 @@ class ARSurfaceView(context: Context) : GLSurfaceView(context), GLSurfaceView.Re
         /* Force the surface to be drawn on top of the window */
 //        setZOrderOnTop(true)
 
-        renderMode = RENDERMODE_CONTINUOUSLY
+        /* Rendered on demand : every frame drawn is swapped, so the native side decides per vsync
+         * whether there is anything new to draw (see doFrame) */
+        renderMode = RENDERMODE_WHEN_DIRTY
         println("SANJU : ARSurfaceView::Init")
     }
 
@@ -66,9 +71,18 @@ class ARSurfaceView(context: Context) : GLSurfaceView(context), GLSurfaceView.Re
         ARNative.onDrawFrame(width, height, displayRotation)
     }
 
+    /* Called on the main thread, once per display vsync while resumed */
+    override fun doFrame(frameTimeNanos: Long) {
+        if(!pacing) return
+        if(ARNative.nativeShouldRender(frameTimeNanos)) requestRender()
+        Choreographer.getInstance().postFrameCallback(this)
+    }
+
     /* Called on the main thread */
     override fun onPause() {
         super.onPause()
+        pacing = false
+        Choreographer.getInstance().removeFrameCallback(this)
         println("SANJU : ARSurfaceView::onPause")
         _surfaceState.value = SurfaceState.PAUSED
     }
@@ -76,6 +90,10 @@ class ARSurfaceView(context: Context) : GLSurfaceView(context), GLSurfaceView.Re
     /* Called on the main thread */
     override fun onResume() {
         super.onResume()
+        if(!pacing) {
+            pacing = true
+            Choreographer.getInstance().postFrameCallback(this)
+        }
         println("SANJU : ARSurfaceView::onResume")
     }
 
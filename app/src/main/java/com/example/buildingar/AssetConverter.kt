@@ -3,24 +3,33 @@ package com.example.buildingar
 import android.content.Context
 import java.io.File
 
-class AssetConverter(private val context: Context) {
+/* Called on a native worker thread, output is empty if the conversion failed */
+interface ConversionListener {
+    fun onConversionProgress(input : String, output : String, done : Int, total : Int)
+}
 
-    fun convertModel(assetPath : String) : String {
-        val outputFile = File(context.filesDir, "converted/${assetPath.substringAfterLast('/')}.glb")
+class AssetConverter(private val context: Context) {
 
-        /* If the file already exists */
-        if(outputFile.exists()) {
-            return outputFile.absolutePath
-        }
+    private val outputDir = File(context.filesDir, "converted")
 
-        /* If the file does not already exists, create the file */
-        outputFile.parentFile?.mkdirs()
+    /* Blocking. The native side keys its cache on the asset content and converter version,
+     * so an edited asset or a converter update is converted again. packaged produces a
+     * ready-to-render .arpk instead of a GLB, the model loader maps and uploads it as is */
+    fun convertModel(assetPath : String, packaged : Boolean = false) : String {
+        outputDir.mkdirs()
+        return ARNative.nativeConvertCached(assetPath, outputDir.absolutePath, packaged)
+    }
 
-        val success = ARNative.nativeConvertToGLB(
-            assetPath,
-            outputFile.absolutePath
-        )
+    /* Converts several assets in parallel, progress is reported per finished input */
+    fun convertModels(assetPaths : List<String>, listener : ConversionListener?, packaged : Boolean = false) {
+        if(assetPaths.isEmpty()) return
+        outputDir.mkdirs()
+        ARNative.nativeConvertBatch(assetPaths.toTypedArray(), outputDir.absolutePath, packaged, listener)
+    }
 
-        return if(success) outputFile.absolutePath else ""
+    /* Picks up conversions a previous run didn't finish, returns how many were queued */
+    fun resumePending(listener : ConversionListener?) : Int {
+        outputDir.mkdirs()
+        return ARNative.nativeResumeConversions(outputDir.absolutePath, listener)
     }
-}
\ No newline at end of file
+}
@@ -10,6 +10,7 @@ import android.net.Uri
 import android.os.Build
 import androidx.appcompat.app.AppCompatActivity
 import android.os.Bundle
+import android.os.SystemClock
 import android.provider.OpenableColumns
 import android.widget.TextView
 import androidx.activity.ComponentActivity
@@ -21,6 +22,7 @@ import androidx.activity.viewModels
 import androidx.annotation.RequiresApi
 import androidx.compose.foundation.Image
 import androidx.compose.foundation.clickable
+import androidx.compose.foundation.gestures.detectDragGestures
 import androidx.compose.foundation.gestures.detectTapGestures
 import androidx.compose.foundation.layout.Arrangement
 import androidx.compose.foundation.layout.Box
@@ -52,6 +54,7 @@ import com.google.android.gms.ads.AdSize
 import com.google.android.gms.ads.AdView
 import com.google.android.gms.ads.MobileAds
 import kotlinx.coroutines.Job
+import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.launch
 import java.io.File
 import kotlin.jvm.java
@@ -76,6 +79,16 @@ class MainActivity : ComponentActivity() {
     private lateinit var arSurfaceView: ARSurfaceView
     private lateinit var surfaceStateJob : Job
 
+    /* Latest long press pick on the model, shown under the ad. Set on the GL thread */
+    private val pickedModelText = MutableStateFlow<String?>(null)
+    private val pickListener = object : PickListener {
+        override fun onModelPicked(mesh : Int, triangle : Int, x : Float, y : Float, z : Float, distanceFromPrevious : Float) {
+            var text = "Mesh $mesh, triangle $triangle at %.2f, %.2f, %.2f".format(x, y, z)
+            if(distanceFromPrevious >= 0.0f) text += "\n%.2f m from the previous point".format(distanceFromPrevious)
+            pickedModelText.value = text
+        }
+    }
+
     override fun getAssets(): AssetManager {
         return super.getAssets()
     }
@@ -96,6 +109,20 @@ class MainActivity : ComponentActivity() {
 
         cameraPermissionViewModel.checkCameraPermission()
         ARNative.onCreate(this)
+        ARNative.setPickListener(pickListener)
+        startBenchmarkIfRequested(intent)
+        if(intent.getBooleanExtra(EXTRA_TRACKING_PIPELINE, false)) {
+            ARNative.setTrackingPipelineEnabled(true)
+        }
+        if(intent.getBooleanExtra(EXTRA_BACKGROUND_UPLOADS, false)) {
+            ARNative.setBackgroundUploadsEnabled(true)
+        }
+        /* Frames are only rendered for new camera images or input, these cap them further, e.g.
+         * --ei max_fps 60 --ei stationary_fps 30 (0 : uncapped) */
+        ARNative.setFrameRateCaps(intent.getIntExtra(EXTRA_MAX_FPS, 0),
+            intent.getIntExtra(EXTRA_STATIONARY_FPS, DEFAULT_STATIONARY_FPS))
+        benchmarkParsersIfRequested(intent)
+        benchmarkPickingIfRequested(intent)
 
         enableEdgeToEdge()
         setContent {
@@ -182,6 +209,42 @@ class MainActivity : ComponentActivity() {
         }
     }
 
+    /* Benchmark mode : replays a recorded ARCore dataset and writes frame-time percentiles, e.g.
+     * adb shell am start -n com.example.buildingar/.MainActivity --es playback_dataset <dataset uri> */
+    private fun startBenchmarkIfRequested(intent : Intent) {
+        val dataset = intent.getStringExtra(EXTRA_PLAYBACK_DATASET) ?: return
+        /* Must happen before the session is resumed */
+        if(!ARNative.nativeSetPlaybackDataset(dataset)) {
+            println("SANJU : MainActivity::startBenchmarkIfRequested : playback dataset rejected")
+            return
+        }
+        val report = intent.getStringExtra(EXTRA_BENCHMARK_REPORT)
+            ?: File(filesDir, "benchmark.txt").absolutePath
+        ARNative.startBenchmark(report)
+    }
+
+    /* GLB parser benchmark : GLBReader vs Assimp on the same file, e.g.
+     * adb shell am start -n com.example.buildingar/.MainActivity --es parse_benchmark <model.glb> */
+    private fun benchmarkParsersIfRequested(intent : Intent) {
+        val model = intent.getStringExtra(EXTRA_PARSE_BENCHMARK) ?: return
+        val report = File(filesDir, "parse_benchmark.txt").absolutePath
+        Thread {
+            val success = ARNative.nativeBenchmarkParsers(model, report)
+            println("SANJU : MainActivity::benchmarkParsersIfRequested : $success -> $report")
+        }.start()
+    }
+
+    /* Picking BVH build time and rays per second on a model's triangles, e.g.
+     * adb shell am start -n com.example.buildingar/.MainActivity --es pick_benchmark <model.glb> */
+    private fun benchmarkPickingIfRequested(intent : Intent) {
+        val model = intent.getStringExtra(EXTRA_PICK_BENCHMARK) ?: return
+        val report = File(filesDir, "pick_benchmark.txt").absolutePath
+        Thread {
+            val success = ARNative.nativeBenchmarkPicking(model, report)
+            println("SANJU : MainActivity::benchmarkPickingIfRequested : $success -> $report")
+        }.start()
+    }
+
     override fun onPause() {
         super.onPause()
         println("SANJU : MainActivity::onPause() ${Thread.currentThread().name}")
@@ -225,19 +288,58 @@ class MainActivity : ComponentActivity() {
 //        return true
 //    }
 
+    companion object {
+        const val EXTRA_PLAYBACK_DATASET = "playback_dataset"
+        const val EXTRA_BENCHMARK_REPORT = "benchmark_report"
+        const val EXTRA_TRACKING_PIPELINE = "tracking_pipeline"
+        const val EXTRA_BACKGROUND_UPLOADS = "background_uploads"
+        const val EXTRA_PARSE_BENCHMARK = "parse_benchmark"
+        const val EXTRA_PICK_BENCHMARK = "pick_benchmark"
+        const val EXTRA_MAX_FPS = "max_fps"
+        const val EXTRA_STATIONARY_FPS = "stationary_fps"
+        const val DEFAULT_STATIONARY_FPS = 30
+    }
+
     @Composable
     fun ArViewWithTouch() {
         val configuration = LocalConfiguration.current
         val isLandscape = (configuration.orientation == Configuration.ORIENTATION_LANDSCAPE)
         val context = LocalContext.current
+        val pickedModel by pickedModelText.collectAsState()
 
         Box(
             modifier = Modifier
                 .fillMaxSize()
                 .pointerInput(Unit) {
-                    detectTapGestures { offset : Offset ->
-                        ARNative.onTouch(offset.x, offset.y)
-                    }
+                    /* A tap places the model, a long press picks the point of it under the finger */
+                    detectTapGestures(
+                        onLongPress = { offset : Offset ->
+                            ARNative.onLongPress(offset.x, offset.y)
+                        },
+                        onTap = { offset : Offset ->
+                            ARNative.onTouch(offset.x, offset.y)
+                        }
+                    )
+                }
+                .pointerInput(Unit) {
+                    /* Drags the placed model along its plane, every move event goes to native as is */
+                    var last = Offset.Zero
+                    detectDragGestures(
+                        onDragStart = { offset : Offset ->
+                            last = offset
+                            ARNative.nativeOnDrag(ARNative.DRAG_START, offset.x, offset.y, SystemClock.uptimeMillis())
+                        },
+                        onDragEnd = {
+                            ARNative.nativeOnDrag(ARNative.DRAG_END, last.x, last.y, SystemClock.uptimeMillis())
+                        },
+                        onDragCancel = {
+                            ARNative.nativeOnDrag(ARNative.DRAG_END, last.x, last.y, SystemClock.uptimeMillis())
+                        },
+                        onDrag = { change, _ ->
+                            last = change.position
+                            ARNative.nativeOnDrag(ARNative.DRAG_MOVE, last.x, last.y, change.uptimeMillis)
+                        }
+                    )
                 }
         ) {
 
@@ -331,6 +433,9 @@ class MainActivity : ComponentActivity() {
                 horizontalAlignment = Alignment.CenterHorizontally
             ) {
                 BannerAd()
+                pickedModel?.let { text ->
+                    Text(text, modifier = Modifier.padding(top = 8.dp))
+                }
             }
         }
     }
@@ -0,0 +1,84 @@
+/*
+ * DepthOcclusion::ConvertDepth16 (SSE2 on x86 hosts, NEON on arm64 ones) against the plain
+ * per pixel conversion, over the widths and strides ARCore hands out.
+ */
+#include <depth_occlusion.h>
+#include <host_test.h>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+/* What every path must produce, the scalar tail of ConvertDepth16 written out */
+float ReferenceMeters(uint16_t mm) {
+    return mm ? (float)mm * 0.001f : DepthOcclusion::kUnknownDepth;
+}
+
+/* Converts a random image with the given padding after each row, one in zeroSpacing pixels 0.
+ * Returns the number of mismatches, and checks nothing is written past width * height */
+int ConvertAndCompare(int32_t width, int32_t height, int32_t paddingBytes, int zeroSpacing, uint32_t seed) {
+    int32_t rowStride = width * 2 + paddingBytes;
+    /* 2 bytes in, so the 16 byte loads are never aligned by accident */
+    std::vector<uint8_t> storage((size_t)rowStride * height + 2, 0xCD);
+    uint8_t* src = storage.data() + 2;
+
+    std::mt19937 random(seed);
+    std::vector<uint16_t> pixels((size_t)width * height);
+    for(int32_t y = 0; y < height; y++) {
+        for(int32_t x = 0; x < width; x++) {
+            uint16_t mm = (uint16_t)(random() % 65536);
+            if(random() % zeroSpacing == 0) mm = 0;
+            /* The extremes on every row */
+            if(x == 0) mm = 0;
+            if(x == width - 1) mm = 65535;
+            pixels[(size_t)y * width + x] = mm;
+            memcpy(src + (size_t)y * rowStride + x * 2, &mm, 2);
+        }
+    }
+
+    constexpr float kGuard = -1.0f;
+    std::vector<float> meters((size_t)width * height + 4, kGuard);
+    DepthOcclusion::ConvertDepth16(src, rowStride, width, height, meters.data());
+
+    int mismatches = 0;
+    for(size_t i = 0; i < pixels.size(); i++) {
+        if(meters[i] != ReferenceMeters(pixels[i])) mismatches++;
+    }
+    for(size_t i = pixels.size(); i < meters.size(); i++) {
+        if(meters[i] != kGuard) mismatches++;
+    }
+    return mismatches;
+}
+
+}
+
+TEST(DepthOcclusion, ConvertMatchesScalarOnPackedRows) {
+    /* The vector loop covers everything */
+    EXPECT_EQ(ConvertAndCompare(160, 90, 0, 7, 1), 0);
+    EXPECT_EQ(ConvertAndCompare(256, 192, 0, 3, 2), 0);
+}
+
+TEST(DepthOcclusion, ConvertMatchesScalarOnTails) {
+    /* Widths that leave 1 to 7 pixels for the scalar tail, and ones with no vector loop at all */
+    for(int32_t width = 1; width <= 25; width++) {
+        EXPECT_EQ(ConvertAndCompare(width, 5, 0, 4, 100 + width), 0);
+    }
+}
+
+TEST(DepthOcclusion, ConvertHonoursPaddedRowStride) {
+    /* Row padding is garbage (0xCD) and must never leak into the next row */
+    for(int32_t padding : {2, 6, 16, 30}) {
+        EXPECT_EQ(ConvertAndCompare(37, 11, padding, 5, 200 + padding), 0);
+        EXPECT_EQ(ConvertAndCompare(64, 4, padding, 5, 300 + padding), 0);
+    }
+}
+
+TEST(DepthOcclusion, ZeroDepthIsUnknownEverywhere) {
+    constexpr int32_t kWidth = 19;
+    std::vector<uint16_t> zeros(kWidth * 3, 0);
+    std::vector<float> meters(zeros.size(), 0.0f);
+    DepthOcclusion::ConvertDepth16(reinterpret_cast<const uint8_t*>(zeros.data()), kWidth * 2, kWidth, 3, meters.data());
+    for(float value : meters) EXPECT_EQ(value, DepthOcclusion::kUnknownDepth);
+}
@@ -0,0 +1,234 @@
+/*
+ * ARCoreManager's frame loop against arcore_sim and llvmpipe : a recorded trace is replayed one
+ * frame per OnDrawFrame and the results are read back from the framebuffer.
+ */
+#include <arcore_manager.h>
+#include <arcore_sim.h>
+#include <host_assets.h>
+#include <host_gl.h>
+#include <host_test.h>
+#include <test_models.h>
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kWidth = 320;
+constexpr int kHeight = 240;
+constexpr int kTraceFrames = 24;
+const char* kTracePath = BUILDINGAR_TEST_DATA_DIR "/floor_orbit.trace";
+
+struct Pixel {
+    int r, g, b;
+};
+
+Pixel ReadPixel(int x, int y) {
+    unsigned char rgba[4] = {0, 0, 0, 0};
+    /* GL's origin is the bottom left, touches come from the top left */
+    glReadPixels(x, kHeight - 1 - y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    return {rgba[0], rgba[1], rgba[2]};
+}
+
+/* A session over the trace with its surface created, like the activity after onResume */
+struct Harness {
+    HostGlContext gl;
+    std::unique_ptr<ARCoreManager> manager;
+
+    void start(bool playback) {
+        if(!gl.create(kWidth, kHeight)) SKIP_TEST("no EGL display with GLES 3");
+        ASSERT_TRUE(ArSim_loadTrace(kTracePath));
+        manager = std::make_unique<ARCoreManager>();
+        ASSERT_TRUE(manager->Initialize(nullptr, nullptr, HostAssets_create(BUILDINGAR_ASSETS_DIR)));
+        if(playback) ASSERT_TRUE(manager->SetPlaybackDataset(kTracePath));
+        manager->Resume();
+        manager->OnSurfaceCreated();
+    }
+
+    void drawFrame() {
+        manager->OnDrawFrame(kWidth, kHeight, 0);
+        glFinish();
+    }
+};
+
+}
+
+TEST(FrameLoop, ReplaysOneTraceFramePerDraw) {
+    Harness harness;
+    harness.start(false);
+    for(int frame = 0; frame < kTraceFrames + 2; frame++) {
+        harness.drawFrame();
+        /* The free running trace loops */
+        EXPECT_EQ(ArSim_getFrameIndex(), frame % kTraceFrames);
+    }
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(FrameLoop, DrawsTrackedPlanes) {
+    Harness harness;
+    harness.start(false);
+    harness.drawFrame();
+    /* The camera looks at the floor's center, the plane pass tints it green over the camera image */
+    Pixel center = ReadPixel(kWidth / 2, kHeight / 2);
+    EXPECT_GT(center.g, center.r + 10);
+    EXPECT_GT(center.g, center.b + 10);
+}
+
+TEST(FrameLoop, TapPlacesLoadedModelOnPlane) {
+    Harness harness;
+    harness.start(false);
+    std::string model = host_test::TempPath("frame_loop_box.glb");
+    ASSERT_TRUE(WriteBoxGlb(model, 2.0f));
+    harness.manager->loadModelFromIntent(model);
+
+    /* Loads on the job system, poll() in the frame loop picks the results up */
+    for(int frame = 0; frame < 200; frame++) {
+        harness.drawFrame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    Pixel before = ReadPixel(kWidth / 2, kHeight / 2);
+
+    harness.manager->OnTouch(kWidth / 2.0f, kHeight / 2.0f);
+    harness.drawFrame();
+    harness.drawFrame();
+    Pixel after = ReadPixel(kWidth / 2, kHeight / 2);
+    /* The box covers the floor under the tap, it isn't plane green anymore */
+    int change = std::abs(after.r - before.r) + std::abs(after.g - before.g) + std::abs(after.b - before.b);
+    EXPECT_GT(change, 30);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(FrameLoop, LongPressPicksThePlacedModelTapsPlaceIt) {
+    Harness harness;
+    harness.start(false);
+    std::string model = host_test::TempPath("frame_loop_pick_box.glb");
+    ASSERT_TRUE(WriteBoxGlb(model, 2.0f));
+    harness.manager->loadModelFromIntent(model);
+    std::vector<ARCoreManager::PickResult> picks;
+    harness.manager->SetPickCallback([&picks](const ARCoreManager::PickResult& pick) { picks.push_back(pick); });
+
+    /* Loaded and its BVH built on the job system */
+    for(int frame = 0; frame < 200; frame++) {
+        harness.drawFrame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    harness.manager->OnTouch(kWidth / 2.0f, kHeight / 2.0f);
+    harness.drawFrame();
+
+    harness.manager->OnLongPress(kWidth / 2.0f, kHeight / 2.0f);
+    harness.drawFrame();
+    ASSERT_EQ(picks.size(), (size_t)1);
+    EXPECT_LT(picks[0].triangle, 12u);
+    EXPECT_LT(picks[0].distance_from_previous, 0.0f);
+
+    /* The camera orbits between frames : another point of the box, measured in world space */
+    harness.manager->OnLongPress(kWidth / 2.0f, kHeight / 2.0f);
+    harness.drawFrame();
+    ASSERT_EQ(picks.size(), (size_t)2);
+    EXPECT_NEAR(picks[1].distance_from_previous, glm::distance(picks[0].point, picks[1].point), 1e-4f);
+
+    /* Taps on the model place it again, they don't pick */
+    harness.manager->OnTouch(kWidth / 2.0f, kHeight / 2.0f);
+    harness.drawFrame();
+    EXPECT_EQ(picks.size(), (size_t)2);
+
+    /* Off the model */
+    harness.manager->OnLongPress(2.0f, 2.0f);
+    harness.drawFrame();
+    EXPECT_EQ(picks.size(), (size_t)2);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(FrameLoop, PlaybackBenchmarkWritesReport) {
+    Harness harness;
+    harness.start(true);
+    std::string report = host_test::TempPath("frame_loop_benchmark.txt");
+    std::remove(report.c_str());
+    harness.manager->StartBenchmark(report);
+
+    /* Playback stops on the trace's last frame, the benchmark ends with it */
+    for(int frame = 0; frame < kTraceFrames + 1; frame++) harness.drawFrame();
+    EXPECT_FALSE(harness.manager->StopBenchmark());
+
+    std::ifstream file(report);
+    ASSERT_TRUE(file.is_open());
+    std::string stage;
+    size_t samples = 0;
+    bool sawFrame = false;
+    while(file >> stage) {
+        if(stage == "frame" && file >> samples) {
+            sawFrame = true;
+            break;
+        }
+    }
+    EXPECT_TRUE(sawFrame);
+    EXPECT_GE(samples, (size_t)kTraceFrames - 1);
+}
+
+TEST(FrameLoop, PipelinedTrackingSurvivesSurfaceRecreation) {
+    Harness harness;
+    harness.start(false);
+    harness.manager->SetTrackingPipelineEnabled(true);
+    for(int frame = 0; frame < 10; frame++) harness.drawFrame();
+
+    /* Like the activity coming back with a new surface and context */
+    ASSERT_TRUE(harness.gl.recreate());
+    harness.manager->OnSurfaceCreated();
+    for(int frame = 0; frame < 10; frame++) {
+        harness.drawFrame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    /* Tracking snapshots keep arriving and the camera pass still covers the plane */
+    Pixel center = ReadPixel(kWidth / 2, kHeight / 2);
+    EXPECT_GT(center.g, center.r + 10);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(FrameLoop, FramesWithoutASnapshotCloseTheirCounters) {
+    Harness harness;
+    harness.start(false);
+    std::string report = host_test::TempPath("frame_loop_counters.txt");
+    std::remove(report.c_str());
+    harness.manager->StartBenchmark(report);
+    /* The first frames come before the tracking thread published anything, they only clear */
+    harness.manager->SetTrackingPipelineEnabled(true);
+    for(int frame = 0; frame < 10; frame++) {
+        harness.drawFrame();
+        if(frame >= 5) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    EXPECT_TRUE(harness.manager->StopBenchmark());
+
+    /* One counter sample per timed frame, none dropped or carried into the next frame */
+    std::ifstream file(report);
+    ASSERT_TRUE(file.is_open());
+    std::string name;
+    size_t frames = 0, stateCallFrames = 0;
+    while(file >> name) {
+        if(name == "frame") file >> frames;
+        else if(name == "state_calls") file >> stateCallFrames;
+    }
+    EXPECT_EQ(frames, (size_t)10);
+    EXPECT_EQ(stateCallFrames, frames);
+}
+
+TEST(FrameLoop, StateChangedBetweenFramesIsReissued) {
+    Harness harness;
+    harness.start(false);
+    harness.drawFrame();
+
+    /* What ArSession_update may do to the render context, unseen by the state cache */
+    glUseProgram(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE3);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    harness.drawFrame();
+
+    Pixel center = ReadPixel(kWidth / 2, kHeight / 2);
+    EXPECT_GT(center.g, center.r + 10);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
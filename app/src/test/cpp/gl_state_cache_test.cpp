@@ -0,0 +1,176 @@
+/*
+ * GLStateCache over a recording GLBackend : which calls reach the driver, and that the model's
+ * uploads invalidate it. The frame loop's own invalidate point is covered in frame_loop_test.
+ */
+#include <gl_state_cache.h>
+#include <glb_renderer_async.h>
+#include <host_gl.h>
+#include <host_test.h>
+#include <test_models.h>
+
+#include <GLES2/gl2ext.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Call {
+    std::string name;
+    GLuint a, b;
+
+    bool operator==(const Call& other) const { return name == other.name && a == other.a && b == other.b; }
+};
+
+std::vector<Call> gCalls;
+
+void Record(const char* name, GLuint a = 0, GLuint b = 0) { gCalls.push_back(Call{name, a, b}); }
+
+const GLBackend kRecording = {
+        [](GLuint program) { Record("useProgram", program); },
+        [](GLuint array) { Record("bindVertexArray", array); },
+        [](GLenum unit) { Record("activeTexture", unit); },
+        [](GLenum target, GLuint texture) { Record("bindTexture", target, texture); },
+        [](GLenum target, GLuint buffer) { Record("bindBuffer", target, buffer); },
+        [](GLenum cap) { Record("enable", cap); },
+        [](GLenum cap) { Record("disable", cap); },
+        [](GLenum sfactor, GLenum dfactor) { Record("blendFunc", sfactor, dfactor); },
+        [](GLenum srcRGB, GLenum dstRGB, GLenum, GLenum) { Record("blendFuncSeparate", srcRGB, dstRGB); },
+        [](GLenum func) { Record("depthFunc", func); },
+        [](GLboolean flag) { Record("depthMask", flag); },
+};
+
+/* Calls recorded since the previous Take() */
+std::vector<Call> Take() {
+    std::vector<Call> calls;
+    calls.swap(gCalls);
+    return calls;
+}
+
+}
+
+TEST(GLStateCache, ForwardsOnlyChanges) {
+    GLStateCache state(kRecording);
+    Take();
+    state.useProgram(5);
+    state.useProgram(5);
+    state.bindVertexArray(2);
+    state.bindVertexArray(2);
+    state.setEnabled(GL_DEPTH_TEST, true);
+    state.setEnabled(GL_DEPTH_TEST, true);
+    state.setEnabled(GL_DEPTH_TEST, false);
+    state.depthFunc(GL_LESS);
+    state.depthFunc(GL_LESS);
+    state.depthMask(false);
+    state.depthMask(false);
+
+    std::vector<Call> expected = {
+            {"useProgram", 5, 0}, {"bindVertexArray", 2, 0}, {"enable", GL_DEPTH_TEST, 0},
+            {"disable", GL_DEPTH_TEST, 0}, {"depthFunc", GL_LESS, 0}, {"depthMask", GL_FALSE, 0},
+    };
+    EXPECT_TRUE(Take() == expected);
+    EXPECT_EQ(state.counters().issued, (uint64_t)6);
+    EXPECT_EQ(state.counters().skipped, (uint64_t)5);
+}
+
+TEST(GLStateCache, InvalidateReissuesEverything) {
+    GLStateCache state(kRecording);
+    state.useProgram(5);
+    state.bindBuffer(GL_ARRAY_BUFFER, 3);
+    state.setEnabled(GL_BLEND, true);
+    state.blendFunc(GL_ONE, GL_ZERO);
+    Take();
+
+    state.invalidate();
+    state.useProgram(5);
+    state.bindBuffer(GL_ARRAY_BUFFER, 3);
+    state.setEnabled(GL_BLEND, true);
+    state.blendFunc(GL_ONE, GL_ZERO);
+    EXPECT_EQ(Take().size(), (size_t)4);
+
+    /* Known again right after */
+    state.useProgram(5);
+    state.blendFunc(GL_ONE, GL_ZERO);
+    EXPECT_TRUE(Take().empty());
+}
+
+TEST(GLStateCache, TracksTexturesPerUnitAndTarget) {
+    GLStateCache state(kRecording);
+    state.bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 7);
+    state.bindTexture(GL_TEXTURE0, GL_TEXTURE_EXTERNAL_OES, 8);
+    state.bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, 7);
+    Take();
+
+    /* Same bindings on both units : only the unit switches are issued */
+    state.bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 7);
+    state.bindTexture(GL_TEXTURE0, GL_TEXTURE_EXTERNAL_OES, 8);
+    state.bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, 7);
+    std::vector<Call> expected = { {"activeTexture", GL_TEXTURE0, 0}, {"activeTexture", GL_TEXTURE1, 0} };
+    EXPECT_TRUE(Take() == expected);
+
+    /* An untracked target is forwarded and the unit's bindings become unknown */
+    state.bindTexture(GL_TEXTURE_3D, 9);
+    state.bindTexture(GL_TEXTURE_2D, 7);
+    expected = { {"bindTexture", GL_TEXTURE_3D, 9}, {"bindTexture", GL_TEXTURE_2D, 7} };
+    EXPECT_TRUE(Take() == expected);
+}
+
+TEST(GLStateCache, BlendFuncsShareOneShadow) {
+    GLStateCache state(kRecording);
+    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    Take();
+    /* Equal color and alpha factors are what blendFunc already set */
+    state.blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    EXPECT_TRUE(Take().empty());
+    state.blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    EXPECT_EQ(Take().size(), (size_t)1);
+    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    EXPECT_EQ(Take().size(), (size_t)1);
+}
+
+TEST(GLStateCache, UntrackedBuffersAndCapsAlwaysForward) {
+    GLStateCache state(kRecording);
+    Take();
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 4);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 4);
+    state.setEnabled(GL_SCISSOR_TEST, true);
+    state.setEnabled(GL_SCISSOR_TEST, true);
+    EXPECT_EQ(Take().size(), (size_t)4);
+}
+
+TEST(GLStateCache, ModelPollInvalidatesOnlyAfterUploads) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    std::string path = host_test::TempPath("state_cache_box.glb");
+    ASSERT_TRUE(WriteBoxGlb(path, 1.0f));
+
+    GLStateCache state(kRecording);
+    GLBModelAsync model;
+    state.useProgram(5);
+
+    /* Nothing loaded, nothing uploaded : the cache still knows the program */
+    model.poll(state);
+    Take();
+    state.useProgram(5);
+    EXPECT_TRUE(Take().empty());
+
+    /* Polls that upload bind buffers and VAOs directly, the next useProgram must go out */
+    model.load(path);
+    bool reissued = false;
+    for(int frame = 0; frame < 2000 && model.state() != GLBModelAsync::READY; frame++) {
+        model.poll(state);
+        state.useProgram(5);
+        reissued = reissued || !Take().empty();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(model.state(), GLBModelAsync::READY);
+    EXPECT_TRUE(reissued);
+
+    /* READY and nothing queued : back to skipping */
+    model.poll(state);
+    Take();
+    state.useProgram(5);
+    EXPECT_TRUE(Take().empty());
+}
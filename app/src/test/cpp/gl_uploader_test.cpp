@@ -0,0 +1,198 @@
+/*
+ * GLUploader on llvmpipe : uploads made on its shared context are read back from the render
+ * context, completions run in submission order, and stop() either finishes or drops the rest.
+ */
+#include <gl_uploader.h>
+#include <host_gl.h>
+#include <host_test.h>
+
+#include <EGL/egl.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/* Polls like the frame loop until every completion ran or time runs out */
+bool PollUntilIdle(GLUploader& uploader) {
+    for(int frame = 0; frame < 2000 && uploader.pending() > 0; frame++) {
+        uploader.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return uploader.pending() == 0;
+}
+
+/* Unbinds the render context for the scope, like teardown after the surface is gone */
+struct NoCurrentContext {
+    EGLDisplay display = eglGetCurrentDisplay();
+    EGLSurface draw = eglGetCurrentSurface(EGL_DRAW);
+    EGLSurface read = eglGetCurrentSurface(EGL_READ);
+    EGLContext context = eglGetCurrentContext();
+
+    NoCurrentContext() { eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT); }
+    ~NoCurrentContext() { eglMakeCurrent(display, draw, read, context); }
+};
+
+}
+
+TEST(GLUploader, CompletesInSubmissionOrder) {
+    HostGlContext gl;
+    if(!gl.create(16, 16)) SKIP_TEST("no EGL display with GLES 3");
+    GLUploader uploader;
+    ASSERT_TRUE(uploader.start());
+
+    constexpr int kUploads = 100;
+    std::vector<GLuint> buffers(kUploads);
+    glGenBuffers(kUploads, buffers.data());
+    std::vector<int> completed;
+    for(int i = 0; i < kUploads; i++) {
+        GLuint buffer = buffers[i];
+        /* Uneven sizes, so the fences signal at uneven times */
+        size_t bytes = (size_t)(i % 7 + 1) * 4096;
+        ASSERT_TRUE(uploader.submit([buffer, bytes] {
+            std::vector<uint8_t> data(bytes, 0x5A);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)bytes, data.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }, [&completed, i] { completed.push_back(i); }));
+        /* Polling meanwhile, like frames passing during a load */
+        if(i % 10 == 0) uploader.poll();
+    }
+    EXPECT_EQ(uploader.pending() + completed.size(), (size_t)kUploads);
+    EXPECT_TRUE(PollUntilIdle(uploader));
+
+    ASSERT_EQ(completed.size(), (size_t)kUploads);
+    for(int i = 0; i < kUploads; i++) EXPECT_EQ(completed[i], i);
+    uploader.stop();
+    glDeleteBuffers(kUploads, buffers.data());
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(GLUploader, RenderContextReadsWhatTheUploadThreadWrote) {
+    HostGlContext gl;
+    if(!gl.create(16, 16)) SKIP_TEST("no EGL display with GLES 3");
+    GLUploader uploader;
+    ASSERT_TRUE(uploader.start());
+
+    constexpr int kSize = 8;
+    std::vector<uint8_t> texels(kSize * kSize * 4);
+    for(size_t i = 0; i < texels.size(); i++) texels[i] = (uint8_t)(i * 37 + 11);
+    std::vector<float> vertices = { 1.5f, -2.0f, 3.25f, 4.0f };
+
+    GLuint texture = 0, buffer = 0;
+    glGenTextures(1, &texture);
+    glGenBuffers(1, &buffer);
+    bool done = false;
+    ASSERT_TRUE(uploader.submit([&] {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, kSize, kSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }, [&done] { done = true; }));
+    EXPECT_TRUE(PollUntilIdle(uploader));
+    ASSERT_TRUE(done);
+
+    /* Framebuffers aren't shared : made here, in the render context, like the completions do */
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    ASSERT_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), (GLenum)GL_FRAMEBUFFER_COMPLETE);
+    std::vector<uint8_t> read(texels.size(), 0);
+    glReadPixels(0, 0, kSize, kSize, GL_RGBA, GL_UNSIGNED_BYTE, read.data());
+    EXPECT_TRUE(read == texels);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    const float* mapped = static_cast<const float*>(
+            glMapBufferRange(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), GL_MAP_READ_BIT));
+    ASSERT_TRUE(mapped != nullptr);
+    for(size_t i = 0; i < vertices.size(); i++) EXPECT_EQ(mapped[i], vertices[i]);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    uploader.stop();
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(GLUploader, StopRunsEveryOutstandingCompletion) {
+    HostGlContext gl;
+    if(!gl.create(16, 16)) SKIP_TEST("no EGL display with GLES 3");
+    GLUploader uploader;
+    ASSERT_TRUE(uploader.start());
+
+    constexpr int kUploads = 200;
+    std::vector<GLuint> buffers(kUploads);
+    glGenBuffers(kUploads, buffers.data());
+    std::vector<int> completed;
+    for(int i = 0; i < kUploads; i++) {
+        GLuint buffer = buffers[i];
+        ASSERT_TRUE(uploader.submit([buffer] {
+            std::vector<uint8_t> data(64 * 1024, 0x11);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)data.size(), data.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }, [&completed, i] { completed.push_back(i); }));
+    }
+
+    /* Never polled : more than mFenced holds, stop() has to drain it while the thread finishes */
+    uploader.stop();
+    EXPECT_FALSE(uploader.isRunning());
+    EXPECT_EQ(uploader.pending(), (size_t)0);
+    ASSERT_EQ(completed.size(), (size_t)kUploads);
+    for(int i = 0; i < kUploads; i++) EXPECT_EQ(completed[i], i);
+
+    /* And every upload actually happened */
+    for(GLuint buffer : buffers) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        GLint size = 0;
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+        EXPECT_EQ(size, 64 * 1024);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDeleteBuffers(kUploads, buffers.data());
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(GLUploader, WithoutAContextNothingStartsOrRuns) {
+    HostGlContext gl;
+    if(!gl.create(16, 16)) SKIP_TEST("no EGL display with GLES 3");
+
+    /* No render context to share with : the caller keeps uploading itself */
+    {
+        NoCurrentContext none;
+        GLUploader uploader;
+        EXPECT_FALSE(uploader.start());
+        EXPECT_FALSE(uploader.isRunning());
+        EXPECT_FALSE(uploader.submit([] {}, [] {}));
+        EXPECT_EQ(uploader.pending(), (size_t)0);
+    }
+
+    /* Teardown without a context : what is left is dropped, no completion runs */
+    GLUploader uploader;
+    ASSERT_TRUE(uploader.start());
+    int completions = 0;
+    for(int i = 0; i < 50; i++) {
+        ASSERT_TRUE(uploader.submit([] {}, [&completions] { completions++; }));
+    }
+    {
+        NoCurrentContext none;
+        uploader.stop();
+    }
+    EXPECT_FALSE(uploader.isRunning());
+    EXPECT_EQ(completions, 0);
+    EXPECT_EQ(uploader.pending(), (size_t)0);
+
+    /* Starts again once a context is current */
+    EXPECT_TRUE(uploader.start());
+    EXPECT_TRUE(uploader.submit([] {}, [&completions] { completions++; }));
+    EXPECT_TRUE(PollUntilIdle(uploader));
+    EXPECT_EQ(completions, 1);
+    uploader.stop();
+}
@@ -0,0 +1,103 @@
+/*
+ * GLBModelAsync's load jobs against the real JobSystem : results reach poll() in order, superseded
+ * generations are dropped, and destruction waits out jobs whose results nobody polls.
+ */
+#include <glb_renderer_async.h>
+#include <host_gl.h>
+#include <host_test.h>
+#include <test_models.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace {
+
+/* Polls like the frame loop until the model leaves LOADING / STREAMING or time runs out */
+GLBModelAsync::State PollUntilSettled(GLBModelAsync& model, GLStateCache& state) {
+    for(int frame = 0; frame < 2000; frame++) {
+        model.poll(state);
+        GLBModelAsync::State current = model.state();
+        if(current == GLBModelAsync::READY || current == GLBModelAsync::ERROR) return current;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return model.state();
+}
+
+}
+
+TEST(GLBModelAsync, LoadsToReady) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    std::string path = host_test::TempPath("async_box.glb");
+    ASSERT_TRUE(WriteBoxGlb(path, 1.0f));
+
+    GLStateCache state;
+    GLBModelAsync model;
+    model.load(path);
+    EXPECT_EQ(PollUntilSettled(model, state), GLBModelAsync::READY);
+}
+
+TEST(GLBModelAsync, SupersededLoadsAreDropped) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    std::string path = host_test::TempPath("async_box.glb");
+    ASSERT_TRUE(WriteBoxGlb(path, 1.0f));
+
+    GLStateCache state;
+    GLBModelAsync model;
+    uint32_t generation = 0;
+    for(int i = 0; i < 20; i++) {
+        generation = model.load(path);
+        /* Every other load polls a little of the previous one in */
+        if(i % 2) model.poll(state);
+    }
+    EXPECT_EQ(model.generation(), generation);
+    EXPECT_EQ(PollUntilSettled(model, state), GLBModelAsync::READY);
+}
+
+TEST(GLBModelAsync, LoadCancelPollWithEveryThreadBusy) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    std::string path = host_test::TempPath("async_box.glb");
+    ASSERT_TRUE(WriteBoxGlb(path, 1.0f));
+
+    /* Parse, BVH and upload threads all against the polling GL thread */
+    GLStateCache state;
+    GLBModelAsync model;
+    model.setBackgroundUploads(true);
+    GLBModelAsync::LoadOptions options;
+    options.pickable = true;
+    for(int round = 0; round < 40; round++) {
+        model.load(path, options);
+        for(int frame = 0; frame < round % 5; frame++) {
+            model.poll(state);
+            std::this_thread::sleep_for(std::chrono::microseconds(200 * frame));
+        }
+        if(round % 7 == 0) model.release();
+    }
+    model.load(path, options);
+    EXPECT_EQ(PollUntilSettled(model, state), GLBModelAsync::READY);
+    /* The BVH job outlives READY, it lands in a later poll */
+    for(int frame = 0; frame < 2000 && !model.isPickable(); frame++) {
+        model.poll(state);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(model.isPickable());
+}
+
+TEST(GLBModelAsync, DestructionDrainsUnpolledResults) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    std::string path = host_test::TempPath("async_box.glb");
+    ASSERT_TRUE(WriteBoxGlb(path, 1.0f));
+
+    /* Nobody polls : every load's results pile up until the destructor */
+    for(int round = 0; round < 10; round++) {
+        auto model = std::make_unique<GLBModelAsync>();
+        for(int i = 0; i < 8; i++) model->load(path);
+        if(round % 2) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        model.reset();
+    }
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
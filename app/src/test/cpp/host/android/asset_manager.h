@@ -0,0 +1,32 @@
+#ifndef BUILDING_AR_HOST_ANDROID_ASSET_MANAGER_H
+#define BUILDING_AR_HOST_ANDROID_ASSET_MANAGER_H
+
+/* Host stand-in for the NDK's asset manager, reads files under a directory, see host_assets.h */
+
+#include <sys/types.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct AAssetManager;
+typedef struct AAssetManager AAssetManager;
+struct AAsset;
+typedef struct AAsset AAsset;
+
+enum {
+    AASSET_MODE_UNKNOWN = 0, AASSET_MODE_RANDOM = 1, AASSET_MODE_STREAMING = 2, AASSET_MODE_BUFFER = 3
+};
+
+AAsset* AAssetManager_open(AAssetManager* mgr, const char* filename, int mode);
+const void* AAsset_getBuffer(AAsset* asset);
+off_t AAsset_getLength(AAsset* asset);
+int AAsset_read(AAsset* asset, void* buf, size_t count);
+void AAsset_close(AAsset* asset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BUILDING_AR_HOST_ANDROID_ASSET_MANAGER_H
@@ -0,0 +1,17 @@
+#ifndef BUILDING_AR_HOST_ANDROID_ASSET_MANAGER_JNI_H
+#define BUILDING_AR_HOST_ANDROID_ASSET_MANAGER_JNI_H
+
+#include <jni.h>
+#include <android/asset_manager.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+AAssetManager* AAssetManager_fromJava(JNIEnv* env, jobject assetManager);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BUILDING_AR_HOST_ANDROID_ASSET_MANAGER_JNI_H
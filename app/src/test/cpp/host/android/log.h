@@ -0,0 +1,21 @@
+#ifndef BUILDING_AR_HOST_ANDROID_LOG_H
+#define BUILDING_AR_HOST_ANDROID_LOG_H
+
+/* Host stand-in for the NDK's liblog : errors go to stderr, the rest only with BUILDINGAR_HOST_LOG set */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    ANDROID_LOG_UNKNOWN = 0, ANDROID_LOG_DEFAULT, ANDROID_LOG_VERBOSE, ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR, ANDROID_LOG_FATAL, ANDROID_LOG_SILENT
+};
+
+int __android_log_print(int priority, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BUILDING_AR_HOST_ANDROID_LOG_H
@@ -0,0 +1,71 @@
+/*
+ * Assimp on the host : nothing imports or exports, every read fails like a file it can't parse.
+ * The prebuilt libassimp.so is Android only, and the host tests load GLBs GLBReader handles.
+ */
+#include <assimp/Exporter.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/material.h>
+
+#include <new>
+
+namespace {
+const char* kUnavailable = "Assimp is not available in the host build";
+}
+
+namespace Assimp {
+
+Importer::Importer() : pimpl(nullptr) {}
+Importer::~Importer() {}
+
+const aiScene* Importer::ReadFileFromMemory(const void* pBuffer, size_t pLength, unsigned int pFlags, const char* pHint) {
+    return nullptr;
+}
+
+void Importer::SetProgressHandler(ProgressHandler* pHandler) {}
+
+const char* Importer::GetErrorString() const {
+    return kUnavailable;
+}
+
+Exporter::Exporter() : pimpl(nullptr) {}
+Exporter::~Exporter() {}
+
+const aiExportDataBlob* Exporter::ExportToBlob(const aiScene* pScene, const char* pFormatId, unsigned int pPreprocessing,
+                                               const ExportProperties* pProperties) {
+    return nullptr;
+}
+
+const char* Exporter::GetErrorString() const {
+    return kUnavailable;
+}
+
+namespace Intern {
+void* AllocateFromAssimpHeap::operator new(size_t num_bytes) { return ::operator new(num_bytes); }
+void* AllocateFromAssimpHeap::operator new(size_t num_bytes, const std::nothrow_t&) throw() { return ::operator new(num_bytes, std::nothrow); }
+void AllocateFromAssimpHeap::operator delete(void* data) { ::operator delete(data); }
+void* AllocateFromAssimpHeap::operator new[](size_t num_bytes) { return ::operator new[](num_bytes); }
+void* AllocateFromAssimpHeap::operator new[](size_t num_bytes, const std::nothrow_t&) throw() { return ::operator new[](num_bytes, std::nothrow); }
+void AllocateFromAssimpHeap::operator delete[](void* data) { ::operator delete[](data); }
+}
+
+}
+
+/* No scene is ever imported, these never see a material */
+aiReturn aiGetMaterialFloatArray(const aiMaterial* pMat, const char* pKey, unsigned int type, unsigned int index,
+                                 ai_real* pOut, unsigned int* pMax) {
+    return aiReturn_FAILURE;
+}
+
+aiReturn aiGetMaterialString(const aiMaterial* pMat, const char* pKey, unsigned int type, unsigned int index, aiString* pOut) {
+    return aiReturn_FAILURE;
+}
+
+unsigned int aiGetMaterialTextureCount(const aiMaterial* pMat, aiTextureType type) {
+    return 0;
+}
+
+aiReturn aiGetMaterialTexture(const aiMaterial* mat, aiTextureType type, unsigned int index, aiString* path,
+                              aiTextureMapping* mapping, unsigned int* uvindex, ai_real* blend, aiTextureOp* op,
+                              aiTextureMapMode* mapmode, unsigned int* flags) {
+    return aiReturn_FAILURE;
+}
@@ -0,0 +1,72 @@
+#include <host_assets.h>
+
+#include <android/asset_manager_jni.h>
+#include <android/log.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct AAssetManager {
+    std::string root;
+};
+
+struct AAsset {
+    std::vector<char> bytes;
+    size_t position = 0;
+};
+
+int __android_log_print(int priority, const char* tag, const char* format, ...) {
+    static const bool verbose = std::getenv("BUILDINGAR_HOST_LOG") != nullptr;
+    if(priority < ANDROID_LOG_ERROR && !verbose) return 0;
+
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s : ", tag);
+    int written = vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return written;
+}
+
+AAssetManager* HostAssets_create(const char* root) {
+    return new AAssetManager{root};
+}
+
+AAsset* AAssetManager_open(AAssetManager* mgr, const char* filename, int mode) {
+    if(!mgr || !filename) return nullptr;
+    std::ifstream file(mgr->root + "/" + filename, std::ios::binary);
+    if(!file.is_open()) return nullptr;
+    AAsset* asset = new AAsset();
+    asset->bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return asset;
+}
+
+const void* AAsset_getBuffer(AAsset* asset) {
+    return asset->bytes.data();
+}
+
+off_t AAsset_getLength(AAsset* asset) {
+    return (off_t)asset->bytes.size();
+}
+
+int AAsset_read(AAsset* asset, void* buf, size_t count) {
+    size_t left = asset->bytes.size() - asset->position;
+    if(count > left) count = left;
+    std::copy(asset->bytes.begin() + asset->position, asset->bytes.begin() + asset->position + count, (char*)buf);
+    asset->position += count;
+    return (int)count;
+}
+
+void AAsset_close(AAsset* asset) {
+    delete asset;
+}
+
+AAssetManager* AAssetManager_fromJava(JNIEnv* env, jobject assetManager) {
+    return nullptr;
+}
@@ -0,0 +1,9 @@
+#ifndef BUILDING_AR_HOST_ASSETS_H
+#define BUILDING_AR_HOST_ASSETS_H
+
+#include <android/asset_manager.h>
+
+/* An asset manager over the files under root, e.g. app/src/main/assets. Never freed, one per test is plenty */
+AAssetManager* HostAssets_create(const char* root);
+
+#endif //BUILDING_AR_HOST_ASSETS_H
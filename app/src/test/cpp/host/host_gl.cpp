@@ -0,0 +1,50 @@
+#include <host_gl.h>
+
+bool HostGlContext::create(int width, int height) {
+    destroy();
+    mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(mDisplay == EGL_NO_DISPLAY || !eglInitialize(mDisplay, nullptr, nullptr)) {
+        mDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+    if(!eglBindAPI(EGL_OPENGL_ES_API)) return false;
+
+    const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+    };
+    EGLint configCount = 0;
+    if(!eglChooseConfig(mDisplay, configAttributes, &mConfig, 1, &configCount) || configCount == 0) return false;
+
+    mWidth = width;
+    mHeight = height;
+    return recreate();
+}
+
+bool HostGlContext::recreate() {
+    if(mDisplay == EGL_NO_DISPLAY) return false;
+    eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(mContext != EGL_NO_CONTEXT) eglDestroyContext(mDisplay, mContext);
+    if(mSurface != EGL_NO_SURFACE) eglDestroySurface(mDisplay, mSurface);
+
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, mWidth, EGL_HEIGHT, mHeight, EGL_NONE };
+    mSurface = eglCreatePbufferSurface(mDisplay, mConfig, surfaceAttributes);
+    const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_NONE };
+    mContext = eglCreateContext(mDisplay, mConfig, EGL_NO_CONTEXT, contextAttributes);
+    if(mSurface == EGL_NO_SURFACE || mContext == EGL_NO_CONTEXT) return false;
+    return eglMakeCurrent(mDisplay, mSurface, mSurface, mContext) == EGL_TRUE;
+}
+
+void HostGlContext::destroy() {
+    if(mDisplay == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(mContext != EGL_NO_CONTEXT) eglDestroyContext(mDisplay, mContext);
+    if(mSurface != EGL_NO_SURFACE) eglDestroySurface(mDisplay, mSurface);
+    mContext = EGL_NO_CONTEXT;
+    mSurface = EGL_NO_SURFACE;
+    eglTerminate(mDisplay);
+    mDisplay = EGL_NO_DISPLAY;
+}
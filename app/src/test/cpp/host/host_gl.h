@@ -0,0 +1,33 @@
+#ifndef BUILDING_AR_HOST_GL_H
+#define BUILDING_AR_HOST_GL_H
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+
+/*
+ * A GLES 3 context current on the calling thread, over a pbuffer standing in for the app's
+ * window surface. Run with EGL_PLATFORM=surfaceless to get llvmpipe on a box without a display.
+ */
+class HostGlContext {
+public:
+    ~HostGlContext() { destroy(); }
+
+    /* False when there is no EGL display or no GLES 3 config, GL tests skip then */
+    bool create(int width, int height);
+    void destroy();
+    /* Drops the context and makes a new one, like Android does when the surface is recreated */
+    bool recreate();
+
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+
+private:
+    EGLDisplay mDisplay = EGL_NO_DISPLAY;
+    EGLConfig mConfig = nullptr;
+    EGLContext mContext = EGL_NO_CONTEXT;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+    int mWidth = 0;
+    int mHeight = 0;
+};
+
+#endif //BUILDING_AR_HOST_GL_H
@@ -0,0 +1,113 @@
+#ifndef BUILDING_AR_HOST_TEST_H
+#define BUILDING_AR_HOST_TEST_H
+
+/*
+ * Just enough of a test framework for the host tests, no dependency to install on a CI box.
+ *
+ *   TEST(Suite, Name) { EXPECT_EQ(a, b); ASSERT_TRUE(c); SKIP_TEST("why"); }
+ *
+ * EXPECT_* records a failure and goes on, ASSERT_* and SKIP_TEST leave the test. Each test
+ * executable runs all of its tests (or those whose name contains argv[1]) and exits with 0, 1
+ * when one failed, or 77 when all of them skipped, which ctest reports as skipped.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace host_test {
+
+struct Test {
+    const char* name;
+    std::function<void()> body;
+};
+
+struct Skip {
+    std::string reason;
+};
+
+struct Abort {};
+
+inline std::vector<Test>& Registry() {
+    static std::vector<Test> tests;
+    return tests;
+}
+
+inline int& Failures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct Registrar {
+    Registrar(const char* name, std::function<void()> body) { Registry().push_back({name, std::move(body)}); }
+};
+
+template <typename T>
+std::string Describe(const T& value) {
+    if constexpr(std::is_arithmetic<T>::value || std::is_enum<T>::value) {
+        std::ostringstream out;
+        out << +static_cast<typename std::conditional<std::is_enum<T>::value, long long, T>::type>(value);
+        return out.str();
+    } else {
+        return "?";
+    }
+}
+
+/* A scratch file of this test run, under $TMPDIR when set */
+inline std::string TempPath(const std::string& name) {
+    const char* directory = std::getenv("TMPDIR");
+    return std::string(directory && *directory ? directory : "/tmp") + "/buildingar_" + name;
+}
+
+inline void Fail(const char* file, int line, const std::string& message) {
+    Failures()++;
+    fprintf(stderr, "%s:%d: failure : %s\n", file, line, message.c_str());
+}
+
+}
+
+#define HOST_TEST_CONCAT(a, b) a##b
+#define TEST(suite, name) \
+    static void HOST_TEST_CONCAT(suite##_, name)(); \
+    static host_test::Registrar HOST_TEST_CONCAT(suite##_##name, _registrar)(#suite "." #name, HOST_TEST_CONCAT(suite##_, name)); \
+    static void HOST_TEST_CONCAT(suite##_, name)()
+
+#define HOST_TEST_CHECK(condition, message, fatal) \
+    do { \
+        if(!(condition)) { \
+            host_test::Fail(__FILE__, __LINE__, message); \
+            if(fatal) throw host_test::Abort(); \
+        } \
+    } while(0)
+
+#define HOST_TEST_COMPARE(a, op, b, fatal) \
+    do { \
+        auto&& host_test_a = (a); \
+        auto&& host_test_b = (b); \
+        HOST_TEST_CHECK(host_test_a op host_test_b, std::string(#a " " #op " " #b " (") + \
+                host_test::Describe(host_test_a) + " vs " + host_test::Describe(host_test_b) + ")", fatal); \
+    } while(0)
+
+#define EXPECT_TRUE(condition) HOST_TEST_CHECK(condition, #condition, false)
+#define EXPECT_FALSE(condition) HOST_TEST_CHECK(!(condition), "!(" #condition ")", false)
+#define EXPECT_EQ(a, b) HOST_TEST_COMPARE(a, ==, b, false)
+#define EXPECT_NE(a, b) HOST_TEST_COMPARE(a, !=, b, false)
+#define EXPECT_LT(a, b) HOST_TEST_COMPARE(a, <, b, false)
+#define EXPECT_LE(a, b) HOST_TEST_COMPARE(a, <=, b, false)
+#define EXPECT_GT(a, b) HOST_TEST_COMPARE(a, >, b, false)
+#define EXPECT_GE(a, b) HOST_TEST_COMPARE(a, >=, b, false)
+#define EXPECT_NEAR(a, b, tolerance) HOST_TEST_COMPARE(std::fabs((double)(a) - (double)(b)), <=, (double)(tolerance), false)
+#define ASSERT_TRUE(condition) HOST_TEST_CHECK(condition, #condition, true)
+#define ASSERT_FALSE(condition) HOST_TEST_CHECK(!(condition), "!(" #condition ")", true)
+#define ASSERT_EQ(a, b) HOST_TEST_COMPARE(a, ==, b, true)
+#define ASSERT_GT(a, b) HOST_TEST_COMPARE(a, >, b, true)
+#define ASSERT_NEAR(a, b, tolerance) HOST_TEST_COMPARE(std::fabs((double)(a) - (double)(b)), <=, (double)(tolerance), true)
+#define SKIP_TEST(reason) throw host_test::Skip{reason}
+
+#endif //BUILDING_AR_HOST_TEST_H
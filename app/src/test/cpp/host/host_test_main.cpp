@@ -0,0 +1,25 @@
+#include <host_test.h>
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int ran = 0, skipped = 0, failed = 0;
+    for(const host_test::Test& test : host_test::Registry()) {
+        if(filter && !strstr(test.name, filter)) continue;
+        int failuresBefore = host_test::Failures();
+        ran++;
+        try {
+            test.body();
+        } catch(const host_test::Skip& skip) {
+            skipped++;
+            fprintf(stderr, "[ SKIP ] %s : %s\n", test.name, skip.reason.c_str());
+            continue;
+        } catch(const host_test::Abort&) {
+        }
+        bool passed = host_test::Failures() == failuresBefore;
+        if(!passed) failed++;
+        fprintf(stderr, "[ %s ] %s\n", passed ? " OK " : "FAIL", test.name);
+    }
+    fprintf(stderr, "%d tests, %d failed, %d skipped\n", ran, failed, skipped);
+    if(failed) return 1;
+    return ran > 0 && skipped == ran ? 77 : 0;
+}
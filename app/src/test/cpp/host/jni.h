@@ -0,0 +1,28 @@
+#ifndef BUILDING_AR_HOST_JNI_H
+#define BUILDING_AR_HOST_JNI_H
+
+/* Host stand-in for jni.h : the types the native sources name. Nothing on the host calls into a VM */
+
+#include <stdint.h>
+
+typedef uint8_t jboolean;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef float jfloat;
+typedef double jdouble;
+typedef jint jsize;
+
+class _jobject {};
+typedef _jobject* jobject;
+typedef jobject jclass;
+typedef jobject jstring;
+
+struct _JNIEnv;
+typedef _JNIEnv JNIEnv;
+
+#define JNI_FALSE 0
+#define JNI_TRUE 1
+#define JNIEXPORT __attribute__((visibility("default")))
+#define JNICALL
+
+#endif //BUILDING_AR_HOST_JNI_H
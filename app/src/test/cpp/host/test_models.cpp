@@ -0,0 +1,144 @@
+#include <test_models.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+void Append(std::vector<uint8_t>& out, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+void AppendU32(std::vector<uint8_t>& out, uint32_t value) {
+    Append(out, &value, sizeof(value));
+}
+
+}
+
+bool WriteBoxGlb(const std::string& path, float halfSize) {
+    /* Per face : normal axis and sign, then 4 corners */
+    std::vector<float> positions, normals;
+    std::vector<uint16_t> indices;
+    for(int axis = 0; axis < 3; axis++) {
+        for(int sign = -1; sign <= 1; sign += 2) {
+            uint16_t first = (uint16_t)(positions.size() / 3);
+            int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+            for(const auto& corner : corners) {
+                float position[3], normal[3] = {0, 0, 0};
+                position[axis] = sign * halfSize;
+                position[u] = corner[0] * halfSize;
+                position[v] = corner[1] * halfSize;
+                position[1] += halfSize;
+                normal[axis] = (float)sign;
+                positions.insert(positions.end(), position, position + 3);
+                normals.insert(normals.end(), normal, normal + 3);
+            }
+            /* Counter clockwise seen from outside */
+            const uint16_t quad[6] = {0, 1, 2, 0, 2, 3};
+            const uint16_t flipped[6] = {0, 2, 1, 0, 3, 2};
+            for(int i = 0; i < 6; i++) indices.push_back(first + (sign > 0 ? quad[i] : flipped[i]));
+        }
+    }
+
+    std::vector<uint8_t> bin;
+    Append(bin, positions.data(), positions.size() * sizeof(float));
+    Append(bin, normals.data(), normals.size() * sizeof(float));
+    Append(bin, indices.data(), indices.size() * sizeof(uint16_t));
+    while(bin.size() % 4) bin.push_back(0);
+
+    size_t positionBytes = positions.size() * sizeof(float);
+    size_t indexBytes = indices.size() * sizeof(uint16_t);
+    char json[2048];
+    snprintf(json, sizeof(json),
+             "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+             "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":2}]}],"
+             "\"accessors\":["
+             "{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\",\"min\":[%g,0,%g],\"max\":[%g,%g,%g]},"
+             "{\"bufferView\":1,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+             "{\"bufferView\":2,\"componentType\":5123,\"count\":%zu,\"type\":\"SCALAR\"}],"
+             "\"bufferViews\":["
+             "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu},"
+             "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},"
+             "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+             "\"buffers\":[{\"byteLength\":%zu}]}",
+             positions.size() / 3, -halfSize, -halfSize, halfSize, 2 * halfSize, halfSize,
+             normals.size() / 3, indices.size(),
+             positionBytes, positionBytes, positionBytes, 2 * positionBytes, indexBytes, bin.size());
+    std::vector<uint8_t> jsonChunk(json, json + strlen(json));
+    while(jsonChunk.size() % 4) jsonChunk.push_back(' ');
+
+    std::vector<uint8_t> glb;
+    AppendU32(glb, 0x46546C67);     // "glTF"
+    AppendU32(glb, 2);
+    AppendU32(glb, (uint32_t)(12 + 8 + jsonChunk.size() + 8 + bin.size()));
+    AppendU32(glb, (uint32_t)jsonChunk.size());
+    AppendU32(glb, 0x4E4F534A);     // "JSON"
+    Append(glb, jsonChunk.data(), jsonChunk.size());
+    AppendU32(glb, (uint32_t)bin.size());
+    AppendU32(glb, 0x004E4942);     // "BIN\0"
+    Append(glb, bin.data(), bin.size());
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) return false;
+    bool written = fwrite(glb.data(), 1, glb.size(), file) == glb.size();
+    fclose(file);
+    return written;
+}
+
+TestMesh MakeBuildingMesh(int floors, int boxesPerFloor, int gridCells, uint32_t seed) {
+    constexpr float kFootprint = 100.0f;
+    constexpr float kFloorHeight = 3.0f;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    TestMesh mesh;
+
+    /* Walls, furniture and the like : boxes standing on their floor */
+    for(int floor = 0; floor < floors; floor++) {
+        for(int box = 0; box < boxesPerFloor; box++) {
+            float low[3], high[3];
+            low[0] = unit(random) * kFootprint;
+            low[1] = floor * kFloorHeight;
+            low[2] = unit(random) * kFootprint;
+            high[0] = low[0] + 0.05f + unit(random) * 4.0f;
+            high[1] = low[1] + 0.1f + unit(random) * (kFloorHeight - 0.1f);
+            high[2] = low[2] + 0.05f + unit(random) * 4.0f;
+            uint32_t first = (uint32_t)(mesh.positions.size() / 3);
+            for(int corner = 0; corner < 8; corner++) {
+                mesh.positions.push_back(corner & 1 ? high[0] : low[0]);
+                mesh.positions.push_back(corner & 2 ? high[1] : low[1]);
+                mesh.positions.push_back(corner & 4 ? high[2] : low[2]);
+            }
+            /* Two triangles per face, corners numbered by the bits above */
+            const uint32_t faces[12][3] = {
+                    {0, 2, 3}, {0, 3, 1}, {4, 5, 7}, {4, 7, 6}, {0, 1, 5}, {0, 5, 4},
+                    {2, 6, 7}, {2, 7, 3}, {0, 4, 6}, {0, 6, 2}, {1, 3, 7}, {1, 7, 5}};
+            for(const auto& face : faces) {
+                for(uint32_t corner : face) mesh.indices.push_back(first + corner);
+            }
+        }
+    }
+
+    /* The ground, a little uneven like a scan of it */
+    uint32_t first = (uint32_t)(mesh.positions.size() / 3);
+    for(int z = 0; z <= gridCells; z++) {
+        for(int x = 0; x <= gridCells; x++) {
+            mesh.positions.push_back(x * kFootprint / gridCells);
+            mesh.positions.push_back((unit(random) - 0.5f) * 0.05f);
+            mesh.positions.push_back(z * kFootprint / gridCells);
+        }
+    }
+    uint32_t row = (uint32_t)gridCells + 1;
+    for(uint32_t z = 0; z < (uint32_t)gridCells; z++) {
+        for(uint32_t x = 0; x < (uint32_t)gridCells; x++) {
+            uint32_t corner = first + z * row + x;
+            const uint32_t quad[6] = {corner, corner + row, corner + 1, corner + 1, corner + row, corner + row + 1};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
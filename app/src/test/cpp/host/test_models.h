@@ -0,0 +1,23 @@
+#ifndef BUILDING_AR_HOST_TEST_MODELS_H
+#define BUILDING_AR_HOST_TEST_MODELS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* A GLB that GLBReader takes without Assimp : an axis aligned box of halfSize resting on y = 0,
+ * 24 vertices (POSITION, NORMAL), 36 uint16 indices, no material. False if path can't be written */
+bool WriteBoxGlb(const std::string& path, float halfSize);
+
+/* Positions (3 floats per vertex) and a uint32 triangle list */
+struct TestMesh {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+};
+
+/* A scanned building stand-in over a 100 x 100 m footprint : floors 3 m apart, each with
+ * boxesPerFloor random boxes (12 triangles each), on a gridCells x gridCells jittered ground
+ * (2 triangles per cell). Same seed, same mesh */
+TestMesh MakeBuildingMesh(int floors, int boxesPerFloor, int gridCells, uint32_t seed);
+
+#endif //BUILDING_AR_HOST_TEST_MODELS_H
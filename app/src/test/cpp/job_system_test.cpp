@@ -0,0 +1,101 @@
+/*
+ * JobSystem::wait() from job threads : nested waits run the queued jobs themselves, and a wait on
+ * a job running elsewhere blocks instead of spinning on a core. And which cores the workers get.
+ */
+#include <job_system.h>
+#include <host_test.h>
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+namespace {
+
+double ThreadCpuMs() {
+    timespec now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+}
+
+TEST(JobSystem, NestedWaitsRunTheQueuedJobs) {
+    JobSystem& jobs = JobSystem::instance();
+    std::atomic<int> ran{0};
+
+    /* Every worker can be inside such a job at once, only helping keeps the pool from deadlocking */
+    std::vector<JobHandle> parents;
+    for(int p = 0; p < jobs.workerCount() * 2; p++) {
+        parents.push_back(jobs.submit(PRIORITY_DECODE, [&](const CancelToken&) {
+            std::vector<JobHandle> children;
+            for(int c = 0; c < 16; c++) {
+                children.push_back(JobSystem::instance().submit(PRIORITY_MIPGEN, [&](const CancelToken&) {
+                    ran.fetch_add(1, std::memory_order_relaxed);
+                }));
+            }
+            for(const JobHandle& child : children) JobSystem::instance().wait(child);
+        }));
+    }
+    for(const JobHandle& parent : parents) jobs.wait(parent);
+    EXPECT_EQ(ran.load(), jobs.workerCount() * 2 * 16);
+}
+
+TEST(JobSystem, CancelledJobsCompleteWithoutRunning) {
+    JobSystem& jobs = JobSystem::instance();
+    CancelToken token;
+    token.cancel();
+    bool ran = false;
+    JobHandle handle = jobs.submit(PRIORITY_PARSE, token, [&](const CancelToken&) { ran = true; });
+    jobs.wait(handle);
+    EXPECT_TRUE(handle.isDone());
+    EXPECT_FALSE(ran);
+}
+
+TEST(JobSystem, WorkerWaitBlocksOnAJobRunningElsewhere) {
+    JobSystem& jobs = JobSystem::instance();
+    if(jobs.workerCount() < 2) SKIP_TEST("one worker, no job can run elsewhere");
+
+    constexpr int kSlowJobMs = 200;
+    std::atomic<bool> slowStarted{false};
+    JobHandle slow = jobs.submit(PRIORITY_PARSE, [&](const CancelToken&) {
+        slowStarted.store(true, std::memory_order_release);
+        std::this_thread::sleep_for(std::chrono::milliseconds(kSlowJobMs));
+    });
+    while(!slowStarted.load(std::memory_order_acquire)) std::this_thread::yield();
+
+    /* The slow job is off the queues : the waiting worker finds nothing to steal */
+    double waitCpuMs = -1.0;
+    JobHandle waiter = jobs.submit(PRIORITY_PARSE, [&](const CancelToken&) {
+        double start = ThreadCpuMs();
+        JobSystem::instance().wait(slow);
+        waitCpuMs = ThreadCpuMs() - start;
+    });
+    jobs.wait(waiter);
+    EXPECT_TRUE(slow.isDone());
+    /* A spinning wait burns about the whole kSlowJobMs */
+    EXPECT_LT(waitCpuMs, kSlowJobMs / 4.0);
+    EXPECT_GE(waitCpuMs, 0.0);
+}
+
+TEST(JobSystem, BigCoresAreEveryClusterButTheSlowest) {
+    /* 1 prime + 3 big + 4 little */
+    std::vector<int> expected = {4, 5, 6, 7};
+    EXPECT_TRUE(JobSystem::BigCores({{0, 1800000}, {1, 1800000}, {2, 1800000}, {3, 1800000},
+                                     {4, 2400000}, {5, 2400000}, {6, 2400000}, {7, 3000000}}) == expected);
+    /* 2 big + 6 little */
+    expected = {6, 7};
+    EXPECT_TRUE(JobSystem::BigCores({{0, 1700000}, {1, 1700000}, {2, 1700000}, {3, 1700000},
+                                     {4, 1700000}, {5, 1700000}, {6, 2200000}, {7, 2200000}}) == expected);
+    /* One cluster : all of it */
+    expected = {0, 1, 2, 3};
+    EXPECT_TRUE(JobSystem::BigCores({{0, 2000000}, {1, 2000000}, {2, 2000000}, {3, 2000000}}) == expected);
+    /* No cpufreq, as on most hosts */
+    EXPECT_TRUE(JobSystem::BigCores({}).empty());
+}
+
+TEST(JobSystem, AlwaysAtLeastTwoWorkers) {
+    /* Even on this host's cores, cpufreq or not */
+    EXPECT_GE(JobSystem::instance().workerCount(), 2);
+}
@@ -0,0 +1,125 @@
+/*
+ * MeshBvh build time and rays/s on the host, outside ctest :
+ *
+ *   mesh_bvh_benchmark                                the synthetic building below
+ *   mesh_bvh_benchmark <floors> <boxes> <gridCells>   another one, see MakeBuildingMesh()
+ *   mesh_bvh_benchmark <model.glb>                    GLBModelAsync::BenchmarkPicking, what the
+ *                                                     pick_benchmark intent extra runs on a device
+ *
+ * Same measurements as BenchmarkPicking : best build of 3, then 100k seeded rays from a sphere
+ * around the model towards random points of its box. Numbers only mean something optimized :
+ *
+ *   cmake -S app/src/test/cpp -B build-release -DCMAKE_BUILD_TYPE=Release
+ *   cmake --build build-release --target mesh_bvh_benchmark
+ */
+#include <glb_renderer_async.h>
+#include <mesh_bvh.h>
+#include <host_test.h>
+#include <test_models.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+/* 30 floors of 8000 boxes and a 1000 x 1000 ground : 4.88M triangles, a large scanned building */
+constexpr int kFloors = 30;
+constexpr int kBoxesPerFloor = 8000;
+constexpr int kGridCells = 1000;
+
+constexpr int kRuns = 3;
+constexpr int kRays = 100000;
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int BenchmarkGlb(const std::string& path) {
+    std::string report = host_test::TempPath("pick_benchmark.txt");
+    if(!GLBModelAsync::BenchmarkPicking(path, report)) {
+        fprintf(stderr, "BenchmarkPicking failed on %s\n", path.c_str());
+        return 1;
+    }
+    std::ifstream file(report);
+    std::cout << file.rdbuf();
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if(argc == 2 && EndsWith(argv[1], ".glb")) return BenchmarkGlb(argv[1]);
+    int floors = kFloors, boxesPerFloor = kBoxesPerFloor, gridCells = kGridCells;
+    if(argc == 4) {
+        floors = atoi(argv[1]);
+        boxesPerFloor = atoi(argv[2]);
+        gridCells = atoi(argv[3]);
+    } else if(argc != 1) {
+        fprintf(stderr, "usage : %s [<floors> <boxes per floor> <grid cells> | <model.glb>]\n", argv[0]);
+        return 2;
+    }
+
+    TestMesh mesh = MakeBuildingMesh(floors, boxesPerFloor, gridCells, 1);
+    MeshBvh::Source source;
+    source.positions = reinterpret_cast<const uint8_t*>(mesh.positions.data());
+    source.stride = 3 * sizeof(float);
+    source.vertexCount = mesh.positions.size() / 3;
+    source.indices = mesh.indices.data();
+    source.indexCount = mesh.indices.size();
+    std::vector<MeshBvh::Source> sources = {source};
+    glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+    for(size_t i = 0; i < mesh.positions.size(); i += 3) {
+        glm::vec3 position(mesh.positions[i], mesh.positions[i + 1], mesh.positions[i + 2]);
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+
+    double bestBuildMs = -1.0;
+    MeshBvh bvh;
+    for(int run = 0; run < kRuns; run++) {
+        if(!bvh.build(sources, CancelToken())) {
+            fprintf(stderr, "no triangle to build from\n");
+            return 1;
+        }
+        if(bestBuildMs < 0.0 || bvh.stats().buildMs < bestBuildMs) bestBuildMs = bvh.stats().buildMs;
+    }
+
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - boundsMin);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> normal;
+    std::vector<glm::vec3> origins(kRays), directions(kRays);
+    for(int ray = 0; ray < kRays; ray++) {
+        glm::vec3 around = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)) + glm::vec3(1e-6f));
+        glm::vec3 target = boundsMin + glm::vec3(unit(random), unit(random), unit(random)) * (boundsMax - boundsMin);
+        origins[ray] = center + around * radius;
+        directions[ray] = glm::normalize(target - origins[ray]);
+    }
+
+    int hits = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int ray = 0; ray < kRays; ray++) {
+        MeshBvh::Hit hit;
+        if(bvh.intersect(origins[ray], directions[ray], std::numeric_limits<float>::max(), hit)) hits++;
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    const MeshBvh::Stats& stats = bvh.stats();
+    printf("building %d floors x %d boxes, %d x %d ground, best build of %d runs\n", floors, boxesPerFloor, gridCells,
+           gridCells, kRuns);
+    printf("triangles %zu\nbuild_ms %.3f\nnodes %zu\nleaves %zu\ndepth %d\nbvh_mb %.2f\nbytes_per_triangle %.1f\n",
+           stats.triangles, bestBuildMs, stats.nodes, stats.leaves, stats.depth, stats.bytes / (1024.0 * 1024.0),
+           (double)stats.bytes / stats.triangles);
+    printf("rays %d\nrays_per_second %.0f\nray_avg_us %.3f\nhit_ratio %.3f\n", kRays, kRays / (elapsed.count() / 1000.0),
+           elapsed.count() * 1000.0 / kRays, (double)hits / kRays);
+    return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * MeshBvh::intersect() against a brute force Moller-Trumbore over every triangle. Built twice :
+ * mesh_bvh_test with the host's vector lanes (SSE2 on x86, NEON on arm64) and mesh_bvh_scalar_test
+ * with BUILDINGAR_BVH_SCALAR, the plain lanes.
+ */
+#include <mesh_bvh.h>
+#include <host_test.h>
+#include <test_models.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Reference {
+    bool hit = false;
+    uint32_t source = 0;
+    uint32_t triangle = 0;
+    float distance = 0.0f;
+    float u = 0.0f;
+    float v = 0.0f;
+};
+
+/* Nearest hit over every triangle, the test of one packet lane written out */
+Reference BruteForce(const std::vector<MeshBvh::Source>& sources, const glm::vec3& origin, const glm::vec3& direction,
+                     float maxDistance) {
+    Reference nearest;
+    nearest.distance = maxDistance;
+    for(size_t s = 0; s < sources.size(); s++) {
+        const MeshBvh::Source& source = sources[s];
+        for(size_t triangle = 0; triangle < source.indexCount / 3; triangle++) {
+            glm::vec3 corners[3];
+            bool inRange = true;
+            for(int corner = 0; corner < 3; corner++) {
+                size_t at = triangle * 3 + corner;
+                size_t index = source.shortIndices ? static_cast<const uint16_t*>(source.indices)[at]
+                                                   : static_cast<const uint32_t*>(source.indices)[at];
+                if(index >= source.vertexCount) inRange = false;
+                if(!inRange) break;
+                const float* position = reinterpret_cast<const float*>(source.positions + index * source.stride);
+                corners[corner] = glm::vec3(position[0], position[1], position[2]);
+            }
+            if(!inRange) continue;
+
+            glm::vec3 e1 = corners[1] - corners[0], e2 = corners[2] - corners[0];
+            glm::vec3 p = glm::cross(direction, e2);
+            float det = glm::dot(e1, p);
+            if(std::fabs(det) <= 1e-12f) continue;
+            float inverseDet = 1.0f / det;
+            glm::vec3 t = origin - corners[0];
+            float u = glm::dot(t, p) * inverseDet;
+            glm::vec3 q = glm::cross(t, e1);
+            float v = glm::dot(direction, q) * inverseDet;
+            float distance = glm::dot(e2, q) * inverseDet;
+            if(u < 0.0f || v < 0.0f || u + v > 1.0f || distance <= 0.0f || distance >= nearest.distance) continue;
+            nearest.hit = true;
+            nearest.source = (uint32_t)s;
+            nearest.triangle = (uint32_t)triangle;
+            nearest.distance = distance;
+            nearest.u = u;
+            nearest.v = v;
+        }
+    }
+    return nearest;
+}
+
+/* Rounding may put a ray grazing an edge on either side of it */
+bool OnAnEdge(float u, float v) {
+    constexpr float kEdge = 1e-4f;
+    return u < kEdge || v < kEdge || 1.0f - u - v < kEdge;
+}
+
+/* Casts the ray both ways and returns whether they agree : same hit or miss, same distance, and
+ * the same triangle unless another one lies at that distance too */
+bool Agrees(const MeshBvh& bvh, const std::vector<MeshBvh::Source>& sources, const glm::vec3& origin,
+            const glm::vec3& direction, float maxDistance) {
+    MeshBvh::Hit hit;
+    bool found = bvh.intersect(origin, direction, maxDistance, hit);
+    Reference reference = BruteForce(sources, origin, direction, maxDistance);
+    if(found != reference.hit) {
+        /* The one that hit grazed an edge */
+        return found ? OnAnEdge(hit.u, hit.v) : OnAnEdge(reference.u, reference.v);
+    }
+    if(!found) return true;
+    if(std::fabs(hit.distance - reference.distance) > 1e-4f * std::max(1.0f, reference.distance)) return false;
+    if(hit.source == reference.source && hit.triangle == reference.triangle) {
+        return std::fabs(hit.u - reference.u) < 1e-4f && std::fabs(hit.v - reference.v) < 1e-4f;
+    }
+    return true;
+}
+
+MeshBvh::Source SourceOf(const TestMesh& mesh, size_t firstIndex, size_t indexCount) {
+    MeshBvh::Source source;
+    source.positions = reinterpret_cast<const uint8_t*>(mesh.positions.data());
+    source.stride = 3 * sizeof(float);
+    source.vertexCount = mesh.positions.size() / 3;
+    source.indices = mesh.indices.data() + firstIndex;
+    source.indexCount = indexCount;
+    return source;
+}
+
+}
+
+TEST(MeshBvh, MatchesBruteForceOnABuilding) {
+    TestMesh mesh = MakeBuildingMesh(2, 250, 30, 7);
+    /* Two sources over the same vertices, for Hit::source */
+    size_t half = mesh.indices.size() / 6 * 3;
+    std::vector<MeshBvh::Source> sources = {SourceOf(mesh, 0, half), SourceOf(mesh, half, mesh.indices.size() - half)};
+    MeshBvh bvh;
+    ASSERT_TRUE(bvh.build(sources, CancelToken()));
+    EXPECT_EQ(bvh.stats().triangles, mesh.indices.size() / 3);
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+    for(size_t i = 0; i < mesh.positions.size(); i += 3) {
+        glm::vec3 position(mesh.positions[i], mesh.positions[i + 1], mesh.positions[i + 2]);
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - boundsMin);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> normal;
+    int mismatches = 0, hits = 0;
+    for(int ray = 0; ray < 2000; ray++) {
+        glm::vec3 target = boundsMin + glm::vec3(unit(random), unit(random), unit(random)) * (boundsMax - boundsMin);
+        glm::vec3 around = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)) + glm::vec3(1e-6f));
+        glm::vec3 origin, direction;
+        float maxDistance = std::numeric_limits<float>::max();
+        if(ray % 3 == 0) {
+            /* From inside, a few meters at most : boxes are entered from within, and culled */
+            origin = target;
+            direction = around;
+            maxDistance = 5.0f;
+        } else {
+            /* Taps from all around */
+            origin = center + around * radius;
+            direction = glm::normalize(target - origin);
+        }
+        if(!Agrees(bvh, sources, origin, direction, maxDistance)) mismatches++;
+        MeshBvh::Hit hit;
+        if(bvh.intersect(origin, direction, maxDistance, hit)) hits++;
+    }
+    EXPECT_EQ(mismatches, 0);
+    /* Most rays should have something to agree on */
+    EXPECT_GT(hits, 1000);
+
+    /* Axis aligned rays, whose zero components go through the huge inverse */
+    for(int ray = 0; ray < 300; ray++) {
+        glm::vec3 origin = boundsMin + glm::vec3(unit(random), unit(random), unit(random)) * (boundsMax - boundsMin);
+        glm::vec3 direction(0.0f);
+        direction[ray % 3] = ray % 2 ? 1.0f : -1.0f;
+        if(!Agrees(bvh, sources, origin, direction, std::numeric_limits<float>::max())) mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0);
+}
+
+TEST(MeshBvh, PaddingLanesNeverHit) {
+    /* Triangle counts leaving 0 to 3 lanes of a packet empty. The empty lanes are zeros, a
+     * triangle at the origin if their det didn't rule them out */
+    for(int count = 1; count <= 9; count++) {
+        TestMesh mesh;
+        for(int i = 0; i < count; i++) {
+            const float corners[3][3] = {{2.0f * i + 1.0f, 1.0f, 0.0f}, {2.0f * i + 2.0f, 1.0f, 0.0f}, {2.0f * i + 1.0f, 2.0f, 0.0f}};
+            for(const auto& corner : corners) mesh.positions.insert(mesh.positions.end(), corner, corner + 3);
+            for(uint32_t corner = 0; corner < 3; corner++) mesh.indices.push_back(i * 3 + corner);
+        }
+        std::vector<MeshBvh::Source> sources = {SourceOf(mesh, 0, mesh.indices.size())};
+        MeshBvh bvh;
+        ASSERT_TRUE(bvh.build(sources, CancelToken()));
+        EXPECT_EQ(bvh.stats().triangles, (size_t)count);
+
+        /* Through the origin, head on and within the plane of the triangles */
+        MeshBvh::Hit hit;
+        EXPECT_FALSE(bvh.intersect(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, hit));
+        EXPECT_FALSE(bvh.intersect(glm::vec3(0.0f, 0.0f, 5.0f), glm::normalize(glm::vec3(0.01f, 0.01f, -1.0f)), 100.0f, hit));
+        EXPECT_FALSE(bvh.intersect(glm::vec3(-5.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), 100.0f, hit));
+
+        /* And each real lane still hits */
+        for(int i = 0; i < count; i++) {
+            glm::vec3 centroid(2.0f * i + 1.25f, 1.25f, 0.0f);
+            ASSERT_TRUE(bvh.intersect(centroid + glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, hit));
+            EXPECT_EQ(hit.triangle, (uint32_t)i);
+            EXPECT_NEAR(hit.distance, 3.0f, 1e-5f);
+            EXPECT_NEAR(hit.u, 0.25f, 1e-5f);
+            EXPECT_NEAR(hit.v, 0.25f, 1e-5f);
+        }
+    }
+}
+
+TEST(MeshBvh, SpillsPastTheLeafSizeAtMaxDepth) {
+    /* A sane SAH build stays far from kMaxDepth, a lower limit makes the big leaves it would */
+    TestMesh mesh = MakeBuildingMesh(2, 100, 10, 11);
+    std::vector<MeshBvh::Source> sources = {SourceOf(mesh, 0, mesh.indices.size())};
+    std::mt19937 random(9);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for(int maxDepth : {1, 2, 5}) {
+        MeshBvh bvh;
+        ASSERT_TRUE(bvh.build(sources, CancelToken(), maxDepth));
+        const MeshBvh::Stats& stats = bvh.stats();
+        EXPECT_EQ(stats.depth, maxDepth);
+        EXPECT_LE(stats.leaves, (size_t)1 << (maxDepth - 1));
+        /* More triangles than full leaves could hold : they spilled into several packets */
+        EXPECT_GT(stats.triangles, stats.leaves * MeshBvh::kLeafSize);
+
+        int mismatches = 0;
+        for(int ray = 0; ray < 300; ray++) {
+            glm::vec3 origin(unit(random) * 100.0f, 10.0f, unit(random) * 100.0f);
+            glm::vec3 direction = glm::normalize(glm::vec3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f));
+            if(!Agrees(bvh, sources, origin, direction, std::numeric_limits<float>::max())) mismatches++;
+        }
+        EXPECT_EQ(mismatches, 0);
+    }
+
+    /* Coincident triangles, which no bin separates : halved by count down to the limit, leaving
+     * a padded last packet in every leaf */
+    constexpr int kCopies = 203;
+    TestMesh stack;
+    stack.positions = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+    for(int copy = 0; copy < kCopies; copy++) stack.indices.insert(stack.indices.end(), {0, 1, 2});
+    std::vector<MeshBvh::Source> stacked = {SourceOf(stack, 0, stack.indices.size())};
+    MeshBvh bvh;
+    ASSERT_TRUE(bvh.build(stacked, CancelToken(), 4));
+    EXPECT_EQ(bvh.stats().depth, 4);
+    EXPECT_EQ(bvh.stats().leaves, (size_t)8);
+    MeshBvh::Hit hit;
+    ASSERT_TRUE(bvh.intersect(glm::vec3(0.25f, 0.25f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f), 10.0f, hit));
+    EXPECT_LT(hit.triangle, (uint32_t)kCopies);
+    EXPECT_NEAR(hit.distance, 2.0f, 1e-6f);
+    EXPECT_FALSE(bvh.intersect(glm::vec3(0.75f, 0.75f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f), 10.0f, hit));
+
+    /* Without a limit, the same triangles end in leaves of kLeafSize */
+    ASSERT_TRUE(bvh.build(stacked, CancelToken()));
+    EXPECT_LE(bvh.stats().triangles, bvh.stats().leaves * MeshBvh::kLeafSize);
+}
+
+TEST(MeshBvh, ShortIndicesAndLeftOutTriangles) {
+    TestMesh mesh = MakeBuildingMesh(1, 20, 4, 3);
+    std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+    /* A triangle with an index past the vertices, left out but still counted */
+    shortIndices[3] = (uint16_t)(mesh.positions.size() / 3);
+    MeshBvh::Source source = SourceOf(mesh, 0, shortIndices.size());
+    source.indices = shortIndices.data();
+    source.shortIndices = true;
+    std::vector<MeshBvh::Source> sources = {source};
+
+    MeshBvh bvh;
+    ASSERT_TRUE(bvh.build(sources, CancelToken()));
+    EXPECT_EQ(bvh.stats().triangles, shortIndices.size() / 3 - 1);
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    int mismatches = 0;
+    for(int ray = 0; ray < 500; ray++) {
+        glm::vec3 origin(unit(random) * 100.0f, 10.0f, unit(random) * 100.0f);
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f));
+        if(!Agrees(bvh, sources, origin, direction, std::numeric_limits<float>::max())) mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0);
+}
@@ -0,0 +1,188 @@
+/*
+ * PixelUnpackRing on llvmpipe : texels staged by claim() / data() reach the texture, and claims
+ * held across a new context are refused without their slot being handed to anyone else.
+ */
+#include <pixel_unpack_ring.h>
+#include <host_gl.h>
+#include <host_test.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/* The slot index is the low byte of a ticket */
+int SlotOf(int ticket) { return ticket & 0xFF; }
+
+/* Recycles like the frame loop until every slot can be claimed again. The tickets are cancelled */
+bool RecycleUntilAllFree(PixelUnpackRing& ring) {
+    for(int frame = 0; frame < 100; frame++) {
+        glFinish();
+        ring.recycle();
+        std::vector<int> tickets;
+        for(int i = 0; i < PixelUnpackRing::kSlotCount; i++) {
+            int ticket = ring.claim(64);
+            if(ticket >= 0) tickets.push_back(ticket);
+        }
+        for(int ticket : tickets) ring.cancel(ticket);
+        if(tickets.size() == (size_t)PixelUnpackRing::kSlotCount) return true;
+    }
+    return false;
+}
+
+}
+
+TEST(PixelUnpackRing, UploadsWhatWasStaged) {
+    HostGlContext gl;
+    if(!gl.create(16, 16)) SKIP_TEST("no EGL display with GLES 3");
+    PixelUnpackRing ring;
+    ASSERT_TRUE(ring.create());
+
+    constexpr int kSize = 8;
+    std::vector<uint8_t> texels(kSize * kSize * 4);
+    for(size_t i = 0; i < texels.size(); i++) texels[i] = (uint8_t)(i * 29 + 3);
+    int ticket = ring.claim(texels.size());
+    ASSERT_TRUE(ticket >= 0);
+    ASSERT_TRUE(ring.data(ticket) != nullptr);
+    memcpy(ring.data(ticket), texels.data(), texels.size());
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    ASSERT_TRUE(ring.begin(ticket));
+    /* An offset into the bound slot */
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, kSize, kSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    ring.end(ticket);
+    /* Uploaded : the ticket is spent */
+    EXPECT_TRUE(ring.data(ticket) == nullptr);
+
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    ASSERT_EQ(glCheckFramebufferStatus(GL_FRAMEBUFFER), (GLenum)GL_FRAMEBUFFER_COMPLETE);
+    std::vector<uint8_t> read(texels.size(), 0);
+    glReadPixels(0, 0, kSize, kSize, GL_RGBA, GL_UNSIGNED_BYTE, read.data());
+    EXPECT_TRUE(read == texels);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &texture);
+
+    /* The slot comes back once the GPU copied out of it */
+    EXPECT_TRUE(RecycleUntilAllFree(ring));
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(PixelUnpackRing, ClaimsFromThePreviousContextKeepTheirSlot) {
+    HostGlContext gl;
+    if(!gl.create(16, 16)) SKIP_TEST("no EGL display with GLES 3");
+    PixelUnpackRing ring;
+    ASSERT_TRUE(ring.create());
+
+    /* Two decode jobs hold slots while the surface is recreated */
+    int published = ring.claim(64);
+    int dropped = ring.claim(64);
+    ASSERT_TRUE(published >= 0);
+    ASSERT_TRUE(dropped >= 0);
+    ASSERT_TRUE(gl.recreate());
+    ASSERT_TRUE(ring.create());
+
+    /* Nothing to write into, nothing to upload */
+    EXPECT_TRUE(ring.data(published) == nullptr);
+    EXPECT_TRUE(ring.data(dropped) == nullptr);
+
+    /* Only the slot nobody held is mapped in the new context */
+    int fresh = ring.claim(64);
+    EXPECT_TRUE(fresh >= 0);
+    EXPECT_TRUE(ring.data(fresh) != nullptr);
+    EXPECT_NE(SlotOf(fresh), SlotOf(published));
+    EXPECT_NE(SlotOf(fresh), SlotOf(dropped));
+    EXPECT_EQ(ring.claim(64), -1);
+
+    /* Refused when it reaches the GL thread, cancelled when its result is dropped */
+    EXPECT_FALSE(ring.begin(published));
+    ring.cancel(dropped);
+    /* Spent tickets stay harmless */
+    ring.cancel(published);
+    ring.cancel(dropped);
+    EXPECT_FALSE(ring.begin(dropped));
+    ring.cancel(fresh);
+
+    /* Both slots are mapped again, in this context */
+    EXPECT_TRUE(RecycleUntilAllFree(ring));
+    int ticket = ring.claim(64);
+    ASSERT_TRUE(ticket >= 0);
+    ASSERT_TRUE(ring.begin(ticket));
+    ring.end(ticket);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(PixelUnpackRing, NoSlotHasTwoOwnersAcrossContexts) {
+    HostGlContext gl;
+    if(!gl.create(16, 16)) SKIP_TEST("no EGL display with GLES 3");
+    PixelUnpackRing ring;
+    ASSERT_TRUE(ring.create());
+
+    std::atomic<int> owners[PixelUnpackRing::kSlotCount];
+    for(std::atomic<int>& owner : owners) owner.store(0);
+    std::atomic<int> doubleClaims{0};
+    std::atomic<bool> running{true};
+    std::mutex publishedMutex;
+    std::vector<int> published;
+
+    /* Decode jobs : claim, look at the slot, then either drop it or publish it to the GL thread */
+    std::vector<std::thread> writers;
+    for(int w = 0; w < 3; w++) {
+        writers.emplace_back([&, w] {
+            for(int i = 0; running.load(std::memory_order_acquire); i++) {
+                int ticket = ring.claim(64);
+                if(ticket < 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if(owners[SlotOf(ticket)].fetch_add(1) != 0) doubleClaims.fetch_add(1);
+                if(!ring.data(ticket) || (i + w) % 2 == 0) {
+                    owners[SlotOf(ticket)].fetch_sub(1);
+                    ring.cancel(ticket);
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(publishedMutex);
+                published.push_back(ticket);
+            }
+        });
+    }
+
+    /* The GL thread : uploads what was published, and drops the context now and then */
+    auto upload = [&] {
+        std::vector<int> tickets;
+        {
+            std::lock_guard<std::mutex> lock(publishedMutex);
+            tickets.swap(published);
+        }
+        for(int ticket : tickets) {
+            owners[SlotOf(ticket)].fetch_sub(1);
+            if(ring.begin(ticket)) ring.end(ticket);
+        }
+    };
+    for(int frame = 0; frame < 400; frame++) {
+        upload();
+        ring.recycle();
+        if(frame % 20 == 10) {
+            /* Destroyed the way the app does it : nothing writes into the slots in this test */
+            ring.destroy();
+            ring.create();
+        }
+        std::this_thread::yield();
+    }
+    running.store(false, std::memory_order_release);
+    for(std::thread& writer : writers) writer.join();
+    upload();
+
+    EXPECT_EQ(doubleClaims.load(), 0);
+    /* And no slot was lost on the way */
+    EXPECT_TRUE(RecycleUntilAllFree(ring));
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
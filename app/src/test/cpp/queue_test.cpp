@@ -0,0 +1,103 @@
+/*
+ * SpscQueue and MpscQueue across real threads, meant to run under BUILDINGAR_TSAN as well : every
+ * value arrives once, in each producer's order, and what the consumer reads was fully written.
+ */
+#include <mpsc_queue.h>
+#include <spsc_queue.h>
+#include <host_test.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kValues = 200000;
+
+struct Node {
+    int producer = 0;
+    int sequence = 0;
+    /* Written before the push, read after the pop : a race here is a missing barrier */
+    std::vector<int> payload;
+    Node* next = nullptr;
+};
+
+}
+
+TEST(SpscQueue, DeliversEveryValueInOrder) {
+    SpscQueue<std::unique_ptr<int>, 16> queue;
+    std::thread producer([&] {
+        for(int i = 0; i < kValues; i++) {
+            std::unique_ptr<int> value = std::make_unique<int>(i);
+            while(!queue.push(std::move(value))) std::this_thread::yield();
+        }
+    });
+
+    int expected = 0;
+    std::unique_ptr<int> value;
+    while(expected < kValues) {
+        if(!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(*value, expected);
+        expected++;
+    }
+    producer.join();
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(SpscQueue, PushFailsWhenFullWithoutMovingFrom) {
+    SpscQueue<std::unique_ptr<int>, 4> queue;
+    for(int i = 0; i < 4; i++) EXPECT_TRUE(queue.push(std::make_unique<int>(i)));
+    std::unique_ptr<int> extra = std::make_unique<int>(4);
+    EXPECT_FALSE(queue.push(std::move(extra)));
+    EXPECT_TRUE(extra != nullptr);
+
+    std::unique_ptr<int> value;
+    EXPECT_TRUE(queue.pop(value));
+    EXPECT_EQ(*value, 0);
+    EXPECT_TRUE(queue.push(std::move(extra)));
+}
+
+TEST(MpscQueue, DeliversEveryValueInEachProducersOrder) {
+    constexpr int kProducers = 4;
+    MpscQueue<Node> queue;
+    std::vector<std::thread> producers;
+    for(int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&queue, p] {
+            for(int i = 0; i < kValues / kProducers; i++) {
+                std::unique_ptr<Node> node = std::make_unique<Node>();
+                node->producer = p;
+                node->sequence = i;
+                node->payload.assign(4, i);
+                queue.push(std::move(node));
+            }
+        });
+    }
+
+    int next[kProducers] = {0};
+    int received = 0;
+    std::unique_ptr<Node> node;
+    while(received < kValues) {
+        if(!queue.pop(node)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(node->sequence, next[node->producer]);
+        ASSERT_EQ(node->payload.size(), (size_t)4);
+        EXPECT_EQ(node->payload[3], node->sequence);
+        next[node->producer]++;
+        received++;
+    }
+    for(std::thread& producer : producers) producer.join();
+    EXPECT_FALSE(queue.pop(node));
+}
+
+TEST(MpscQueue, DestructorFreesWhatWasNeverPopped) {
+    /* Leaks show up under ASan / LSan, here it only has to not crash */
+    MpscQueue<Node> queue;
+    for(int i = 0; i < 100; i++) queue.push(std::make_unique<Node>());
+    std::unique_ptr<Node> node;
+    EXPECT_TRUE(queue.pop(node));
+}
@@ -0,0 +1,158 @@
+/*
+ * ResolutionController fed with synthetic GPU times : a pass costing costAtFullMs at scale 1
+ * costs costAtFullMs * scale^2, fragment work being proportional to the pixel count.
+ */
+#include <resolution_controller.h>
+#include <host_test.h>
+
+namespace {
+
+constexpr double kEpsilon = 1e-5;
+
+/* Feeds count samples of the modelled cost at the current scale, returns how many changed it */
+int Feed(ResolutionController& controller, double costAtFullMs, int count) {
+    int changes = 0;
+    for(int i = 0; i < count; i++) {
+        double scale = controller.scale();
+        if(controller.addSample(costAtFullMs * scale * scale)) changes++;
+    }
+    return changes;
+}
+
+/* Feeds the modelled cost until the scale changes once. False if it never did */
+bool FeedUntilChange(ResolutionController& controller, double costAtFullMs, int maxCount) {
+    for(int i = 0; i < maxCount; i++) {
+        double scale = controller.scale();
+        if(controller.addSample(costAtFullMs * scale * scale)) return true;
+    }
+    return false;
+}
+
+}
+
+TEST(ResolutionController, DropsStraightToThePredictedScale) {
+    ResolutionController controller;
+    const ResolutionController::Config& config = controller.config();
+    EXPECT_NEAR(controller.scale(), 1.0f, kEpsilon);
+
+    /* Twice the budget : sqrt(1/2) = 0.707, floored to the 0.05 grid, in a single step */
+    for(int i = 0; i < config.settleSamples - 1; i++) EXPECT_FALSE(controller.addSample(12.0));
+    EXPECT_TRUE(controller.addSample(12.0));
+    EXPECT_NEAR(controller.scale(), 0.70f, kEpsilon);
+    /* The average carries over, predicted for the new pixel count */
+    EXPECT_NEAR(controller.averageMs(), 12.0 * 0.70 * 0.70, 1e-4);
+
+    /* Which then fits : it stays there */
+    EXPECT_EQ(Feed(controller, 12.0, 100), 0);
+    EXPECT_NEAR(controller.scale(), 0.70f, kEpsilon);
+}
+
+TEST(ResolutionController, IgnoresSamplesWhileSettling) {
+    ResolutionController controller;
+    int settle = controller.config().settleSamples;
+    Feed(controller, 12.0, settle);
+    ASSERT_NEAR(controller.scale(), 0.70f, kEpsilon);
+    double predicted = controller.averageMs();
+
+    /* Timings right after a change still describe the old scale, even absurd ones are skipped */
+    for(int i = 0; i < settle; i++) EXPECT_FALSE(controller.addSample(100.0));
+    EXPECT_NEAR(controller.averageMs(), predicted, 1e-9);
+
+    /* Then as many samples are averaged before anything is decided, however slow they are */
+    for(int i = 0; i < settle - 1; i++) EXPECT_FALSE(controller.addSample(20.0));
+    EXPECT_GT(controller.averageMs(), controller.config().targetMs);
+    EXPECT_NEAR(controller.scale(), 0.70f, kEpsilon);
+    EXPECT_TRUE(controller.addSample(20.0));
+    EXPECT_LT(controller.scale(), 0.70f);
+}
+
+TEST(ResolutionController, NegativeSamplesAreNoMeasurement) {
+    ResolutionController controller;
+    /* GpuTimer::end() has nothing new most frames */
+    for(int i = 0; i < 50; i++) EXPECT_FALSE(controller.addSample(-1.0));
+    EXPECT_NEAR(controller.averageMs(), 0.0, 1e-9);
+    EXPECT_NEAR(controller.scale(), 1.0f, kEpsilon);
+}
+
+TEST(ResolutionController, GrowsBackOneStepAtATime) {
+    ResolutionController controller;
+    Feed(controller, 12.0, controller.config().settleSamples);
+    ASSERT_NEAR(controller.scale(), 0.70f, kEpsilon);
+
+    /* The scene got cheap : 0.75, 0.80 ... one step per settled decision, never a jump */
+    float previous = controller.scale();
+    int changes = 0;
+    for(int i = 0; i < 400 && controller.scale() < 1.0f; i++) {
+        double scale = controller.scale();
+        if(controller.addSample(2.0 * scale * scale)) {
+            EXPECT_NEAR(controller.scale() - previous, controller.config().step, kEpsilon);
+            previous = controller.scale();
+            changes++;
+        }
+    }
+    EXPECT_NEAR(controller.scale(), 1.0f, kEpsilon);
+    EXPECT_EQ(changes, 6);
+}
+
+TEST(ResolutionController, GrowsOnlyWhenThePredictionFits) {
+    ResolutionController::Config config;
+    config.targetMs = 6.0;
+    /* Growth is considered up to 5.7 ms, the prediction decides from there */
+    config.growBelow = 0.95;
+    config.minScale = 0.5f;
+    ResolutionController controller(config);
+    Feed(controller, 100.0, config.settleSamples);
+    ASSERT_NEAR(controller.scale(), 0.5f, kEpsilon);
+
+    /* 5.5 ms at 0.50 would be 5.5 * 1.21 = 6.66 ms at 0.55 : over budget, stays */
+    EXPECT_EQ(Feed(controller, 5.5 / 0.25, 200), 0);
+    EXPECT_NEAR(controller.scale(), 0.5f, kEpsilon);
+
+    /* 4.9 ms would be 5.93 ms : fits, grows */
+    EXPECT_TRUE(FeedUntilChange(controller, 4.9 / 0.25, 200));
+    EXPECT_NEAR(controller.scale(), 0.55f, kEpsilon);
+}
+
+TEST(ResolutionController, QuantizesAtTheMinimumScale) {
+    ResolutionController::Config config;
+    /* Not a step multiple : the floor is minScale itself, not the grid below it */
+    config.minScale = 0.52f;
+    ResolutionController controller(config);
+
+    Feed(controller, 1000.0, config.settleSamples);
+    EXPECT_NEAR(controller.scale(), 0.52f, kEpsilon);
+    /* Still over budget, but nothing left to drop */
+    EXPECT_EQ(Feed(controller, 1000.0, 100), 0);
+    EXPECT_NEAR(controller.scale(), 0.52f, kEpsilon);
+
+    /* Growing goes back onto the grid : 0.52 + 0.05 floors to 0.55 */
+    EXPECT_TRUE(FeedUntilChange(controller, 1.0, 200));
+    EXPECT_NEAR(controller.scale(), 0.55f, kEpsilon);
+}
+
+TEST(ResolutionController, QuantizesAtTheMaximumScale) {
+    ResolutionController::Config config;
+    config.maxScale = 0.93f;
+    ResolutionController controller(config);
+    /* The start is the grid point under maxScale */
+    EXPECT_NEAR(controller.scale(), 0.90f, kEpsilon);
+    /* 0.95 clamps to 0.93, which floors back to 0.90 : no change however cheap */
+    EXPECT_EQ(Feed(controller, 0.1, 100), 0);
+    EXPECT_NEAR(controller.scale(), 0.90f, kEpsilon);
+
+    /* Lowering maxScale below the current scale pulls it down right away */
+    config.maxScale = 0.8f;
+    controller.setConfig(config);
+    EXPECT_NEAR(controller.scale(), 0.80f, kEpsilon);
+}
+
+TEST(ResolutionController, StepSumsDontFloorBackDown) {
+    ResolutionController::Config config;
+    config.minScale = 0.55f;
+    ResolutionController controller(config);
+    Feed(controller, 1000.0, config.settleSamples);
+    ASSERT_NEAR(controller.scale(), 0.55f, kEpsilon);
+    /* 0.55f + 0.05f is a hair under 0.6 in binary */
+    EXPECT_TRUE(FeedUntilChange(controller, 1.0, 200));
+    EXPECT_NEAR(controller.scale(), 0.60f, kEpsilon);
+}
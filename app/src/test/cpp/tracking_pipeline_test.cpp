@@ -0,0 +1,127 @@
+/*
+ * TrackingPipeline's tracking thread against arcore_sim, which never blocks in ArSession_update :
+ * only the camera textures the render thread hands back hold it up.
+ */
+#include <tracking_pipeline.h>
+#include <arcore_sim.h>
+#include <host_gl.h>
+#include <host_test.h>
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+constexpr int kTraceFrames = 20000;
+constexpr int64_t kFrameIntervalNs = 33333333;
+
+/* The synthetic trace stamps frame i with i * kFrameIntervalNs + 1 */
+int64_t FrameOf(int64_t timestamp_ns) {
+    return (timestamp_ns - 1) / kFrameIntervalNs;
+}
+
+struct Session {
+    ArSession* session = nullptr;
+
+    Session() {
+        ArSim_useSyntheticTrace(kTraceFrames);
+        ArSession_create(nullptr, nullptr, &session);
+        ArSession_resume(session);
+    }
+    ~Session() { ArSession_destroy(session); }
+};
+
+bool WaitForFirstSnapshot(TrackingPipeline& pipeline) {
+    for(int i = 0; i < 1000; i++) {
+        if(pipeline.acquire()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+}
+
+TEST(TrackingPipeline, NeverRunsMoreThanTwoFramesAheadOfTheHeldTexture) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    Session session;
+    GLuint restoreTexture = 0;
+    glGenTextures(1, &restoreTexture);
+
+    TrackingPipeline pipeline;
+    ASSERT_TRUE(pipeline.start(session.session, restoreTexture));
+    ASSERT_TRUE(WaitForFirstSnapshot(pipeline));
+
+    int64_t firstFrame = FrameOf(pipeline.latest().timestamp_ns);
+    for(int round = 0; round < 20; round++) {
+        int64_t heldFrame = FrameOf(pipeline.latest().timestamp_ns);
+        GLuint heldTexture = pipeline.latest().camera_texture;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        /* ARCore may only latch into the two textures the render thread doesn't hold */
+        int64_t ahead = FrameOf(pipeline.publishedTimestamp()) - heldFrame;
+        EXPECT_LE(ahead, 2);
+        EXPECT_GT(ahead, 0);
+
+        ASSERT_TRUE(pipeline.acquire());
+        EXPECT_NE(pipeline.latest().camera_texture, heldTexture);
+        /* Stands in for the frame's swap, which sends the release fence on its way */
+        glFlush();
+    }
+    /* Held back, not stalled */
+    EXPECT_GT(FrameOf(pipeline.latest().timestamp_ns), firstFrame + 20);
+
+    pipeline.stop();
+    glDeleteTextures(1, &restoreTexture);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}
+
+TEST(TrackingPipeline, RunsFreelyUntilTheFirstAcquire) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    Session session;
+    GLuint restoreTexture = 0;
+    glGenTextures(1, &restoreTexture);
+
+    TrackingPipeline pipeline;
+    ASSERT_TRUE(pipeline.start(session.session, restoreTexture));
+    /* Nothing is held before the render thread's first acquire() */
+    for(int i = 0; i < 1000 && FrameOf(pipeline.publishedTimestamp()) < 10; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GE(FrameOf(pipeline.publishedTimestamp()), 10);
+
+    pipeline.stop();
+    glDeleteTextures(1, &restoreTexture);
+}
+
+TEST(TrackingPipeline, ForgetLeavesTheNewContextsObjectsAlone) {
+    HostGlContext gl;
+    if(!gl.create(64, 64)) SKIP_TEST("no EGL display with GLES 3");
+    Session session;
+    GLuint restoreTexture = 0;
+    glGenTextures(1, &restoreTexture);
+
+    TrackingPipeline pipeline;
+    ASSERT_TRUE(pipeline.start(session.session, restoreTexture));
+    ASSERT_TRUE(WaitForFirstSnapshot(pipeline));
+
+    /* Surface recreation : the new context hands out the names the pipeline still remembers */
+    ASSERT_TRUE(gl.recreate());
+    GLuint textures[TrackingPipeline::kCameraTextureCount + 1] = {0};
+    glGenTextures(TrackingPipeline::kCameraTextureCount + 1, textures);
+    for(GLuint texture : textures) glBindTexture(GL_TEXTURE_2D, texture);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    pipeline.forget();
+    EXPECT_FALSE(pipeline.isRunning());
+    for(GLuint texture : textures) EXPECT_TRUE(glIsTexture(texture));
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+
+    /* And it starts over on the new context */
+    ASSERT_TRUE(pipeline.start(session.session, textures[0]));
+    EXPECT_TRUE(WaitForFirstSnapshot(pipeline));
+    pipeline.stop();
+    glDeleteTextures(TrackingPipeline::kCameraTextureCount + 1, textures);
+    EXPECT_EQ(glGetError(), (GLenum)GL_NO_ERROR);
+}